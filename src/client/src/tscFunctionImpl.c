@@ -14,6 +14,7 @@
  */
 
 #include "os.h"
+#include "qAggFunc.h"
 #include "qast.h"
 #include "qextbuffer.h"
 #include "qfill.h"
@@ -416,14 +417,7 @@ static void count_function(SQLFunctionCtx *pCtx) {
     numOfElem = pCtx->size - pCtx->preAggVals.statis.numOfNull;
   } else {
     if (pCtx->hasNull) {
-      for (int32_t i = 0; i < pCtx->size; ++i) {
-        char *val = GET_INPUT_CHAR_INDEX(pCtx, i);
-        if (isNull(val, pCtx->inputType)) {
-          continue;
-        }
-        
-        numOfElem += 1;
-      }
+      numOfElem = aggCountNotNull(GET_INPUT_CHAR(pCtx), pCtx->size, pCtx->inputType, pCtx->inputBytes);
     } else {
       /*
        * when counting on the primary time stamp column and no statistics data is provided,
@@ -486,18 +480,6 @@ int32_t no_data_info(SQLFunctionCtx *pCtx, TSKEY start, TSKEY end, int32_t colId
   return BLK_DATA_NO_NEEDED;
 }
 
-#define LIST_ADD_N(x, ctx, p, t, numOfElem, tsdbType)              \
-  {                                                                \
-    t *d = (t *)(p);                                               \
-    for (int32_t i = 0; i < (ctx)->size; ++i) {                    \
-      if (((ctx)->hasNull) && isNull((char *)&(d)[i], tsdbType)) { \
-        continue;                                                  \
-      };                                                           \
-      (x) += (d)[i];                                               \
-      (numOfElem)++;                                               \
-    }                                                              \
-  };
-
 #define UPDATE_DATA(ctx, left, right, num, sign, k) \
   do {                                              \
     if (((left) < (right)) ^ (sign)) {              \
@@ -517,20 +499,14 @@ do {                                              \
   } while (0);
 
 
-#define LOOPCHECK_N(val, list, ctx, tsdbType, sign, num)          \
-  for (int32_t i = 0; i < ((ctx)->size); ++i) {                   \
-    if ((ctx)->hasNull && isNull((char *)&(list)[i], tsdbType)) { \
-      continue;                                                   \
-    }                                                             \
-    TSKEY key = (ctx)->ptsList[i];                                \
-    UPDATE_DATA(ctx, val, (list)[i], num, sign, key);             \
-  }
-
-#define TYPED_LOOPCHECK_N(type, data, list, ctx, tsdbType, sign, notNullElems) \
-  do {                                                                         \
-    type *_data = (type *)data;                                                \
-    type *_list = (type *)list;                                                \
-    LOOPCHECK_N(*_data, _list, ctx, tsdbType, sign, notNullElems);             \
+#define UPDATE_DATA_AT(ctx, type, output, input, index, sign, k) \
+  do {                                                           \
+    type *_out = (type *)(output);                               \
+    type  _val = ((type *)(input))[index];                       \
+    if ((*_out < _val) ^ (sign)) {                               \
+      *_out = _val;                                              \
+      DO_UPDATE_TAG_COLUMNS(ctx, k);                             \
+    }                                                            \
   } while (0)
 
 static void do_sum(SQLFunctionCtx *pCtx) {
@@ -554,22 +530,28 @@ static void do_sum(SQLFunctionCtx *pCtx) {
     
     if (pCtx->inputType >= TSDB_DATA_TYPE_TINYINT && pCtx->inputType <= TSDB_DATA_TYPE_BIGINT) {
       int64_t *retVal = (int64_t*) pCtx->aOutputBuf;
+      int64_t  sum = 0;
       
       if (pCtx->inputType == TSDB_DATA_TYPE_TINYINT) {
-        LIST_ADD_N(*retVal, pCtx, pData, int8_t, notNullElems, pCtx->inputType);
+        aggSum_i8(pData, pCtx->size, pCtx->hasNull, &sum, &notNullElems);
       } else if (pCtx->inputType == TSDB_DATA_TYPE_SMALLINT) {
-        LIST_ADD_N(*retVal, pCtx, pData, int16_t, notNullElems, pCtx->inputType);
+        aggSum_i16(pData, pCtx->size, pCtx->hasNull, &sum, &notNullElems);
       } else if (pCtx->inputType == TSDB_DATA_TYPE_INT) {
-        LIST_ADD_N(*retVal, pCtx, pData, int32_t, notNullElems, pCtx->inputType);
+        aggSum_i32(pData, pCtx->size, pCtx->hasNull, &sum, &notNullElems);
       } else if (pCtx->inputType == TSDB_DATA_TYPE_BIGINT) {
-        LIST_ADD_N(*retVal, pCtx, pData, int64_t, notNullElems, pCtx->inputType);
+        aggSum_i64(pData, pCtx->size, pCtx->hasNull, &sum, &notNullElems);
       }
+      *retVal += sum;
     } else if (pCtx->inputType == TSDB_DATA_TYPE_DOUBLE) {
       double *retVal = (double*) pCtx->aOutputBuf;
-      LIST_ADD_N(*retVal, pCtx, pData, double, notNullElems, pCtx->inputType);
+      double  sum = 0;
+      aggSum_dd(pData, pCtx->size, pCtx->hasNull, &sum, &notNullElems);
+      *retVal += sum;
     } else if (pCtx->inputType == TSDB_DATA_TYPE_FLOAT) {
       double *retVal = (double*) pCtx->aOutputBuf;
-      LIST_ADD_N(*retVal, pCtx, pData, float, notNullElems, pCtx->inputType);
+      double  sum = 0;
+      aggSum_ds(pData, pCtx->size, pCtx->hasNull, &sum, &notNullElems);
+      *retVal += sum;
     }
   }
   
@@ -690,6 +672,11 @@ static void sum_func_second_merge(SQLFunctionCtx *pCtx) {
 }
 
 static int32_t precal_req_load_info(SQLFunctionCtx *pCtx, TSKEY start, TSKEY end, int32_t colId) {
+  // the timestamp of the min/max value required by the tag columns is not in the statistics of data block
+  if (pCtx->tagInfo.numOfTagCols > 0) {
+    return BLK_DATA_ALL_NEEDED;
+  }
+
   return BLK_DATA_FILEDS_NEEDED;
 }
 
@@ -779,21 +766,25 @@ static void avg_function(SQLFunctionCtx *pCtx) {
       *pVal += GET_DOUBLE_VAL(&(pCtx->preAggVals.statis.sum));
     }
   } else {
-    void *pData = GET_INPUT_CHAR(pCtx);
+    void   *pData = GET_INPUT_CHAR(pCtx);
+    int64_t isum = 0;
+    double  dsum = 0;
     
     if (pCtx->inputType == TSDB_DATA_TYPE_TINYINT) {
-      LIST_ADD_N(*pVal, pCtx, pData, int8_t, notNullElems, pCtx->inputType);
+      aggSum_i8(pData, pCtx->size, pCtx->hasNull, &isum, &notNullElems);
     } else if (pCtx->inputType == TSDB_DATA_TYPE_SMALLINT) {
-      LIST_ADD_N(*pVal, pCtx, pData, int16_t, notNullElems, pCtx->inputType);
+      aggSum_i16(pData, pCtx->size, pCtx->hasNull, &isum, &notNullElems);
     } else if (pCtx->inputType == TSDB_DATA_TYPE_INT) {
-      LIST_ADD_N(*pVal, pCtx, pData, int32_t, notNullElems, pCtx->inputType);
+      aggSum_i32(pData, pCtx->size, pCtx->hasNull, &isum, &notNullElems);
     } else if (pCtx->inputType == TSDB_DATA_TYPE_BIGINT) {
-      LIST_ADD_N(*pVal, pCtx, pData, int64_t, notNullElems, pCtx->inputType);
+      aggSum_i64(pData, pCtx->size, pCtx->hasNull, &isum, &notNullElems);
     } else if (pCtx->inputType == TSDB_DATA_TYPE_DOUBLE) {
-      LIST_ADD_N(*pVal, pCtx, pData, double, notNullElems, pCtx->inputType);
+      aggSum_dd(pData, pCtx->size, pCtx->hasNull, &dsum, &notNullElems);
     } else if (pCtx->inputType == TSDB_DATA_TYPE_FLOAT) {
-      LIST_ADD_N(*pVal, pCtx, pData, float, notNullElems, pCtx->inputType);
+      aggSum_ds(pData, pCtx->size, pCtx->hasNull, &dsum, &notNullElems);
     }
+    
+    *pVal += (double)isum + dsum;
   }
   
   if (!pCtx->hasNull) {
@@ -936,6 +927,11 @@ static void minMax_function(SQLFunctionCtx *pCtx, char *pOutput, int32_t isMin,
     *notNullElems = pCtx->size - pCtx->preAggVals.statis.numOfNull;
     assert(*notNullElems >= 0);
     
+    // all data are null in current data block, the min/max value in statistics is invalid
+    if (*notNullElems == 0) {
+      return;
+    }
+    
     void *  tval = NULL;
     int16_t index = 0;
     
@@ -957,7 +953,8 @@ static void minMax_function(SQLFunctionCtx *pCtx, char *pOutput, int32_t isMin,
       index = 0;
     }
     
-    TSKEY key = pCtx->ptsList[index];
+    // the data block may not be loaded, the timestamp is only required by the tag columns
+    TSKEY key = (pCtx->tagInfo.numOfTagCols > 0) ? pCtx->ptsList[index] : 0;
     
     if (pCtx->inputType >= TSDB_DATA_TYPE_TINYINT && pCtx->inputType <= TSDB_DATA_TYPE_BIGINT) {
       int64_t val = GET_INT64_VAL(tval);
@@ -1008,39 +1005,42 @@ static void minMax_function(SQLFunctionCtx *pCtx, char *pOutput, int32_t isMin,
   void *p = GET_INPUT_CHAR(pCtx);
   *notNullElems = 0;
   
-  if (pCtx->inputType >= TSDB_DATA_TYPE_TINYINT && pCtx->inputType <= TSDB_DATA_TYPE_BIGINT) {
-    if (pCtx->inputType == TSDB_DATA_TYPE_TINYINT) {
-      TYPED_LOOPCHECK_N(int8_t, pOutput, p, pCtx, pCtx->inputType, isMin, *notNullElems);
-    } else if (pCtx->inputType == TSDB_DATA_TYPE_SMALLINT) {
-      TYPED_LOOPCHECK_N(int16_t, pOutput, p, pCtx, pCtx->inputType, isMin, *notNullElems);
-    } else if (pCtx->inputType == TSDB_DATA_TYPE_INT) {
-      int32_t *pData = p;
-      int32_t *retVal = (int32_t*) pOutput;
-      
-      for (int32_t i = 0; i < pCtx->size; ++i) {
-        if (pCtx->hasNull && isNull((const char*)&pData[i], pCtx->inputType)) {
-          continue;
-        }
-        
-        if ((*retVal < pData[i]) ^ isMin) {
-          *retVal = pData[i];
-          TSKEY k = pCtx->ptsList[i];
-          
-          DO_UPDATE_TAG_COLUMNS(pCtx, k);
-        }
-        
-        *notNullElems += 1;
-      }
+  /*
+   * The kernel finds the row that the row by row comparison would end up with, so the output and the tag columns
+   * are updated once for the block.
+   */
+  int32_t index = -1;
+  switch (pCtx->inputType) {
+    case TSDB_DATA_TYPE_TINYINT:  index = aggMinMax_i8(p, pCtx->size, pCtx->hasNull, isMin, notNullElems); break;
+    case TSDB_DATA_TYPE_SMALLINT: index = aggMinMax_i16(p, pCtx->size, pCtx->hasNull, isMin, notNullElems); break;
+    case TSDB_DATA_TYPE_INT:      index = aggMinMax_i32(p, pCtx->size, pCtx->hasNull, isMin, notNullElems); break;
+    case TSDB_DATA_TYPE_BIGINT:   index = aggMinMax_i64(p, pCtx->size, pCtx->hasNull, isMin, notNullElems); break;
+    case TSDB_DATA_TYPE_FLOAT:    index = aggMinMax_ds(p, pCtx->size, pCtx->hasNull, isMin, notNullElems); break;
+    case TSDB_DATA_TYPE_DOUBLE:   index = aggMinMax_dd(p, pCtx->size, pCtx->hasNull, isMin, notNullElems); break;
+    default: break;
+  }
+  
+  if (index < 0) {
+    return;
+  }
+  
+  TSKEY key = pCtx->ptsList[index];
+  
+  if (pCtx->inputType == TSDB_DATA_TYPE_TINYINT) {
+    UPDATE_DATA_AT(pCtx, int8_t, pOutput, p, index, isMin, key);
+  } else if (pCtx->inputType == TSDB_DATA_TYPE_SMALLINT) {
+    UPDATE_DATA_AT(pCtx, int16_t, pOutput, p, index, isMin, key);
+  } else if (pCtx->inputType == TSDB_DATA_TYPE_INT) {
+    UPDATE_DATA_AT(pCtx, int32_t, pOutput, p, index, isMin, key);
 #if defined(_DEBUG_VIEW)
-      tscTrace("max value updated:%d", *retVal);
+    tscTrace("max value updated:%d", *(int32_t *)pOutput);
 #endif
-    } else if (pCtx->inputType == TSDB_DATA_TYPE_BIGINT) {
-      TYPED_LOOPCHECK_N(int64_t, pOutput, p, pCtx, pCtx->inputType, isMin, *notNullElems);
-    }
-  } else if (pCtx->inputType == TSDB_DATA_TYPE_DOUBLE) {
-    TYPED_LOOPCHECK_N(double, pOutput, p, pCtx, pCtx->inputType, isMin, *notNullElems);
+  } else if (pCtx->inputType == TSDB_DATA_TYPE_BIGINT) {
+    UPDATE_DATA_AT(pCtx, int64_t, pOutput, p, index, isMin, key);
   } else if (pCtx->inputType == TSDB_DATA_TYPE_FLOAT) {
-    TYPED_LOOPCHECK_N(float, pOutput, p, pCtx, pCtx->inputType, isMin, *notNullElems);
+    UPDATE_DATA_AT(pCtx, float, pOutput, p, index, isMin, key);
+  } else if (pCtx->inputType == TSDB_DATA_TYPE_DOUBLE) {
+    UPDATE_DATA_AT(pCtx, double, pOutput, p, index, isMin, key);
   }
 }
 
@@ -3446,6 +3446,9 @@ static void spread_function(SQLFunctionCtx *pCtx) {
         pInfo->max = GET_DOUBLE_VAL(&(pCtx->preAggVals.statis.max));
       }
     }
+    
+    // the data block is not loaded when the statistics are used
+    goto _spread_over;
   } else {
 //    if (pInfo->min > pCtx->param[1].dKey) {
 //      pInfo->min = pCtx->param[1].dKey;
@@ -149,9 +149,14 @@ typedef struct SDataCol {
   int             len;        // column data length
   VarDataOffsetT *dataOff;    // For binary and nchar data, the offset in the data column
   void *          pData;      // Actual data pointer
+  int             dictSize;   // For dictionary decoded binary and nchar data, the number of distinct values, or 0
+  uint8_t *       codes;      // The index of the value of each row in the distinct values, valid if dictSize > 0
 } SDataCol;
 
-static FORCE_INLINE void dataColReset(SDataCol *pDataCol) { pDataCol->len = 0; }
+static FORCE_INLINE void dataColReset(SDataCol *pDataCol) {
+  pDataCol->len = 0;
+  pDataCol->dictSize = 0;
+}
 
 void dataColInit(SDataCol *pDataCol, STColumn *pCol, void **pBuf, int maxPoints);
 void dataColAppendVal(SDataCol *pCol, void *value, int numOfPoints, int maxPoints);
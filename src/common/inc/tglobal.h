@@ -81,9 +81,24 @@ extern int32_t tsDaysToKeep;
 extern int32_t tsMinRowsInFileBlock;
 extern int32_t tsMaxRowsInFileBlock;
 extern int16_t tsCommitTime;  // seconds
+extern int32_t tsCommitThreads;
+extern char    tsRollupIntervals[];
+extern int32_t tsBlockCacheSize;
+extern int32_t tsBlockIdxCacheSize;
+extern int32_t tsTagHashIndex;
+extern int32_t tsTagCondCacheSize;
+extern int32_t tsReadAheadBlocks;
+extern int32_t tsDecompressThreads;
+extern int32_t tsAdaptiveComp;
+extern int32_t tsCompactSubBlocks;
+extern int32_t tsCompactTombSize;
+extern int32_t tsCompactIORate;
 extern int32_t tsTimePrecision;
 extern int16_t tsCompression;
 extern int16_t tsWAL;
+extern int32_t tsWalFsyncInterval;
+extern int32_t tsWalFsyncSize;
+extern int32_t tsWalSegmentSize;
 extern int32_t tsReplications;
 
 extern int16_t tsAffectedRowsMod;
@@ -158,6 +173,7 @@ extern uint32_t taosMaxTmrCtrl;
 
 extern int  tsRpcTimer;
 extern int  tsRpcMaxTime;
+extern int  tsRpcUdpReusePort;
 extern int  tsUdpDelay;
 extern char version[];
 extern char compatible_version[];
@@ -173,6 +173,7 @@ void dataColInit(SDataCol *pDataCol, STColumn *pCol, void **pBuf, int maxPoints)
   pDataCol->offset = colOffset(pCol) + TD_DATA_ROW_HEAD_SIZE;
 
   pDataCol->len = 0;
+  pDataCol->dictSize = 0;  // the codes buffer is kept for the next decoded one
   if (pDataCol->type == TSDB_DATA_TYPE_BINARY || pDataCol->type == TSDB_DATA_TYPE_NCHAR) {
     pDataCol->spaceSize = (sizeof(VarDataLenT) + pDataCol->bytes) * maxPoints;
     pDataCol->dataOff = (VarDataOffsetT *)(*pBuf);
@@ -193,6 +194,7 @@ void dataColAppendVal(SDataCol *pCol, void *value, int numOfPoints, int maxPoint
   switch (pCol->type) {
     case TSDB_DATA_TYPE_BINARY:
     case TSDB_DATA_TYPE_NCHAR:
+      pCol->dictSize = 0;
       // set offset
       pCol->dataOff[numOfPoints] = pCol->len;
       // Copy data
@@ -213,6 +215,7 @@ void dataColPopPoints(SDataCol *pCol, int pointsToPop, int numOfPoints) {
 
   ASSERT(pointsLeft > 0);
 
+  pCol->dictSize = 0;
   if (pCol->type == TSDB_DATA_TYPE_BINARY || pCol->type == TSDB_DATA_TYPE_NCHAR) {
     ASSERT(pCol->len > 0);
     VarDataOffsetT toffset = pCol->dataOff[pointsToPop];
@@ -245,6 +248,7 @@ bool isNEleNull(SDataCol *pCol, int nEle) {
 
 void dataColSetNEleNull(SDataCol *pCol, int nEle, int maxPoints) {
   char *ptr = NULL;
+  pCol->dictSize = 0;
   switch (pCol->type) {
     case TSDB_DATA_TYPE_BINARY:
     case TSDB_DATA_TYPE_NCHAR:
@@ -311,6 +315,9 @@ void tdInitDataCols(SDataCols *pCols, STSchema *pSchema) {
 
 void tdFreeDataCols(SDataCols *pCols) {
   if (pCols) {
+    for (int i = 0; i < pCols->maxCols; i++) {
+      tfree(pCols->cols[i].codes);
+    }
     tfree(pCols->buf);
     free(pCols);
   }
@@ -75,6 +75,7 @@ int32_t tsShellActivityTimer = 3;     // second
 int32_t tsTableMetaKeepTimer = 7200;  // second
 int32_t tsRpcTimer = 300;
 int32_t tsRpcMaxTime = 600;      // seconds;
+int32_t tsRpcUdpReusePort = 0;   // UDP threads of a server share its port instead of using port + i
 
 float   tsNumOfThreadsPerCore = 1.0;
 float   tsRatioOfQueryThreads = 0.5;
@@ -94,9 +95,24 @@ int32_t tsDaysToKeep     = TSDB_DEFAULT_KEEP;
 int32_t tsMinRowsInFileBlock = TSDB_DEFAULT_MIN_ROW_FBLOCK;
 int32_t tsMaxRowsInFileBlock = TSDB_DEFAULT_MAX_ROW_FBLOCK;
 int16_t tsCommitTime    = TSDB_DEFAULT_COMMIT_TIME;  // seconds
+int32_t tsCommitThreads = TSDB_DEFAULT_COMMIT_THREADS;  // max threads to commit file groups of a vnode
+char    tsRollupIntervals[TSDB_ROLLUP_INTERVALS_LEN] = {0};  // seconds of the rollup levels, e.g. "60,3600,86400"
+int32_t tsBlockCacheSize = TSDB_DEFAULT_BLOCK_CACHE_SIZE;  // MB, decoded file blocks cached by each vnode for queries
+int32_t tsBlockIdxCacheSize = TSDB_DEFAULT_BLOCK_IDX_CACHE_SIZE;  // MB, sparse block indexes cached by each vnode
+int32_t tsTagHashIndex = TSDB_DEFAULT_TAG_HASH_INDEX;  // index the child tables of a super table by each tag value
+int32_t tsTagCondCacheSize = TSDB_DEFAULT_TAG_COND_CACHE_SIZE;  // MB, tables qualified by the tag conditions of each vnode
+int32_t tsReadAheadBlocks = TSDB_DEFAULT_READ_AHEAD_BLOCKS;  // file blocks read ahead by a scan
+int32_t tsDecompressThreads = TSDB_DEFAULT_DECOMPRESS_THREADS;  // threads decoding the columns of a block in parallel
 int32_t tsTimePrecision = TSDB_DEFAULT_PRECISION;
 int16_t tsCompression   = TSDB_DEFAULT_COMP_LEVEL;
+int32_t tsAdaptiveComp  = TSDB_DEFAULT_ADAPTIVE_COMP;  // choose the algorithm of each column of a file block
+int32_t tsCompactSubBlocks = TSDB_DEFAULT_COMPACT_SUB_BLOCKS;  // percent of sub-blocks to compact a file group
+int32_t tsCompactTombSize  = TSDB_DEFAULT_COMPACT_TOMB_SIZE;   // percent of unused size to compact a file group
+int32_t tsCompactIORate    = TSDB_DEFAULT_COMPACT_IO_RATE;     // MB/s read and written by a compaction
 int16_t tsWAL           = TSDB_DEFAULT_WAL_LEVEL;
+int32_t tsWalFsyncInterval = TSDB_DEFAULT_WAL_FSYNC_INTERVAL;  // ms
+int32_t tsWalFsyncSize     = TSDB_DEFAULT_WAL_FSYNC_SIZE;      // KB
+int32_t tsWalSegmentSize   = TSDB_DEFAULT_WAL_SEGMENT_SIZE;    // MB
 int32_t tsReplications  = TSDB_DEFAULT_REPLICA_NUM;
 
 /**
@@ -494,6 +510,16 @@ static void doInitGlobalConfig() {
   cfg.unitType = TAOS_CFG_UTYPE_SECOND;
   taosInitConfigOption(cfg);
 
+  cfg.option = "rpcUdpReusePort";
+  cfg.ptr = &tsRpcUdpReusePort;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG;
+  cfg.minValue = 0;
+  cfg.maxValue = 1;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
   cfg.option = "statusInterval";
   cfg.ptr = &tsStatusInterval;
   cfg.valType = TAOS_CFG_VTYPE_INT32;
@@ -665,6 +691,86 @@ static void doInitGlobalConfig() {
   cfg.unitType = TAOS_CFG_UTYPE_SECOND;
   taosInitConfigOption(cfg);
 
+  cfg.option = "commitThreads";
+  cfg.ptr = &tsCommitThreads;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_COMMIT_THREADS;
+  cfg.maxValue = TSDB_MAX_COMMIT_THREADS;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "rollupIntervals";
+  cfg.ptr = tsRollupIntervals;
+  cfg.valType = TAOS_CFG_VTYPE_STRING;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = 0;
+  cfg.maxValue = 0;
+  cfg.ptrLength = TSDB_ROLLUP_INTERVALS_LEN;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "blockCacheSize";
+  cfg.ptr = &tsBlockCacheSize;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_BLOCK_CACHE_SIZE;
+  cfg.maxValue = TSDB_MAX_BLOCK_CACHE_SIZE;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_Mb;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "blockIdxCacheSize";
+  cfg.ptr = &tsBlockIdxCacheSize;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_BLOCK_IDX_CACHE_SIZE;
+  cfg.maxValue = TSDB_MAX_BLOCK_IDX_CACHE_SIZE;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_Mb;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "tagHashIndex";
+  cfg.ptr = &tsTagHashIndex;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_TAG_HASH_INDEX;
+  cfg.maxValue = TSDB_MAX_TAG_HASH_INDEX;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "tagCondCacheSize";
+  cfg.ptr = &tsTagCondCacheSize;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_TAG_COND_CACHE_SIZE;
+  cfg.maxValue = TSDB_MAX_TAG_COND_CACHE_SIZE;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_Mb;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "readAheadBlocks";
+  cfg.ptr = &tsReadAheadBlocks;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_READ_AHEAD_BLOCKS;
+  cfg.maxValue = TSDB_MAX_READ_AHEAD_BLOCKS;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "decompressThreads";
+  cfg.ptr = &tsDecompressThreads;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_DECOMPRESS_THREADS;
+  cfg.maxValue = TSDB_MAX_DECOMPRESS_THREADS;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
   cfg.option = "comp";
   cfg.ptr = &tsCompression;
   cfg.valType = TAOS_CFG_VTYPE_INT16;
@@ -675,6 +781,46 @@ static void doInitGlobalConfig() {
   cfg.unitType = TAOS_CFG_UTYPE_NONE;
   taosInitConfigOption(cfg);
 
+  cfg.option = "adaptiveComp";
+  cfg.ptr = &tsAdaptiveComp;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_ADAPTIVE_COMP;
+  cfg.maxValue = TSDB_MAX_ADAPTIVE_COMP;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "compactSubBlocks";
+  cfg.ptr = &tsCompactSubBlocks;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_COMPACT_RATIO;
+  cfg.maxValue = TSDB_MAX_COMPACT_RATIO;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "compactTombSize";
+  cfg.ptr = &tsCompactTombSize;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_COMPACT_RATIO;
+  cfg.maxValue = TSDB_MAX_COMPACT_RATIO;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "compactIORate";
+  cfg.ptr = &tsCompactIORate;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_COMPACT_IO_RATE;
+  cfg.maxValue = TSDB_MAX_COMPACT_IO_RATE;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_Mb;
+  taosInitConfigOption(cfg);
+
   cfg.option = "wallevel";
   cfg.ptr = &tsWAL;
   cfg.valType = TAOS_CFG_VTYPE_INT16;
@@ -685,6 +831,36 @@ static void doInitGlobalConfig() {
   cfg.unitType = TAOS_CFG_UTYPE_NONE;
   taosInitConfigOption(cfg);
 
+  cfg.option = "walFsyncInterval";
+  cfg.ptr = &tsWalFsyncInterval;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_WAL_FSYNC_INTERVAL;
+  cfg.maxValue = TSDB_MAX_WAL_FSYNC_INTERVAL;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_MS;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "walFsyncSize";
+  cfg.ptr = &tsWalFsyncSize;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_WAL_FSYNC_SIZE;
+  cfg.maxValue = TSDB_MAX_WAL_FSYNC_SIZE;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
+  cfg.option = "walSegmentSize";
+  cfg.ptr = &tsWalSegmentSize;
+  cfg.valType = TAOS_CFG_VTYPE_INT32;
+  cfg.cfgType = TSDB_CFG_CTYPE_B_CONFIG | TSDB_CFG_CTYPE_B_SHOW;
+  cfg.minValue = TSDB_MIN_WAL_SEGMENT_SIZE;
+  cfg.maxValue = TSDB_MAX_WAL_SEGMENT_SIZE;
+  cfg.ptrLength = 0;
+  cfg.unitType = TAOS_CFG_UTYPE_NONE;
+  taosInitConfigOption(cfg);
+
   cfg.option = "replica";
   cfg.ptr = &tsReplications;
   cfg.valType = TAOS_CFG_VTYPE_INT32;
@@ -232,9 +232,10 @@ static void getStatics_f(const TSKEY *primaryKey, const void *pData, int32_t num
   SET_DOUBLE_VAL_ALIGN(max, &fmax);
   SET_DOUBLE_VAL_ALIGN(min, &fmin);
 #else
-  *sum = csum;
-  *max = fmax;
-  *min = fmin;
+  // the statistics of float and double are kept as double values in the int64 fields
+  *(double *)sum = csum;
+  *(double *)max = fmax;
+  *(double *)min = fmin;
 #endif
 }
 
@@ -288,9 +289,9 @@ static void getStatics_d(const TSKEY *primaryKey, const void *pData, int32_t num
     SET_DOUBLE_VAL_ALIGN(max, &dmax);
     SET_DOUBLE_VAL_ALIGN(min, &dmin);
 #else
-  *sum = csum;
-  *max = dmax;
-  *min = dmin;
+  *(double *)sum = csum;
+  *(double *)max = dmax;
+  *(double *)min = dmin;
 #endif
 }
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _TD_CQ_INT_H_
+#define _TD_CQ_INT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "tarray.h"
+#include "tdataformat.h"
+
+#define cError(...) if (cqDebugFlag & DEBUG_ERROR) {taosPrintLog("ERROR CQ  ", cqDebugFlag, __VA_ARGS__);}
+#define cWarn(...) if (cqDebugFlag & DEBUG_WARN) {taosPrintLog("WARN CQ  ", cqDebugFlag, __VA_ARGS__);}
+#define cTrace(...) if (cqDebugFlag & DEBUG_TRACE) {taosPrintLog("CQ  ", cqDebugFlag, __VA_ARGS__);}
+#define cPrint(...) {taosPrintLog("CQ  ", 255, __VA_ARGS__);}
+
+typedef union {
+  int64_t i;
+  double  d;
+} SCqValue;
+
+// partial aggregate of one column in one pane
+typedef struct {
+  int64_t  count;     // number of non-null values
+  SCqValue sum;
+  SCqValue min;
+  SCqValue max;
+  TSKEY    firstKey;
+  SCqValue first;
+  TSKEY    lastKey;
+  SCqValue last;
+} SCqAggState;
+
+// a pane is a slice of gcd(interval, sliding) long, a window is made up of the consecutive panes it covers
+typedef struct {
+  TSKEY       skey;      // start key of the pane
+  SCqAggState states[];  // of each aggregate column
+} SCqPane;
+
+typedef struct {
+  SCqDef   *pDef;
+  STSchema *pSchema;        // schema of the target table
+  int64_t   paneSize;
+  SArray   *pPanes;         // SCqPane * of the panes still covered by open windows, ordered by skey
+  TSKEY     nextSkey;       // windows starting before it are emitted already
+  TSKEY     watermark;      // the largest key processed
+  int64_t   numOfRows;      // rows processed
+  int64_t   numOfLateRows;  // late rows, counted once for each emitted window they miss
+  int64_t   numOfEmitted;   // windows emitted
+  char     *pBuf;           // buffer to build the submit msg of the emitted windows
+  int       bufSize;
+} SCqIncr;
+
+typedef struct {
+  int      vgId;
+  char     user[TSDB_USER_LEN];
+  char     pass[TSDB_PASSWORD_LEN];
+  FCqWrite cqWrite;
+  void    *ahandle;
+  int      num;      // number of continuous streams
+  int      numOfIncr;  // number of incremental CQs
+  struct SCqObj *pHead;
+  void    *dbConn;
+  int      master;
+  pthread_mutex_t mutex;
+} SCqContext;
+
+typedef struct SCqObj {
+  int      tid;      // table ID
+  int      rowSize;  // bytes of a row 
+  char    *sqlStr;   // SQL string
+  int      columns;  // number of columns
+  SSchema *pSchema;  // pointer to schema array
+  void    *pStream;
+  SCqIncr *pIncr;    // state of an incremental CQ, NULL for a stream CQ
+  struct SCqObj *prev; 
+  struct SCqObj *next; 
+  SCqContext *pContext;
+} SCqObj;
+
+// cqIncr.c
+SCqIncr *cqNewIncr(const SCqDef *pDef, SSchema *pSchema, int columns);
+void     cqFreeIncr(SCqIncr *pIncr);
+void     cqResetIncr(SCqIncr *pIncr);
+int      cqFeedIncr(SCqObj *pObj, SSubmitBlk *pBlock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // _TD_CQ_INT_H_
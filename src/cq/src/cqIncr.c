@@ -0,0 +1,490 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "os.h"
+#include "taosdef.h"
+#include "taosmsg.h"
+#include "tlog.h"
+#include "twal.h"
+#include "tcq.h"
+#include "cqInt.h"
+
+#define CQ_IS_FLOAT_TYPE(t) ((t) == TSDB_DATA_TYPE_FLOAT || (t) == TSDB_DATA_TYPE_DOUBLE)
+#define CQ_IS_NUMERIC_TYPE(t) \
+  ((t) >= TSDB_DATA_TYPE_BOOL && (t) <= TSDB_DATA_TYPE_TIMESTAMP && (t) != TSDB_DATA_TYPE_BINARY)
+#define CQ_MAX_ROWS_PER_SUBMIT 1024
+
+static bool     cqIsValidDef(const SCqDef *pDef, SSchema *pSchema, int columns);
+static TSKEY    cqAlignKey(TSKEY key, int64_t sliding);
+static int64_t  cqCountMissedWindows(SCqIncr *pIncr, TSKEY key);
+static SCqPane *cqGetPane(SCqIncr *pIncr, TSKEY skey);
+static size_t   cqSearchPane(SArray *pPanes, TSKEY skey);
+static void     cqUpdateState(SCqAggState *pState, int8_t type, const void *pVal, TSKEY key);
+static void     cqMergeState(SCqAggState *pDst, const SCqAggState *pSrc, int8_t type);
+static void     cqGetAggResult(SCqAggCol *pCol, SCqAggState *pState, STColumn *pTCol, char *buf);
+static int      cqEmitWindows(SCqObj *pObj);
+static int      cqWriteWindows(SCqObj *pObj, int num, int32_t len);
+
+SCqIncr *cqNewIncr(const SCqDef *pDef, SSchema *pSchema, int columns) {
+  if (!cqIsValidDef(pDef, pSchema, columns)) return NULL;
+
+  SCqIncr *pIncr = calloc(1, sizeof(SCqIncr));
+  if (pIncr == NULL) return NULL;
+
+  int size = sizeof(SCqDef) + sizeof(SCqAggCol) * pDef->numOfCols;
+  pIncr->pDef = malloc(size);
+  pIncr->pSchema = tdNewSchema(columns);
+  pIncr->pPanes = taosArrayInit(16, sizeof(SCqPane *));
+  if (pIncr->pDef == NULL || pIncr->pSchema == NULL || pIncr->pPanes == NULL) {
+    cqFreeIncr(pIncr);
+    return NULL;
+  }
+
+  memcpy(pIncr->pDef, pDef, size);
+  for (int i = 0; i < columns; i++) {
+    tdSchemaAddCol(pIncr->pSchema, pSchema[i].type, pSchema[i].colId, pSchema[i].bytes);
+  }
+
+  pIncr->bufSize = sizeof(SWalHead) + sizeof(SSubmitMsg) + sizeof(SSubmitBlk) +
+                   dataRowMaxBytesFromSchema(pIncr->pSchema) * CQ_MAX_ROWS_PER_SUBMIT;
+  pIncr->pBuf = malloc(pIncr->bufSize);
+  if (pIncr->pBuf == NULL) {
+    cqFreeIncr(pIncr);
+    return NULL;
+  }
+
+  int64_t a = pDef->interval, b = pDef->sliding;
+  while (b != 0) {
+    int64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  pIncr->paneSize = a;
+  pIncr->nextSkey = TSKEY_INITIAL_VAL;
+  pIncr->watermark = TSKEY_INITIAL_VAL;
+
+  return pIncr;
+}
+
+void cqFreeIncr(SCqIncr *pIncr) {
+  if (pIncr == NULL) return;
+
+  if (pIncr->pPanes) {
+    cqResetIncr(pIncr);
+    taosArrayDestroy(pIncr->pPanes);
+  }
+  tdFreeSchema(pIncr->pSchema);
+  tfree(pIncr->pDef);
+  tfree(pIncr->pBuf);
+  free(pIncr);
+}
+
+/**
+ * Discard the open windows, called when the vnode is no longer master. Rows written meanwhile are not
+ * seen by this node, so the partial aggregates can not be continued once it becomes master again.
+ */
+void cqResetIncr(SCqIncr *pIncr) {
+  size_t num = taosArrayGetSize(pIncr->pPanes);
+  for (size_t i = 0; i < num; i++) {
+    free(taosArrayGetP(pIncr->pPanes, i));
+  }
+  taosArrayClear(pIncr->pPanes);
+
+  pIncr->nextSkey = TSKEY_INITIAL_VAL;
+  pIncr->watermark = TSKEY_INITIAL_VAL;
+}
+
+/**
+ * Fold the rows of a submit block of the source table into the partial aggregates of the panes they fall
+ * in, then emit the windows closed by the new watermark. Each row updates a single pane however many
+ * sliding windows overlap it, so the cost is proportional to the number of new rows instead of the number
+ * of rows in a window.
+ */
+int cqFeedIncr(SCqObj *pObj, SSubmitBlk *pBlock) {
+  SCqIncr *pIncr = pObj->pIncr;
+  SCqDef * pDef = pIncr->pDef;
+  SCqPane *pPane = NULL;
+
+  char *pRow = pBlock->data;
+  char *pEnd = pBlock->data + pBlock->len;
+  for (; pRow < pEnd; pRow += dataRowLen(pRow)) {
+    TSKEY key = dataRowKey(pRow);
+
+    pIncr->numOfRows++;
+    if (key > pIncr->watermark) pIncr->watermark = key;
+
+    // a row misses the emitted windows covering it, all of them if it is before nextSkey
+    int64_t missed = cqCountMissedWindows(pIncr, key);
+    if (missed > 0) {
+      pIncr->numOfLateRows += missed;
+      cTrace("vgId:%d, id:%d CQ, late row of key:%" PRId64 " misses %" PRId64 " emitted windows, nextSkey:%" PRId64,
+             pObj->pContext->vgId, pObj->tid, key, missed, pIncr->nextSkey);
+    }
+
+    // windows starting before nextSkey are emitted, and a window starting after key does not cover it
+    if (key < pIncr->nextSkey) continue;
+
+    TSKEY skey = cqAlignKey(key, pIncr->paneSize);
+    if (pPane == NULL || pPane->skey != skey) {
+      pPane = cqGetPane(pIncr, skey);
+      if (pPane == NULL) return TSDB_CODE_SERV_OUT_OF_MEMORY;
+    }
+
+    for (int i = 0; i < pDef->numOfCols; i++) {
+      SCqAggCol *pCol = pDef->cols + i;
+      cqUpdateState(pPane->states + i, pCol->type, POINTER_SHIFT(dataRowTuple(pRow), pCol->offset), key);
+    }
+  }
+
+  return cqEmitWindows(pObj);
+}
+
+static bool cqIsValidDef(const SCqDef *pDef, SSchema *pSchema, int columns) {
+  if (pDef->interval <= 0 || pDef->sliding <= 0 || pDef->sliding > pDef->interval || pDef->delay < 0) return false;
+  if (pDef->srcUid == pDef->uid) return false;
+  if (pDef->numOfCols <= 0 || pDef->numOfCols + 1 != columns) return false;
+  if (pSchema[0].type != TSDB_DATA_TYPE_TIMESTAMP) return false;
+
+  for (int i = 0; i < pDef->numOfCols; i++) {
+    const SCqAggCol *pCol = pDef->cols + i;
+    if (!CQ_IS_NUMERIC_TYPE(pCol->type) || pCol->offset < 0) return false;
+    if (!CQ_IS_NUMERIC_TYPE(pSchema[i + 1].type)) return false;
+
+    switch (pCol->funcId) {
+      case TSDB_CQ_FUNC_COUNT:
+      case TSDB_CQ_FUNC_SUM:
+      case TSDB_CQ_FUNC_AVG:
+      case TSDB_CQ_FUNC_MIN:
+      case TSDB_CQ_FUNC_MAX:
+      case TSDB_CQ_FUNC_FIRST:
+      case TSDB_CQ_FUNC_LAST:
+        break;
+      default:
+        return false;
+    }
+  }
+
+  return true;
+}
+
+static TSKEY cqAlignKey(TSKEY key, int64_t sliding) {
+  int64_t mod = key % sliding;
+  if (mod < 0) mod += sliding;
+  return key - mod;
+}
+
+// return the number of the windows covering key which are emitted already
+static int64_t cqCountMissedWindows(SCqIncr *pIncr, TSKEY key) {
+  SCqDef *pDef = pIncr->pDef;
+  if (pIncr->nextSkey == TSKEY_INITIAL_VAL) return 0;
+
+  // the last emitted window starts at nextSkey - sliding, most rows are after it
+  TSKEY last = pIncr->nextSkey - pDef->sliding;
+  if (key >= last + pDef->interval) return 0;
+
+  TSKEY first = cqAlignKey(key - pDef->interval, pDef->sliding) + pDef->sliding;
+  last = MIN(cqAlignKey(key, pDef->sliding), last);
+  return (last < first) ? 0 : (last - first) / pDef->sliding + 1;
+}
+
+// return the index of the first pane not before skey
+static size_t cqSearchPane(SArray *pPanes, TSKEY skey) {
+  size_t lo = 0, hi = taosArrayGetSize(pPanes);
+
+  // rows mostly come in order, so check the newest pane first
+  if (hi > 0 && ((SCqPane *)taosArrayGetP(pPanes, hi - 1))->skey < skey) return hi;
+
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (((SCqPane *)taosArrayGetP(pPanes, mid))->skey < skey) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return lo;
+}
+
+static SCqPane *cqGetPane(SCqIncr *pIncr, TSKEY skey) {
+  SArray *pPanes = pIncr->pPanes;
+  size_t  index = cqSearchPane(pPanes, skey);
+
+  if (index < taosArrayGetSize(pPanes)) {
+    SCqPane *pPane = taosArrayGetP(pPanes, index);
+    if (pPane->skey == skey) return pPane;
+  }
+
+  SCqPane *pPane = calloc(1, sizeof(SCqPane) + sizeof(SCqAggState) * pIncr->pDef->numOfCols);
+  if (pPane == NULL) return NULL;
+  pPane->skey = skey;
+
+  if (taosArrayInsert(pPanes, index, &pPane) == NULL) {
+    free(pPane);
+    return NULL;
+  }
+
+  return pPane;
+}
+
+static void cqUpdateState(SCqAggState *pState, int8_t type, const void *pVal, TSKEY key) {
+  if (isNull(pVal, type)) return;
+
+  SCqValue v;
+  switch (type) {
+    case TSDB_DATA_TYPE_BOOL:
+    case TSDB_DATA_TYPE_TINYINT:
+      v.i = *(int8_t *)pVal;
+      break;
+    case TSDB_DATA_TYPE_SMALLINT:
+      v.i = *(int16_t *)pVal;
+      break;
+    case TSDB_DATA_TYPE_INT:
+      v.i = *(int32_t *)pVal;
+      break;
+    case TSDB_DATA_TYPE_FLOAT:
+      v.d = *(float *)pVal;
+      break;
+    case TSDB_DATA_TYPE_DOUBLE:
+      v.d = *(double *)pVal;
+      break;
+    default:
+      v.i = *(int64_t *)pVal;
+      break;
+  }
+
+  if (pState->count++ == 0) {
+    pState->sum = pState->min = pState->max = pState->first = pState->last = v;
+    pState->firstKey = pState->lastKey = key;
+    return;
+  }
+
+  if (CQ_IS_FLOAT_TYPE(type)) {
+    pState->sum.d += v.d;
+    if (v.d < pState->min.d) pState->min = v;
+    if (v.d > pState->max.d) pState->max = v;
+  } else {
+    pState->sum.i += v.i;
+    if (v.i < pState->min.i) pState->min = v;
+    if (v.i > pState->max.i) pState->max = v;
+  }
+
+  // TSDB keeps the first row written for a timestamp, so a duplicated key does not replace first/last
+  if (key < pState->firstKey) {
+    pState->firstKey = key;
+    pState->first = v;
+  }
+  if (key > pState->lastKey) {
+    pState->lastKey = key;
+    pState->last = v;
+  }
+}
+
+static void cqMergeState(SCqAggState *pDst, const SCqAggState *pSrc, int8_t type) {
+  if (pSrc->count == 0) return;
+  if (pDst->count == 0) {
+    *pDst = *pSrc;
+    return;
+  }
+
+  pDst->count += pSrc->count;
+  if (CQ_IS_FLOAT_TYPE(type)) {
+    pDst->sum.d += pSrc->sum.d;
+    if (pSrc->min.d < pDst->min.d) pDst->min = pSrc->min;
+    if (pSrc->max.d > pDst->max.d) pDst->max = pSrc->max;
+  } else {
+    pDst->sum.i += pSrc->sum.i;
+    if (pSrc->min.i < pDst->min.i) pDst->min = pSrc->min;
+    if (pSrc->max.i > pDst->max.i) pDst->max = pSrc->max;
+  }
+
+  if (pSrc->firstKey < pDst->firstKey) {
+    pDst->firstKey = pSrc->firstKey;
+    pDst->first = pSrc->first;
+  }
+  if (pSrc->lastKey > pDst->lastKey) {
+    pDst->lastKey = pSrc->lastKey;
+    pDst->last = pSrc->last;
+  }
+}
+
+static void cqGetAggResult(SCqAggCol *pCol, SCqAggState *pState, STColumn *pTCol, char *buf) {
+  if (pState->count == 0 && pCol->funcId != TSDB_CQ_FUNC_COUNT) {
+    setNull(buf, colType(pTCol), colBytes(pTCol));
+    return;
+  }
+
+  bool     isFloat = CQ_IS_FLOAT_TYPE(pCol->type);
+  SCqValue v;
+  switch (pCol->funcId) {
+    case TSDB_CQ_FUNC_COUNT:
+      v.i = pState->count;
+      isFloat = false;
+      break;
+    case TSDB_CQ_FUNC_AVG:
+      v.d = (isFloat ? pState->sum.d : (double)pState->sum.i) / pState->count;
+      isFloat = true;
+      break;
+    case TSDB_CQ_FUNC_SUM:
+      v = pState->sum;
+      break;
+    case TSDB_CQ_FUNC_MIN:
+      v = pState->min;
+      break;
+    case TSDB_CQ_FUNC_MAX:
+      v = pState->max;
+      break;
+    case TSDB_CQ_FUNC_FIRST:
+      v = pState->first;
+      break;
+    default:
+      v = pState->last;
+      break;
+  }
+
+  switch (colType(pTCol)) {
+    case TSDB_DATA_TYPE_BOOL:
+    case TSDB_DATA_TYPE_TINYINT:
+      *(int8_t *)buf = (int8_t)(isFloat ? v.d : v.i);
+      break;
+    case TSDB_DATA_TYPE_SMALLINT:
+      *(int16_t *)buf = (int16_t)(isFloat ? v.d : v.i);
+      break;
+    case TSDB_DATA_TYPE_INT:
+      *(int32_t *)buf = (int32_t)(isFloat ? v.d : v.i);
+      break;
+    case TSDB_DATA_TYPE_FLOAT:
+      *(float *)buf = (float)(isFloat ? v.d : v.i);
+      break;
+    case TSDB_DATA_TYPE_DOUBLE:
+      *(double *)buf = isFloat ? v.d : v.i;
+      break;
+    default:
+      *(int64_t *)buf = isFloat ? (int64_t)v.d : v.i;
+      break;
+  }
+}
+
+/**
+ * A window is closed once the watermark passes its end by the delay of the CQ. The closed windows which
+ * hold any row are merged from their panes and written into the target table as submit msgs through the
+ * write queue of the vnode, so the results go through WAL and replication like any other insert. Rows
+ * arriving after their windows are closed are counted as late and dropped: TSDB keeps the first row of a
+ * timestamp, a recomputed window could not replace the one emitted.
+ */
+static int cqEmitWindows(SCqObj *pObj) {
+  SCqIncr *pIncr = pObj->pIncr;
+  SCqDef * pDef = pIncr->pDef;
+  SArray * pPanes = pIncr->pPanes;
+  int      code = 0;
+
+  if (pIncr->watermark == TSKEY_INITIAL_VAL) return 0;
+
+  TSKEY closeKey = cqAlignKey(pIncr->watermark - pDef->interval - pDef->delay, pDef->sliding) + pDef->sliding;
+  if (closeKey <= pIncr->nextSkey) return 0;
+
+  SSubmitBlk *pBlk = (SSubmitBlk *)((SSubmitMsg *)((SWalHead *)pIncr->pBuf)->cont)->blocks;
+  int         num = 0;
+  int32_t     len = 0;
+  size_t      first = 0;  // panes before it are not covered by any window left to emit
+
+  while (first < taosArrayGetSize(pPanes)) {
+    // the first window covering the oldest pane, earlier windows are emitted or empty
+    TSKEY paneKey = ((SCqPane *)taosArrayGetP(pPanes, first))->skey;
+    TSKEY skey = cqAlignKey(paneKey - pDef->interval, pDef->sliding) + pDef->sliding;
+    if (skey < pIncr->nextSkey) skey = pIncr->nextSkey;
+    if (skey >= closeKey) break;
+
+    SDataRow row = POINTER_SHIFT(pBlk->data, len);
+    tdInitDataRow(row, pIncr->pSchema);
+    tdAppendColVal(row, &skey, TSDB_DATA_TYPE_TIMESTAMP, sizeof(TSKEY), 0);
+
+    for (int c = 0; c < pDef->numOfCols; c++) {
+      SCqAggState state = {0};
+      for (size_t i = first; i < taosArrayGetSize(pPanes); i++) {
+        SCqPane *pPane = taosArrayGetP(pPanes, i);
+        if (pPane->skey >= skey + pDef->interval) break;
+        cqMergeState(&state, pPane->states + c, pDef->cols[c].type);
+      }
+
+      STColumn *pTCol = schemaColAt(pIncr->pSchema, c + 1);
+      char      buf[sizeof(int64_t)];
+      cqGetAggResult(pDef->cols + c, &state, pTCol, buf);
+      tdAppendColVal(row, buf, colType(pTCol), colBytes(pTCol), colOffset(pTCol));
+    }
+
+    len += dataRowLen(row);
+    num++;
+    pIncr->nextSkey = skey + pDef->sliding;
+    while (first < taosArrayGetSize(pPanes) && ((SCqPane *)taosArrayGetP(pPanes, first))->skey < pIncr->nextSkey) {
+      first++;
+    }
+
+    if (num == CQ_MAX_ROWS_PER_SUBMIT) {
+      code = cqWriteWindows(pObj, num, len);
+      if (code != 0) break;
+      num = 0;
+      len = 0;
+    }
+  }
+
+  if (num > 0 && code == 0) code = cqWriteWindows(pObj, num, len);
+
+  pIncr->nextSkey = closeKey;
+  for (size_t i = 0; i < first; i++) {
+    free(taosArrayGetP(pPanes, 0));
+    taosArrayRemove(pPanes, 0);
+  }
+
+  return code;
+}
+
+static int cqWriteWindows(SCqObj *pObj, int num, int32_t len) {
+  SCqIncr *   pIncr = pObj->pIncr;
+  SCqContext *pContext = pObj->pContext;
+
+  SWalHead *  pHead = (SWalHead *)pIncr->pBuf;
+  SSubmitMsg *pSubmit = (SSubmitMsg *)pHead->cont;
+  SSubmitBlk *pBlk = (SSubmitBlk *)pSubmit->blocks;
+
+  pBlk->uid = htobe64(pIncr->pDef->uid);
+  pBlk->tid = htonl(pObj->tid);
+  pBlk->padding = 0;
+  pBlk->sversion = htonl(pIncr->pDef->sversion);
+  pBlk->len = htonl(len);
+  pBlk->numOfRows = htons((int16_t)num);
+
+  int32_t msgLen = sizeof(SSubmitMsg) + sizeof(SSubmitBlk) + len;
+  memset(pSubmit, 0, sizeof(SSubmitMsg));
+  pSubmit->header.vgId = htonl(pContext->vgId);
+  pSubmit->header.contLen = htonl(msgLen);
+  pSubmit->length = htonl(msgLen);
+  pSubmit->numOfBlocks = htonl(1);
+
+  memset(pHead, 0, sizeof(SWalHead));
+  pHead->msgType = TSDB_MSG_TYPE_SUBMIT;
+  pHead->len = msgLen;
+
+  pIncr->numOfEmitted += num;
+  cTrace("vgId:%d, id:%d CQ, %d windows are emitted, nextSkey:%" PRId64 " lateRows:%" PRId64, pContext->vgId,
+         pObj->tid, num, pIncr->nextSkey, pIncr->numOfLateRows);
+
+  return pContext->cqWrite(pContext->ahandle, pHead, TAOS_QTYPE_CQ);
+}
@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include "os.h"
 #include "taosdef.h"
 #include "taosmsg.h"
 #include "tglobal.h"
@@ -25,36 +26,7 @@
 #include "twal.h"
 #include "tcq.h"
 #include "taos.h"
-
-#define cError(...) if (cqDebugFlag & DEBUG_ERROR) {taosPrintLog("ERROR CQ  ", cqDebugFlag, __VA_ARGS__);}
-#define cWarn(...) if (cqDebugFlag & DEBUG_WARN) {taosPrintLog("WARN CQ  ", cqDebugFlag, __VA_ARGS__);}
-#define cTrace(...) if (cqDebugFlag & DEBUG_TRACE) {taosPrintLog("CQ  ", cqDebugFlag, __VA_ARGS__);}
-#define cPrint(...) {taosPrintLog("CQ  ", 255, __VA_ARGS__);}
-
-typedef struct {
-  int      vgId;
-  char     user[TSDB_USER_LEN];
-  char     pass[TSDB_PASSWORD_LEN];
-  FCqWrite cqWrite;
-  void    *ahandle;
-  int      num;      // number of continuous streams
-  struct SCqObj *pHead;
-  void    *dbConn;
-  int      master;
-  pthread_mutex_t mutex;
-} SCqContext;
-
-typedef struct SCqObj {
-  int      tid;      // table ID
-  int      rowSize;  // bytes of a row 
-  char    *sqlStr;   // SQL string
-  int      columns;  // number of columns
-  SSchema *pSchema;  // pointer to schema array
-  void    *pStream;
-  struct SCqObj *prev; 
-  struct SCqObj *next; 
-  SCqContext *pContext;
-} SCqObj;
+#include "cqInt.h"
 
 int cqDebugFlag = 135;
 
@@ -93,6 +65,9 @@ void cqClose(void *handle) {
   while (pObj) {
     SCqObj *pTemp = pObj;
     pObj = pObj->next;
+    cqFreeIncr(pTemp->pIncr);
+    free(pTemp->sqlStr);
+    free(pTemp->pSchema);
     free(pTemp);
   } 
   
@@ -115,7 +90,7 @@ void cqStart(void *handle) {
 
   SCqObj *pObj = pContext->pHead;
   while (pObj) {
-    cqCreateStream(pContext, pObj);
+    if (pObj->pIncr == NULL) cqCreateStream(pContext, pObj);
     pObj = pObj->next;
   }
 
@@ -125,13 +100,15 @@ void cqStart(void *handle) {
 void cqStop(void *handle) {
   SCqContext *pContext = handle;
   cTrace("vgId:%d, stop all CQs", pContext->vgId);
-  if (pContext->dbConn == NULL || pContext->master == 0) return;
+  if (pContext->master == 0) return;
 
   pthread_mutex_lock(&pContext->mutex);
 
   pContext->master = 0;
   SCqObj *pObj = pContext->pHead;
   while (pObj) {
+    if (pObj->pIncr) cqResetIncr(pObj->pIncr);
+
     if (pObj->pStream) {
       taos_close_stream(pObj->pStream);
       pObj->pStream = NULL;
@@ -147,13 +124,23 @@ void cqStop(void *handle) {
   pthread_mutex_unlock(&pContext->mutex);
 }
 
-void *cqCreate(void *handle, int tid, char *sqlStr, SSchema *pSchema, int columns) {
+void *cqCreate(void *handle, int tid, char *sqlStr, const SCqDef *pDef, SSchema *pSchema, int columns) {
   SCqContext *pContext = handle;
 
   SCqObj *pObj = calloc(sizeof(SCqObj), 1);
   if (pObj == NULL) return NULL;
 
+  if (pDef) {
+    pObj->pIncr = cqNewIncr(pDef, pSchema, columns);
+    if (pObj->pIncr == NULL) {
+      cError("vgId:%d, id:%d CQ:%s, invalid definition for incremental CQ", pContext->vgId, tid, sqlStr);
+      free(pObj);
+      return NULL;
+    }
+  }
+
   pObj->tid = tid;
+  pObj->pContext = pContext;
   pObj->sqlStr = malloc(strlen(sqlStr)+1);
   strcpy(pObj->sqlStr, sqlStr);
 
@@ -171,7 +158,11 @@ void *cqCreate(void *handle, int tid, char *sqlStr, SSchema *pSchema, int column
   if (pContext->pHead) pContext->pHead->prev = pObj;
   pContext->pHead = pObj;
 
-  cqCreateStream(pContext, pObj);
+  if (pObj->pIncr) {
+    atomic_add_fetch_32(&pContext->numOfIncr, 1);
+  } else {
+    cqCreateStream(pContext, pObj);
+  }
 
   pthread_mutex_unlock(&pContext->mutex);
 
@@ -198,10 +189,43 @@ void cqDrop(void *handle) {
   if (pObj->pStream) taos_close_stream(pObj->pStream);
   pObj->pStream = NULL;
 
+  if (pObj->pIncr) {
+    atomic_sub_fetch_32(&pContext->numOfIncr, 1);
+    cqFreeIncr(pObj->pIncr);
+  }
+
   cTrace("vgId:%d, id:%d CQ:%s is dropped", pContext->vgId, pObj->tid, pObj->sqlStr); 
+  free(pObj->sqlStr);
+  free(pObj->pSchema);
   free(pObj);
 
+  pthread_mutex_unlock(&pContext->mutex);
+}
+
+void cqProcessSubmit(void *handle, SSubmitMsg *pMsg) {
+  SCqContext *pContext = handle;
+  if (atomic_load_32(&pContext->numOfIncr) == 0 || pContext->master == 0) return;
+
   pthread_mutex_lock(&pContext->mutex);
+
+  int32_t pos = sizeof(SSubmitMsg);
+  while (pos < pMsg->length) {
+    SSubmitBlk *pBlock = (SSubmitBlk *)((char *)pMsg + pos);
+
+    for (SCqObj *pObj = pContext->pHead; pObj; pObj = pObj->next) {
+      if (pObj->pIncr == NULL || pObj->pIncr->pDef->srcUid != pBlock->uid) continue;
+
+      int code = cqFeedIncr(pObj, pBlock);
+      if (code != 0) {
+        cError("vgId:%d, id:%d CQ:%s, failed to process submit block since %s", pContext->vgId, pObj->tid,
+               pObj->sqlStr, tstrerror(code));
+      }
+    }
+
+    pos += sizeof(SSubmitBlk) + pBlock->len;
+  }
+
+  pthread_mutex_unlock(&pContext->mutex);
 }
 
 static void cqCreateStream(SCqContext *pContext, SCqObj *pObj) {
@@ -251,5 +275,6 @@ static void cqProcessStreamRes(void *param, TAOS_RES *tres, TAOS_ROW row) {
 
   // write into vnode write queue
   pContext->cqWrite(pContext->ahandle, pHead, TAOS_QTYPE_CQ);
+  free(buffer);
 }
 
@@ -19,26 +19,147 @@
 #include "taosmsg.h"
 #include "tglobal.h"
 #include "tlog.h"
+#include "ttime.h"
+#include "twal.h"
+#include "tdataformat.h"
 #include "tcq.h"
 
 int64_t  ver = 0;
 void    *pCq = NULL;
 
+int64_t  numOfWindows = 0;
+double   checkSum = 0;
+
 int writeToQueue(void *pVnode, void *data, int type) {
+  SWalHead   *pHead = data;
+  SSubmitMsg *pSubmit = (SSubmitMsg *)pHead->cont;
+  SSubmitBlk *pBlk = (SSubmitBlk *)pSubmit->blocks;
+
+  int   numOfRows = htons(pBlk->numOfRows);
+  char *pRow = pBlk->data;
+  for (int i = 0; i < numOfRows; ++i) {
+    // windows starting before the first row only hold part of their rows
+    if (dataRowKey(pRow) >= 0) {
+      checkSum += *(double *)POINTER_SHIFT(dataRowTuple(pRow), sizeof(TSKEY));
+      numOfWindows++;
+    }
+    pRow += dataRowLen(pRow);
+  }
+
   return 0;
 }
 
+// feed rows of (ts, speed) into "select avg(speed) from t1 interval(?) sliding(1s)" as incremental CQ
+void runIncrCq(int64_t totalRows, int rowsPerBlock, int64_t interval) {
+  const int64_t sliding = 1000, step = 10;
+
+  SCqDef *pDef = calloc(1, sizeof(SCqDef) + sizeof(SCqAggCol));
+  pDef->srcUid = 1;
+  pDef->uid = 2;
+  pDef->interval = interval;
+  pDef->sliding = sliding;
+  pDef->numOfCols = 1;
+  pDef->cols[0].funcId = TSDB_CQ_FUNC_AVG;
+  pDef->cols[0].type = TSDB_DATA_TYPE_INT;
+  pDef->cols[0].offset = sizeof(TSKEY);
+
+  SSchema schema[2];
+  schema[0].type = TSDB_DATA_TYPE_TIMESTAMP;
+  strcpy(schema[0].name, "ts");
+  schema[0].colId = 0;
+  schema[0].bytes = 8;
+
+  schema[1].type = TSDB_DATA_TYPE_DOUBLE;
+  strcpy(schema[1].name, "avgspeed");
+  schema[1].colId = 1;
+  schema[1].bytes = 8;
+
+  if (cqCreate(pCq, 2, "select avg(speed) from demo.t1 interval(5s) sliding(1s)", pDef, schema, 2) == NULL) {
+    printf("failed to create incremental CQ\n");
+    exit(-1);
+  }
+  cqStart(pCq);
+
+  STSchema *pSrcSchema = tdNewSchema(2);
+  tdSchemaAddCol(pSrcSchema, TSDB_DATA_TYPE_TIMESTAMP, 0, 8);
+  tdSchemaAddCol(pSrcSchema, TSDB_DATA_TYPE_INT, 1, 4);
+  int rowSize = dataRowMaxBytesFromSchema(pSrcSchema);
+
+  int         size = sizeof(SSubmitMsg) + sizeof(SSubmitBlk) + rowSize * rowsPerBlock;
+  SSubmitMsg *pMsg = calloc(1, size);
+  SSubmitBlk *pBlk = (SSubmitBlk *)pMsg->blocks;
+  pMsg->length = size;
+  pMsg->numOfBlocks = 1;
+  pBlk->uid = 1;
+  pBlk->numOfRows = rowsPerBlock;
+  pBlk->len = rowSize * rowsPerBlock;
+
+  int32_t *speeds = malloc(sizeof(int32_t) * totalRows);
+  int64_t  us = 0;
+  for (int64_t r = 0; r < totalRows; r += rowsPerBlock) {
+    for (int i = 0; i < rowsPerBlock; ++i) {
+      TSKEY   key = (r + i) * step;
+      int32_t speed = (int32_t)((r + i) % 97);
+      SDataRow row = POINTER_SHIFT(pBlk->data, rowSize * i);
+      tdInitDataRow(row, pSrcSchema);
+      tdAppendColVal(row, &key, TSDB_DATA_TYPE_TIMESTAMP, 8, 0);
+      tdAppendColVal(row, &speed, TSDB_DATA_TYPE_INT, 4, 8);
+      speeds[r + i] = speed;
+    }
+
+    int64_t st = taosGetTimestampUs();
+    cqProcessSubmit(pCq, pMsg);
+    us += taosGetTimestampUs() - st;
+  }
+
+  printf("incremental: %" PRId64 " rows, %" PRId64 " windows, checksum:%.3f, %.3f ms, %.1f ns/row\n", totalRows,
+         numOfWindows, checkSum, us / 1000.0, us * 1000.0 / totalRows);
+
+  // the cost of rescanning every window once it is closed, which is what re-running the SQL per tick does
+  int64_t rowsPerWindow = interval / step, rowsPerSliding = sliding / step;
+  int64_t windows = 0;
+  double  sum = 0;
+  int64_t st = taosGetTimestampUs();
+  for (int64_t begin = 0; begin + rowsPerWindow < totalRows; begin += rowsPerSliding) {
+    int64_t total = 0;
+    for (int64_t i = begin; i < begin + rowsPerWindow; ++i) total += speeds[i];
+    sum += (double)total / rowsPerWindow;
+    windows++;
+  }
+  us = taosGetTimestampUs() - st;
+  printf("rescan:      %" PRId64 " rows, %" PRId64 " windows, checksum:%.3f, %.3f ms, %.1f ns/row\n", totalRows,
+         windows, sum, us / 1000.0, us * 1000.0 / totalRows);
+
+  free(speeds);
+  free(pMsg);
+  tdFreeSchema(pSrcSchema);
+  free(pDef);
+}
+
 int main(int argc, char *argv[]) {
   int num = 3;
+  int64_t incrRows = 0;
+  int rowsPerBlock = 100;
+  int64_t interval = 5000;
 
   for (int i=1; i<argc; ++i) {
     if (strcmp(argv[i], "-d")==0 && i < argc-1) {
       dDebugFlag = atoi(argv[++i]);
+      cqDebugFlag = dDebugFlag;
     } else if (strcmp(argv[i], "-n") == 0 && i <argc-1) {
       num = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-i") == 0 && i <argc-1) {
+      incrRows = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-b") == 0 && i <argc-1) {
+      rowsPerBlock = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-w") == 0 && i <argc-1) {
+      interval = atoll(argv[++i]);
     } else {
       printf("\nusage: %s [options] \n", argv[0]);
       printf("  [-n num]: number of streams, default:%d\n", num);
+      printf("  [-i rows]: feed rows into an incremental CQ and exit, default:%" PRId64 "\n", incrRows);
+      printf("  [-b rows]: rows per submit block for -i, default:%d\n", rowsPerBlock);
+      printf("  [-w interval]: window length in ms for -i, sliding is 1s, default:%" PRId64 "\n", interval);
       printf("  [-d debugFlag]: debug flag, default:%d\n", dDebugFlag);
       printf("  [-h help]: print out this help\n\n");
       exit(0);
@@ -59,6 +180,13 @@ int main(int argc, char *argv[]) {
     exit(-1);
   }
 
+  if (incrRows > 0) {
+    runIncrCq(incrRows, rowsPerBlock, interval);
+    cqClose(pCq);
+    taosCloseLog();
+    return 0;
+  }
+
   SSchema schema[2];
   schema[0].type = TSDB_DATA_TYPE_TIMESTAMP;
   strcpy(schema[0].name, "ts");
@@ -71,7 +199,7 @@ int main(int argc, char *argv[]) {
   schema[1].bytes = 4;
 
   for (int sid =1; sid<10; ++sid) {
-    cqCreate(pCq, sid, "select avg(speed) from demo.t1 sliding(1s) interval(5s)", schema, 2);
+    cqCreate(pCq, sid, "select avg(speed) from demo.t1 sliding(1s) interval(5s)", NULL, schema, 2);
   }
 
   while (1) {
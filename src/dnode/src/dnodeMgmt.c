@@ -166,9 +166,34 @@ static int32_t dnodeGetVnodeList(int32_t vnodeList[], int32_t *numOfVnodes) {
   return TSDB_CODE_SUCCESS;
 }
 
-static int32_t dnodeOpenVnodes() {
+// vnodes are opened by several threads, each thread takes the next vnode in the list
+typedef struct {
+  int32_t *vnodeList;
+  int32_t  numOfVnodes;
+  int32_t  nextIndex;
+  int32_t  finished;
+  int32_t  failed;
+} SOpenVnodeJobs;
+
+static void *dnodeOpenVnodeFunc(void *param) {
+  SOpenVnodeJobs *pJobs = param;
   char vnodeDir[TSDB_FILENAME_LEN * 3];
-  int32_t failed = 0;
+
+  while (1) {
+    int32_t i = atomic_fetch_add_32(&pJobs->nextIndex, 1);
+    if (i >= pJobs->numOfVnodes) break;
+
+    snprintf(vnodeDir, TSDB_FILENAME_LEN * 3, "%s/vnode%d", tsVnodeDir, pJobs->vnodeList[i]);
+    if (vnodeOpen(pJobs->vnodeList[i], vnodeDir) < 0) atomic_add_fetch_32(&pJobs->failed, 1);
+
+    int32_t finished = atomic_add_fetch_32(&pJobs->finished, 1);
+    dPrint("vgId:%d, vnode open is finished, progress:%d/%d", pJobs->vnodeList[i], finished, pJobs->numOfVnodes);
+  }
+
+  return NULL;
+}
+
+static int32_t dnodeOpenVnodes() {
   int32_t *vnodeList = (int32_t *)malloc(sizeof(int32_t) * TSDB_MAX_VNODES);
   int32_t numOfVnodes;
   int32_t status;
@@ -177,17 +202,36 @@ static int32_t dnodeOpenVnodes() {
 
   if (status != TSDB_CODE_SUCCESS) {
     dPrint("Get dnode list failed");
+    free(vnodeList);
     return status;
   }
 
-  for (int32_t i = 0; i < numOfVnodes; ++i) {
-    snprintf(vnodeDir, TSDB_FILENAME_LEN * 3, "%s/vnode%d", tsVnodeDir, vnodeList[i]);
-    if (vnodeOpen(vnodeList[i], vnodeDir) < 0) failed++;
+  int64_t        start = taosGetTimestampMs();
+  SOpenVnodeJobs jobs = {.vnodeList = vnodeList, .numOfVnodes = numOfVnodes};
+
+  // WAL replay of the vnodes is independent, the calling thread is one of the threads
+  int32_t    numOfThreads = MIN(tsNumOfCores, numOfVnodes);
+  pthread_t *threads = NULL;
+  int32_t    numOfStarted = 0;
+  if (numOfThreads > 1) threads = (pthread_t *)calloc(numOfThreads - 1, sizeof(pthread_t));
+
+  for (; threads != NULL && numOfStarted < numOfThreads - 1; ++numOfStarted) {
+    if (pthread_create(threads + numOfStarted, NULL, dnodeOpenVnodeFunc, &jobs) != 0) {
+      dError("failed to create thread to open vnodes, reason:%s", strerror(errno));
+      break;
+    }
+  }
+
+  dnodeOpenVnodeFunc(&jobs);
+  for (int32_t i = 0; i < numOfStarted; ++i) {
+    pthread_join(threads[i], NULL);
   }
 
+  free(threads);
   free(vnodeList);
 
-  dPrint("there are total vnodes:%d, openned:%d failed:%d", numOfVnodes, numOfVnodes-failed, failed);
+  dPrint("there are total vnodes:%d, openned:%d failed:%d, threads:%d, %" PRId64 " ms", numOfVnodes,
+         numOfVnodes - jobs.failed, jobs.failed, numOfStarted + 1, taosGetTimestampMs() - start);
   return TSDB_CODE_SUCCESS;
 }
 
@@ -22,6 +22,8 @@
 #include "tglobal.h"
 #include "http.h"
 #include "mnode.h"
+#include "tsdb.h"
+#include "vnode.h"
 #include "dnode.h"
 #include "dnodeInt.h"
 #include "dnodeVRead.h"
@@ -175,6 +177,13 @@ SDnodeStatisInfo dnodeGetStatisInfo() {
     info.httpReqNum   = httpGetReqCount();
     info.queryReqNum  = atomic_exchange_32(&tsDnodeQueryReqNum, 0);
     info.submitReqNum = atomic_exchange_32(&tsDnodeSubmitReqNum, 0);
+
+    STsdbCommitStat stat;
+    vnodeGetCommitStat(&stat);
+    info.commitNum  = stat.numOfCommits;
+    info.commitRows = stat.numOfRows;
+    info.commitMs   = stat.totalCommitUs / 1000;
+    memcpy(info.commitColsByAlgorithm, stat.numOfColsByAlgorithm, sizeof(info.commitColsByAlgorithm));
   }
 
   return info;
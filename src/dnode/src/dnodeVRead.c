@@ -22,6 +22,7 @@
 #include "trpc.h"
 #include "twal.h"
 #include "tglobal.h"
+#include "tsdb.h"
 #include "dnodeInt.h"
 #include "dnodeMgmt.h"
 #include "dnodeVRead.h"
@@ -44,6 +45,7 @@ typedef struct {
   int32_t    min;       // min number of workers
   int32_t    num;       // current number of workers
   SReadWorker *readWorker;
+  pthread_mutex_t mutex;  // vnodes may be opened concurrently
 } SReadWorkerPool;
 
 static void *dnodeProcessReadQueue(void *param);
@@ -62,6 +64,7 @@ int32_t dnodeInitRead() {
   readPool.readWorker = (SReadWorker *) calloc(sizeof(SReadWorker), readPool.max);
 
   if (readPool.readWorker == NULL) return -1;
+  pthread_mutex_init(&readPool.mutex, NULL);
   for (int i=0; i < readPool.max; ++i) {
     SReadWorker *pWorker = readPool.readWorker + i;
     pWorker->workerId = i;
@@ -88,6 +91,7 @@ void dnodeCleanupRead() {
 
   taosCloseQset(readQset);
   free(readPool.readWorker);
+  pthread_mutex_destroy(&readPool.mutex);
 
   dPrint("dnode read is closed");
 }
@@ -148,6 +152,8 @@ void *dnodeAllocateRqueue(void *pVnode) {
 
   taosAddIntoQset(readQset, queue, pVnode);
 
+  pthread_mutex_lock(&readPool.mutex);
+
   // spawn a thread to process queue
   if (readPool.num < readPool.max) {
     do {
@@ -167,6 +173,8 @@ void *dnodeAllocateRqueue(void *pVnode) {
     } while (readPool.num < readPool.min);
   }
 
+  pthread_mutex_unlock(&readPool.mutex);
+
   dTrace("pVnode:%p, read queue:%p is allocated", pVnode, queue); 
 
   return queue;
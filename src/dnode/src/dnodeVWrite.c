@@ -23,17 +23,30 @@
 #include "tsdb.h"
 #include "twal.h"
 #include "tglobal.h"
+#include "ttime.h"
 #include "vnode.h"
 #include "tdataformat.h"
 #include "dnodeInt.h"
 #include "dnodeVWrite.h"
 #include "dnodeMgmt.h"
 
+#define DNODE_MAX_WRITE_BATCHES 32
+
+// messages drained from the write queue of a vnode in one read
 typedef struct {
   taos_qall  qall;
-  taos_qset  qset;      // queue set
-  pthread_t  thread;    // thread 
-  int32_t    workerId;  // worker ID
+  void      *pVnode;
+  int32_t    numOfMsgs;
+} SWriteBatch;
+
+typedef struct {
+  taos_qset    qset;          // queue set
+  pthread_t    thread;        // thread 
+  int32_t      workerId;      // worker ID
+  int32_t      numOfBatches;  // batches written into WAL but not fsynced and responded yet
+  int64_t      walBytes;      // WAL bytes of the pending batches
+  int64_t      firstBatchMs;  // time the first pending batch was drained
+  SWriteBatch  batches[DNODE_MAX_WRITE_BATCHES];
 } SWriteWorker;  
 
 typedef struct {
@@ -47,10 +60,12 @@ typedef struct {
   int32_t        max;        // max number of workers
   int32_t        nextId;     // from 0 to max-1, cyclic
   SWriteWorker  *writeWorker;
+  pthread_mutex_t mutex;     // vnodes may be opened concurrently
 } SWriteWorkerPool;
 
 static void *dnodeProcessWriteQueue(void *param);
 static void  dnodeHandleIdleWorker(SWriteWorker *pWorker);
+static void  dnodeCommitWriteBatches(SWriteWorker *pWorker);
 
 SWriteWorkerPool wWorkerPool;
 
@@ -58,6 +73,7 @@ int32_t dnodeInitWrite() {
   wWorkerPool.max = tsNumOfCores;
   wWorkerPool.writeWorker = (SWriteWorker *)calloc(sizeof(SWriteWorker), wWorkerPool.max);
   if (wWorkerPool.writeWorker == NULL) return -1;
+  pthread_mutex_init(&wWorkerPool.mutex, NULL);
 
   for (int32_t i = 0; i < wWorkerPool.max; ++i) {
     wWorkerPool.writeWorker[i].workerId = i;
@@ -79,12 +95,15 @@ void dnodeCleanupWrite() {
     SWriteWorker *pWorker =  wWorkerPool.writeWorker + i;
     if (pWorker->thread) {
       pthread_join(pWorker->thread, NULL);
-      taosFreeQall(pWorker->qall);
+      for (int32_t j = 0; j < DNODE_MAX_WRITE_BATCHES; ++j) {
+        taosFreeQall(pWorker->batches[j].qall);
+      }
       taosCloseQset(pWorker->qset);
     }
   }
 
   free(wWorkerPool.writeWorker);
+  pthread_mutex_destroy(&wWorkerPool.mutex);
   dPrint("dnode write is closed");
 }
 
@@ -123,16 +142,24 @@ void dnodeDispatchToVnodeWriteQueue(SRpcMsg *pMsg) {
 }
 
 void *dnodeAllocateWqueue(void *pVnode) {
-  SWriteWorker *pWorker = wWorkerPool.writeWorker + wWorkerPool.nextId;
   void *queue = taosOpenQueue();
   if (queue == NULL) return NULL;
 
+  pthread_mutex_lock(&wWorkerPool.mutex);
+  SWriteWorker *pWorker = wWorkerPool.writeWorker + wWorkerPool.nextId;
+
   if (pWorker->qset == NULL) {
     pWorker->qset = taosOpenQset();
-    if (pWorker->qset == NULL) return NULL;
+    if (pWorker->qset == NULL) {
+      pthread_mutex_unlock(&wWorkerPool.mutex);
+      taosCloseQueue(queue);
+      return NULL;
+    }
 
     taosAddIntoQset(pWorker->qset, queue, pVnode);
-    pWorker->qall = taosAllocateQall();
+    for (int32_t i = 0; i < DNODE_MAX_WRITE_BATCHES; ++i) {
+      pWorker->batches[i].qall = taosAllocateQall();
+    }
     wWorkerPool.nextId = (wWorkerPool.nextId + 1) % wWorkerPool.max;
 
     pthread_attr_t thAttr;
@@ -152,6 +179,8 @@ void *dnodeAllocateWqueue(void *pVnode) {
     wWorkerPool.nextId = (wWorkerPool.nextId + 1) % wWorkerPool.max;
   }
 
+  pthread_mutex_unlock(&wWorkerPool.mutex);
+
   dTrace("pVnode:%p, write queue:%p is allocated", pVnode, queue);
 
   return queue;
@@ -184,6 +213,7 @@ void dnodeSendRpcWriteRsp(void *pVnode, void *param, int32_t code) {
 
 static void *dnodeProcessWriteQueue(void *param) {
   SWriteWorker *pWorker = (SWriteWorker *)param;
+  SWriteBatch  *pBatch;
   SWriteMsg    *pWrite;
   SWalHead     *pHead;
   int32_t       numOfMsgs;
@@ -191,15 +221,22 @@ static void *dnodeProcessWriteQueue(void *param) {
   void         *pVnode, *item;
 
   while (1) {
-    numOfMsgs = taosReadAllQitemsFromQset(pWorker->qset, pWorker->qall, &pVnode);
+    pBatch = pWorker->batches + pWorker->numOfBatches;
+    numOfMsgs = taosReadAllQitemsFromQset(pWorker->qset, pBatch->qall, &pVnode);
     if (numOfMsgs ==0) { 
+      dnodeCommitWriteBatches(pWorker);
       dTrace("dnodeProcessWriteQueee: got no message from qset, exiting...");
       break;
     }
 
+    pBatch->pVnode = pVnode;
+    pBatch->numOfMsgs = numOfMsgs;
+    if (pWorker->numOfBatches == 0) pWorker->firstBatchMs = taosGetTimestampMs();
+    pWorker->numOfBatches++;
+
     for (int32_t i = 0; i < numOfMsgs; ++i) {
       pWrite = NULL;
-      taosGetQitem(pWorker->qall, &type, &item);
+      taosGetQitem(pBatch->qall, &type, &item);
       if (type == TAOS_QTYPE_RPC) {
         pWrite = (SWriteMsg *)item;
         pHead = (SWalHead *)(pWrite->pCont - sizeof(SWalHead));
@@ -213,25 +250,63 @@ static void *dnodeProcessWriteQueue(void *param) {
 
       int32_t code = vnodeProcessWrite(pVnode, type, pHead, item);
       if (pWrite) pWrite->rpcMsg.code = code;
+      pWorker->walBytes += sizeof(SWalHead) + pHead->len;
     }
 
-    walFsync(vnodeGetWal(pVnode));
+    // group commit: while more messages are queued, the fsync is deferred and shared by the following
+    // batches, until the pending batches reach the time or size limit
+    if (pWorker->numOfBatches >= DNODE_MAX_WRITE_BATCHES || taosGetQsetItemsNumber(pWorker->qset) <= 0 ||
+        pWorker->walBytes >= (int64_t)tsWalFsyncSize * 1024 ||
+        taosGetTimestampMs() - pWorker->firstBatchMs >= tsWalFsyncInterval) {
+      dnodeCommitWriteBatches(pWorker);
+    }
+  }
 
-    // browse all items, and process them one by one
-    taosResetQitems(pWorker->qall);
-    for (int32_t i = 0; i < numOfMsgs; ++i) {
-      taosGetQitem(pWorker->qall, &type, &item);
+  return NULL;
+}
+
+// fsync the WAL of each vnode having pending batches once, then respond to all the pending messages
+static void dnodeCommitWriteBatches(SWriteWorker *pWorker) {
+  SWriteBatch *pBatch;
+  SWriteMsg   *pWrite;
+  int          type;
+  void        *item;
+
+  int32_t codes[DNODE_MAX_WRITE_BATCHES];
+  for (int32_t i = 0; i < pWorker->numOfBatches; ++i) {
+    pBatch = pWorker->batches + i;
+
+    int32_t j = 0;
+    while (j < i && pWorker->batches[j].pVnode != pBatch->pVnode) j++;
+    if (j == i) {
+      codes[i] = (walFsync(vnodeGetWal(pBatch->pVnode)) < 0) ? TSDB_CODE_OTHERS : TSDB_CODE_SUCCESS;
+      if (codes[i] != TSDB_CODE_SUCCESS) dError("vnode:%p, failed to flush WAL, pending writes fail", pBatch->pVnode);
+    } else {
+      codes[i] = codes[j];
+    }
+  }
+
+  // browse all items, and process them one by one
+  for (int32_t i = 0; i < pWorker->numOfBatches; ++i) {
+    pBatch = pWorker->batches + i;
+
+    taosResetQitems(pBatch->qall);
+    for (int32_t k = 0; k < pBatch->numOfMsgs; ++k) {
+      taosGetQitem(pBatch->qall, &type, &item);
       if (type == TAOS_QTYPE_RPC) {
         pWrite = (SWriteMsg *)item;
-        dnodeSendRpcWriteRsp(pVnode, item, pWrite->rpcMsg.code); 
+        // the records not in WAL shall not be acknowledged
+        if (pWrite->rpcMsg.code == TSDB_CODE_SUCCESS) pWrite->rpcMsg.code = codes[i];
+        dnodeSendRpcWriteRsp(pBatch->pVnode, item, pWrite->rpcMsg.code); 
       } else {
         taosFreeQitem(item);
-        vnodeRelease(pVnode);
+        vnodeRelease(pBatch->pVnode);
       }
     }
   }
 
-  return NULL;
+  pWorker->numOfBatches = 0;
+  pWorker->walBytes = 0;
 }
 
 UNUSED_FUNC
@@ -242,7 +317,9 @@ static void dnodeHandleIdleWorker(SWriteWorker *pWorker) {
      usleep(30000);
      sched_yield(); 
   } else {
-     taosFreeQall(pWorker->qall);
+     for (int32_t i = 0; i < DNODE_MAX_WRITE_BATCHES; ++i) {
+       taosFreeQall(pWorker->batches[i].qall);
+     }
      taosCloseQset(pWorker->qset);
      pWorker->qset = NULL;
      dTrace("write worker:%d is released", pWorker->workerId);
@@ -26,6 +26,10 @@ typedef struct {
   int32_t queryReqNum;
   int32_t submitReqNum;
   int32_t httpReqNum;
+  int64_t commitNum;   // commits finished by the open vnodes
+  int64_t commitRows;  // rows written to files by these commits
+  int64_t commitMs;    // total duration of these commits
+  int64_t commitColsByAlgorithm[TSDB_COMP_ALGORITHMS];  // columns of the file blocks written by each algorithm
 } SDnodeStatisInfo;
 
 typedef enum {
@@ -283,18 +283,75 @@ void tsDataSwap(void *pLeft, void *pRight, int32_t type, int32_t size);
 #define TSDB_MAX_COMMIT_TIME            40960
 #define TSDB_DEFAULT_COMMIT_TIME        3600
 
+#define TSDB_MIN_COMMIT_THREADS         1
+#define TSDB_MAX_COMMIT_THREADS         16
+#define TSDB_DEFAULT_COMMIT_THREADS     4
+
+#define TSDB_ROLLUP_INTERVALS_LEN       64
+
+#define TSDB_MIN_BLOCK_CACHE_SIZE       0     // MB
+#define TSDB_MAX_BLOCK_CACHE_SIZE       65536
+#define TSDB_DEFAULT_BLOCK_CACHE_SIZE   16
+
+#define TSDB_MIN_BLOCK_IDX_CACHE_SIZE   0     // MB
+#define TSDB_MAX_BLOCK_IDX_CACHE_SIZE   1024
+#define TSDB_DEFAULT_BLOCK_IDX_CACHE_SIZE 4
+
+#define TSDB_MIN_TAG_COND_CACHE_SIZE    0     // MB
+#define TSDB_MAX_TAG_COND_CACHE_SIZE    1024
+#define TSDB_DEFAULT_TAG_COND_CACHE_SIZE 1
+
+#define TSDB_MIN_TAG_HASH_INDEX         0
+#define TSDB_MAX_TAG_HASH_INDEX         1
+#define TSDB_DEFAULT_TAG_HASH_INDEX     1
+
+#define TSDB_MIN_READ_AHEAD_BLOCKS      0
+#define TSDB_MAX_READ_AHEAD_BLOCKS      256
+#define TSDB_DEFAULT_READ_AHEAD_BLOCKS  8
+
+#define TSDB_MIN_DECOMPRESS_THREADS     0
+#define TSDB_MAX_DECOMPRESS_THREADS     32
+#define TSDB_DEFAULT_DECOMPRESS_THREADS 0
+
 #define TSDB_MIN_PRECISION              TSDB_PRECISION_MILLI
 #define TSDB_MAX_PRECISION              TSDB_PRECISION_NANO
 #define TSDB_DEFAULT_PRECISION          TSDB_PRECISION_MILLI
 
 #define TSDB_MIN_COMP_LEVEL             0
-#define TSDB_MAX_COMP_LEVEL             2
+#define TSDB_MAX_COMP_LEVEL             4
 #define TSDB_DEFAULT_COMP_LEVEL         2
 
+#define TSDB_MIN_ADAPTIVE_COMP          0
+#define TSDB_MAX_ADAPTIVE_COMP          1
+#define TSDB_DEFAULT_ADAPTIVE_COMP      0
+
+#define TSDB_COMP_ALGORITHMS            8     // algorithms a column of a file block may be compressed by
+
+#define TSDB_MIN_COMPACT_RATIO          0     // percent, 0 means no compaction by the ratio
+#define TSDB_MAX_COMPACT_RATIO          100
+#define TSDB_DEFAULT_COMPACT_SUB_BLOCKS 0     // sub-blocks in percent of the blocks of a file group, 20 is suggested
+#define TSDB_DEFAULT_COMPACT_TOMB_SIZE  0     // unused size in percent of the data and last files of a group, 30 is suggested
+
+#define TSDB_MIN_COMPACT_IO_RATE        0     // MB/s, 0 means no limit
+#define TSDB_MAX_COMPACT_IO_RATE        10240
+#define TSDB_DEFAULT_COMPACT_IO_RATE    32
+
 #define TSDB_MIN_WAL_LEVEL             0
 #define TSDB_MAX_WAL_LEVEL             2
 #define TSDB_DEFAULT_WAL_LEVEL         2
 
+#define TSDB_MIN_WAL_FSYNC_INTERVAL     0        // ms, 0 means fsync each batch drained from a write queue
+#define TSDB_MAX_WAL_FSYNC_INTERVAL     1000
+#define TSDB_DEFAULT_WAL_FSYNC_INTERVAL 10
+
+#define TSDB_MIN_WAL_FSYNC_SIZE         0        // KB of WAL records written by a write worker before fsync
+#define TSDB_MAX_WAL_FSYNC_SIZE         (64 * 1024)
+#define TSDB_DEFAULT_WAL_FSYNC_SIZE     4096
+
+#define TSDB_MIN_WAL_SEGMENT_SIZE       0        // MB, 0 means WAL files grow with writes
+#define TSDB_MAX_WAL_SEGMENT_SIZE       1024
+#define TSDB_DEFAULT_WAL_SEGMENT_SIZE   0
+
 #define TSDB_MIN_REPLICA_NUM            1
 #define TSDB_MAX_REPLICA_NUM            3
 #define TSDB_DEFAULT_REPLICA_NUM        1
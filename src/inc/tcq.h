@@ -29,6 +29,37 @@ typedef struct {
   FCqWrite cqWrite;
 } SCqCfg;
 
+// aggregate functions an incremental CQ can evaluate, same values as TSDB_FUNC_* in tsqlfunction.h
+#define TSDB_CQ_FUNC_COUNT 0
+#define TSDB_CQ_FUNC_SUM   1
+#define TSDB_CQ_FUNC_AVG   2
+#define TSDB_CQ_FUNC_MIN   3
+#define TSDB_CQ_FUNC_MAX   4
+#define TSDB_CQ_FUNC_FIRST 8
+#define TSDB_CQ_FUNC_LAST  9
+
+typedef struct {
+  int8_t   funcId;   // TSDB_CQ_FUNC_*
+  int8_t   type;     // data type of the source column
+  int16_t  offset;   // offset of the source column in a data row of the source table
+} SCqAggCol;
+
+/* Compiled form of "select func(col), ... from srcTable interval(interval) sliding(sliding)". If it is
+ * given to cqCreate, the CQ is evaluated incrementally on the write path instead of by a stream. The
+ * first column of the target table is the window start key, the i-th aggregate column fills the
+ * (i+1)-th column of the target table.
+ */
+typedef struct {
+  uint64_t  srcUid;    // uid of the source table
+  uint64_t  uid;       // uid of the target table
+  int32_t   sversion;  // schema version of the target table
+  int64_t   interval;  // window length, in the precision of the source table
+  int64_t   sliding;   // window step, equal to interval for tumbling windows
+  int64_t   delay;     // how long a window stays open after its end to absorb out of order rows
+  int32_t   numOfCols; // number of aggregate columns
+  SCqAggCol cols[];
+} SCqDef;
+
 // the following API shall be called by vnode
 void *cqOpen(void *ahandle, const SCqCfg *pCfg);
 void  cqClose(void *handle);
@@ -39,12 +70,15 @@ void  cqStart(void *handle);
 // if vnode is slave/unsynced, vnode shall call this API to stop CQ
 void  cqStop(void *handle);
 
-// cqCreate is called by TSDB to start an instance of CQ 
-void *cqCreate(void *handle, int sid, char *sqlStr, SSchema *pSchema, int columns);
+// cqCreate is called by TSDB to start an instance of CQ, pDef is NULL if the CQ can only run as a stream
+void *cqCreate(void *handle, int sid, char *sqlStr, const SCqDef *pDef, SSchema *pSchema, int columns);
 
 // cqDrop is called by TSDB to stop an instance of CQ, handle is the return value of cqCreate
 void  cqDrop(void *handle);
 
+// cqProcessSubmit is called by vnode once a submit msg is written into TSDB, pMsg is in host order
+void  cqProcessSubmit(void *handle, SSubmitMsg *pMsg);
+
 extern int cqDebugFlag;
 
 
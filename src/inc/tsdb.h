@@ -123,6 +123,36 @@ typedef struct STsdbRepoInfo {
 } STsdbRepoInfo;
 STsdbRepoInfo *tsdbGetStatus(TsdbRepoT *pRepo);
 
+// the commit statistics of a TSDB repository
+typedef struct {
+  int64_t numOfCommits;   // number of commits finished
+  int64_t numOfFGroups;   // total file groups written
+  int64_t numOfRows;      // total rows written to files
+  int64_t lastCommitUs;   // duration of the last commit, in microseconds
+  int64_t lastCommitRows; // rows written by the last commit
+  int64_t totalCommitUs;  // total duration of all commits, in microseconds
+  int64_t numOfColsByAlgorithm[TSDB_COMP_ALGORITHMS];  // columns of the file blocks written by each algorithm
+} STsdbCommitStat;
+void tsdbGetCommitStat(TsdbRepoT *repo, STsdbCommitStat *pStat);
+
+// the compaction statistics of a TSDB repository
+typedef struct {
+  int64_t numOfCompactions;  // file groups rewritten
+  int64_t numOfAborts;       // compactions given up for commits
+  int64_t bytesRead;         // bytes of the blocks read by compactions
+  int64_t bytesWritten;      // bytes of the files written by compactions
+  int64_t totalCompactUs;    // total duration of all compactions, in microseconds
+} STsdbCompactStat;
+void tsdbGetCompactStat(TsdbRepoT *repo, STsdbCompactStat *pStat);
+
+/**
+ * Rewrite the file groups with too many sub-blocks or too much unused size into merged blocks, as the compaction
+ * after a commit does. The compaction gives up as soon as a commit starts.
+ *
+ * @return 0 for success, -1 if a commit or compaction is running or the compaction fails
+ */
+int32_t tsdbCompact(TsdbRepoT *repo);
+
 // the meter information report structure
 typedef struct {
   STableCfg tableCfg;
@@ -152,6 +182,7 @@ typedef struct STsdbQueryCond {
   int32_t          order;  // desc|asc order to iterate the data block
   int32_t          numOfCols;
   SColumnInfo     *colList;
+  int64_t          rollup;  // interval of the rollups to return instead of the data blocks of files, 0 for none
 } STsdbQueryCond;
 
 typedef struct SDataBlockInfo {
@@ -184,6 +215,20 @@ typedef void *TsdbPosT;
  */
 TsdbQueryHandleT *tsdbQueryTables(TsdbRepoT *tsdb, STsdbQueryCond *pCond, STableGroupInfo *groupInfo);
 
+/**
+ * Get the largest rollup interval an interval query can be served with. The windows of the query start from skey
+ * and the buckets of the rollup must not cross them.
+ *
+ * If rollups are used, each rollup bucket of the file groups covered by the query window is returned as a data
+ * block with the block statistics only, and tsdbRetrieveDataBlock returns NULL for it.
+ *
+ * @param tsdb      tsdb handle
+ * @param interval  interval of the query windows
+ * @param skey      start key of the first query window
+ * @return the rollup interval to set in STsdbQueryCond, 0 if no rollup can be used
+ */
+int64_t tsdbGetRollupInterval(TsdbRepoT *tsdb, int64_t interval, TSKEY skey);
+
 /**
  * Get the last row of the given query time window for all the tables in STableGroupInfo object.
  * Note that only one data block with only row will be returned while invoking retrieve data block function for
@@ -204,6 +249,14 @@ TsdbQueryHandleT tsdbQueryLastRow(TsdbRepoT *tsdb, STsdbQueryCond *pCond, STable
  */
 bool tsdbNextDataBlock(TsdbQueryHandleT *pQueryHandle);
 
+/**
+ * Get the error that ended the scan, tsdbNextDataBlock returns false both at the end of the data and on a failure
+ *
+ * @param pQueryHandle
+ * @return TSDB_CODE_SUCCESS, or the error code of the failed scan
+ */
+int32_t tsdbGetQueryCode(TsdbQueryHandleT *pQueryHandle);
+
 /**
  * Get current data block information
  *
@@ -236,6 +289,21 @@ int32_t tsdbRetrieveDataBlockStatisInfo(TsdbQueryHandleT *pQueryHandle, SDataSta
  */
 SArray *tsdbRetrieveDataBlock(TsdbQueryHandleT *pQueryHandle, SArray *pColumnIdList);
 
+/**
+ * Get the dictionary codes of a binary or nchar column of the data block returned by tsdbRetrieveDataBlock. The code
+ * of a row is the index of its value in the distinct values of the column in the block, so that a filter on the column
+ * can be evaluated once for each distinct value instead of each row.
+ *
+ * The codes are available only if the column of the block is dictionary encoded, and the block is returned as a
+ * whole from the file.
+ *
+ * @param pQueryHandle      query handle
+ * @param colId             column id
+ * @param codes             the code of each row, valid until the next data block is retrieved
+ * @return                  the number of distinct values, or 0 if the codes are not available
+ */
+int32_t tsdbRetrieveDataBlockDictCodes(TsdbQueryHandleT *pQueryHandle, int16_t colId, const uint8_t **codes);
+
 /**
  * todo remove this function later
  * @param pQueryHandle
@@ -37,6 +37,7 @@ typedef struct {
   int8_t    walLevel;  // wal level
   int8_t    wals;      // number of WAL files;
   int8_t    keep;      // keep the wal file when closed
+  int32_t   segSize;   // size of pre-allocated and recycled WAL files, 0 for files growing with writes
 } SWalCfg;
 
 typedef void* twalh;  // WAL HANDLE
@@ -46,7 +47,7 @@ twalh   walOpen(const char *path, const SWalCfg *pCfg);
 void    walClose(twalh);
 int     walRenew(twalh);
 int     walWrite(twalh, SWalHead *);
-void    walFsync(twalh);
+int     walFsync(twalh);
 int     walRestore(twalh, void *pVnode, FWalWrite writeFp);
 int     walGetWalFile(twalh, char *name, uint32_t *index);
 
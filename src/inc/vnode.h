@@ -51,6 +51,7 @@ void*   vnodeGetWal(void *pVnode);
 
 int32_t vnodeProcessWrite(void *pVnode, int qtype, void *pHead, void *item);
 void    vnodeBuildStatusMsg(void * param);
+void    vnodeGetCommitStat(STsdbCommitStat *pStat);  // summed over the open vnodes
 
 int32_t vnodeProcessRead(void *pVnode, int msgType, void *pCont, int32_t contLen, SRspRet *ret);
 
@@ -524,7 +524,11 @@ static int sdbWrite(void *param, void *data, int type) {
     pthread_mutex_unlock(&tsSdbObj.mutex);
     return code;
   }
-  walFsync(tsSdbObj.wal);
+  if (walFsync(tsSdbObj.wal) < 0) {
+    pthread_mutex_unlock(&tsSdbObj.mutex);
+    sdbError("table:%s, failed to fsync wal, version:%" PRId64, pTable->tableName, pHead->version);
+    return TSDB_CODE_OTHERS;
+  }
 
   code = sdbForwardToPeer(pHead);
   pthread_mutex_unlock(&tsSdbObj.mutex);
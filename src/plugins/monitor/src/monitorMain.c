@@ -22,6 +22,7 @@
 #include "ttimer.h"
 #include "tutil.h"
 #include "tsystem.h"
+#include "tscompression.h"
 #include "tscUtil.h"
 #include "tsclient.h"
 #include "dnode.h"
@@ -165,6 +166,9 @@ static void dnodeBuildMonitorSql(char *sql, int32_t cmd) {
              ", band_speed float"
              ", io_read float, io_write float"
              ", req_http int, req_select int, req_insert int"
+             ", commit_num bigint, commit_rows bigint, commit_ms bigint"
+             ", comp_none bigint, comp_one_stage bigint, comp_two_stage bigint"
+             ", comp_bitpack bigint, comp_chimp bigint, comp_dict bigint"
              ") tags (dnodeid int, fqdn binary(%d))",
              tsMonitorDbName, TSDB_FQDN_LEN + 1);
   } else if (cmd == MONITOR_CMD_CREATE_TB_DN) {
@@ -331,7 +335,12 @@ static int32_t monitorBuildBandSql(char *sql) {
 
 static int32_t monitorBuildReqSql(char *sql) {
   SDnodeStatisInfo info = dnodeGetStatisInfo(); 
-  return sprintf(sql, ", %d, %d, %d)", info.httpReqNum, info.queryReqNum, info.submitReqNum);
+  int32_t pos = sprintf(sql, ", %d, %d, %d, %" PRId64 ", %" PRId64 ", %" PRId64, info.httpReqNum, info.queryReqNum,
+                        info.submitReqNum, info.commitNum, info.commitRows, info.commitMs);
+  for (int32_t i = NO_COMPRESSION; i <= DICT_COMP; ++i) {
+    pos += sprintf(sql + pos, ", %" PRId64, info.commitColsByAlgorithm[i]);
+  }
+  return pos + sprintf(sql + pos, ")");
 }
 
 static int32_t monitorBuildIoSql(char *sql) {
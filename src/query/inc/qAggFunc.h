@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TDENGINE_QAGGFUNC_H
+#define TDENGINE_QAGGFUNC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "os.h"
+
+/*
+ * Aggregation kernels over a column of a data block. If hasNull is false, the column is known to contain no null
+ * value, e.g. from the numOfNull of the block statistics, and the values are not checked. Otherwise the null values
+ * are masked out. *numOfElems is set to the number of values that are not null.
+ */
+void aggSum_i8(const void *data, int32_t num, bool hasNull, int64_t *sum, int32_t *numOfElems);
+void aggSum_i16(const void *data, int32_t num, bool hasNull, int64_t *sum, int32_t *numOfElems);
+void aggSum_i32(const void *data, int32_t num, bool hasNull, int64_t *sum, int32_t *numOfElems);
+void aggSum_i64(const void *data, int32_t num, bool hasNull, int64_t *sum, int32_t *numOfElems);
+void aggSum_ds(const void *data, int32_t num, bool hasNull, double *sum, int32_t *numOfElems);
+void aggSum_dd(const void *data, int32_t num, bool hasNull, double *sum, int32_t *numOfElems);
+
+/*
+ * Return the index of the min (isMin is 1) or max value, -1 if all values are null. The last index of the min value
+ * and the first index of the max value are returned, which are the positions a row by row comparison stops at.
+ */
+int32_t aggMinMax_i8(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems);
+int32_t aggMinMax_i16(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems);
+int32_t aggMinMax_i32(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems);
+int32_t aggMinMax_i64(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems);
+int32_t aggMinMax_ds(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems);
+int32_t aggMinMax_dd(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems);
+
+// number of values that are not null, for all data types
+int32_t aggCountNotNull(const void *data, int32_t num, int32_t type, int32_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TDENGINE_QAGGFUNC_H
@@ -35,6 +35,8 @@
 
 struct SColumnFilterElem;
 typedef bool (*__filter_func_t)(struct SColumnFilterElem* pFilter, char* val1, char* val2);
+typedef void (*__block_filter_func_t)(struct SColumnFilterElem* pFilter, const char* pData, int32_t numOfRows,
+                                      int8_t* pRes);
 typedef int32_t (*__block_search_fn_t)(char* data, int32_t num, int64_t key, int32_t order);
 
 typedef struct SSqlGroupbyExpr {
@@ -86,6 +88,7 @@ typedef struct SWindowResInfo {
 typedef struct SColumnFilterElem {
   int16_t           bytes;  // column length
   __filter_func_t   fp;
+  __block_filter_func_t blockFp;  // evaluates the filter over a column of a block, NULL if not available
   SColumnFilterInfo filterInfo;
 } SColumnFilterElem;
 
@@ -94,6 +97,8 @@ typedef struct SSingleColumnFilterInfo {
   int32_t            numOfFilters;
   SColumnFilterElem* pFilters;
   void*              pData;
+  const uint8_t*     pCodes;    // dictionary code of each row of the block for binary and nchar columns, or NULL
+  int32_t            dictSize;  // number of distinct values in the block if pCodes is not NULL
 } SSingleColumnFilterInfo;
 
 typedef struct STableQueryInfo {  // todo merge with the STableQueryInfo struct
@@ -111,6 +116,11 @@ typedef struct STableQueryInfo {  // todo merge with the STableQueryInfo struct
 } STableQueryInfo;
 
 typedef struct SQueryCostSummary {
+  int32_t totalBlocks;      // number of data blocks checked by the query
+  int32_t loadBlocks;       // number of data blocks loaded and decompressed
+  int32_t loadBlockStatis;  // number of data blocks aggregated by their statistics only
+  int32_t discardBlocks;    // number of data blocks not required at all
+  int64_t totalRows;        // number of rows in all data blocks checked
 } SQueryCostSummary;
 
 typedef struct SGroupItem {
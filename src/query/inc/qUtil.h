@@ -40,6 +40,9 @@ char *getPosInResultPage(SQueryRuntimeEnv *pRuntimeEnv, int32_t columnIndex, SWi
 
 __filter_func_t *getRangeFilterFuncArray(int32_t type);
 __filter_func_t *getValueFilterFuncArray(int32_t type);
+__block_filter_func_t *getRangeBlockFilterFuncArray(int32_t type);
+__block_filter_func_t *getValueBlockFilterFuncArray(int32_t type);
+void filterNotNullBlock(int32_t type, int32_t bytes, const char *pData, int32_t numOfRows, int8_t *pRes);
 
 bool supportPrefilter(int32_t type);
 
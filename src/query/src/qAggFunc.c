@@ -0,0 +1,538 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _DEFAULT_SOURCE
+#include "os.h"
+
+#include "qAggFunc.h"
+#include "taosdef.h"
+
+/*
+ * The kernels process 16 bytes of values per iteration with SSE4.2, which is what the tree is built with, and the
+ * rest of the values one by one. A null value is a special value of the type, it is replaced by a value that does
+ * not change the result in the lanes where it is found.
+ */
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+
+#define NUM_OF_NULLS(mask) __builtin_popcount(mask)
+
+static inline int64_t sumOfLanes_i64(__m128i v) { return _mm_cvtsi128_si64(v) + _mm_extract_epi64(v, 1); }
+#endif
+
+// the remaining values after the vectorized loop
+#define SUM_REST(_type, _d, _i, _num, _hasNull, _tsdbType, _sum, _count) \
+  for (; (_i) < (_num); ++(_i)) {                                        \
+    if ((_hasNull) && isNull((const char *)&(_d)[(_i)], _tsdbType)) {    \
+      continue;                                                          \
+    }                                                                    \
+    (_sum) += (_d)[(_i)];                                                \
+    (_count) += 1;                                                       \
+  }
+
+/*
+ * Compare the remaining values with the min/max of the vectorized loop, then find the last index of the min or the
+ * first index of the max. A null value is never the min/max of the not null values, so it needs no check here.
+ */
+#define MINMAX_REST(_type, _d, _i, _num, _hasNull, _tsdbType, _isMin, _ext, _count) \
+  do {                                                                              \
+    for (; (_i) < (_num); ++(_i)) {                                                 \
+      if ((_hasNull) && isNull((const char *)&(_d)[(_i)], _tsdbType)) {             \
+        continue;                                                                   \
+      }                                                                             \
+      if ((_isMin) ? ((_d)[(_i)] < (_ext)) : ((_d)[(_i)] > (_ext))) {               \
+        (_ext) = (_d)[(_i)];                                                        \
+      }                                                                             \
+      (_count) += 1;                                                                \
+    }                                                                               \
+                                                                                    \
+    *numOfElems = (_count);                                                         \
+    if ((_count) == 0) {                                                            \
+      return -1;                                                                    \
+    }                                                                               \
+                                                                                    \
+    if (_isMin) {                                                                   \
+      for (int32_t k = (_num) - 1; k >= 0; --k) {                                   \
+        if ((_d)[k] == (_ext)) return k;                                            \
+      }                                                                             \
+    } else {                                                                        \
+      for (int32_t k = 0; k < (_num); ++k) {                                        \
+        if ((_d)[k] == (_ext)) return k;                                            \
+      }                                                                             \
+    }                                                                               \
+    return -1;                                                                      \
+  } while (0)
+
+void aggSum_i8(const void *data, int32_t num, bool hasNull, int64_t *sum, int32_t *numOfElems) {
+  const int8_t *d = data;
+  int32_t       i = 0, count = 0;
+  int64_t       s = 0;
+
+#ifdef __SSE4_2__
+  // the values plus 128 are summed as unsigned bytes by psadbw, the null value 0x80 becomes 0 and adds nothing
+  const __m128i bias = _mm_set1_epi8((char)TSDB_DATA_TINYINT_NULL);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i       acc = zero;
+
+  for (; i + 16 <= num; i += 16) {
+    __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(d + i)), bias);
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+    count += hasNull ? 16 - NUM_OF_NULLS(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))) : 16;
+  }
+
+  s = sumOfLanes_i64(acc) - 128LL * count;
+#endif
+
+  SUM_REST(int8_t, d, i, num, hasNull, TSDB_DATA_TYPE_TINYINT, s, count);
+  *sum = s;
+  *numOfElems = count;
+}
+
+void aggSum_i16(const void *data, int32_t num, bool hasNull, int64_t *sum, int32_t *numOfElems) {
+  const int16_t *d = data;
+  int32_t        i = 0, count = 0;
+  int64_t        s = 0;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi16((int16_t)TSDB_DATA_SMALLINT_NULL);
+  const __m128i one = _mm_set1_epi16(1);
+  __m128i       acc = _mm_setzero_si128();
+
+  for (; i + 8 <= num; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(d + i));
+    if (hasNull) {
+      __m128i mask = _mm_cmpeq_epi16(v, nullVal);
+      v = _mm_andnot_si128(mask, v);
+      count += 8 - NUM_OF_NULLS(_mm_movemask_epi8(mask)) / 2;
+    } else {
+      count += 8;
+    }
+
+    // sums of adjacent pairs in 32 bits, then widened to 64 bits
+    __m128i p = _mm_madd_epi16(v, one);
+    acc = _mm_add_epi64(acc, _mm_add_epi64(_mm_cvtepi32_epi64(p), _mm_cvtepi32_epi64(_mm_srli_si128(p, 8))));
+  }
+
+  s = sumOfLanes_i64(acc);
+#endif
+
+  SUM_REST(int16_t, d, i, num, hasNull, TSDB_DATA_TYPE_SMALLINT, s, count);
+  *sum = s;
+  *numOfElems = count;
+}
+
+void aggSum_i32(const void *data, int32_t num, bool hasNull, int64_t *sum, int32_t *numOfElems) {
+  const int32_t *d = data;
+  int32_t        i = 0, count = 0;
+  int64_t        s = 0;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi32((int32_t)TSDB_DATA_INT_NULL);
+  __m128i       acc0 = _mm_setzero_si128();
+  __m128i       acc1 = _mm_setzero_si128();
+
+  for (; i + 4 <= num; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(d + i));
+    if (hasNull) {
+      __m128i mask = _mm_cmpeq_epi32(v, nullVal);
+      v = _mm_andnot_si128(mask, v);
+      count += 4 - NUM_OF_NULLS(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+    } else {
+      count += 4;
+    }
+
+    acc0 = _mm_add_epi64(acc0, _mm_cvtepi32_epi64(v));
+    acc1 = _mm_add_epi64(acc1, _mm_cvtepi32_epi64(_mm_srli_si128(v, 8)));
+  }
+
+  s = sumOfLanes_i64(_mm_add_epi64(acc0, acc1));
+#endif
+
+  SUM_REST(int32_t, d, i, num, hasNull, TSDB_DATA_TYPE_INT, s, count);
+  *sum = s;
+  *numOfElems = count;
+}
+
+void aggSum_i64(const void *data, int32_t num, bool hasNull, int64_t *sum, int32_t *numOfElems) {
+  const int64_t *d = data;
+  int32_t        i = 0, count = 0;
+  int64_t        s = 0;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi64x((int64_t)TSDB_DATA_BIGINT_NULL);
+  __m128i       acc0 = _mm_setzero_si128();
+  __m128i       acc1 = _mm_setzero_si128();
+
+  for (; i + 4 <= num; i += 4) {
+    __m128i v0 = _mm_loadu_si128((const __m128i *)(d + i));
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(d + i + 2));
+    if (hasNull) {
+      __m128i mask0 = _mm_cmpeq_epi64(v0, nullVal);
+      __m128i mask1 = _mm_cmpeq_epi64(v1, nullVal);
+      v0 = _mm_andnot_si128(mask0, v0);
+      v1 = _mm_andnot_si128(mask1, v1);
+      count += 4 - NUM_OF_NULLS(_mm_movemask_pd(_mm_castsi128_pd(mask0))) -
+               NUM_OF_NULLS(_mm_movemask_pd(_mm_castsi128_pd(mask1)));
+    } else {
+      count += 4;
+    }
+
+    acc0 = _mm_add_epi64(acc0, v0);
+    acc1 = _mm_add_epi64(acc1, v1);
+  }
+
+  s = sumOfLanes_i64(_mm_add_epi64(acc0, acc1));
+#endif
+
+  SUM_REST(int64_t, d, i, num, hasNull, TSDB_DATA_TYPE_BIGINT, s, count);
+  *sum = s;
+  *numOfElems = count;
+}
+
+void aggSum_ds(const void *data, int32_t num, bool hasNull, double *sum, int32_t *numOfElems) {
+  const float *d = data;
+  int32_t      i = 0, count = 0;
+  double       s = 0;
+
+#ifdef __SSE4_2__
+  // float values are summed in double, as they are row by row
+  const __m128i nullVal = _mm_set1_epi32((int32_t)TSDB_DATA_FLOAT_NULL);
+  __m128d       acc0 = _mm_setzero_pd();
+  __m128d       acc1 = _mm_setzero_pd();
+
+  for (; i + 4 <= num; i += 4) {
+    __m128 v = _mm_loadu_ps(d + i);
+    if (hasNull) {
+      __m128 mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_castps_si128(v), nullVal));
+      v = _mm_andnot_ps(mask, v);
+      count += 4 - NUM_OF_NULLS(_mm_movemask_ps(mask));
+    } else {
+      count += 4;
+    }
+
+    acc0 = _mm_add_pd(acc0, _mm_cvtps_pd(v));
+    acc1 = _mm_add_pd(acc1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+  }
+
+  acc0 = _mm_add_pd(acc0, acc1);
+  s = _mm_cvtsd_f64(acc0) + _mm_cvtsd_f64(_mm_unpackhi_pd(acc0, acc0));
+#endif
+
+  SUM_REST(float, d, i, num, hasNull, TSDB_DATA_TYPE_FLOAT, s, count);
+  *sum = s;
+  *numOfElems = count;
+}
+
+void aggSum_dd(const void *data, int32_t num, bool hasNull, double *sum, int32_t *numOfElems) {
+  const double *d = data;
+  int32_t       i = 0, count = 0;
+  double        s = 0;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi64x((int64_t)TSDB_DATA_DOUBLE_NULL);
+  __m128d       acc0 = _mm_setzero_pd();
+  __m128d       acc1 = _mm_setzero_pd();
+
+  for (; i + 4 <= num; i += 4) {
+    __m128d v0 = _mm_loadu_pd(d + i);
+    __m128d v1 = _mm_loadu_pd(d + i + 2);
+    if (hasNull) {
+      __m128d mask0 = _mm_castsi128_pd(_mm_cmpeq_epi64(_mm_castpd_si128(v0), nullVal));
+      __m128d mask1 = _mm_castsi128_pd(_mm_cmpeq_epi64(_mm_castpd_si128(v1), nullVal));
+      v0 = _mm_andnot_pd(mask0, v0);
+      v1 = _mm_andnot_pd(mask1, v1);
+      count += 4 - NUM_OF_NULLS(_mm_movemask_pd(mask0)) - NUM_OF_NULLS(_mm_movemask_pd(mask1));
+    } else {
+      count += 4;
+    }
+
+    acc0 = _mm_add_pd(acc0, v0);
+    acc1 = _mm_add_pd(acc1, v1);
+  }
+
+  acc0 = _mm_add_pd(acc0, acc1);
+  s = _mm_cvtsd_f64(acc0) + _mm_cvtsd_f64(_mm_unpackhi_pd(acc0, acc0));
+#endif
+
+  SUM_REST(double, d, i, num, hasNull, TSDB_DATA_TYPE_DOUBLE, s, count);
+  *sum = s;
+  *numOfElems = count;
+}
+
+/*
+ * The max is found as the min of the complemented integers, or of the negated floats, so that one loop serves both.
+ * A null value is replaced by the max of the type, which is never less than a not null value.
+ */
+#define MINMAX_LANES(_type, _n, _store, _acc, _isMin, _ext) \
+  do {                                                              \
+    _type lanes[_n];                                                \
+    _store(lanes, _acc);                                            \
+    for (int32_t k = 0; k < (_n); ++k) {                            \
+      _type v = lanes[k];                                           \
+      if ((_isMin) ? (v < (_ext)) : (v > (_ext))) (_ext) = v;       \
+    }                                                               \
+  } while (0)
+
+#ifdef __SSE4_2__
+static inline void storeLanes_epi(void *p, __m128i v) { _mm_storeu_si128((__m128i *)p, v); }
+#endif
+
+int32_t aggMinMax_i8(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems) {
+  const int8_t *d = data;
+  int32_t       i = 0, count = 0;
+  int8_t        ext = isMin ? INT8_MAX : INT8_MIN;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi8((char)TSDB_DATA_TINYINT_NULL);
+  const __m128i flip = _mm_set1_epi8(isMin ? 0 : -1);
+  const __m128i init = _mm_set1_epi8(INT8_MAX);
+  __m128i       acc = init;
+
+  for (; i + 16 <= num; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(d + i));
+    if (hasNull) {
+      __m128i mask = _mm_cmpeq_epi8(v, nullVal);
+      acc = _mm_min_epi8(acc, _mm_blendv_epi8(_mm_xor_si128(v, flip), init, mask));
+      count += 16 - NUM_OF_NULLS(_mm_movemask_epi8(mask));
+    } else {
+      acc = _mm_min_epi8(acc, _mm_xor_si128(v, flip));
+      count += 16;
+    }
+  }
+
+  MINMAX_LANES(int8_t, 16, storeLanes_epi, _mm_xor_si128(acc, flip), isMin, ext);
+#endif
+
+  MINMAX_REST(int8_t, d, i, num, hasNull, TSDB_DATA_TYPE_TINYINT, isMin, ext, count);
+}
+
+int32_t aggMinMax_i16(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems) {
+  const int16_t *d = data;
+  int32_t        i = 0, count = 0;
+  int16_t        ext = isMin ? INT16_MAX : INT16_MIN;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi16((int16_t)TSDB_DATA_SMALLINT_NULL);
+  const __m128i flip = _mm_set1_epi16(isMin ? 0 : -1);
+  const __m128i init = _mm_set1_epi16(INT16_MAX);
+  __m128i       acc = init;
+
+  for (; i + 8 <= num; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(d + i));
+    if (hasNull) {
+      __m128i mask = _mm_cmpeq_epi16(v, nullVal);
+      acc = _mm_min_epi16(acc, _mm_blendv_epi8(_mm_xor_si128(v, flip), init, mask));
+      count += 8 - NUM_OF_NULLS(_mm_movemask_epi8(mask)) / 2;
+    } else {
+      acc = _mm_min_epi16(acc, _mm_xor_si128(v, flip));
+      count += 8;
+    }
+  }
+
+  MINMAX_LANES(int16_t, 8, storeLanes_epi, _mm_xor_si128(acc, flip), isMin, ext);
+#endif
+
+  MINMAX_REST(int16_t, d, i, num, hasNull, TSDB_DATA_TYPE_SMALLINT, isMin, ext, count);
+}
+
+int32_t aggMinMax_i32(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems) {
+  const int32_t *d = data;
+  int32_t        i = 0, count = 0;
+  int32_t        ext = isMin ? INT32_MAX : INT32_MIN;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi32((int32_t)TSDB_DATA_INT_NULL);
+  const __m128i flip = _mm_set1_epi32(isMin ? 0 : -1);
+  const __m128i init = _mm_set1_epi32(INT32_MAX);
+  __m128i       acc = init;
+
+  for (; i + 4 <= num; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(d + i));
+    if (hasNull) {
+      __m128i mask = _mm_cmpeq_epi32(v, nullVal);
+      acc = _mm_min_epi32(acc, _mm_blendv_epi8(_mm_xor_si128(v, flip), init, mask));
+      count += 4 - NUM_OF_NULLS(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+    } else {
+      acc = _mm_min_epi32(acc, _mm_xor_si128(v, flip));
+      count += 4;
+    }
+  }
+
+  MINMAX_LANES(int32_t, 4, storeLanes_epi, _mm_xor_si128(acc, flip), isMin, ext);
+#endif
+
+  MINMAX_REST(int32_t, d, i, num, hasNull, TSDB_DATA_TYPE_INT, isMin, ext, count);
+}
+
+int32_t aggMinMax_i64(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems) {
+  const int64_t *d = data;
+  int32_t        i = 0, count = 0;
+  int64_t        ext = isMin ? INT64_MAX : INT64_MIN;
+
+#ifdef __SSE4_2__
+  // there is no min of 64 bits integers in SSE, it is a compare and a blend
+  const __m128i nullVal = _mm_set1_epi64x((int64_t)TSDB_DATA_BIGINT_NULL);
+  const __m128i flip = _mm_set1_epi64x(isMin ? 0 : -1);
+  const __m128i init = _mm_set1_epi64x(INT64_MAX);
+  __m128i       acc0 = init;
+  __m128i       acc1 = init;
+
+  for (; i + 4 <= num; i += 4) {
+    __m128i v0 = _mm_loadu_si128((const __m128i *)(d + i));
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(d + i + 2));
+    if (hasNull) {
+      __m128i mask0 = _mm_cmpeq_epi64(v0, nullVal);
+      __m128i mask1 = _mm_cmpeq_epi64(v1, nullVal);
+      v0 = _mm_blendv_epi8(_mm_xor_si128(v0, flip), init, mask0);
+      v1 = _mm_blendv_epi8(_mm_xor_si128(v1, flip), init, mask1);
+      count += 4 - NUM_OF_NULLS(_mm_movemask_pd(_mm_castsi128_pd(mask0))) -
+               NUM_OF_NULLS(_mm_movemask_pd(_mm_castsi128_pd(mask1)));
+    } else {
+      v0 = _mm_xor_si128(v0, flip);
+      v1 = _mm_xor_si128(v1, flip);
+      count += 4;
+    }
+    acc0 = _mm_blendv_epi8(acc0, v0, _mm_cmpgt_epi64(acc0, v0));
+    acc1 = _mm_blendv_epi8(acc1, v1, _mm_cmpgt_epi64(acc1, v1));
+  }
+
+  acc0 = _mm_blendv_epi8(acc0, acc1, _mm_cmpgt_epi64(acc0, acc1));
+  MINMAX_LANES(int64_t, 2, storeLanes_epi, _mm_xor_si128(acc0, flip), isMin, ext);
+#endif
+
+  MINMAX_REST(int64_t, d, i, num, hasNull, TSDB_DATA_TYPE_BIGINT, isMin, ext, count);
+}
+
+int32_t aggMinMax_ds(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems) {
+  const float *d = data;
+  int32_t      i = 0, count = 0;
+  float        ext = isMin ? INFINITY : -INFINITY;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi32((int32_t)TSDB_DATA_FLOAT_NULL);
+  const __m128  flip = _mm_set1_ps(isMin ? 0.0f : -0.0f);
+  const __m128  init = _mm_set1_ps(INFINITY);
+  __m128        acc = init;
+
+  for (; i + 4 <= num; i += 4) {
+    __m128 v = _mm_loadu_ps(d + i);
+    if (hasNull) {
+      __m128 mask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_castps_si128(v), nullVal));
+      acc = _mm_min_ps(acc, _mm_blendv_ps(_mm_xor_ps(v, flip), init, mask));
+      count += 4 - NUM_OF_NULLS(_mm_movemask_ps(mask));
+    } else {
+      acc = _mm_min_ps(acc, _mm_xor_ps(v, flip));
+      count += 4;
+    }
+  }
+
+  MINMAX_LANES(float, 4, _mm_storeu_ps, _mm_xor_ps(acc, flip), isMin, ext);
+#endif
+
+  MINMAX_REST(float, d, i, num, hasNull, TSDB_DATA_TYPE_FLOAT, isMin, ext, count);
+}
+
+int32_t aggMinMax_dd(const void *data, int32_t num, bool hasNull, int32_t isMin, int32_t *numOfElems) {
+  const double *d = data;
+  int32_t       i = 0, count = 0;
+  double        ext = isMin ? INFINITY : -INFINITY;
+
+#ifdef __SSE4_2__
+  const __m128i nullVal = _mm_set1_epi64x((int64_t)TSDB_DATA_DOUBLE_NULL);
+  const __m128d flip = _mm_set1_pd(isMin ? 0.0 : -0.0);
+  const __m128d init = _mm_set1_pd(INFINITY);
+  __m128d       acc0 = init;
+  __m128d       acc1 = init;
+
+  for (; i + 4 <= num; i += 4) {
+    __m128d v0 = _mm_loadu_pd(d + i);
+    __m128d v1 = _mm_loadu_pd(d + i + 2);
+    if (hasNull) {
+      __m128d mask0 = _mm_castsi128_pd(_mm_cmpeq_epi64(_mm_castpd_si128(v0), nullVal));
+      __m128d mask1 = _mm_castsi128_pd(_mm_cmpeq_epi64(_mm_castpd_si128(v1), nullVal));
+      acc0 = _mm_min_pd(acc0, _mm_blendv_pd(_mm_xor_pd(v0, flip), init, mask0));
+      acc1 = _mm_min_pd(acc1, _mm_blendv_pd(_mm_xor_pd(v1, flip), init, mask1));
+      count += 4 - NUM_OF_NULLS(_mm_movemask_pd(mask0)) - NUM_OF_NULLS(_mm_movemask_pd(mask1));
+    } else {
+      acc0 = _mm_min_pd(acc0, _mm_xor_pd(v0, flip));
+      acc1 = _mm_min_pd(acc1, _mm_xor_pd(v1, flip));
+      count += 4;
+    }
+  }
+
+  MINMAX_LANES(double, 2, _mm_storeu_pd, _mm_xor_pd(_mm_min_pd(acc0, acc1), flip), isMin, ext);
+#endif
+
+  MINMAX_REST(double, d, i, num, hasNull, TSDB_DATA_TYPE_DOUBLE, isMin, ext, count);
+}
+
+int32_t aggCountNotNull(const void *data, int32_t num, int32_t type, int32_t bytes) {
+  int32_t     i = 0, numOfNull = 0;
+  const char *d = data;
+
+#ifdef __SSE4_2__
+  switch (type) {
+    case TSDB_DATA_TYPE_BOOL:
+    case TSDB_DATA_TYPE_TINYINT: {
+      const __m128i nullVal =
+          _mm_set1_epi8((char)((type == TSDB_DATA_TYPE_BOOL) ? TSDB_DATA_BOOL_NULL : TSDB_DATA_TINYINT_NULL));
+      for (; i + 16 <= num; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(d + i));
+        numOfNull += NUM_OF_NULLS(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nullVal)));
+      }
+      break;
+    }
+    case TSDB_DATA_TYPE_SMALLINT: {
+      const __m128i nullVal = _mm_set1_epi16((int16_t)TSDB_DATA_SMALLINT_NULL);
+      for (; i + 8 <= num; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(d + i * 2));
+        numOfNull += NUM_OF_NULLS(_mm_movemask_epi8(_mm_cmpeq_epi16(v, nullVal))) / 2;
+      }
+      break;
+    }
+    case TSDB_DATA_TYPE_INT:
+    case TSDB_DATA_TYPE_FLOAT: {
+      const __m128i nullVal =
+          _mm_set1_epi32((int32_t)((type == TSDB_DATA_TYPE_INT) ? TSDB_DATA_INT_NULL : TSDB_DATA_FLOAT_NULL));
+      for (; i + 4 <= num; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(d + i * 4));
+        numOfNull += NUM_OF_NULLS(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, nullVal))));
+      }
+      break;
+    }
+    case TSDB_DATA_TYPE_BIGINT:
+    case TSDB_DATA_TYPE_TIMESTAMP:
+    case TSDB_DATA_TYPE_DOUBLE: {
+      const __m128i nullVal =
+          _mm_set1_epi64x((int64_t)((type == TSDB_DATA_TYPE_DOUBLE) ? TSDB_DATA_DOUBLE_NULL : TSDB_DATA_BIGINT_NULL));
+      for (; i + 2 <= num; i += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(d + i * 8));
+        numOfNull += NUM_OF_NULLS(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(v, nullVal))));
+      }
+      break;
+    }
+    default:
+      break;
+  }
+#endif
+
+  for (; i < num; ++i) {
+    if (isNull(d + bytes * i, type)) {
+      numOfNull += 1;
+    }
+  }
+
+  return num - numOfNull;
+}
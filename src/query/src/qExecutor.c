@@ -101,6 +101,7 @@ typedef struct {
 static void setQueryStatus(SQuery *pQuery, int8_t status);
 
 static bool isIntervalQuery(SQuery *pQuery) { return pQuery->intervalTime > 0; }
+static bool isIntervalQueryOnStatis(SQuery *pQuery);
 
 // todo move to utility
 static int32_t mergeIntoGroupResultImpl(SQInfo *pQInfo, SArray *group);
@@ -226,11 +227,47 @@ bool getNeighborPoints(SQInfo *pQInfo, void *pMeterObj, SPointInterpoSupporter *
   return true;
 }
 
-bool doFilterData(SQuery *pQuery, int32_t elemPos) {
+/*
+ * Evaluate the filters of a dictionary encoded column once for each distinct value, the result of a distinct value is
+ * decided by the first selected row of it.
+ */
+static void doFilterByDictCodes(SSingleColumnFilterInfo *pFilterInfo, int32_t start, int32_t numOfRows,
+                                const int8_t *pSelected, int8_t *pColRes) {
+  int32_t        bytes = pFilterInfo->info.bytes;
+  char          *pData = (char *)pFilterInfo->pData + bytes * start;
+  const uint8_t *codes = pFilterInfo->pCodes + start;
+
+  int8_t dictRes[DICT_MAX_ENTRIES];  // -1 if the distinct value is not evaluated yet
+  assert(pFilterInfo->dictSize <= DICT_MAX_ENTRIES);
+  memset(dictRes, -1, (size_t)pFilterInfo->dictSize);
+
+  for (int32_t i = 0; i < numOfRows; ++i) {
+    if (!pSelected[i]) {
+      pColRes[i] = 0;
+      continue;
+    }
+
+    int8_t *pRes = &dictRes[codes[i]];
+    if (*pRes < 0) {
+      char *pElem = pData + bytes * i;
+
+      *pRes = 0;
+      for (int32_t j = 0; j < pFilterInfo->numOfFilters && *pRes == 0; ++j) {
+        SColumnFilterElem *pFilterElem = &pFilterInfo->pFilters[j];
+        *pRes = pFilterElem->fp(pFilterElem, pElem, pElem);
+      }
+    }
+
+    pColRes[i] = *pRes;
+  }
+}
+
+// Evaluate the filters on the row elemPos, used when the buffer of doFilterDataBlock cannot be allocated
+static bool doFilterData(SQuery *pQuery, int32_t elemPos) {
   for (int32_t k = 0; k < pQuery->numOfFilterCols; ++k) {
     SSingleColumnFilterInfo *pFilterInfo = &pQuery->pFilterInfo[k];
-    
-    char *pElem = pFilterInfo->pData + pFilterInfo->info.bytes * elemPos;
+
+    char *pElem = (char *)pFilterInfo->pData + pFilterInfo->info.bytes * elemPos;
     if (isNull(pElem, pFilterInfo->info.type)) {
       return false;
     }
@@ -238,7 +275,7 @@ bool doFilterData(SQuery *pQuery, int32_t elemPos) {
     bool qualified = false;
     for (int32_t j = 0; j < pFilterInfo->numOfFilters; ++j) {
       SColumnFilterElem *pFilterElem = &pFilterInfo->pFilters[j];
-      
+
       if (pFilterElem->fp(pFilterElem, pElem, pElem)) {
         qualified = true;
         break;
@@ -253,6 +290,54 @@ bool doFilterData(SQuery *pQuery, int32_t elemPos) {
   return true;
 }
 
+/*
+ * Evaluate the filters column by column over numOfRows rows of the data block starting from row start. pSelected[i]
+ * is set to 1 if the value of each filter column in row start + i is not null and satisfies any filter of the
+ * column. pColRes is the buffer of the result of one column.
+ */
+static void doFilterDataBlock(SQuery *pQuery, int32_t start, int32_t numOfRows, int8_t *pSelected, int8_t *pColRes) {
+  memset(pSelected, 1, (size_t)numOfRows);
+
+  for (int32_t k = 0; k < pQuery->numOfFilterCols; ++k) {
+    SSingleColumnFilterInfo *pFilterInfo = &pQuery->pFilterInfo[k];
+    int32_t                  bytes = pFilterInfo->info.bytes;
+    char                    *pData = (char *)pFilterInfo->pData + bytes * start;
+
+    filterNotNullBlock(pFilterInfo->info.type, bytes, pData, numOfRows, pSelected);
+
+    if (pFilterInfo->pCodes != NULL) {
+      doFilterByDictCodes(pFilterInfo, start, numOfRows, pSelected, pColRes);
+      for (int32_t i = 0; i < numOfRows; ++i) {
+        pSelected[i] &= pColRes[i];
+      }
+      continue;
+    }
+
+    memset(pColRes, 0, (size_t)numOfRows);
+
+    for (int32_t j = 0; j < pFilterInfo->numOfFilters; ++j) {
+      SColumnFilterElem *pFilterElem = &pFilterInfo->pFilters[j];
+
+      if (pFilterElem->blockFp != NULL) {
+        pFilterElem->blockFp(pFilterElem, pData, numOfRows, pColRes);
+        continue;
+      }
+
+      // binary and nchar columns are still evaluated row by row
+      for (int32_t i = 0; i < numOfRows; ++i) {
+        if (pSelected[i] && !pColRes[i]) {
+          char *pElem = pData + bytes * i;
+          pColRes[i] = pFilterElem->fp(pFilterElem, pElem, pElem);
+        }
+      }
+    }
+
+    for (int32_t i = 0; i < numOfRows; ++i) {
+      pSelected[i] &= pColRes[i];
+    }
+  }
+}
+
 int64_t getNumOfResult(SQueryRuntimeEnv *pRuntimeEnv) {
   SQuery *pQuery = pRuntimeEnv->pQuery;
   bool    hasMainFunction = hasMainOutput(pQuery);
@@ -745,7 +830,7 @@ static void doBlockwiseApplyFunctions(SQueryRuntimeEnv *pRuntimeEnv, SWindowStat
       pCtx[k].size = forwardStep;
       pCtx[k].startOffset = (QUERY_IS_ASC_QUERY(pQuery)) ? startPos : startPos - (forwardStep - 1);
 
-      if ((aAggs[functionId].nStatus & TSDB_FUNCSTATE_SELECTIVITY) != 0) {
+      if ((aAggs[functionId].nStatus & TSDB_FUNCSTATE_SELECTIVITY) != 0 && tsBuf != NULL) {
         pCtx[k].ptsList = &tsBuf[pCtx[k].startOffset];
       }
 
@@ -945,8 +1030,11 @@ static void blockwiseApplyFunctions(SQueryRuntimeEnv *pRuntimeEnv, SDataStatis *
 
   int32_t step = GET_FORWARD_DIRECTION_FACTOR(pQuery->order.order);
   if (isIntervalQuery(pQuery)) {
-    int32_t offset = GET_COL_DATA_POS(pQuery, 0, step);
-    TSKEY   ts = primaryKeyCol[offset];
+    // the block is not loaded if it is inside one time window
+    TSKEY ts = QUERY_IS_ASC_QUERY(pQuery) ? pDataBlockInfo->window.skey : pDataBlockInfo->window.ekey;
+    if (primaryKeyCol != NULL) {
+      ts = primaryKeyCol[GET_COL_DATA_POS(pQuery, 0, step)];
+    }
 
     STimeWindow win = getActiveTimeWindow(pWindowResInfo, ts, pQuery);
     if (setWindowOutputBufByKey(pRuntimeEnv, pWindowResInfo, pDataBlockInfo->tid, &win) != TSDB_CODE_SUCCESS) {
@@ -963,7 +1051,7 @@ static void blockwiseApplyFunctions(SQueryRuntimeEnv *pRuntimeEnv, SDataStatis *
     int32_t     index = pWindowResInfo->curIndex;
     STimeWindow nextWin = win;
 
-    while (1) {
+    while (primaryKeyCol != NULL) {
       int32_t startPos = getNextQualifiedWindow(pRuntimeEnv, &nextWin, pDataBlockInfo, primaryKeyCol, searchFn);
       if (startPos < 0) {
         break;
@@ -1164,15 +1252,37 @@ static void rowwiseApplyFunctions(SQueryRuntimeEnv *pRuntimeEnv, SDataStatis *pS
                   &sasArray[k], pRuntimeEnv->scanFlag);
   }
 
-  // set the input column data
+  // set the input column data, and the dictionary codes of the binary and nchar columns of a file block
+  TsdbQueryHandleT pQueryHandle = IS_MASTER_SCAN(pRuntimeEnv)? pRuntimeEnv->pQueryHandle : pRuntimeEnv->pSecQueryHandle;
   for (int32_t k = 0; k < pQuery->numOfFilterCols; ++k) {
     SSingleColumnFilterInfo *pFilterInfo = &pQuery->pFilterInfo[k];
     pFilterInfo->pData = getDataBlockImpl(pDataBlock, pFilterInfo->info.colId);
     assert(pFilterInfo->pData != NULL);
+
+    pFilterInfo->pCodes = NULL;
+    pFilterInfo->dictSize = 0;
+    if (pQueryHandle != NULL &&
+        (pFilterInfo->info.type == TSDB_DATA_TYPE_BINARY || pFilterInfo->info.type == TSDB_DATA_TYPE_NCHAR)) {
+      pFilterInfo->dictSize =
+          tsdbRetrieveDataBlockDictCodes(pQueryHandle, pFilterInfo->info.colId, &pFilterInfo->pCodes);
+    }
   }
 
   int32_t step = GET_FORWARD_DIRECTION_FACTOR(pQuery->order.order);
 
+  // the rows qualified by the filters are decided for all rows to scan before any function is applied
+  int8_t *pSelected = NULL;
+  int32_t startPos = MIN(pQuery->pos, GET_COL_DATA_POS(pQuery, pDataBlockInfo->rows - 1, step));
+  if (pQuery->numOfFilterCols > 0 && pDataBlockInfo->rows > 0) {
+    pSelected = malloc((size_t)pDataBlockInfo->rows * 2);
+    if (pSelected != NULL) {
+      doFilterDataBlock(pQuery, startPos, pDataBlockInfo->rows, pSelected, pSelected + pDataBlockInfo->rows);
+    } else {
+      qError("QInfo:%p failed to allocate the selection of %d rows, filter row by row", GET_QINFO_ADDR(pRuntimeEnv),
+             pDataBlockInfo->rows);
+    }
+  }
+
   // from top to bottom in desc
   // from bottom to top in asc order
   if (pRuntimeEnv->pTSBuf != NULL) {
@@ -1198,7 +1308,11 @@ static void rowwiseApplyFunctions(SQueryRuntimeEnv *pRuntimeEnv, SDataStatis *pS
       }
     }
 
-    if (pQuery->numOfFilterCols > 0 && (!doFilterData(pQuery, offset))) {
+    if (pSelected != NULL) {
+      if (!pSelected[offset - startPos]) {
+        continue;
+      }
+    } else if (pQuery->numOfFilterCols > 0 && !doFilterData(pQuery, offset)) {
       continue;
     }
 
@@ -1287,6 +1401,7 @@ static void rowwiseApplyFunctions(SQueryRuntimeEnv *pRuntimeEnv, SDataStatis *pS
   }
   
   free(sasArray);
+  tfree(pSelected);
 }
 
 static int32_t tableApplyFunctionsOnBlock(SQueryRuntimeEnv *pRuntimeEnv, SDataBlockInfo *pDataBlockInfo,
@@ -2261,6 +2376,20 @@ static void getNextTimeWindow(SQuery *pQuery, STimeWindow *pTimeWindow) {
   pTimeWindow->ekey = pTimeWindow->skey + (pQuery->intervalTime - 1);
 }
 
+/*
+ * The data block of an interval query is not loaded if it is inside one time window and the functions can be computed
+ * from the block statistics.
+ */
+static bool isBlockInOneTimeWindow(SQuery *pQuery, SDataBlockInfo *pBlockInfo) {
+  if (!isIntervalQueryOnStatis(pQuery)) {
+    return false;
+  }
+
+  TSKEY st = taosGetIntervalStartTimestamp(pBlockInfo->window.skey, pQuery->slidingTime, pQuery->slidingTimeUnit,
+                                           pQuery->precision);
+  return pBlockInfo->window.skey >= st && pBlockInfo->window.ekey < st + pQuery->intervalTime;
+}
+
 SArray *loadDataBlockOnDemand(SQueryRuntimeEnv *pRuntimeEnv, void* pQueryHandle, SDataBlockInfo* pBlockInfo, SDataStatis **pStatis) {
   SQuery *pQuery = pRuntimeEnv->pQuery;
 
@@ -2276,28 +2405,38 @@ SArray *loadDataBlockOnDemand(SQueryRuntimeEnv *pRuntimeEnv, void* pQueryHandle,
       r |= aAggs[functionId].dataReqFunc(&pRuntimeEnv->pCtx[i], pQuery->window.skey, pQuery->window.ekey, colId);
     }
 
-    if (pRuntimeEnv->pTSBuf > 0 || isIntervalQuery(pQuery)) {
+    if (pRuntimeEnv->pTSBuf > 0 || (isIntervalQuery(pQuery) && !isBlockInOneTimeWindow(pQuery, pBlockInfo))) {
       r |= BLK_DATA_ALL_NEEDED;
     }
   }
 
+  SQueryCostSummary *pSummary = &pRuntimeEnv->summary;
+  pSummary->totalBlocks += 1;
+  pSummary->totalRows += pBlockInfo->rows;
+
   if (r == BLK_DATA_NO_NEEDED) {
     qTrace("QInfo:%p data block ignored, brange:%" PRId64 "-%" PRId64 ", rows:%d", GET_QINFO_ADDR(pRuntimeEnv),
            pBlockInfo->window.skey, pBlockInfo->window.ekey, pBlockInfo->rows);
+    pSummary->discardBlocks += 1;
   } else if (r == BLK_DATA_FILEDS_NEEDED) {
     if (tsdbRetrieveDataBlockStatisInfo(pQueryHandle, pStatis) != TSDB_CODE_SUCCESS) {
       //        return DISK_DATA_LOAD_FAILED;
     }
 
+    /*
+     * the statistics are only available for the file block completely included in the query time range,
+     * the boundary blocks and the blocks in cache are loaded.
+     */
     if (*pStatis == NULL) {
       pDataBlock = tsdbRetrieveDataBlock(pQueryHandle, NULL);
+      pSummary->loadBlocks += 1;
+    } else {
+      pSummary->loadBlockStatis += 1;
     }
   } else {
     assert(r == BLK_DATA_ALL_NEEDED);
-    if (tsdbRetrieveDataBlockStatisInfo(pQueryHandle, pStatis) != TSDB_CODE_SUCCESS) {
-      //        return DISK_DATA_LOAD_FAILED;
-    }
 
+    // the statistics are not read, the filter by them is not supported yet and the block is loaded anyway
     /*
      * if this block is completed included in the query range, do more filter operation
      * filter the data block according to the value filter condition.
@@ -2311,6 +2450,7 @@ SArray *loadDataBlockOnDemand(SQueryRuntimeEnv *pRuntimeEnv, void* pQueryHandle,
     }
 
     pDataBlock = tsdbRetrieveDataBlock(pQueryHandle, NULL);
+    pSummary->loadBlocks += 1;
   }
 
   return pDataBlock;
@@ -2469,6 +2609,16 @@ static int64_t doScanAllDataBlocks(SQueryRuntimeEnv *pRuntimeEnv) {
     }
   }
 
+  // a failed scan of the files fails the query, rather than returning the results of the blocks read so far
+  int32_t code = tsdbGetQueryCode(pQueryHandle);
+  if (code != TSDB_CODE_SUCCESS) {
+    SQInfo *pQInfo = GET_QINFO_ADDR(pRuntimeEnv);
+    qError("QInfo:%p failed to scan data blocks, code:%d", pQInfo, code);
+    pQInfo->code = code;
+    setQueryStatus(pQuery, QUERY_COMPLETED);
+    return 0;
+  }
+
   // if the result buffer is not full, set the query complete
   if (!Q_STATUS_EQUAL(pQuery->status, QUERY_RESBUF_FULL)) {
     setQueryStatus(pQuery, QUERY_COMPLETED);
@@ -3916,6 +4066,12 @@ int32_t doFillGapsInResults(SQueryRuntimeEnv* pRuntimeEnv, tFilePage **pDst, int
 }
 
 void vnodePrintQueryStatistics(SQInfo *pQInfo) {
+  SQueryCostSummary *pSummary = &pQInfo->runtimeEnv.summary;
+
+  qTrace("QInfo:%p statis: blocks:%d, rows:%" PRId64 ", loaded:%d, by statistics:%d, discarded:%d", pQInfo,
+         pSummary->totalBlocks, pSummary->totalRows, pSummary->loadBlocks, pSummary->loadBlockStatis,
+         pSummary->discardBlocks);
+
 #if 0
   SQueryRuntimeEnv *pRuntimeEnv = &pQInfo->runtimeEnv;
 
@@ -4154,6 +4310,37 @@ static bool skipTimeInterval(SQueryRuntimeEnv *pRuntimeEnv, TSKEY* start) {
 }
 
 
+/*
+ * The functions of the interval query can be computed from the block statistics of the data blocks inside a time
+ * window, so the rollups whose buckets do not cross the time windows can be used instead of the data blocks.
+ */
+static bool isIntervalQueryOnStatis(SQuery *pQuery) {
+  if (!isIntervalQuery(pQuery) || pQuery->intervalTime != pQuery->slidingTime || pQuery->numOfFilterCols > 0 ||
+      isGroupbyNormalCol(pQuery->pGroupbyExpr)) {
+    return false;
+  }
+
+  for (int32_t i = 0; i < pQuery->numOfOutput; ++i) {
+    int32_t functionId = pQuery->pSelectExpr[i].base.functionId;
+    int16_t colId = pQuery->pSelectExpr[i].base.colInfo.colId;
+
+    if (functionId == TSDB_FUNC_COUNT || functionId == TSDB_FUNC_TS || functionId == TSDB_FUNC_TAG) {
+      continue;
+    }
+
+    // the min/max of timestamp column and the timestamp of min/max value are not in the statistics
+    if ((functionId == TSDB_FUNC_SUM || functionId == TSDB_FUNC_AVG || functionId == TSDB_FUNC_MIN ||
+         functionId == TSDB_FUNC_MAX || functionId == TSDB_FUNC_SPREAD) &&
+        colId != PRIMARYKEY_TIMESTAMP_COL_INDEX) {
+      continue;
+    }
+
+    return false;
+  }
+
+  return true;
+}
+
 static void setupQueryHandle(void* tsdb, SQInfo* pQInfo, bool isSTableQuery) {
   SQueryRuntimeEnv *pRuntimeEnv = &pQInfo->runtimeEnv;
   SQuery *pQuery = pQInfo->runtimeEnv.pQuery;
@@ -4185,6 +4372,13 @@ static void setupQueryHandle(void* tsdb, SQInfo* pQInfo, bool isSTableQuery) {
     cond.twindow = pItem->info->win;
   }
 
+  // the join query needs the timestamp of each row
+  if (isIntervalQueryOnStatis(pQuery) && cond.order == TSDB_ORDER_ASC && pRuntimeEnv->pTSBuf == NULL) {
+    TSKEY skey = taosGetIntervalStartTimestamp(cond.twindow.skey, pQuery->slidingTime, pQuery->slidingTimeUnit,
+                                               pQuery->precision);
+    cond.rollup = tsdbGetRollupInterval(tsdb, pQuery->intervalTime, skey);
+  }
+
   if (isFirstLastRowQuery(pQuery)) {
     pRuntimeEnv->pQueryHandle = tsdbQueryLastRow(tsdb, &cond, &pQInfo->tableIdGroupInfo);
   } else {
@@ -4222,13 +4416,14 @@ int32_t doInitQInfo(SQInfo *pQInfo, void *param, void *tsdb, int32_t vgId, bool
 
   setScanLimitationByResultBuffer(pQuery);
   changeExecuteScanOrder(pQuery, false);
+
+  pRuntimeEnv->pTSBuf = param;
   setupQueryHandle(tsdb, pQInfo, isSTableQuery);
   
   pQInfo->tsdb = tsdb;
   pQInfo->vgId = vgId;
 
   pRuntimeEnv->pQuery = pQuery;
-  pRuntimeEnv->pTSBuf = param;
   pRuntimeEnv->cur.vgroupIndex = -1;
   pRuntimeEnv->stableQuery = isSTableQuery;
 
@@ -4403,6 +4598,12 @@ static int64_t queryOnDataBlocks(SQInfo *pQInfo) {
     stableApplyFunctionsOnBlock(pRuntimeEnv, pTableQueryInfo, &blockInfo, pStatis, pDataBlock, binarySearchForKey);
   }
 
+  int32_t code = tsdbGetQueryCode(pQueryHandle);
+  if (code != TSDB_CODE_SUCCESS) {
+    qError("QInfo:%p failed to scan data blocks, code:%d", pQInfo, code);
+    pQInfo->code = code;
+  }
+
   int64_t et = taosGetTimestampMs();
   return et - st;
 }
@@ -5040,7 +5241,7 @@ static void tableQueryImpl(SQInfo *pQInfo) {
     }
 
     qTrace("QInfo:%p query over, %d rows are returned", pQInfo, pQuery->rec.total);
-    //    vnodePrintQueryStatistics(pSupporter);
+    vnodePrintQueryStatistics(pQInfo);
     return;
   }
 
@@ -5098,7 +5299,7 @@ static void stableQueryImpl(SQInfo *pQInfo) {
   if (pQuery->rec.rows == 0) {
     qTrace("QInfo:%p over, %d tables queried, %d points are returned", pQInfo, pQInfo->groupInfo.numOfTables,
            pQuery->rec.total);
-    //    vnodePrintQueryStatistics(pSupporter);
+    vnodePrintQueryStatistics(pQInfo);
   }
 }
 
@@ -5557,6 +5758,8 @@ static int32_t createFilterInfo(void *pQInfo, SQuery *pQuery) {
         // todo refactor
         __filter_func_t *rangeFilterArray = getRangeFilterFuncArray(type);
         __filter_func_t *filterArray = getValueFilterFuncArray(type);
+        __block_filter_func_t *rangeBlockFilterArray = getRangeBlockFilterFuncArray(type);
+        __block_filter_func_t *blockFilterArray = getValueBlockFilterFuncArray(type);
 
         if (rangeFilterArray == NULL && filterArray == NULL) {
           qError("QInfo:%p failed to get filter function, invalid data type:%d", pQInfo, type);
@@ -5565,22 +5768,19 @@ static int32_t createFilterInfo(void *pQInfo, SQuery *pQuery) {
 
         if ((lower == TSDB_RELATION_GREATER_EQUAL || lower == TSDB_RELATION_GREATER) &&
             (upper == TSDB_RELATION_LESS_EQUAL || upper == TSDB_RELATION_LESS)) {
+          int32_t index = 0;
           if (lower == TSDB_RELATION_GREATER_EQUAL) {
-            if (upper == TSDB_RELATION_LESS_EQUAL) {
-              pSingleColFilter->fp = rangeFilterArray[4];
-            } else {
-              pSingleColFilter->fp = rangeFilterArray[2];
-            }
+            index = (upper == TSDB_RELATION_LESS_EQUAL) ? 4 : 2;
           } else {
-            if (upper == TSDB_RELATION_LESS_EQUAL) {
-              pSingleColFilter->fp = rangeFilterArray[3];
-            } else {
-              pSingleColFilter->fp = rangeFilterArray[1];
-            }
+            index = (upper == TSDB_RELATION_LESS_EQUAL) ? 3 : 1;
           }
+
+          pSingleColFilter->fp = rangeFilterArray[index];
+          pSingleColFilter->blockFp = (rangeBlockFilterArray != NULL) ? rangeBlockFilterArray[index] : NULL;
         } else {  // set callback filter function
           if (lower != TSDB_RELATION_INVALID) {
             pSingleColFilter->fp = filterArray[lower];
+            pSingleColFilter->blockFp = (blockFilterArray != NULL) ? blockFilterArray[lower] : NULL;
 
             if (upper != TSDB_RELATION_INVALID) {
               qError("pQInfo:%p failed to get filter function, invalid filter condition", pQInfo, type);
@@ -5588,6 +5788,7 @@ static int32_t createFilterInfo(void *pQInfo, SQuery *pQuery) {
             }
           } else {
             pSingleColFilter->fp = filterArray[upper];
+            pSingleColFilter->blockFp = (blockFilterArray != NULL) ? blockFilterArray[upper] : NULL;
           }
         }
         assert(pSingleColFilter->fp != NULL);
@@ -555,4 +555,124 @@ __filter_func_t* getValueFilterFuncArray(int32_t type) {
   }
 }
 
+////////////////////////////////////////////////////////////////////////////
+/*
+ * Block filter functions evaluate a filter over all values of a column in a data block, pRes[i] is set to 1 if the
+ * i-th value satisfies the filter and left unchanged otherwise, so that filters of a column are OR'ed together.
+ * The loops have no branches and the bounds are copied into locals, which leaves them to the auto-vectorizer.
+ */
+#define BLOCK_FILTER_FUNC(_name, _type, _btype, _bnd, _cond)                                                \
+  static void _name(SColumnFilterElem *pFilter, const char *pData, int32_t numOfRows, int8_t *pRes) {       \
+    const _type *val = (const _type *)pData;                                                                \
+    const _btype bnd = pFilter->filterInfo._bnd;                                                           \
+    for (int32_t i = 0; i < numOfRows; ++i) {                                                               \
+      pRes[i] |= (_cond);                                                                                   \
+    }                                                                                                       \
+  }
+
+#define BLOCK_RANGE_FILTER_FUNC(_name, _type, _btype, _lower, _upper, _cond)                                \
+  static void _name(SColumnFilterElem *pFilter, const char *pData, int32_t numOfRows, int8_t *pRes) {       \
+    const _type *val = (const _type *)pData;                                                                \
+    const _btype lower = pFilter->filterInfo._lower;                                                       \
+    const _btype upper = pFilter->filterInfo._upper;                                                       \
+    for (int32_t i = 0; i < numOfRows; ++i) {                                                               \
+      pRes[i] |= (_cond);                                                                                   \
+    }                                                                                                       \
+  }
+
+#define BLOCK_FILTER_FUNCS(_t, _type, _btype, _l, _u, _equal)                                              \
+  BLOCK_FILTER_FUNC(blockLess_##_t, _type, _btype, _u, val[i] < bnd)                                       \
+  BLOCK_FILTER_FUNC(blockLarge_##_t, _type, _btype, _l, val[i] > bnd)                                      \
+  BLOCK_FILTER_FUNC(blockEqual_##_t, _type, _btype, _l, _equal)                                            \
+  BLOCK_FILTER_FUNC(blockLessEqual_##_t, _type, _btype, _u, val[i] <= bnd)                                 \
+  BLOCK_FILTER_FUNC(blockLargeEqual_##_t, _type, _btype, _l, val[i] >= bnd)                                \
+  BLOCK_FILTER_FUNC(blockNequal_##_t, _type, _btype, _l, val[i] != bnd)                                    \
+  BLOCK_RANGE_FILTER_FUNC(blockRangeFilter_##_t##_ee, _type, _btype, _l, _u, (val[i] > lower) & (val[i] < upper))   \
+  BLOCK_RANGE_FILTER_FUNC(blockRangeFilter_##_t##_ie, _type, _btype, _l, _u, (val[i] >= lower) & (val[i] < upper))  \
+  BLOCK_RANGE_FILTER_FUNC(blockRangeFilter_##_t##_ei, _type, _btype, _l, _u, (val[i] > lower) & (val[i] <= upper))  \
+  BLOCK_RANGE_FILTER_FUNC(blockRangeFilter_##_t##_ii, _type, _btype, _l, _u, (val[i] >= lower) & (val[i] <= upper)) \
+                                                                                                            \
+  __block_filter_func_t blockFilterFunc_##_t[] = {                                                          \
+    NULL,                                                                                                   \
+    blockLess_##_t,                                                                                         \
+    blockLarge_##_t,                                                                                        \
+    blockEqual_##_t,                                                                                        \
+    blockLessEqual_##_t,                                                                                    \
+    blockLargeEqual_##_t,                                                                                   \
+    blockNequal_##_t,                                                                                       \
+    NULL,                                                                                                   \
+  };                                                                                                        \
+                                                                                                            \
+  __block_filter_func_t blockRangeFilterFunc_##_t[] = {                                                     \
+    NULL,                                                                                                   \
+    blockRangeFilter_##_t##_ee,                                                                             \
+    blockRangeFilter_##_t##_ie,                                                                             \
+    blockRangeFilter_##_t##_ei,                                                                             \
+    blockRangeFilter_##_t##_ii,                                                                             \
+  };
+
+BLOCK_FILTER_FUNCS(i8, int8_t, int64_t, lowerBndi, upperBndi, val[i] == bnd)
+BLOCK_FILTER_FUNCS(i16, int16_t, int64_t, lowerBndi, upperBndi, val[i] == bnd)
+BLOCK_FILTER_FUNCS(i32, int32_t, int64_t, lowerBndi, upperBndi, val[i] == bnd)
+BLOCK_FILTER_FUNCS(i64, int64_t, int64_t, lowerBndi, upperBndi, val[i] == bnd)
+BLOCK_FILTER_FUNCS(ds, float, double, lowerBndd, upperBndd, fabs(val[i] - bnd) <= FLT_EPSILON)
+BLOCK_FILTER_FUNCS(dd, double, double, lowerBndd, upperBndd, val[i] == bnd)
+
+__block_filter_func_t* getRangeBlockFilterFuncArray(int32_t type) {
+  switch(type) {
+    case TSDB_DATA_TYPE_BOOL:       return blockRangeFilterFunc_i8;
+    case TSDB_DATA_TYPE_TINYINT:    return blockRangeFilterFunc_i8;
+    case TSDB_DATA_TYPE_SMALLINT:   return blockRangeFilterFunc_i16;
+    case TSDB_DATA_TYPE_INT:        return blockRangeFilterFunc_i32;
+    case TSDB_DATA_TYPE_TIMESTAMP:  //timestamp uses bigint filter
+    case TSDB_DATA_TYPE_BIGINT:     return blockRangeFilterFunc_i64;
+    case TSDB_DATA_TYPE_FLOAT:      return blockRangeFilterFunc_ds;
+    case TSDB_DATA_TYPE_DOUBLE:     return blockRangeFilterFunc_dd;
+    default:return NULL;
+  }
+}
+
+__block_filter_func_t* getValueBlockFilterFuncArray(int32_t type) {
+  switch(type) {
+    case TSDB_DATA_TYPE_BOOL:       return blockFilterFunc_i8;
+    case TSDB_DATA_TYPE_TINYINT:    return blockFilterFunc_i8;
+    case TSDB_DATA_TYPE_SMALLINT:   return blockFilterFunc_i16;
+    case TSDB_DATA_TYPE_INT:        return blockFilterFunc_i32;
+    case TSDB_DATA_TYPE_TIMESTAMP:  //timestamp uses bigint filter
+    case TSDB_DATA_TYPE_BIGINT:     return blockFilterFunc_i64;
+    case TSDB_DATA_TYPE_FLOAT:      return blockFilterFunc_ds;
+    case TSDB_DATA_TYPE_DOUBLE:     return blockFilterFunc_dd;
+    default: return NULL;
+  }
+}
+
+#define NOT_NULL_BLOCK(_type, _null)                          \
+  do {                                                        \
+    const _type *val = (const _type *)pData;                  \
+    for (int32_t i = 0; i < numOfRows; ++i) {                 \
+      pRes[i] &= (val[i] != (_type)(_null));                  \
+    }                                                         \
+  } while (0)
+
+/*
+ * Clear pRes[i] if the i-th value of the column is null. The null value of float and double is a NaN, so they are
+ * compared as integers.
+ */
+void filterNotNullBlock(int32_t type, int32_t bytes, const char *pData, int32_t numOfRows, int8_t *pRes) {
+  switch (type) {
+    case TSDB_DATA_TYPE_BOOL:       NOT_NULL_BLOCK(uint8_t, TSDB_DATA_BOOL_NULL); break;
+    case TSDB_DATA_TYPE_TINYINT:    NOT_NULL_BLOCK(uint8_t, TSDB_DATA_TINYINT_NULL); break;
+    case TSDB_DATA_TYPE_SMALLINT:   NOT_NULL_BLOCK(uint16_t, TSDB_DATA_SMALLINT_NULL); break;
+    case TSDB_DATA_TYPE_INT:        NOT_NULL_BLOCK(uint32_t, TSDB_DATA_INT_NULL); break;
+    case TSDB_DATA_TYPE_TIMESTAMP:
+    case TSDB_DATA_TYPE_BIGINT:     NOT_NULL_BLOCK(uint64_t, TSDB_DATA_BIGINT_NULL); break;
+    case TSDB_DATA_TYPE_FLOAT:      NOT_NULL_BLOCK(uint32_t, TSDB_DATA_FLOAT_NULL); break;
+    case TSDB_DATA_TYPE_DOUBLE:     NOT_NULL_BLOCK(uint64_t, TSDB_DATA_DOUBLE_NULL); break;
+    default:
+      for (int32_t i = 0; i < numOfRows; ++i) {
+        if (pRes[i] && isNull(pData + bytes * i, type)) pRes[i] = 0;
+      }
+  }
+}
+
 bool supportPrefilter(int32_t type) { return type != TSDB_DATA_TYPE_BINARY && type != TSDB_DATA_TYPE_NCHAR; }
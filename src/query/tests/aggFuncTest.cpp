@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <cassert>
+#include <iostream>
+#include <sys/time.h>
+
+#include "qAggFunc.h"
+#include "taosdef.h"
+
+namespace {
+const int32_t NUM_OF_ROWS = 1000000;
+const int32_t NUM_OF_LOOPS = 20;
+
+double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+// the sum and the min/max loops used before the kernels
+template <typename T, typename S>
+void oldSum(const T* d, int32_t num, bool hasNull, int32_t type, S* sum, int32_t* numOfElems) {
+  for (int32_t i = 0; i < num; ++i) {
+    if (hasNull && isNull((char*)&d[i], type)) {
+      continue;
+    }
+    *sum += d[i];
+    *numOfElems += 1;
+  }
+}
+
+template <typename T>
+int32_t oldMinMax(const T* d, int32_t num, bool hasNull, int32_t type, int32_t isMin, T* val) {
+  int32_t index = -1;
+  for (int32_t i = 0; i < num; ++i) {
+    if (hasNull && isNull((char*)&d[i], type)) {
+      continue;
+    }
+    if ((*val < d[i]) ^ isMin) {
+      *val = d[i];
+      index = i;
+    }
+  }
+  return index;
+}
+
+// values in [-100, 100), every 50th value is null if hasNull
+template <typename T>
+T* createData(int32_t type, bool hasNull) {
+  T* d = (T*)malloc(sizeof(T) * NUM_OF_ROWS);
+  srand(4321);
+  for (int32_t i = 0; i < NUM_OF_ROWS; ++i) {
+    if (hasNull && i % 50 == 0) {
+      setNull((char*)&d[i], type, sizeof(T));
+    } else {
+      d[i] = (T)(rand() % 200 - 100);
+    }
+  }
+  return d;
+}
+
+template <typename T, typename S>
+void aggBench(const char* name, int32_t type, bool hasNull,
+              void (*sumFn)(const void*, int32_t, bool, S*, int32_t*),
+              int32_t (*minMaxFn)(const void*, int32_t, bool, int32_t, int32_t*)) {
+  T* d = createData<T>(type, hasNull);
+
+  S       oldS = 0, newS = 0;
+  int32_t oldNum = 0, newNum = 0;
+  oldSum<T, S>(d, NUM_OF_ROWS, hasNull, type, &oldS, &oldNum);
+  sumFn(d, NUM_OF_ROWS, hasNull, &newS, &newNum);
+  EXPECT_EQ(oldNum, newNum) << name;
+  EXPECT_NEAR((double)oldS, (double)newS, 1E-6) << name;
+  EXPECT_EQ(aggCountNotNull(d, NUM_OF_ROWS, type, sizeof(T)), oldNum) << name;
+
+  for (int32_t isMin = 0; isMin <= 1; ++isMin) {
+    T       v = isMin ? std::numeric_limits<T>::max() : std::numeric_limits<T>::lowest();
+    int32_t oldIndex = oldMinMax<T>(d, NUM_OF_ROWS, hasNull, type, isMin, &v);
+    EXPECT_EQ(minMaxFn(d, NUM_OF_ROWS, hasNull, isMin, &newNum), oldIndex) << name << " isMin:" << isMin;
+  }
+
+  double st = getCurTime();
+  for (int32_t k = 0; k < NUM_OF_LOOPS; ++k) {
+    oldS = 0, oldNum = 0;
+    oldSum<T, S>(d, NUM_OF_ROWS, hasNull, type, &oldS, &oldNum);
+    T v = std::numeric_limits<T>::lowest();
+    oldMinMax<T>(d, NUM_OF_ROWS, hasNull, type, 0, &v);
+  }
+  double oldTime = getCurTime() - st;
+
+  st = getCurTime();
+  for (int32_t k = 0; k < NUM_OF_LOOPS; ++k) {
+    sumFn(d, NUM_OF_ROWS, hasNull, &newS, &newNum);
+    minMaxFn(d, NUM_OF_ROWS, hasNull, 0, &newNum);
+  }
+  double newTime = getCurTime() - st;
+
+  // each loop reads the block twice, once for sum and once for max
+  double mb = 2.0 * NUM_OF_LOOPS * NUM_OF_ROWS * sizeof(T) / (1024 * 1024);
+  printf("%-8s %-9s sum+max old: %8.1f MB/s, new: %8.1f MB/s, %5.1fx\n", name, hasNull ? "nulls" : "no nulls",
+         mb / oldTime, mb / newTime, oldTime / newTime);
+
+  free(d);
+}
+}  // namespace
+
+TEST(testCase, aggFuncTest) {
+  for (int32_t i = 0; i < 2; ++i) {
+    bool hasNull = (i == 1);
+    aggBench<int8_t, int64_t>("tinyint", TSDB_DATA_TYPE_TINYINT, hasNull, aggSum_i8, aggMinMax_i8);
+    aggBench<int16_t, int64_t>("smallint", TSDB_DATA_TYPE_SMALLINT, hasNull, aggSum_i16, aggMinMax_i16);
+    aggBench<int32_t, int64_t>("int", TSDB_DATA_TYPE_INT, hasNull, aggSum_i32, aggMinMax_i32);
+    aggBench<int64_t, int64_t>("bigint", TSDB_DATA_TYPE_BIGINT, hasNull, aggSum_i64, aggMinMax_i64);
+    aggBench<float, double>("float", TSDB_DATA_TYPE_FLOAT, hasNull, aggSum_ds, aggMinMax_ds);
+    aggBench<double, double>("double", TSDB_DATA_TYPE_DOUBLE, hasNull, aggSum_dd, aggMinMax_dd);
+  }
+}
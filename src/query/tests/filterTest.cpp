@@ -0,0 +1,174 @@
+#include <gtest/gtest.h>
+#include <cassert>
+#include <iostream>
+#include <sys/time.h>
+
+extern "C" {
+#include "qExecutor.h"
+#include "qUtil.h"
+}
+
+#include "taosdef.h"
+
+namespace {
+const int32_t NUM_OF_ROWS = 4096;
+const int32_t NUM_OF_BLOCKS = 2000;
+
+double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+// every 100th value is null
+char* createColumn(int32_t type, int32_t bytes) {
+  char* pData = (char*)malloc(bytes * NUM_OF_ROWS);
+
+  srand(1234);
+  for (int32_t i = 0; i < NUM_OF_ROWS; ++i) {
+    char* p = pData + bytes * i;
+    if (i % 100 == 0) {
+      setNull(p, type, bytes);
+      continue;
+    }
+
+    int32_t v = rand() % 1000;
+    if (type == TSDB_DATA_TYPE_INT) {
+      *(int32_t*)p = v;
+    } else if (type == TSDB_DATA_TYPE_FLOAT) {
+      *(float*)p = v / 10.0f;
+    } else {
+      *(double*)p = v / 10.0;
+    }
+  }
+
+  return pData;
+}
+
+// set the filter with the same functions that the query executor picks for a filter
+void setFilter(SColumnFilterElem* pFilter, int32_t type, int32_t bytes, int16_t lower, int16_t upper, double lbnd,
+               double ubnd) {
+  memset(pFilter, 0, sizeof(SColumnFilterElem));
+  pFilter->bytes = bytes;
+  pFilter->filterInfo.lowerRelOptr = lower;
+  pFilter->filterInfo.upperRelOptr = upper;
+
+  if (type == TSDB_DATA_TYPE_INT) {
+    pFilter->filterInfo.lowerBndi = (int64_t)lbnd;
+    pFilter->filterInfo.upperBndi = (int64_t)ubnd;
+  } else {
+    pFilter->filterInfo.lowerBndd = lbnd;
+    pFilter->filterInfo.upperBndd = ubnd;
+  }
+
+  if (lower != TSDB_RELATION_INVALID && upper != TSDB_RELATION_INVALID) {
+    int32_t index = (lower == TSDB_RELATION_GREATER_EQUAL) ? ((upper == TSDB_RELATION_LESS_EQUAL) ? 4 : 2)
+                                                           : ((upper == TSDB_RELATION_LESS_EQUAL) ? 3 : 1);
+    pFilter->fp = getRangeFilterFuncArray(type)[index];
+    pFilter->blockFp = getRangeBlockFilterFuncArray(type)[index];
+  } else {
+    int32_t optr = (lower != TSDB_RELATION_INVALID) ? lower : upper;
+    pFilter->fp = getValueFilterFuncArray(type)[optr];
+    pFilter->blockFp = getValueBlockFilterFuncArray(type)[optr];
+  }
+}
+
+// the filter of each row used to be evaluated this way
+bool rowFilter(SSingleColumnFilterInfo* pInfo, int32_t numOfCols, int32_t row) {
+  for (int32_t k = 0; k < numOfCols; ++k) {
+    char* pElem = (char*)pInfo[k].pData + pInfo[k].info.bytes * row;
+    if (isNull(pElem, pInfo[k].info.type)) return false;
+
+    bool qualified = false;
+    for (int32_t j = 0; j < pInfo[k].numOfFilters; ++j) {
+      if (pInfo[k].pFilters[j].fp(&pInfo[k].pFilters[j], pElem, pElem)) {
+        qualified = true;
+        break;
+      }
+    }
+
+    if (!qualified) return false;
+  }
+
+  return true;
+}
+
+void blockFilter(SSingleColumnFilterInfo* pInfo, int32_t numOfCols, int8_t* pSelected, int8_t* pColRes) {
+  memset(pSelected, 1, NUM_OF_ROWS);
+  for (int32_t k = 0; k < numOfCols; ++k) {
+    filterNotNullBlock(pInfo[k].info.type, pInfo[k].info.bytes, (char*)pInfo[k].pData, NUM_OF_ROWS, pSelected);
+    memset(pColRes, 0, NUM_OF_ROWS);
+    for (int32_t j = 0; j < pInfo[k].numOfFilters; ++j) {
+      pInfo[k].pFilters[j].blockFp(&pInfo[k].pFilters[j], (char*)pInfo[k].pData, NUM_OF_ROWS, pColRes);
+    }
+    for (int32_t i = 0; i < NUM_OF_ROWS; ++i) pSelected[i] &= pColRes[i];
+  }
+}
+
+/*
+ * columns: int, float, double, int. Predicates in order:
+ * c0 >= 100 and c0 < 900, c1 > 10.5, c2 <= 80 or c2 = 95.5, c3 != 500
+ */
+void filterBench(int32_t numOfPredicates) {
+  int16_t types[] = {TSDB_DATA_TYPE_INT, TSDB_DATA_TYPE_FLOAT, TSDB_DATA_TYPE_DOUBLE, TSDB_DATA_TYPE_INT};
+  int16_t bytes[] = {4, 4, 8, 4};
+
+  SSingleColumnFilterInfo info[4];
+  SColumnFilterElem       filters[4][2];
+  memset(info, 0, sizeof(info));
+
+  for (int32_t k = 0; k < numOfPredicates; ++k) {
+    info[k].info.type = types[k];
+    info[k].info.bytes = bytes[k];
+    info[k].pData = createColumn(types[k], bytes[k]);
+    info[k].pFilters = filters[k];
+    info[k].numOfFilters = 1;
+  }
+
+  setFilter(&filters[0][0], types[0], bytes[0], TSDB_RELATION_GREATER_EQUAL, TSDB_RELATION_LESS, 100, 900);
+  setFilter(&filters[1][0], types[1], bytes[1], TSDB_RELATION_GREATER, TSDB_RELATION_INVALID, 10.5, 0);
+  setFilter(&filters[2][0], types[2], bytes[2], TSDB_RELATION_INVALID, TSDB_RELATION_LESS_EQUAL, 0, 80);
+  setFilter(&filters[2][1], types[2], bytes[2], TSDB_RELATION_EQUAL, TSDB_RELATION_INVALID, 95.5, 0);
+  setFilter(&filters[3][0], types[3], bytes[3], TSDB_RELATION_NOT_EQUAL, TSDB_RELATION_INVALID, 500, 0);
+  info[2].numOfFilters = 2;
+
+  int8_t* pSelected = (int8_t*)malloc(NUM_OF_ROWS * 2);
+  int32_t numOfQualified = 0;
+
+  blockFilter(info, numOfPredicates, pSelected, pSelected + NUM_OF_ROWS);
+  for (int32_t i = 0; i < NUM_OF_ROWS; ++i) {
+    ASSERT_EQ((bool)pSelected[i], rowFilter(info, numOfPredicates, i)) << "row:" << i;
+    numOfQualified += pSelected[i];
+  }
+  ASSERT_GT(numOfQualified, 0);
+  ASSERT_LT(numOfQualified, NUM_OF_ROWS);
+
+  int64_t count = 0;
+  double  st = getCurTime();
+  for (int32_t b = 0; b < NUM_OF_BLOCKS; ++b) {
+    for (int32_t i = 0; i < NUM_OF_ROWS; ++i) count += rowFilter(info, numOfPredicates, i);
+  }
+  double rowTime = getCurTime() - st;
+
+  st = getCurTime();
+  for (int32_t b = 0; b < NUM_OF_BLOCKS; ++b) {
+    blockFilter(info, numOfPredicates, pSelected, pSelected + NUM_OF_ROWS);
+    for (int32_t i = 0; i < NUM_OF_ROWS; ++i) count -= pSelected[i];
+  }
+  double blockTime = getCurTime() - st;
+  EXPECT_EQ(count, 0);
+
+  double rows = (double)NUM_OF_ROWS * NUM_OF_BLOCKS;
+  printf("%d predicates, %d of %d rows qualified, row-wise: %.1fM rows/s, block-wise: %.1fM rows/s\n",
+         numOfPredicates, numOfQualified, NUM_OF_ROWS, rows / rowTime / 1E6, rows / blockTime / 1E6);
+
+  free(pSelected);
+  for (int32_t k = 0; k < numOfPredicates; ++k) free(info[k].pData);
+}
+}  // namespace
+
+TEST(testCase, blockFilterTest) {
+  for (int32_t i = 1; i <= 4; ++i) {
+    filterBench(i);
+  }
+}
@@ -624,8 +624,8 @@ static SRpcConn *rpcAllocateServerConn(SRpcInfo *pRpc, SRecvInfo *pRecv) {
   }      
 
   if (pConn) {
-    if (pRecv->connType == RPC_CONN_UDPS && pRpc->numOfThreads > 1) {
-      // UDP server, assign to new connection
+    if (pRecv->connType == RPC_CONN_UDPS && pRpc->numOfThreads > 1 && !tsRpcUdpReusePort) {
+      // UDP server, assign to new connection, unless all threads share the port by SO_REUSEPORT
       pRpc->index = (pRpc->index+1) % pRpc->numOfThreads;
       pConn->localPort = (pRpc->localPort + pRpc->index);
     }
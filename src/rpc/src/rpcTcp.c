@@ -24,6 +24,17 @@
   #define EPOLLWAKEUP (1u << 29)
 #endif
 
+#define TCP_POLL_EVENTS (EPOLLIN | EPOLLPRI | EPOLLWAKEUP)
+#define TCP_READ_AHEAD_SIZE 4096  // small msgs are received with one read
+#define TCP_MAX_SEND_IOVS 64      // max queued msgs sent with one call
+
+typedef struct SSendBuf {
+  struct SSendBuf *next;
+  int32_t          len;
+  int32_t          offset;   // bytes already sent
+  char             data[];
+} SSendBuf;
+
 typedef struct SFdObj {
   void              *signature;
   int                fd;       // TCP socket FD
@@ -33,6 +44,21 @@ typedef struct SFdObj {
   struct SThreadObj *pThreadObj;
   struct SFdObj     *prev;
   struct SFdObj     *next;
+
+  // receive state, only accessed by the thread polling the FD
+  SRpcHead           rpcHead;   // head of the msg being received
+  int32_t            headLen;   // bytes of the head received
+  int32_t            msgLen;
+  int32_t            recvLen;   // bytes of the msg received
+  char              *buffer;    // msg being received, NULL until the head is complete
+  int32_t            readPos;   // bytes in readAhead consumed
+  int32_t            readLen;   // bytes in readAhead
+  char               readAhead[TCP_READ_AHEAD_SIZE];
+
+  // send queue, msgs which can not be written into the socket without blocking
+  pthread_mutex_t    mutex;
+  SSendBuf          *pSendHead;
+  SSendBuf          *pSendTail;
 } SFdObj;
 
 typedef struct SThreadObj {
@@ -65,6 +91,8 @@ static SFdObj *taosMallocFdObj(SThreadObj *pThreadObj, int fd);
 static void    taosFreeFdObj(SFdObj *pFdObj);
 static void    taosReportBrokenLink(SFdObj *pFdObj);
 static void*   taosAcceptTcpConnection(void *arg);
+static int     taosReadTcpMsg(SFdObj *pFdObj, char **ppBuffer);
+static int     taosSendQueuedTcpData(SFdObj *pFdObj);
 
 void *taosInitTcpServer(uint32_t ip, uint16_t port, char *label, int numOfThreads, void *fp, void *shandle) {
   SServerObj *pServerObj;
@@ -317,12 +345,107 @@ void taosCloseTcpConnection(void *chandle) {
   taosFreeFdObj(pFdObj);
 }
 
+/*
+ * The socket is non-blocking: the part of a msg which can not be written right away is copied into the
+ * send queue of the FD, and written by the thread polling the FD once the socket is writable. Msgs
+ * queued meanwhile are sent together with one call.
+ */
 int taosSendTcpData(uint32_t ip, uint16_t port, void *data, int len, void *chandle) {
   SFdObj *pFdObj = chandle;
 
   if (chandle == NULL) return -1;
 
-  return (int)send(pFdObj->fd, data, (size_t)len, 0);
+  pthread_mutex_lock(&pFdObj->mutex);
+
+  int sent = 0;
+  if (pFdObj->pSendHead == NULL) {
+    sent = (int)send(pFdObj->fd, data, (size_t)len, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        pthread_mutex_unlock(&pFdObj->mutex);
+        return -1;
+      }
+      sent = 0;
+    }
+  }
+
+  if (sent < len) {
+    SSendBuf *pBuf = malloc(sizeof(SSendBuf) + len - sent);
+    if (pBuf == NULL) {
+      pthread_mutex_unlock(&pFdObj->mutex);
+      return sent;
+    }
+
+    pBuf->next = NULL;
+    pBuf->len = len - sent;
+    pBuf->offset = 0;
+    memcpy(pBuf->data, (char *)data + sent, (size_t)pBuf->len);
+
+    if (pFdObj->pSendTail) {
+      pFdObj->pSendTail->next = pBuf;
+    } else {
+      pFdObj->pSendHead = pBuf;
+
+      // the queue was empty, wait for the socket to be writable
+      struct epoll_event event = {.events = TCP_POLL_EVENTS | EPOLLOUT, .data.ptr = pFdObj};
+      epoll_ctl(pFdObj->pThreadObj->pollFd, EPOLL_CTL_MOD, pFdObj->fd, &event);
+    }
+    pFdObj->pSendTail = pBuf;
+  }
+
+  pthread_mutex_unlock(&pFdObj->mutex);
+
+  return len;
+}
+
+static int taosSendQueuedTcpData(SFdObj *pFdObj) {
+  struct iovec  iov[TCP_MAX_SEND_IOVS];
+  struct msghdr msgHdr = {0};
+  int           code = 0;
+
+  pthread_mutex_lock(&pFdObj->mutex);
+
+  while (pFdObj->pSendHead) {
+    int iovcnt = 0;
+    for (SSendBuf *pBuf = pFdObj->pSendHead; pBuf && iovcnt < TCP_MAX_SEND_IOVS; pBuf = pBuf->next) {
+      iov[iovcnt].iov_base = pBuf->data + pBuf->offset;
+      iov[iovcnt].iov_len = (size_t)(pBuf->len - pBuf->offset);
+      iovcnt++;
+    }
+
+    // same as writev, but does not raise SIGPIPE on a closed link
+    msgHdr.msg_iov = iov;
+    msgHdr.msg_iovlen = (size_t)iovcnt;
+    ssize_t written = sendmsg(pFdObj->fd, &msgHdr, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) code = -1;
+      break;
+    }
+
+    while (written > 0) {
+      SSendBuf *pBuf = pFdObj->pSendHead;
+      int32_t   left = pBuf->len - pBuf->offset;
+      if (written < left) {
+        pBuf->offset += (int32_t)written;
+        break;
+      }
+
+      written -= left;
+      pFdObj->pSendHead = pBuf->next;
+      free(pBuf);
+    }
+  }
+
+  if (pFdObj->pSendHead == NULL) {
+    pFdObj->pSendTail = NULL;
+    struct epoll_event event = {.events = TCP_POLL_EVENTS, .data.ptr = pFdObj};
+    epoll_ctl(pFdObj->pThreadObj->pollFd, EPOLL_CTL_MOD, pFdObj->fd, &event);
+  }
+
+  pthread_mutex_unlock(&pFdObj->mutex);
+
+  return code;
 }
 
 static void taosReportBrokenLink(SFdObj *pFdObj) {
@@ -341,7 +464,10 @@ static void taosReportBrokenLink(SFdObj *pFdObj) {
     recvInfo.chandle = NULL;
     recvInfo.connType = RPC_CONN_TCP;
     (*(pThreadObj->processData))(&recvInfo);
-  } 
+  } else {
+    // no upper layer context yet, otherwise the FD stays in epoll and keeps reporting the broken link
+    taosFreeFdObj(pFdObj);
+  }
 }
 
 #define maxEvents 10
@@ -351,7 +477,6 @@ static void *taosProcessTcpData(void *param) {
   SFdObj            *pFdObj;
   struct epoll_event events[maxEvents];
   SRecvInfo          recvInfo;
-  SRpcHead           rpcHead;
 
   while (1) {
     int fdNum = epoll_wait(pThreadObj->pollFd, events, maxEvents, -1);
@@ -376,51 +501,136 @@ static void *taosProcessTcpData(void *param) {
         continue;
       }
 
-      int32_t headLen = taosReadMsg(pFdObj->fd, &rpcHead, sizeof(SRpcHead));
-      if (headLen != sizeof(SRpcHead)) {
-        tError("%s %p, read error, headLen:%d", pThreadObj->label, pFdObj->thandle, headLen);
-        taosReportBrokenLink(pFdObj);
-        continue;
+      if (events[i].events & EPOLLOUT) {
+        if (taosSendQueuedTcpData(pFdObj) < 0) {
+          tError("%s %p, send error(%s)", pThreadObj->label, pFdObj->thandle, strerror(errno));
+          taosReportBrokenLink(pFdObj);
+          continue;
+        }
       }
 
-      int32_t msgLen = (int32_t)htonl((uint32_t)rpcHead.msgLen);
-      char   *buffer = malloc(msgLen + tsRpcOverhead);
-      if ( NULL == buffer) {
-        tError("%s %p, TCP malloc(size:%d) fail", pThreadObj->label, pFdObj->thandle, msgLen);
-        taosReportBrokenLink(pFdObj);
-        continue;
+      if ((events[i].events & (EPOLLIN | EPOLLPRI)) == 0) continue;
+
+      // deliver the msgs completed by the bytes available, without waiting for the rest of a msg
+      while (1) {
+        char *buffer = NULL;
+        int   code = taosReadTcpMsg(pFdObj, &buffer);
+        if (code < 0) {
+          taosReportBrokenLink(pFdObj);
+          break;
+        }
+        if (code == 0) break;
+
+        // tTrace("%s TCP data is received, ip:0x%x:%u len:%d", pThreadObj->label, pFdObj->ip, pFdObj->port, msgLen);
+
+        char *msg = buffer + tsRpcOverhead;
+        recvInfo.msg = msg;
+        recvInfo.msgLen = (int32_t)htonl((uint32_t)((SRpcHead *)msg)->msgLen);
+        recvInfo.ip = pFdObj->ip;
+        recvInfo.port = pFdObj->port;
+        recvInfo.shandle = pThreadObj->shandle;
+        recvInfo.thandle = pFdObj->thandle;;
+        recvInfo.chandle = pFdObj;
+        recvInfo.connType = RPC_CONN_TCP;
+
+        pFdObj->thandle = (*(pThreadObj->processData))(&recvInfo);
+        if (pFdObj->thandle == NULL) {
+          taosFreeFdObj(pFdObj);
+          break;
+        }
+
+        // bytes left in the socket will be reported by epoll again
+        if (pFdObj->readPos >= pFdObj->readLen) break;
       }
+    }
+  }
 
-      char   *msg = buffer + tsRpcOverhead;
-      int32_t leftLen = msgLen - headLen;
-      int32_t retLen = taosReadMsg(pFdObj->fd, msg + headLen, leftLen);
+  return NULL;
+}
 
-      if (leftLen != retLen) {
-        tError("%s %p, read error, leftLen:%d retLen:%d", 
-                pThreadObj->label, pFdObj->thandle, leftLen, retLen);
-        taosReportBrokenLink(pFdObj);
-        tfree(buffer);
-        continue;
+/*
+ * Receive a msg with the bytes available on the non-blocking socket. The state is kept in the FdObj, so a
+ * slow sender only delays itself. Small msgs and the head of large ones are read through a read ahead
+ * buffer to save system calls, the rest of a large msg is read into its own buffer directly.
+ * return 1 if a msg is complete, 0 if more bytes are needed, -1 if the link is broken
+ */
+static int taosReadTcpMsg(SFdObj *pFdObj, char **ppBuffer) {
+  SThreadObj *pThreadObj = pFdObj->pThreadObj;
+
+  while (1) {
+    int32_t avail = pFdObj->readLen - pFdObj->readPos;
+    char   *pRead = pFdObj->readAhead + pFdObj->readPos;
+
+    if (pFdObj->buffer == NULL) {
+      int32_t len = MIN(avail, (int32_t)sizeof(SRpcHead) - pFdObj->headLen);
+      memcpy((char *)&pFdObj->rpcHead + pFdObj->headLen, pRead, (size_t)len);
+      pFdObj->headLen += len;
+      pFdObj->readPos += len;
+      avail -= len;
+      pRead += len;
+
+      if (pFdObj->headLen == sizeof(SRpcHead)) {
+        int32_t msgLen = (int32_t)htonl((uint32_t)pFdObj->rpcHead.msgLen);
+        if (msgLen < (int32_t)sizeof(SRpcHead) || msgLen > INT32_MAX - tsRpcOverhead) {
+          tError("%s %p, invalid msgLen:%d", pThreadObj->label, pFdObj->thandle, msgLen);
+          return -1;
+        }
+
+        pFdObj->buffer = malloc((size_t)(msgLen + tsRpcOverhead));
+        if (pFdObj->buffer == NULL) {
+          tError("%s %p, TCP malloc(size:%d) fail", pThreadObj->label, pFdObj->thandle, msgLen);
+          return -1;
+        }
+
+        memcpy(pFdObj->buffer + tsRpcOverhead, &pFdObj->rpcHead, sizeof(SRpcHead));
+        pFdObj->msgLen = msgLen;
+        pFdObj->recvLen = sizeof(SRpcHead);
       }
+    }
 
-      // tTrace("%s TCP data is received, ip:0x%x:%u len:%d", pThreadObj->label, pFdObj->ip, pFdObj->port, msgLen);
+    if (pFdObj->buffer) {
+      int32_t len = MIN(avail, pFdObj->msgLen - pFdObj->recvLen);
+      memcpy(pFdObj->buffer + tsRpcOverhead + pFdObj->recvLen, pRead, (size_t)len);
+      pFdObj->recvLen += len;
+      pFdObj->readPos += len;
+
+      if (pFdObj->recvLen == pFdObj->msgLen) {
+        *ppBuffer = pFdObj->buffer;
+        pFdObj->buffer = NULL;
+        pFdObj->headLen = 0;
+        return 1;
+      }
+    }
 
-      memcpy(msg, &rpcHead, sizeof(SRpcHead));
-      recvInfo.msg = msg;
-      recvInfo.msgLen = msgLen;
-      recvInfo.ip = pFdObj->ip;
-      recvInfo.port = pFdObj->port;
-      recvInfo.shandle = pThreadObj->shandle;
-      recvInfo.thandle = pFdObj->thandle;;
-      recvInfo.chandle = pFdObj;
-      recvInfo.connType = RPC_CONN_TCP;
+    // all bytes read ahead are consumed, read more from the socket
+    char   *ptr = pFdObj->readAhead;
+    int32_t size = TCP_READ_AHEAD_SIZE;
+    pFdObj->readPos = 0;
+    pFdObj->readLen = 0;
+    if (pFdObj->buffer && pFdObj->msgLen - pFdObj->recvLen >= TCP_READ_AHEAD_SIZE) {
+      ptr = pFdObj->buffer + tsRpcOverhead + pFdObj->recvLen;
+      size = pFdObj->msgLen - pFdObj->recvLen;
+    }
 
-      pFdObj->thandle = (*(pThreadObj->processData))(&recvInfo);
-      if (pFdObj->thandle == NULL) taosFreeFdObj(pFdObj);
+    ssize_t retLen = recv(pFdObj->fd, ptr, (size_t)size, 0);
+    if (retLen < 0) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+      tError("%s %p, read error(%s)", pThreadObj->label, pFdObj->thandle, strerror(errno));
+      return -1;
     }
-  }
 
-  return NULL;
+    if (retLen == 0) {
+      tTrace("%s %p, TCP link is closed by peer", pThreadObj->label, pFdObj->thandle);
+      return -1;
+    }
+
+    if (ptr == pFdObj->readAhead) {
+      pFdObj->readLen = (int32_t)retLen;
+    } else {
+      pFdObj->recvLen += (int32_t)retLen;
+    }
+  }
 }
 
 static SFdObj *taosMallocFdObj(SThreadObj *pThreadObj, int fd) {
@@ -432,10 +642,13 @@ static SFdObj *taosMallocFdObj(SThreadObj *pThreadObj, int fd) {
   pFdObj->fd = fd;
   pFdObj->pThreadObj = pThreadObj;
   pFdObj->signature = pFdObj;
+  pthread_mutex_init(&pFdObj->mutex, NULL);
+  taosSetNonblocking(fd, 1);
 
-  event.events = EPOLLIN | EPOLLPRI | EPOLLWAKEUP;
+  event.events = TCP_POLL_EVENTS;
   event.data.ptr = pFdObj;
   if (epoll_ctl(pThreadObj->pollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+    pthread_mutex_destroy(&pFdObj->mutex);
     tfree(pFdObj);
     return NULL;
   }
@@ -491,5 +704,15 @@ static void taosFreeFdObj(SFdObj *pFdObj) {
   tTrace("%s %p, FD:%p is cleaned, numOfFds:%d", 
           pThreadObj->label, pFdObj->thandle, pFdObj, pThreadObj->numOfFds);
 
+  pthread_mutex_lock(&pFdObj->mutex);
+  while (pFdObj->pSendHead) {
+    SSendBuf *pBuf = pFdObj->pSendHead;
+    pFdObj->pSendHead = pBuf->next;
+    free(pBuf);
+  }
+  pthread_mutex_unlock(&pFdObj->mutex);
+  pthread_mutex_destroy(&pFdObj->mutex);
+
+  tfree(pFdObj->buffer);
   tfree(pFdObj);
 }
@@ -13,7 +13,10 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define _GNU_SOURCE  // recvmmsg/sendmmsg
+
 #include "os.h"
+#include "tglobal.h"
 #include "tsocket.h"
 #include "tsystem.h"
 #include "ttimer.h"
@@ -26,6 +29,10 @@
 #define RPC_MAX_UDP_PKTS 1000
 #define RPC_UDP_BUF_TIME 5  // mseconds
 #define RPC_MAX_UDP_SIZE 65480
+#define RPC_UDP_BATCH 32        // datagrams received or sent by one system call
+#define RPC_UDP_SLOT_SIZE 2048  // datagrams up to it are handed to the upper layer in the buffer received into
+#define RPC_UDP_SPILL_SIZE (RPC_MAX_UDP_SIZE - RPC_UDP_SLOT_SIZE)
+#define RPC_UDP_SEND_SIZE 65536
 
 typedef struct {
   void           *signature;
@@ -39,7 +46,17 @@ typedef struct {
   void           *shandle;  // handle passed by upper layer during server initialization
   void           *pSet;
   void         *(*processData)(SRecvInfo *pRecv);
-  char           *buffer;  // buffer to receive data
+  char           *buffer;  // spill area of each slot, for datagrams larger than a slot
+  char           *slots[RPC_UDP_BATCH];  // tsRpcOverhead + RPC_UDP_SLOT_SIZE each
+  struct mmsghdr  recvMsgs[RPC_UDP_BATCH];
+  struct iovec    recvIovs[RPC_UDP_BATCH][2];
+  struct sockaddr_in recvAddrs[RPC_UDP_BATCH];
+  int             numOfSend;  // datagrams sent by the recv thread while it processes a batch, flushed after it
+  int             sendLen;
+  char           *sendBuf;
+  struct mmsghdr  sendMsgs[RPC_UDP_BATCH];
+  struct iovec    sendIovs[RPC_UDP_BATCH];
+  struct sockaddr_in sendAddrs[RPC_UDP_BATCH];
 } SUdpConn;
 
 typedef struct {
@@ -55,6 +72,12 @@ typedef struct {
 } SUdpConnSet;
 
 static void *taosRecvUdpData(void *param);
+static int   taosInitUdpBuffers(SUdpConn *pConn);
+static void  taosFreeUdpBuffers(SUdpConn *pConn);
+static void  taosFlushUdpData(SUdpConn *pConn);
+
+// the connection whose batch is processed by the calling thread, its sends are queued till the batch is done
+static threadlocal SUdpConn *tsUdpBatchConn = NULL;
 
 void *taosInitUdpConnection(uint32_t ip, uint16_t port, char *label, int threads, void *fp, void *shandle) {
   SUdpConn    *pConn;
@@ -74,20 +97,24 @@ void *taosInitUdpConnection(uint32_t ip, uint16_t port, char *label, int threads
   pSet->fp = fp;
   strcpy(pSet->label, label);
 
+  // with SO_REUSEPORT all threads of a server receive on its port and the kernel spreads the peers over them,
+  // otherwise thread i binds port + i and new connections are moved to it by the port in the response head
+  bool     reusePort = (port != 0 && tsRpcUdpReusePort != 0);
   uint16_t ownPort;
   for (int i = 0; i < threads; ++i) {
     pConn = pSet->udpConn + i;
-    ownPort = (port ? port + i : 0);
-    pConn->fd = taosOpenUdpSocket(ip, ownPort);
+    ownPort = (port ? (reusePort ? port : port + i) : 0);
+    pConn->fd = taosOpenUdpSocket(ip, ownPort, reusePort);
     if (pConn->fd < 0) {
       tError("%s failed to open UDP socket %x:%hu", label, ip, port);
       taosCleanUpUdpConnection(pSet);
       return NULL;
     }
 
-    pConn->buffer = malloc(RPC_MAX_UDP_SIZE);
-    if (NULL == pConn->buffer) {
+    if (taosInitUdpBuffers(pConn) != 0) {
       tError("%s failed to malloc recv buffer", label);
+      taosFreeUdpBuffers(pConn);
+      taosCloseSocket(pConn->fd);
       taosCleanUpUdpConnection(pSet);
       return NULL;
     }
@@ -113,6 +140,7 @@ void *taosInitUdpConnection(uint32_t ip, uint16_t port, char *label, int threads
     pthread_attr_destroy(&thAttr);
     if (code != 0) {
       tError("%s failed to create thread to process UDP data, reason:%s", label, strerror(errno));
+      taosFreeUdpBuffers(pConn);
       taosCloseSocket(pConn->fd);
       taosCleanUpUdpConnection(pSet);
       return NULL;
@@ -142,7 +170,7 @@ void taosCleanUpUdpConnection(void *handle) {
   for (int i = 0; i < pSet->threads; ++i) {
     pConn = pSet->udpConn + i;
     pthread_join(pConn->thread, NULL);
-    free(pConn->buffer);
+    taosFreeUdpBuffers(pConn);
     taosCloseSocket(pConn->fd);
     tTrace("chandle:%p is closed", pConn);
   }
@@ -163,60 +191,165 @@ void *taosOpenUdpConnection(void *shandle, void *thandle, uint32_t ip, uint16_t
   return pConn;
 }
 
+static int taosInitUdpBuffers(SUdpConn *pConn) {
+  // pages of the spill area are only touched by datagrams larger than a slot
+  pConn->buffer = malloc((size_t)RPC_UDP_BATCH * RPC_UDP_SPILL_SIZE);
+  pConn->sendBuf = malloc(RPC_UDP_SEND_SIZE);
+  if (pConn->buffer == NULL || pConn->sendBuf == NULL) return -1;
+
+  for (int i = 0; i < RPC_UDP_BATCH; ++i) {
+    pConn->slots[i] = malloc((size_t)(tsRpcOverhead + RPC_UDP_SLOT_SIZE));
+    if (pConn->slots[i] == NULL) return -1;
+
+    pConn->recvIovs[i][0].iov_base = pConn->slots[i] + tsRpcOverhead;
+    pConn->recvIovs[i][0].iov_len = RPC_UDP_SLOT_SIZE;
+    pConn->recvIovs[i][1].iov_base = pConn->buffer + (size_t)i * RPC_UDP_SPILL_SIZE;
+    pConn->recvIovs[i][1].iov_len = RPC_UDP_SPILL_SIZE;
+
+    struct msghdr *pHdr = &pConn->recvMsgs[i].msg_hdr;
+    pHdr->msg_name = pConn->recvAddrs + i;
+    pHdr->msg_namelen = sizeof(struct sockaddr_in);
+    pHdr->msg_iov = pConn->recvIovs[i];
+    pHdr->msg_iovlen = 2;
+  }
+
+  return 0;
+}
+
+static void taosFreeUdpBuffers(SUdpConn *pConn) {
+  for (int i = 0; i < RPC_UDP_BATCH; ++i) tfree(pConn->slots[i]);
+  tfree(pConn->buffer);
+  tfree(pConn->sendBuf);
+}
+
+/*
+ * Datagrams are received in batches by recvmmsg. Each one is scattered into a slot, and the part beyond
+ * RPC_UDP_SLOT_SIZE into the spill area of the slot. A datagram fitting in its slot is handed to the upper
+ * layer in the slot buffer, which is replaced by a new one, so the common small msgs are never copied.
+ * Larger ones are copied into a buffer of their size, as the spill area is reused.
+ */
 static void *taosRecvUdpData(void *param) {
-  SUdpConn          *pConn = param;
-  struct sockaddr_in sourceAdd;
-  ssize_t            dataLen;
-  unsigned int       addLen;
-  uint16_t           port;
-  SRecvInfo          recvInfo;
-
-  memset(&sourceAdd, 0, sizeof(sourceAdd));
-  addLen = sizeof(sourceAdd);
+  SUdpConn  *pConn = param;
+  SRecvInfo  recvInfo;
+
   tTrace("%s UDP thread is created, index:%d", pConn->label, pConn->index);
-  char *msg = pConn->buffer;
 
   while (1) {
-    dataLen = recvfrom(pConn->fd, pConn->buffer, RPC_MAX_UDP_SIZE, 0, (struct sockaddr *)&sourceAdd, &addLen);
-    if(dataLen == 0) {
-      tTrace("data length is 0, socket was closed, exiting");
+    // block for the first datagram only, then take the ones already queued
+    int num = recvmmsg(pConn->fd, pConn->recvMsgs, RPC_UDP_BATCH, MSG_WAITFORONE, NULL);
+    if (pConn->signature == NULL) {
+      tTrace("%s UDP socket was closed, exiting", pConn->label);
       break;
     }
 
-    port = ntohs(sourceAdd.sin_port);
-
-    if (dataLen < sizeof(SRpcHead)) {
-      tError("%s recvfrom failed, reason:%s\n", pConn->label, strerror(errno));
+    if (num < 0) {
+      if (errno != EINTR) tError("%s recvmmsg failed, reason:%s", pConn->label, strerror(errno));
       continue;
     }
 
-    char *tmsg = malloc(dataLen + tsRpcOverhead);
-    if (NULL == tmsg) {
-      tError("%s failed to allocate memory, size:%d", pConn->label, dataLen);
-      continue;
+    tsUdpBatchConn = pConn;
+
+    for (int i = 0; i < num; ++i) {
+      int   dataLen = (int)pConn->recvMsgs[i].msg_len;
+      char *tmsg;
+
+      pConn->recvMsgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);  // set by the kernel on receive
+
+      if (dataLen < sizeof(SRpcHead) || (pConn->recvMsgs[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+        tError("%s invalid UDP msg is received, len:%d", pConn->label, dataLen);
+        continue;
+      }
+
+      if (dataLen <= RPC_UDP_SLOT_SIZE) {
+        char *slot = malloc((size_t)(tsRpcOverhead + RPC_UDP_SLOT_SIZE));
+        if (NULL == slot) {
+          tError("%s failed to allocate memory, size:%d", pConn->label, RPC_UDP_SLOT_SIZE);
+          continue;
+        }
+        tmsg = pConn->slots[i] + tsRpcOverhead;
+        pConn->slots[i] = slot;
+        pConn->recvIovs[i][0].iov_base = slot + tsRpcOverhead;
+      } else {
+        tmsg = malloc((size_t)(dataLen + tsRpcOverhead));
+        if (NULL == tmsg) {
+          tError("%s failed to allocate memory, size:%d", pConn->label, dataLen);
+          continue;
+        }
+        tmsg += tsRpcOverhead;  // overhead for SRpcReqContext
+        memcpy(tmsg, pConn->slots[i] + tsRpcOverhead, RPC_UDP_SLOT_SIZE);
+        memcpy(tmsg + RPC_UDP_SLOT_SIZE, pConn->recvIovs[i][1].iov_base, (size_t)(dataLen - RPC_UDP_SLOT_SIZE));
+      }
+
+      recvInfo.msg = tmsg;
+      recvInfo.msgLen = dataLen;
+      recvInfo.ip = pConn->recvAddrs[i].sin_addr.s_addr;
+      recvInfo.port = ntohs(pConn->recvAddrs[i].sin_port);
+      recvInfo.shandle = pConn->shandle;
+      recvInfo.thandle = NULL;
+      recvInfo.chandle = pConn;
+      recvInfo.connType = 0;
+      (*(pConn->processData))(&recvInfo);
     }
 
-    tmsg += tsRpcOverhead;  // overhead for SRpcReqContext
-    memcpy(tmsg, msg, dataLen);
-    recvInfo.msg = tmsg;
-    recvInfo.msgLen = dataLen;
-    recvInfo.ip = sourceAdd.sin_addr.s_addr;
-    recvInfo.port = port;
-    recvInfo.shandle = pConn->shandle;
-    recvInfo.thandle = NULL;
-    recvInfo.chandle = pConn;
-    recvInfo.connType = 0;
-    (*(pConn->processData))(&recvInfo);
+    tsUdpBatchConn = NULL;
+    taosFlushUdpData(pConn);
   }
 
   return NULL;
 }
 
+// send the datagrams queued while a batch was processed by one sendmmsg
+static void taosFlushUdpData(SUdpConn *pConn) {
+  int sent = 0;
+
+  while (sent < pConn->numOfSend) {
+    int ret = sendmmsg(pConn->fd, pConn->sendMsgs + sent, (unsigned int)(pConn->numOfSend - sent), 0);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      tError("%s failed to send %d UDP msgs, reason:%s", pConn->label, pConn->numOfSend - sent, strerror(errno));
+      break;
+    }
+    sent += ret;
+  }
+
+  pConn->numOfSend = 0;
+  pConn->sendLen = 0;
+}
+
 int taosSendUdpData(uint32_t ip, uint16_t port, void *data, int dataLen, void *chandle) {
   SUdpConn *pConn = (SUdpConn *)chandle;
 
   if (pConn == NULL || pConn->signature != pConn) return -1;
 
+  // msgs sent while the recv thread processes a batch, mostly responses, are copied and sent together
+  if (tsUdpBatchConn == pConn && dataLen <= RPC_UDP_SEND_SIZE) {
+    if (pConn->numOfSend == RPC_UDP_BATCH || pConn->sendLen + dataLen > RPC_UDP_SEND_SIZE) {
+      taosFlushUdpData(pConn);
+    }
+
+    int                 i = pConn->numOfSend++;
+    struct sockaddr_in *pAddr = pConn->sendAddrs + i;
+    struct msghdr      *pHdr = &pConn->sendMsgs[i].msg_hdr;
+
+    memset(pAddr, 0, sizeof(struct sockaddr_in));
+    pAddr->sin_family = AF_INET;
+    pAddr->sin_addr.s_addr = ip;
+    pAddr->sin_port = htons(port);
+
+    pConn->sendIovs[i].iov_base = pConn->sendBuf + pConn->sendLen;
+    pConn->sendIovs[i].iov_len = (size_t)dataLen;
+    memcpy(pConn->sendIovs[i].iov_base, data, (size_t)dataLen);
+    pConn->sendLen += dataLen;
+
+    memset(pHdr, 0, sizeof(struct msghdr));
+    pHdr->msg_name = pAddr;
+    pHdr->msg_namelen = sizeof(struct sockaddr_in);
+    pHdr->msg_iov = pConn->sendIovs + i;
+    pHdr->msg_iovlen = 1;
+
+    return dataLen;
+  }
+
   struct sockaddr_in destAdd;
   memset(&destAdd, 0, sizeof(destAdd));
   destAdd.sin_family = AF_INET;
@@ -227,4 +360,3 @@ int taosSendUdpData(uint32_t ip, uint16_t port, void *data, int dataLen, void *c
 
   return ret;
 }
-
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "os.h"
+#include "tglobal.h"
+#include "ttime.h"
+#include "rpcLog.h"
+#include "trpc.h"
+#include "taosmsg.h"
+#include "taoserror.h"
+#include "tsocket.h"
+#include "rpcHead.h"
+
+// throughput and latency of request/response pairs from many clients against rserver
+
+typedef struct {
+  int       index;
+  SRpcIpSet ipSet;
+  int       num;
+  int       numOfReqs;
+  int       msgSize;
+  int       msgType;
+  sem_t     rspSem;
+  pthread_t thread;
+  void     *pRpc;
+  int64_t  *latency;  // in microseconds, of each request
+} SInfo;
+
+static void processResponse(SRpcMsg *pMsg, SRpcIpSet *pIpSet) {
+  SInfo *pInfo = (SInfo *)pMsg->handle;
+
+  if (pIpSet) pInfo->ipSet = *pIpSet;
+  if (pMsg->code != 0) tError("thread:%d, response code:0x%x", pInfo->index, pMsg->code);
+
+  rpcFreeCont(pMsg->pCont);
+  sem_post(&pInfo->rspSem);
+}
+
+static void *sendRequest(void *param) {
+  SInfo  *pInfo = (SInfo *)param;
+  SRpcMsg rpcMsg;
+
+  for (pInfo->num = 0; pInfo->num < pInfo->numOfReqs; pInfo->num++) {
+    rpcMsg.pCont = rpcMallocCont(pInfo->msgSize);
+    rpcMsg.contLen = pInfo->msgSize;
+    rpcMsg.handle = pInfo;
+    rpcMsg.msgType = pInfo->msgType;
+
+    int64_t st = taosGetTimestampUs();
+    rpcSendRequest(pInfo->pRpc, &pInfo->ipSet, &rpcMsg);
+    sem_wait(&pInfo->rspSem);
+    pInfo->latency[pInfo->num] = taosGetTimestampUs() - st;
+  }
+
+  return NULL;
+}
+
+static int compareLatency(const void *a, const void *b) {
+  int64_t x = *(int64_t *)a, y = *(int64_t *)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+  SRpcInit  rpcInit;
+  SRpcIpSet ipSet;
+  int       msgSize = 128;
+  int       numOfReqs = 10000;
+  int       numOfClients = 10;
+  int       appThreads = 4;
+  int       useTcp = 1;
+  int       numOfSlow = 0;
+  char      serverIp[40] = "127.0.0.1";
+
+  ipSet.numOfIps = 1;
+  ipSet.inUse = 0;
+  ipSet.port[0] = 7000;
+  strcpy(ipSet.fqdn[0], serverIp);
+
+  memset(&rpcInit, 0, sizeof(rpcInit));
+  rpcInit.localPort    = 0;
+  rpcInit.label        = "APP";
+  rpcInit.numOfThreads = 1;
+  rpcInit.cfp          = processResponse;
+  rpcInit.idleTime     = tsShellActivityTimer*1000;
+  rpcInit.user         = "michael";
+  rpcInit.secret       = "mypassword";
+  rpcInit.ckey         = "key";
+  rpcInit.spi          = 1;
+  rpcInit.connType     = TAOS_CONN_CLIENT;
+
+  for (int i=1; i<argc; ++i) {
+    if (strcmp(argv[i], "-p")==0 && i < argc-1) {
+      ipSet.port[0] = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-i") ==0 && i < argc-1) {
+      strcpy(ipSet.fqdn[0], argv[++i]);
+    } else if (strcmp(argv[i], "-t")==0 && i < argc-1) {
+      rpcInit.numOfThreads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-m")==0 && i < argc-1) {
+      msgSize = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n")==0 && i < argc-1) {
+      numOfReqs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-c")==0 && i < argc-1) {
+      numOfClients = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-a")==0 && i < argc-1) {
+      appThreads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-tcp")==0 && i < argc-1) {
+      useTcp = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-slow")==0 && i < argc-1) {
+      numOfSlow = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-d")==0 && i < argc-1) {
+      rpcDebugFlag = atoi(argv[++i]);
+    } else {
+      printf("\nusage: %s [options] \n", argv[0]);
+      printf("  [-i ip]: server IP address, default is:%s\n", serverIp);
+      printf("  [-p port]: server port number, default is:%d\n", ipSet.port[0]);
+      printf("  [-t threads]: number of rpc threads of each client, default is:%d\n", rpcInit.numOfThreads);
+      printf("  [-m msgSize]: message body size, default is:%d\n", msgSize);
+      printf("  [-c clients]: number of rpc clients, default is:%d\n", numOfClients);
+      printf("  [-a threads]: number of app threads of each client, default is:%d\n", appThreads);
+      printf("  [-n requests]: number of requests per app thread, default is:%d\n", numOfReqs);
+      printf("  [-tcp 0|1]: send requests over TCP, default is:%d\n", useTcp);
+      printf("  [-slow conns]: TCP connections which send a partial msg head and stall, default is:%d\n", numOfSlow);
+      printf("  [-d debugFlag]: debug flag, default:%d\n", rpcDebugFlag);
+      printf("  [-h help]: print out this help\n\n");
+      exit(0);
+    }
+  }
+
+  taosInitLog("bench.log", 100000, 10);
+
+  // each app thread keeps one request outstanding, so it holds one session
+  rpcInit.sessions = appThreads + 1;
+
+  int    totalThreads = numOfClients * appThreads;
+  void **pRpcs = calloc(numOfClients, sizeof(void *));
+  SInfo *pInfos = calloc(totalThreads, sizeof(SInfo));
+
+  for (int c = 0; c < numOfClients; ++c) {
+    pRpcs[c] = rpcOpen(&rpcInit);
+    if (pRpcs[c] == NULL) {
+      printf("failed to initialize RPC client:%d\n", c);
+      return -1;
+    }
+  }
+
+  // a stalled sender shall not block the other connections served by the same server thread
+  int *slowFds = calloc(numOfSlow + 1, sizeof(int));
+  for (int i = 0; i < numOfSlow; ++i) {
+    SRpcHead head = {0};
+    head.msgLen = (int32_t)htonl(sizeof(SRpcHead) + msgSize);
+    slowFds[i] = taosOpenTcpClientSocket(inet_addr(ipSet.fqdn[0]), ipSet.port[0], 0);
+    if (slowFds[i] < 0 || taosWriteMsg(slowFds[i], &head, sizeof(SRpcHead) / 2) < 0) {
+      printf("failed to open slow connection:%d\n", i);
+      return -1;
+    }
+  }
+
+  int64_t startTime = taosGetTimestampUs();
+
+  for (int i = 0; i < totalThreads; ++i) {
+    SInfo *pInfo = pInfos + i;
+    pInfo->index = i;
+    pInfo->ipSet = ipSet;
+    pInfo->numOfReqs = numOfReqs;
+    pInfo->msgSize = msgSize;
+    // queries always go over TCP, other msgs only if they are larger than tsRpcMaxUdpSize
+    pInfo->msgType = useTcp ? TSDB_MSG_TYPE_QUERY : TSDB_MSG_TYPE_SUBMIT;
+    pInfo->pRpc = pRpcs[i / appThreads];
+    pInfo->latency = malloc(sizeof(int64_t) * numOfReqs);
+    sem_init(&pInfo->rspSem, 0, 0);
+    pthread_create(&pInfo->thread, NULL, sendRequest, pInfo);
+  }
+
+  for (int i = 0; i < totalThreads; ++i) {
+    pthread_join(pInfos[i].thread, NULL);
+  }
+
+  int64_t usedTime = taosGetTimestampUs() - startTime;
+  int64_t total = (int64_t)numOfReqs * totalThreads;
+
+  int64_t *latency = malloc(sizeof(int64_t) * total);
+  int64_t  sum = 0;
+  for (int i = 0; i < totalThreads; ++i) {
+    memcpy(latency + (int64_t)i * numOfReqs, pInfos[i].latency, sizeof(int64_t) * numOfReqs);
+    free(pInfos[i].latency);
+  }
+  for (int64_t i = 0; i < total; ++i) sum += latency[i];
+  qsort(latency, total, sizeof(int64_t), compareLatency);
+
+  printf("%s, clients:%d threads:%d msgSize:%d, %" PRId64 " requests in %.3f ms, %.0f requests per second\n",
+         useTcp ? "TCP" : "UDP", numOfClients, totalThreads, msgSize, total, usedTime / 1000.0,
+         total * 1000000.0 / usedTime);
+  // a request and its response are a datagram each
+  if (!useTcp) printf("%.0f packets per second\n", total * 2 * 1000000.0 / usedTime);
+  printf("latency(us) avg:%.1f p50:%" PRId64 " p99:%" PRId64 " p999:%" PRId64 " max:%" PRId64 "\n",
+         (double)sum / total, latency[total / 2], latency[total * 99 / 100], latency[total * 999 / 1000],
+         latency[total - 1]);
+
+  free(latency);
+  for (int i = 0; i < numOfSlow; ++i) taosCloseTcpSocket(slowFds[i]);
+  free(slowFds);
+  for (int c = 0; c < numOfClients; ++c) rpcClose(pRpcs[c]);
+  free(pRpcs);
+  free(pInfos);
+
+  taosCloseLog();
+
+  return 0;
+}
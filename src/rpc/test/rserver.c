@@ -22,6 +22,7 @@
 
 int msgSize = 128;
 int commit = 0;
+int direct = 0;
 int dataFd = -1;
 void *qhandle = NULL;
 
@@ -116,6 +117,17 @@ int retrieveAuthInfo(char *meterId, char *spi, char *encrypt, char *secret, char
 void processRequestMsg(SRpcMsg *pMsg, SRpcIpSet *pIpSet) {
   SRpcMsg *pTemp;
 
+  if (direct) {
+    // respond in the RPC thread, so the benchmark measures the transport instead of the app queue
+    SRpcMsg rpcMsg = {0};
+    rpcFreeCont(pMsg->pCont);
+    rpcMsg.pCont = rpcMallocCont(msgSize);
+    rpcMsg.contLen = msgSize;
+    rpcMsg.handle = pMsg->handle;
+    rpcSendResponse(&rpcMsg);
+    return;
+  }
+
   pTemp = taosAllocateQitem(sizeof(SRpcMsg));
   memcpy(pTemp, pMsg, sizeof(SRpcMsg));
 
@@ -149,6 +161,10 @@ int main(int argc, char *argv[]) {
       tsCompressMsgSize = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-w")==0 && i < argc-1) {
       commit = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-r")==0 && i < argc-1) {
+      direct = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-u")==0 && i < argc-1) {
+      tsRpcUdpReusePort = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-d")==0 && i < argc-1) {
       rpcDebugFlag = atoi(argv[++i]);
       dDebugFlag = rpcDebugFlag;
@@ -161,6 +177,8 @@ int main(int argc, char *argv[]) {
       printf("  [-m msgSize]: message body size, default is:%d\n", msgSize);
       printf("  [-o compSize]: compression message size, default is:%d\n", tsCompressMsgSize);
       printf("  [-w write]: write received data to file(0, 1, 2), default is:%d\n", commit);
+      printf("  [-r direct]: respond in the RPC thread(0, 1), default is:%d\n", direct);
+      printf("  [-u reusePort]: UDP threads share the port by SO_REUSEPORT(0, 1), default is:%d\n", tsRpcUdpReusePort);
       printf("  [-d debugFlag]: debug flag, default:%d\n", rpcDebugFlag);
       printf("  [-h help]: print out this help\n\n");
       exit(0);
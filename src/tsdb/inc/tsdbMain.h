@@ -15,6 +15,8 @@
 #ifndef _TD_TSDB_MAIN_H_
 #define _TD_TSDB_MAIN_H_
 
+#include "tcache.h"
+#include "tsched.h"
 #include "tglobal.h"
 #include "tlist.h"
 #include "tsdb.h"
@@ -71,13 +73,39 @@ void       tsdbCloseMetaFile(SMetaFile *mfh);
 // ------------------------------ TSDB META INTERFACES ------------------------------
 #define IS_CREATE_STABLE(pCfg) ((pCfg)->tagValues != NULL)
 
+// Rows arriving in ascending key order are appended to a row log whose chunks are carved from the cache
+// blocks, only out-of-order rows go to the skiplist in pData. Both are merged by SMemTableIter.
+#define TSDB_MEM_CHUNK_ROWS_BITS 10
+#define TSDB_MEM_CHUNK_ROWS (1 << TSDB_MEM_CHUNK_ROWS_BITS)
+
 typedef struct {
-  TSKEY   keyFirst;
-  TSKEY   keyLast;
-  int32_t numOfPoints;
-  void *  pData;
+  SDataRow rows[TSDB_MEM_CHUNK_ROWS];
+} SMemRowChunk;
+
+typedef struct SMemRowDir {
+  struct SMemRowDir *prev;  // retired directory, kept alive until the mem table is freed
+  int32_t            maxChunks;
+  SMemRowChunk *     chunks[];
+} SMemRowDir;
+
+typedef struct {
+  TSKEY       keyFirst;
+  TSKEY       keyLast;
+  int32_t     numOfPoints;
+  int32_t     numOfLogRows;  // number of rows in the append-only row log
+  TSKEY       logKeyLast;    // key of the last row in the row log
+  SMemRowDir *pDir;          // chunk directory of the row log
+  void *      pData;         // skiplist of out-of-order rows, created on demand
 } SMemTable;
 
+// The row log is read concurrently with the writer, which publishes pDir, the chunk pointers and numOfLogRows with
+// release stores after the contents they guard, so readers load them with acquire
+#define TSDB_MEM_LOG_ROWS(pMem) __atomic_load_n(&(pMem)->numOfLogRows, __ATOMIC_ACQUIRE)
+#define TSDB_MEM_LOG_DIR(pMem) __atomic_load_n(&(pMem)->pDir, __ATOMIC_ACQUIRE)
+#define TSDB_MEM_LOG_CHUNK_AT(pMem, idx) \
+  __atomic_load_n(&TSDB_MEM_LOG_DIR(pMem)->chunks[(idx) >> TSDB_MEM_CHUNK_ROWS_BITS], __ATOMIC_ACQUIRE)
+#define TSDB_MEM_LOG_ROW_AT(pMem, idx) (TSDB_MEM_LOG_CHUNK_AT(pMem, idx)->rows[(idx) & (TSDB_MEM_CHUNK_ROWS - 1)])
+
 // ---------- TSDB TABLE DEFINITION
 typedef struct STable {
   int8_t         type;
@@ -90,6 +118,8 @@ typedef struct STable {
   SMemTable *    mem;
   SMemTable *    imem;
   void *         pIndex;         // For TSDB_SUPER_TABLE, it is the skiplist index
+  void *         pTagIndex;      // For TSDB_SUPER_TABLE, hash indexes of the tag values, NULL if not enabled
+  uint32_t       tversion;       // For TSDB_SUPER_TABLE, changed whenever a child table joins or leaves the index
   void *         eventHandler;   // TODO
   void *         streamHandler;  // TODO
   TSKEY          lastKey;        // lastkey inserted in this table, initialized as 0, TODO: make a structure
@@ -116,6 +146,8 @@ typedef struct {
 
   void *map;  // table map of (uid ===> table)
 
+  uint32_t tversion;  // the last version of the super tables, which never repeats in a vnode
+
   SMetaFile *mfh;  // meta file handle
   int        maxRowBytes;
   int        maxCols;
@@ -127,6 +159,17 @@ typedef struct STableIndexElem {
   STable*    pTable;
 } STableIndexElem;
 
+// hash indexes of the tag values of the child tables of a super table
+typedef struct {
+  int32_t numOfTags;
+  void *  index[];  // SHashObj of each tag column, tag value ==> SArray of sorted tids, NULL if not indexed
+} STagIndex;
+
+#define TSDB_TAG_INDEX_HASH_SIZE 64
+
+bool    tsdbIsTagIndexed(STable *pSTable, int32_t colIndex);
+SArray *tsdbGetTablesOfTagValue(STable *pSTable, int32_t colIndex, const char *val);
+
 STsdbMeta *tsdbInitMeta(char *rootDir, int32_t maxTables);
 int32_t    tsdbFreeMeta(STsdbMeta *pMeta);
 STSchema * tsdbGetTableSchema(STsdbMeta *pMeta, STable *pTable);
@@ -191,6 +234,23 @@ STsdbCache *tsdbInitCache(int cacheBlockSize, int totalBlocks, TsdbRepoT *pRepo)
 void        tsdbFreeCache(STsdbCache *pCache);
 void *      tsdbAllocFromCache(STsdbCache *pCache, int bytes, TSKEY key);
 
+// ---- Operation on SMemTable
+typedef struct {
+  SMemTable *        pMem;
+  int32_t            order;
+  int32_t            logIdx;  // next candidate position in the row log
+  SSkipListIterator *pSIter;  // iterator of out-of-order rows
+  SDataRow           sRow;    // next candidate row from the skiplist
+  SDataRow           row;     // current row
+} SMemTableIter;
+
+int            tsdbInsertRowToMem(STsdbCache *pCache, SMemTable **ppMem, SDataRow row);
+void           tsdbFreeMemTable(SMemTable *pMemTable);
+SMemTableIter *tsdbCreateMemTableIter(SMemTable *pMem, TSKEY *pKey, int32_t order);
+bool           tsdbMemTableIterNext(SMemTableIter *pIter);
+SDataRow       tsdbMemTableIterGet(SMemTableIter *pIter);
+void *         tsdbDestroyMemTableIter(SMemTableIter *pIter);
+
 // ------------------------------ TSDB FILE INTERFACES ------------------------------
 #define TSDB_FILE_HEAD_SIZE 512
 #define TSDB_FILE_DELIMITER 0xF00AFA0F
@@ -216,6 +276,7 @@ typedef struct {
   uint64_t tombSize;  // unused file size
   uint32_t totalBlocks;
   uint32_t totalSubBlocks;
+  uint32_t version;  // of a .head file, increased each time it is rewritten, the rollups record the one built from
 } STsdbFileInfo;
 
 void *tsdbEncodeSFileInfo(void *buf, const STsdbFileInfo *pInfo);
@@ -230,8 +291,9 @@ typedef struct {
 #define TSDB_IS_FILE_OPENED(f) ((f)->fd != -1)
 
 typedef struct {
-  int32_t fileId;
-  SFile   files[TSDB_FILE_TYPE_MAX];
+  int32_t  fileId;
+  uint32_t version;  // changed whenever the files are rewritten by commit, part of the block cache key
+  SFile    files[TSDB_FILE_TYPE_MAX];
 } SFileGroup;
 
 // TSDB file handle
@@ -239,6 +301,8 @@ typedef struct {
   int maxFGroups;
   int numOfFGroups;
 
+  uint32_t version;  // the last version assigned to a file group
+
   SFileGroup *fGroup;
 } STsdbFileH;
 
@@ -338,9 +402,23 @@ typedef struct {
   int16_t maxIndex;
   int16_t minIndex;
   int16_t numOfNull;
-  char    padding[2];
+  int8_t  algorithm;  // Algorithm + 1 of the column if it is not the one of the block, 0 otherwise
+  int8_t  flags;      // TSDB_COL_FLAG_*, 0 in the blocks written before the flags
 } SCompCol;
 
+// The sum, max and min of a float or double column are kept as double values. The blocks written before keep them
+// in another layout, and are loaded by queries instead of answered by the statistics.
+#define TSDB_COL_FLAG_DOUBLE_STATIS 0x1
+
+#define TSDB_COL_ALGORITHM(pCompBlock, pCompCol) \
+  (((pCompCol)->algorithm > 0) ? (pCompCol)->algorithm - 1 : (pCompBlock)->algorithm)
+#define TSDB_SET_COL_ALGORITHM(pCompCol, alg) ((pCompCol)->algorithm = (alg) + 1)
+
+// Rows of a column compressed by each candidate algorithm to choose the one of the column
+#define TSDB_COMP_SAMPLE_ROWS 256
+// An algorithm slower to decode is chosen only if it makes the sample smaller by 1 / TSDB_COMP_MIN_GAIN at least
+#define TSDB_COMP_MIN_GAIN 8
+
 // TODO: Take recover into account
 typedef struct {
   int32_t  delimiter;  // For recovery usage
@@ -356,6 +434,112 @@ int         tsdbCopyBlockDataInFile(SFile *pOutFile, SFile *pInFile, SCompInfo *
 SFileGroup *tsdbSearchFGroup(STsdbFileH *pFileH, int fid);
 void tsdbGetKeyRangeOfFileId(int32_t daysPerFile, int8_t precision, int32_t fileId, TSKEY *minKey, TSKEY *maxKey);
 
+// ------------------------------ TSDB ROLLUP INTERFACES ------------------------------
+/**
+ * Rollups are the statistics of each table in the buckets of the configured intervals, kept in a .rollup file
+ * beside the file group. The file is rebuilt from the new files of the group at each commit to the group, and
+ * only the buckets covering the committed keys are computed from the data blocks again.
+ *
+ * | SRollupHead | SRollupInfo of table 1 | SRollupInfo of table 2 | ... | SRollupIdx[numOfTables] + TSCKSUM |
+ *
+ * SRollupInfo of a table is followed by the SRollupCol array and a TSCKSUM, then the entries of each level, each
+ * level followed by its own TSCKSUM so a query reads only the level it needs. An entry is a SRollupEntry followed by
+ * the SRollupStat of each column. Each part is aligned to 8 bytes.
+ */
+#define TSDB_MAX_ROLLUP_LEVELS 3
+#define TSDB_ROLLUP_FILE_SUFFIX ".rollup"
+
+typedef struct {
+  int32_t numOfLevels;
+  int64_t levels[TSDB_MAX_ROLLUP_LEVELS];  // intervals in the precision of the repository, each a multiple of the last
+} SRollupCfg;
+
+typedef struct {
+  uint32_t delimiter;
+  int32_t  numOfLevels;
+  int64_t  levels[TSDB_MAX_ROLLUP_LEVELS];
+  uint32_t headVersion;  // version of the .head file the rollups are built from, and offset and length of its
+  uint32_t headOffset;   // SCompIdx part
+  uint32_t headLen;
+  int64_t  idxOffset;
+  int32_t  numOfTables;
+  uint32_t checksum;
+} SRollupHead;
+
+typedef struct {
+  int32_t  tid;
+  uint32_t len;
+  uint64_t uid;
+  int64_t  offset;
+} SRollupIdx;
+
+typedef struct {
+  int16_t colId;
+  int16_t type;
+} SRollupCol;
+
+typedef struct {
+  int32_t    delimiter;
+  int32_t    numOfCols;  // columns with statistics, the timestamp column is not included
+  uint64_t   uid;
+  int32_t    numOfEntries[TSDB_MAX_ROLLUP_LEVELS];
+  int32_t    offset[TSDB_MAX_ROLLUP_LEVELS];  // offset of the entries of each level from the start of SRollupInfo
+  SRollupCol cols[];
+} SRollupInfo;
+
+typedef struct {
+  TSKEY   skey;  // start of the bucket
+  TSKEY   keyFirst;
+  TSKEY   keyLast;
+  int32_t numOfRows;
+  int32_t padding;
+} SRollupEntry;
+
+// the values of float and double columns are kept as double values, like SDataStatis
+typedef struct {
+  int64_t sum;
+  int64_t max;
+  int64_t min;
+  int64_t first;  // values of the first and last rows that are not null
+  int64_t last;
+  TSKEY   firstKey;
+  TSKEY   lastKey;
+  int32_t numOfNull;
+  int32_t padding;
+} SRollupStat;
+
+#define TSDB_ROLLUP_ENTRY_SIZE(numOfCols) (sizeof(SRollupEntry) + sizeof(SRollupStat) * (numOfCols))
+#define TSDB_ROLLUP_ENTRY_AT(pInfo, level, idx) \
+  ((SRollupEntry *)((char *)(pInfo) + (pInfo)->offset[level] + TSDB_ROLLUP_ENTRY_SIZE((pInfo)->numOfCols) * (idx)))
+#define TSDB_ROLLUP_STAT_AT(pEntry, col) ((SRollupStat *)((char *)(pEntry) + sizeof(SRollupEntry)) + (col))
+#define TSDB_ROLLUP_HEAD_SIZE(numOfCols) \
+  ALIGN8(sizeof(SRollupInfo) + sizeof(SRollupCol) * (numOfCols) + sizeof(TSCKSUM))
+#define TSDB_ROLLUP_LEVEL_SIZE(numOfCols, numOfEntries) \
+  ALIGN8(TSDB_ROLLUP_ENTRY_SIZE(numOfCols) * (numOfEntries) + sizeof(TSCKSUM))
+
+typedef struct {
+  int         fd;
+  SRollupHead head;
+  SRollupIdx *pIdx;
+} SRollupFile;
+
+// range of the keys committed to a table
+typedef struct {
+  int32_t tid;
+  TSKEY   keyFirst;
+  TSKEY   keyLast;
+} SRollupRange;
+
+// Worker threads shared by all the repositories to decode the columns of a block in parallel
+typedef struct {
+  void *  qhandle;
+  int32_t numOfThreads;
+  int32_t refCount;  // number of the repositories using it
+} STsdbDecompPool;
+
+// A decoding task in the pool decodes this many columns at least, fewer ones are not worth the dispatching
+#define TSDB_MIN_COLS_PER_DECODE_TASK 4
+
 // TSDB repository definition
 typedef struct STsdbRepo {
   char *rootDir;
@@ -381,6 +565,19 @@ typedef struct STsdbRepo {
   int       commit;
   pthread_t commitThread;
 
+  STsdbCommitStat commitStat;
+
+  int              compacting;  // set by the compaction after a commit or tsdbCompact, commits wait for it
+  STsdbCompactStat compactStat;
+
+  SRollupCfg rollup;
+
+  SLRUCache *pBlockCache;
+  SLRUCache *pBlockIdxCache;  // SBlockIdx of the tables in each file group, put by commits and queries
+  SLRUCache *pTagCondCache;   // tables grouped for the tag conditions of super table queries
+
+  STsdbDecompPool *pDecompPool;
+
   // A limiter to monitor the resources used by tsdb
   void *limiter;
 
@@ -429,6 +626,7 @@ typedef struct {
 
 typedef struct {
   int fid;
+  uint32_t version;
   TSKEY minKey;
   TSKEY maxKey;
   // For read/write purpose
@@ -446,6 +644,13 @@ typedef struct {
   int32_t  sversion;
 } SHelperTable;
 
+// The blocks of a table or a file group, and the size they take in the data and last files
+typedef struct {
+  int64_t numOfBlocks;
+  int64_t numOfSubBlocks;
+  int64_t size;
+} SBlockUsage;
+
 typedef struct {
   // Global configuration
   SHelperCfg config;
@@ -460,6 +665,7 @@ typedef struct {
   SHelperTable tableInfo;
   SCompInfo *  pCompInfo;
   bool         hasOldLastBlock;
+  SBlockUsage  oldUsage;  // of the table when its SCompInfo is loaded by a write helper, before it is changed
 
   // For block set usage
   SCompData *pCompData;
@@ -467,8 +673,31 @@ typedef struct {
 
   void *pBuffer;  // Buffer to hold the whole data block
   void *compBuffer;   // Buffer for temperary compress/decompress purpose
+
+  SLRUCache *pBlockCache;  // Decoded columns of the loaded blocks, set by queries only
+
+  STsdbDecompPool *pDecompPool;
+  void *           decompBuffers[TSDB_MAX_DECOMPRESS_THREADS];  // compBuffer of each decoding task in the pool
+
+  int64_t numOfColsByAlgorithm[TSDB_COMP_ALGORITHMS];  // columns written by each algorithm, for the commit statistics
 } SRWHelper;
 
+#define TSDB_BLOCK_CACHE_SHARDS 16
+
+// Column ranges of a block apart by no more than it are read together, it is cheaper than another read
+#define TSDB_COALESCE_READ_GAP 4096
+
+// Key of a decoded column in the block cache, the offset is the one of the block or of its first sub-block
+typedef struct {
+  int32_t  fid;
+  uint32_t version;
+  uint64_t uid;
+  int64_t  offset;
+  int16_t  colId;
+  int16_t  last;
+  int32_t  padding;
+} SBlockCacheKey;
+
 // --------- Helper state
 #define TSDB_HELPER_CLEAR_STATE 0x0        // Clear state
 #define TSDB_HELPER_FILE_SET_AND_OPEN 0x1  // File is set
@@ -498,9 +727,10 @@ int  tsdbCloseHelperFile(SRWHelper *pHelper, bool hasError);
 int  tsdbLoadCompIdx(SRWHelper *pHelper, void *target);
 int  tsdbLoadCompInfo(SRWHelper *pHelper, void *target);
 int  tsdbLoadCompData(SRWHelper *pHelper, SCompBlock *pCompBlock, void *target);
-int  tsdbLoadBlockDataCols(SRWHelper *pHelper, SDataCols *pDataCols, int blkIdx, int16_t *colIds, int numOfColIds);
+int  tsdbLoadBlockDataCols(SRWHelper *pHelper, SCompBlock *pCompBlock, int16_t *colIds, int numOfColIds);
 int  tsdbLoadBlockData(SRWHelper *pHelper, SCompBlock *pCompBlock, SDataCols *target);
-void tsdbGetDataStatis(SRWHelper *pHelper, SDataStatis *pStatis, int numOfCols);
+void tsdbReadAheadBlockData(SRWHelper *pHelper, SCompInfo *pCompInfo, SCompBlock *pCompBlock);
+int  tsdbGetDataStatis(SRWHelper *pHelper, SDataStatis *pStatis, int numOfCols);
 
 // --------- For write operations
 int tsdbWriteDataBlock(SRWHelper *pHelper, SDataCols *pDataCols);
@@ -508,6 +738,69 @@ int tsdbMoveLastBlockIfNeccessary(SRWHelper *pHelper);
 int tsdbWriteCompInfo(SRWHelper *pHelper);
 int tsdbWriteCompIdx(SRWHelper *pHelper);
 
+// --------- For rollup operations
+int          tsdbParseRollupCfg(char *intervals, int8_t precision, SRollupCfg *pCfg);
+int          tsdbGetRollupLevelIdx(SRollupCfg *pCfg, int64_t level);
+int          tsdbGetRollupFileName(SFileGroup *pGroup, const char *suffix, char *fname);
+int          tsdbCommitRollup(STsdbRepo *pRepo, SFileGroup *pGroup, SHelperFile *pFiles, SArray *pRanges);
+int          tsdbOpenRollupFile(STsdbRepo *pRepo, SFileGroup *pGroup, SRollupFile *pFile);
+void         tsdbCloseRollupFile(SRollupFile *pFile);
+int          tsdbLoadRollupInfo(SRollupFile *pFile, STableId tableId, int level, SRollupInfo **ppInfo);
+
+// --------- For compaction
+// Suffixes of the files a file group is rewritten to, before they replace the files of the group
+#define TSDB_COMPACT_HEAD_SUFFIX ".chead"
+#define TSDB_COMPACT_DATA_SUFFIX ".cdata"
+#define TSDB_COMPACT_LAST_SUFFIX ".clast"
+// Links to the files of the group kept until the new files replace them all, to roll back a failed replacement
+#define TSDB_COMPACT_OLD_HEAD_SUFFIX ".ohead"
+#define TSDB_COMPACT_OLD_DATA_SUFFIX ".odata"
+#define TSDB_COMPACT_OLD_LAST_SUFFIX ".olast"
+// The marker is the commit point of a compaction, the replacement is rolled forward if it exists, back otherwise
+#define TSDB_COMPACT_MARK_SUFFIX ".compact"
+
+int  tsdbCompactFileGroups(STsdbRepo *pRepo, int *fids, int numOfGroups);
+int  tsdbRecoverCompaction(char *dataDir, int fid);
+void tsdbGetCompInfoUsage(SCompInfo *pCompInfo, int numOfBlocks, SBlockUsage *pUsage);
+int  tsdbInitGroupUsage(STsdbRepo *pRepo, SRWHelper *pHelper, SBlockUsage *pUsage);
+int  tsdbDropTableUsage(SRWHelper *pHelper, int tid, SBlockUsage *pUsage);
+void tsdbUpdateTableUsage(SRWHelper *pHelper, SBlockUsage *pUsage);
+void tsdbSetGroupUsage(SRWHelper *pHelper, SBlockUsage *pUsage);
+
+// --------- For block indexes
+// A sparse index of the blocks of a table in a file group, with the key range of every TSDB_BLOCK_IDX_STEP blocks.
+// The indexes are kept in the block index cache, so that a query loads the SCompBlock of the blocks in its time range
+// instead of the whole SCompInfo of the table. Tables of fewer blocks than TSDB_BLOCK_IDX_MIN_BLOCKS are not indexed.
+#define TSDB_BLOCK_IDX_STEP 16
+#define TSDB_BLOCK_IDX_MIN_BLOCKS (TSDB_BLOCK_IDX_STEP * 2)
+#define TSDB_BLOCK_IDX_CACHE_SHARDS 4
+#define TSDB_TAG_COND_CACHE_SHARDS 4
+
+typedef struct {
+  TSKEY keyFirst;
+  TSKEY keyLast;
+} SBlockIdxEntry;
+
+typedef struct {
+  int32_t        numOfBlocks;
+  int32_t        numOfEntries;
+  SBlockIdxEntry entries[];
+} SBlockIdx;
+
+// The version of the file group is changed whenever it is rewritten, the indexes of the old files are not hit any more
+typedef struct {
+  int32_t  fid;
+  uint32_t version;
+  uint64_t uid;
+} SBlockIdxKey;
+
+#define TSDB_BLOCK_IDX_SIZE(numOfBlocks) \
+  (sizeof(SBlockIdx) + sizeof(SBlockIdxEntry) * (((numOfBlocks) + TSDB_BLOCK_IDX_STEP - 1) / TSDB_BLOCK_IDX_STEP))
+
+void tsdbBuildBlockIdx(SCompInfo *pCompInfo, int numOfBlocks, SBlockIdx *pBlockIdx);
+void tsdbSearchBlockIdx(SBlockIdx *pBlockIdx, TSKEY skey, TSKEY ekey, int *start, int *numOfBlocks);
+int  tsdbLoadCompInfoPart(SRWHelper *pHelper, int start, int numOfBlocks, SCompInfo **ppTarget, int32_t *size);
+
 // --------- Other functions need to further organize
 void    tsdbFitRetention(STsdbRepo *pRepo);
 int     tsdbAlterCacheTotalBlocks(STsdbRepo *pRepo, int totalBlocks);
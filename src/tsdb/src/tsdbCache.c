@@ -204,4 +204,260 @@ void tsdbAdjustCacheBlocks(STsdbCache *pCache) {
   while (pCache->totalCacheBlocks < pCache->pool.numOfCacheBlocks) {
     if (tsdbRemoveCacheBlockFromPool(pCache) < 0) break;
   }
-}
\ No newline at end of file
+}
+static SMemTable *tsdbNewMemTable() {
+  SMemTable *pMem = (SMemTable *)calloc(1, sizeof(SMemTable));
+  if (pMem == NULL) return NULL;
+
+  pMem->keyFirst = INT64_MAX;
+  pMem->keyLast = 0;
+  pMem->logKeyLast = INT64_MIN;
+
+  return pMem;
+}
+
+static int tsdbAddChunkToMemTable(SMemTable *pMem, SMemRowChunk *pChunk) {
+  int nChunks = pMem->numOfLogRows >> TSDB_MEM_CHUNK_ROWS_BITS;
+
+  if (pMem->pDir == NULL || pMem->pDir->maxChunks <= nChunks) {
+    int         maxChunks = (pMem->pDir == NULL) ? 16 : pMem->pDir->maxChunks * 2;
+    SMemRowDir *pDir = (SMemRowDir *)calloc(1, sizeof(SMemRowDir) + sizeof(SMemRowChunk *) * maxChunks);
+    if (pDir == NULL) return -1;
+
+    pDir->maxChunks = maxChunks;
+    if (pMem->pDir != NULL) memcpy(pDir->chunks, pMem->pDir->chunks, sizeof(SMemRowChunk *) * nChunks);
+    // Readers may still be walking the old directory, so just retire it
+    pDir->prev = pMem->pDir;
+    __atomic_store_n(&pMem->pDir, pDir, __ATOMIC_RELEASE);
+  }
+
+  __atomic_store_n(&pMem->pDir->chunks[nChunks], pChunk, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static void tsdbUpdateMemTableInfo(SMemTable *pMem, TSKEY key) {
+  if (key > pMem->keyLast) pMem->keyLast = key;
+  if (key < pMem->keyFirst) pMem->keyFirst = key;
+  pMem->numOfPoints = pMem->numOfLogRows + (int32_t)tSkipListGetSize(pMem->pData);
+}
+
+// Return the first position whose key >= key for ascending order, or the last position whose key <= key
+// for descending order in the row log
+static int32_t tsdbSearchMemLog(SMemTable *pMem, int32_t numOfRows, TSKEY key, int32_t order) {
+  int32_t lo = 0, hi = numOfRows;  // the first position whose key > key (or >= key) is in [lo, hi]
+
+  while (lo < hi) {
+    int32_t mid = lo + ((hi - lo) >> 1);
+    TSKEY   midKey = dataRowKey(TSDB_MEM_LOG_ROW_AT(pMem, mid));
+    if (midKey < key || (order == TSDB_ORDER_DESC && midKey == key)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return (order == TSDB_ORDER_ASC) ? lo : (lo - 1);
+}
+
+static int tsdbAppendRowToMemLog(STsdbCache *pCache, SMemTable **ppMem, SDataRow row) {
+  TSKEY      key = dataRowKey(row);
+  SMemTable *pMem = *ppMem;
+  bool       newChunk = (pMem == NULL || (pMem->numOfLogRows & (TSDB_MEM_CHUNK_ROWS - 1)) == 0);
+  int        chunkSize = newChunk ? sizeof(SMemRowChunk) : 0;
+
+  // Allocate the chunk and the row in one shot, the allocation may trigger a commit and move the mem table away
+  char *ptr = (char *)tsdbAllocFromCache(pCache, chunkSize + dataRowLen(row), key);
+  if (ptr == NULL) return -1;
+
+  SMemRowChunk *pChunk = newChunk ? (SMemRowChunk *)ptr : NULL;
+  SDataRow      pRow = (SDataRow)(ptr + chunkSize);
+  dataRowCpy(pRow, row);
+
+  if (*ppMem != pMem || pMem == NULL) {
+    if (*ppMem == NULL && (*ppMem = tsdbNewMemTable()) == NULL) return -1;
+    pMem = *ppMem;
+  }
+
+  if ((pMem->numOfLogRows & (TSDB_MEM_CHUNK_ROWS - 1)) == 0) {
+    if (pChunk == NULL) {
+      // mem table was switched during allocation, a second allocation will not trigger commit again
+      pChunk = (SMemRowChunk *)tsdbAllocFromCache(pCache, sizeof(SMemRowChunk), key);
+      if (pChunk == NULL) return -1;
+    }
+    if (tsdbAddChunkToMemTable(pMem, pChunk) < 0) return -1;
+  }
+
+  TSDB_MEM_LOG_ROW_AT(pMem, pMem->numOfLogRows) = pRow;
+  __atomic_store_n(&pMem->numOfLogRows, pMem->numOfLogRows + 1, __ATOMIC_RELEASE);
+  pMem->logKeyLast = key;
+
+  tsdbUpdateMemTableInfo(pMem, key);
+  return 0;
+}
+
+static int tsdbPutRowToMemSkipList(STsdbCache *pCache, SMemTable **ppMem, SDataRow row) {
+  int32_t    level = 0;
+  int32_t    headSize = 0;
+  TSKEY      key = dataRowKey(row);
+  SMemTable *pMem = *ppMem;
+
+  if (pMem->pData == NULL) {
+    pMem->pData = tSkipListCreate(5, TSDB_DATA_TYPE_TIMESTAMP, TYPE_BYTES[TSDB_DATA_TYPE_TIMESTAMP], 0, 0, 0,
+                                  getTSTupleKey);
+    if (pMem->pData == NULL) return -1;
+  }
+
+  tSkipListNewNodeInfo(pMem->pData, &level, &headSize);
+
+  SSkipListNode *pNode = tsdbAllocFromCache(pCache, headSize + dataRowLen(row), key);
+  if (pNode == NULL) return -1;
+
+  pNode->level = level;
+  dataRowCpy(SL_GET_NODE_DATA(pNode), row);
+
+  if (*ppMem != pMem) {  // mem table is moved to imem during the allocation
+    if (*ppMem == NULL && (*ppMem = tsdbNewMemTable()) == NULL) return -1;
+    pMem = *ppMem;
+    if (pMem->pData == NULL) {
+      pMem->pData = tSkipListCreate(5, TSDB_DATA_TYPE_TIMESTAMP, TYPE_BYTES[TSDB_DATA_TYPE_TIMESTAMP], 0, 0, 0,
+                                    getTSTupleKey);
+      if (pMem->pData == NULL) return -1;
+    }
+  }
+
+  tSkipListPut(pMem->pData, pNode);
+
+  tsdbUpdateMemTableInfo(pMem, key);
+  return 0;
+}
+
+/**
+ * Insert a row to the mem table *ppMem, create it if not exists. Rows in ascending key order are appended to the
+ * row log, others are put into the skiplist. Row with a key already in the mem table is discarded.
+ *
+ * @return 0 for success, -1 for failure
+ */
+int tsdbInsertRowToMem(STsdbCache *pCache, SMemTable **ppMem, SDataRow row) {
+  TSKEY      key = dataRowKey(row);
+  SMemTable *pMem = *ppMem;
+
+  if (pMem == NULL || pMem->numOfLogRows == 0 || key > pMem->logKeyLast) {
+    return tsdbAppendRowToMemLog(pCache, ppMem, row);
+  }
+
+  int32_t pos = tsdbSearchMemLog(pMem, pMem->numOfLogRows, key, TSDB_ORDER_ASC);
+  if (pos < pMem->numOfLogRows && dataRowKey(TSDB_MEM_LOG_ROW_AT(pMem, pos)) == key) return 0;
+
+  return tsdbPutRowToMemSkipList(pCache, ppMem, row);
+}
+
+void tsdbFreeMemTable(SMemTable *pMemTable) {
+  if (pMemTable == NULL) return;
+
+  SMemRowDir *pDir = pMemTable->pDir;
+  while (pDir != NULL) {
+    SMemRowDir *prev = pDir->prev;
+    free(pDir);
+    pDir = prev;
+  }
+
+  tSkipListDestroy(pMemTable->pData);
+  free(pMemTable);
+}
+
+static void tsdbMemTableIterNextSRow(SMemTableIter *pIter) {
+  if (pIter->pSIter != NULL && tSkipListIterNext(pIter->pSIter)) {
+    pIter->sRow = SL_GET_NODE_DATA(tSkipListIterGet(pIter->pSIter));
+  } else {
+    pIter->sRow = NULL;
+  }
+}
+
+/**
+ * Create an iterator merging the row log and the skiplist of a mem table. Same as the skiplist iterator, the
+ * iterator is positioned before the first row not less (or greater for descending order) than *pKey, and
+ * tsdbMemTableIterNext must be called before getting the first row.
+ */
+SMemTableIter *tsdbCreateMemTableIter(SMemTable *pMem, TSKEY *pKey, int32_t order) {
+  assert(order == TSDB_ORDER_ASC || order == TSDB_ORDER_DESC);
+  if (pMem == NULL) return NULL;
+
+  SMemTableIter *pIter = (SMemTableIter *)calloc(1, sizeof(SMemTableIter));
+  if (pIter == NULL) return NULL;
+
+  pIter->pMem = pMem;
+  pIter->order = order;
+
+  int32_t numOfRows = TSDB_MEM_LOG_ROWS(pMem);
+  if (pKey == NULL) {
+    pIter->logIdx = (order == TSDB_ORDER_ASC) ? 0 : (numOfRows - 1);
+  } else {
+    pIter->logIdx = tsdbSearchMemLog(pMem, numOfRows, *pKey, order);
+  }
+
+  if (pMem->pData != NULL) {
+    pIter->pSIter = tSkipListCreateIterFromVal(pMem->pData, (const char *)pKey, TSDB_DATA_TYPE_TIMESTAMP, order);
+    if (pIter->pSIter == NULL) {
+      free(pIter);
+      return NULL;
+    }
+    tsdbMemTableIterNextSRow(pIter);
+  }
+
+  return pIter;
+}
+
+bool tsdbMemTableIterNext(SMemTableIter *pIter) {
+  SMemTable *pMem = pIter->pMem;
+  SDataRow   lRow = NULL;
+
+  if (pIter->order == TSDB_ORDER_ASC) {
+    if (pIter->logIdx < TSDB_MEM_LOG_ROWS(pMem)) lRow = TSDB_MEM_LOG_ROW_AT(pMem, pIter->logIdx);
+  } else {
+    if (pIter->logIdx >= 0) lRow = TSDB_MEM_LOG_ROW_AT(pMem, pIter->logIdx);
+  }
+
+  if (lRow == NULL && pIter->sRow == NULL) {
+    pIter->row = NULL;
+    return false;
+  }
+
+  int32_t step = (pIter->order == TSDB_ORDER_ASC) ? 1 : -1;
+  if (pIter->sRow == NULL) {
+    pIter->row = lRow;
+    pIter->logIdx += step;
+  } else if (lRow == NULL) {
+    pIter->row = pIter->sRow;
+    tsdbMemTableIterNextSRow(pIter);
+  } else {
+    TSKEY lKey = dataRowKey(lRow);
+    TSKEY sKey = dataRowKey(pIter->sRow);
+
+    if (lKey == sKey) {  // keep the row in the log and skip the duplicated one
+      pIter->row = lRow;
+      pIter->logIdx += step;
+      tsdbMemTableIterNextSRow(pIter);
+    } else if ((lKey < sKey) == (pIter->order == TSDB_ORDER_ASC)) {
+      pIter->row = lRow;
+      pIter->logIdx += step;
+    } else {
+      pIter->row = pIter->sRow;
+      tsdbMemTableIterNextSRow(pIter);
+    }
+  }
+
+  return true;
+}
+
+SDataRow tsdbMemTableIterGet(SMemTableIter *pIter) {
+  if (pIter == NULL) return NULL;
+  return pIter->row;
+}
+
+void *tsdbDestroyMemTableIter(SMemTableIter *pIter) {
+  if (pIter == NULL) return NULL;
+
+  tSkipListDestroyIter(pIter->pSIter);
+  free(pIter);
+  return NULL;
+}
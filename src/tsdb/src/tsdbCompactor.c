@@ -0,0 +1,571 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "os.h"
+#include "tchecksum.h"
+#include "tsdbMain.h"
+#include "ttime.h"
+
+static const char *tsdbCompactFileSuffix[] = {
+    TSDB_COMPACT_HEAD_SUFFIX,  // TSDB_FILE_TYPE_HEAD
+    TSDB_COMPACT_DATA_SUFFIX,  // TSDB_FILE_TYPE_DATA
+    TSDB_COMPACT_LAST_SUFFIX   // TSDB_FILE_TYPE_LAST
+};
+
+static const char *tsdbCompactOldFileSuffix[] = {
+    TSDB_COMPACT_OLD_HEAD_SUFFIX,  // TSDB_FILE_TYPE_HEAD
+    TSDB_COMPACT_OLD_DATA_SUFFIX,  // TSDB_FILE_TYPE_DATA
+    TSDB_COMPACT_OLD_LAST_SUFFIX   // TSDB_FILE_TYPE_LAST
+};
+
+static int     tsdbScanGroupUsage(STsdbRepo *pRepo, SRWHelper *pHelper, SBlockUsage *pUsage);
+static int64_t tsdbGetGroupFileSize(SFile *pDataF, SFile *pLastF);
+static bool    tsdbShouldCompact(STsdbFileInfo *pInfo, int64_t fileSize);
+static int64_t tsdbGetBlockDiskSize(SCompInfo *pCompInfo, SCompBlock *pCompBlock);
+static int     tsdbCompactFileGroup(STsdbRepo *pRepo, SRWHelper *pRHelper, SFileGroup *pGroup, bool *aborted);
+static int     tsdbCompactTable(STsdbRepo *pRepo, SRWHelper *pRHelper, SRWHelper *pWHelper, STable *pTable,
+                                SDataCols *pDataCols, int64_t *bytesRead);
+static void    tsdbThrottleCompaction(int64_t bytes, int64_t startUs);
+static int     tsdbReplaceFileGroup(STsdbRepo *pRepo, char *dataDir, SFileGroup *pGroup, SFileGroup *pNGroup);
+static int     tsdbRollbackFileGroup(char *dataDir, int fid);
+static int     tsdbSyncFile(const char *fname);
+
+#define TSDB_SHOULD_STOP_COMPACTION(pRepo) (atomic_load_32(&(pRepo)->commit) != 0)
+
+/**
+ * Rewrite the file groups with too many sub-blocks, or too much size taken by the blocks replaced by commits and by
+ * the dropped tables. The groups of fids are checked by the counters kept by commits in the data files, all the groups
+ * are checked by counting their blocks if fids is NULL. The caller sets pRepo->compacting, which is cleared when the
+ * compaction is over.
+ *
+ * @return 0 for success, -1 for failure
+ */
+int tsdbCompactFileGroups(STsdbRepo *pRepo, int *fids, int numOfGroups) {
+  STsdbFileH *pFileH = pRepo->tsdbFileH;
+  SRWHelper   rhelper = {{0}};
+  int         code = 0;
+  bool        scan = (fids == NULL);
+
+  // The groups are only added or removed by commits, which wait for the compaction
+  if (scan) {
+    numOfGroups = 0;
+    fids = (int *)calloc(pFileH->maxFGroups, sizeof(int));
+    if (fids == NULL) {
+      code = -1;
+      goto _exit;
+    }
+    for (int i = 0; i < pFileH->numOfFGroups; i++) fids[numOfGroups++] = pFileH->fGroup[i].fileId;
+  }
+  if (tsdbInitReadHelper(&rhelper, pRepo) < 0) {
+    code = -1;
+    goto _exit;
+  }
+
+  for (int i = 0; i < numOfGroups; i++) {
+    if (TSDB_SHOULD_STOP_COMPACTION(pRepo)) break;
+
+    SFileGroup *pGroup = tsdbSearchFGroup(pFileH, fids[i]);
+    if (pGroup == NULL || tsdbSetAndOpenHelperFile(&rhelper, pGroup) < 0) continue;
+
+    STsdbFileInfo info = rhelper.files.dataF.info;
+    int64_t       fileSize = tsdbGetGroupFileSize(&rhelper.files.dataF, &rhelper.files.lastF);
+    if (fileSize < 0) continue;
+
+    if (scan) {
+      SBlockUsage usage = {0};
+      if (tsdbScanGroupUsage(pRepo, &rhelper, &usage) < 0) continue;
+      info.tombSize = MAX(fileSize - usage.size, 0);
+      info.totalBlocks = usage.numOfBlocks;
+      info.totalSubBlocks = usage.numOfSubBlocks;
+    }
+
+    if (!tsdbShouldCompact(&info, fileSize)) continue;
+
+    bool    aborted = false;
+    int64_t stime = taosGetTimestampUs();
+    if (tsdbCompactFileGroup(pRepo, &rhelper, pGroup, &aborted) < 0) {
+      tsdbError("vgId:%d, failed to compact file group %d", pRepo->config.tsdbId, pGroup->fileId);
+      code = -1;
+      continue;
+    }
+
+    tsdbLockRepo((TsdbRepoT *)pRepo);
+    if (aborted) {
+      pRepo->compactStat.numOfAborts++;
+    } else {
+      pRepo->compactStat.numOfCompactions++;
+    }
+    pRepo->compactStat.totalCompactUs += taosGetTimestampUs() - stime;
+    tsdbUnLockRepo((TsdbRepoT *)pRepo);
+  }
+
+_exit:
+  tsdbDestroyHelper(&rhelper);
+  if (scan) tfree(fids);
+  atomic_store_32(&pRepo->compacting, 0);
+  return code;
+}
+
+// Add the blocks of a table in pCompInfo to pUsage
+void tsdbGetCompInfoUsage(SCompInfo *pCompInfo, int numOfBlocks, SBlockUsage *pUsage) {
+  for (int i = 0; i < numOfBlocks; i++) {
+    SCompBlock *pCompBlock = pCompInfo->blocks + i;
+
+    pUsage->numOfBlocks++;
+    if (pCompBlock->numOfSubBlocks > 1) pUsage->numOfSubBlocks += pCompBlock->numOfSubBlocks;
+    pUsage->size += tsdbGetBlockDiskSize(pCompInfo, pCompBlock);
+  }
+}
+
+/**
+ * Get the usage of the group opened by the write helper of a commit, from the counters in its data file. The blocks
+ * of the group are counted instead if it has no counters, as it is written before they are kept, and the tables
+ * dropped are removed from the group.
+ *
+ * @return 0 for success, -1 for failure
+ */
+int tsdbInitGroupUsage(STsdbRepo *pRepo, SRWHelper *pHelper, SBlockUsage *pUsage) {
+  STsdbFileInfo *pInfo = &pHelper->files.dataF.info;
+  STsdbMeta *    pMeta = pRepo->tsdbMeta;
+
+  int64_t fileSize = tsdbGetGroupFileSize(&pHelper->files.dataF, &pHelper->files.lastF);
+  if (fileSize < 0) return -1;
+
+  // A group written before the counters are kept has blocks but no counters
+  bool counted = true;
+  if (pInfo->totalBlocks == 0) {
+    for (int tid = 1; tid < pRepo->config.maxTables; tid++) {
+      if (pHelper->pCompIdx[tid].offset > 0 && pHelper->pCompIdx[tid].numOfBlocks > 0) {
+        counted = false;
+        break;
+      }
+    }
+  }
+
+  memset((void *)pUsage, 0, sizeof(*pUsage));
+  if (counted) {
+    pUsage->numOfBlocks = pInfo->totalBlocks;
+    pUsage->numOfSubBlocks = pInfo->totalSubBlocks;
+    pUsage->size = MAX(fileSize - (int64_t)pInfo->tombSize, 0);
+    return 0;
+  }
+
+  if (tsdbScanGroupUsage(pRepo, pHelper, pUsage) < 0) return -1;
+  for (int tid = 1; tid < pRepo->config.maxTables; tid++) {
+    SCompIdx *pIdx = pHelper->pCompIdx + tid;
+    STable *  pTable = pMeta->tables[tid];
+    if (pIdx->offset > 0 && (pTable == NULL || pTable->tableId.uid != pIdx->uid)) memset((void *)pIdx, 0, sizeof(*pIdx));
+  }
+
+  return 0;
+}
+
+/**
+ * Remove a dropped table from the group opened by the write helper of a commit, with its blocks taken from pUsage.
+ *
+ * @return 0 for success, -1 for failure
+ */
+int tsdbDropTableUsage(SRWHelper *pHelper, int tid, SBlockUsage *pUsage) {
+  SCompIdx *  pIdx = pHelper->pCompIdx + tid;
+  SBlockUsage usage = {0};
+
+  if (pIdx->numOfBlocks > 0) {
+    void *ptr = trealloc((void *)pHelper->pCompInfo, pIdx->len);
+    if (ptr == NULL) return -1;
+    pHelper->pCompInfo = (SCompInfo *)ptr;
+    if (lseek(pHelper->files.headF.fd, pIdx->offset, SEEK_SET) < 0) return -1;
+    if (tread(pHelper->files.headF.fd, (void *)pHelper->pCompInfo, pIdx->len) < pIdx->len) return -1;
+    if (!taosCheckChecksumWhole((uint8_t *)pHelper->pCompInfo, pIdx->len)) return -1;
+    tsdbGetCompInfoUsage(pHelper->pCompInfo, pIdx->numOfBlocks, &usage);
+  }
+
+  pUsage->numOfBlocks -= usage.numOfBlocks;
+  pUsage->numOfSubBlocks -= usage.numOfSubBlocks;
+  pUsage->size -= usage.size;
+  memset((void *)pIdx, 0, sizeof(*pIdx));
+  return 0;
+}
+
+// Apply the change of the blocks of the table just written by the write helper of a commit to pUsage
+void tsdbUpdateTableUsage(SRWHelper *pHelper, SBlockUsage *pUsage) {
+  SCompIdx *  pIdx = pHelper->pCompIdx + pHelper->tableInfo.tid;
+  SBlockUsage usage = {0};
+
+  if (!helperHasState(pHelper, TSDB_HELPER_INFO_LOAD)) return;
+
+  if (pIdx->offset > 0) tsdbGetCompInfoUsage(pHelper->pCompInfo, pIdx->numOfBlocks, &usage);
+  pUsage->numOfBlocks += usage.numOfBlocks - pHelper->oldUsage.numOfBlocks;
+  pUsage->numOfSubBlocks += usage.numOfSubBlocks - pHelper->oldUsage.numOfSubBlocks;
+  pUsage->size += usage.size - pHelper->oldUsage.size;
+}
+
+// Keep the usage of the group written by a write helper in its data file, before the files are closed
+void tsdbSetGroupUsage(SRWHelper *pHelper, SBlockUsage *pUsage) {
+  STsdbFileInfo *pInfo = &pHelper->files.dataF.info;
+  SFile *        pLastF = (pHelper->files.nLastF.fd > 0) ? &pHelper->files.nLastF : &pHelper->files.lastF;
+
+  int64_t fileSize = tsdbGetGroupFileSize(&pHelper->files.dataF, pLastF);
+  if (fileSize < 0) fileSize = pUsage->size;
+
+  pInfo->tombSize = MAX(fileSize - pUsage->size, 0);
+  pInfo->totalBlocks = MAX(pUsage->numOfBlocks, 0);
+  pInfo->totalSubBlocks = MAX(pUsage->numOfSubBlocks, 0);
+}
+
+// Count the blocks of the tables not dropped in the group opened by the helper
+static int tsdbScanGroupUsage(STsdbRepo *pRepo, SRWHelper *pHelper, SBlockUsage *pUsage) {
+  STsdbMeta *pMeta = pRepo->tsdbMeta;
+
+  for (int tid = 1; tid < pRepo->config.maxTables; tid++) {
+    SCompIdx *pIdx = pHelper->pCompIdx + tid;
+    STable *  pTable = pMeta->tables[tid];
+    if (pIdx->offset == 0 || pIdx->numOfBlocks == 0) continue;
+
+    // The blocks of the dropped tables are unused
+    if (pTable == NULL || pTable->tableId.uid != pIdx->uid) continue;
+
+    tsdbSetHelperTable(pHelper, pTable, pRepo);
+    if (tsdbLoadCompInfo(pHelper, NULL) < 0) return -1;
+    tsdbGetCompInfoUsage(pHelper->pCompInfo, pIdx->numOfBlocks, pUsage);
+  }
+
+  return 0;
+}
+
+// The size of the data and last files of a group, without their headers
+static int64_t tsdbGetGroupFileSize(SFile *pDataF, SFile *pLastF) {
+  struct stat dataSt, lastSt;
+
+  if (fstat(pDataF->fd, &dataSt) < 0 || fstat(pLastF->fd, &lastSt) < 0) return -1;
+  return dataSt.st_size + lastSt.st_size - 2 * TSDB_FILE_HEAD_SIZE;
+}
+
+static bool tsdbShouldCompact(STsdbFileInfo *pInfo, int64_t fileSize) {
+  if (tsCompactSubBlocks > 0 && pInfo->totalSubBlocks > 0 &&
+      pInfo->totalSubBlocks * 100 >= (int64_t)tsCompactSubBlocks * pInfo->totalBlocks) {
+    return true;
+  }
+
+  if (tsCompactTombSize > 0 && pInfo->tombSize > 0 && pInfo->tombSize * 100 >= (uint64_t)tsCompactTombSize * fileSize) {
+    return true;
+  }
+
+  return false;
+}
+
+// The size a super-block takes in the files, its sub-blocks included
+static int64_t tsdbGetBlockDiskSize(SCompInfo *pCompInfo, SCompBlock *pCompBlock) {
+  if (pCompBlock->numOfSubBlocks <= 1) return pCompBlock->len;
+
+  int64_t     size = 0;
+  SCompBlock *pSubBlock = (SCompBlock *)((char *)pCompInfo + pCompBlock->offset);
+  for (int i = 0; i < pCompBlock->numOfSubBlocks; i++) size += pSubBlock[i].len;
+
+  return size;
+}
+
+/**
+ * Rewrite the group opened by pRHelper to new files by the write path of commits, with the rows of each table in
+ * blocks of maxRowsPerFileBlock rows, and the remaining rows in a last block. The new files replace the ones of the
+ * group with the lock held, which readers also take to open the files of a group, so that a reader opens either the
+ * old files or the new ones. A reader still reading the old files keeps them open after they are replaced.
+ *
+ * @return 0 for success or if the compaction is given up for a commit, -1 for failure
+ */
+static int tsdbCompactFileGroup(STsdbRepo *pRepo, SRWHelper *pRHelper, SFileGroup *pGroup, bool *aborted) {
+  STsdbMeta * pMeta = pRepo->tsdbMeta;
+  STsdbCfg *  pCfg = &pRepo->config;
+  SRWHelper   whelper = {{0}};
+  SDataCols * pDataCols = NULL;
+  SFileGroup  nGroup = {0};
+  SBlockUsage usage = {0};
+  char *      dataDir = NULL;
+  int64_t     bytesRead = 0;
+  int64_t     bytesWritten = 0;
+  int64_t     stime = taosGetTimestampUs();
+
+  char *fnameDup = strdup(pGroup->files[TSDB_FILE_TYPE_HEAD].fname);
+  if (fnameDup == NULL) return -1;
+  dataDir = dirname(fnameDup);
+
+  nGroup.fileId = pGroup->fileId;
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    // The files may be left by a crash in a compaction
+    tsdbGetFileName(dataDir, pGroup->fileId, tsdbCompactFileSuffix[type], nGroup.files[type].fname);
+    remove(nGroup.files[type].fname);
+    if (tsdbCreateFile(dataDir, pGroup->fileId, tsdbCompactFileSuffix[type], &nGroup.files[type]) < 0) goto _err;
+  }
+  nGroup.files[TSDB_FILE_TYPE_HEAD].info.version = pGroup->files[TSDB_FILE_TYPE_HEAD].info.version;
+
+  if (tsdbInitWriteHelper(&whelper, pRepo) < 0) goto _err;
+  if (tsdbSetAndOpenHelperFile(&whelper, &nGroup) < 0) goto _err;
+  if ((pDataCols = tdNewDataCols(pMeta->maxRowBytes, pMeta->maxCols, pCfg->maxRowsPerFileBlock)) == NULL) goto _err;
+
+  for (int tid = 1; tid < pCfg->maxTables; tid++) {
+    SCompIdx *pIdx = pRHelper->pCompIdx + tid;
+    STable *  pTable = pMeta->tables[tid];
+    if (pIdx->offset == 0 || pIdx->numOfBlocks == 0) continue;
+    if (pTable == NULL || pTable->tableId.uid != pIdx->uid) continue;
+
+    if (TSDB_SHOULD_STOP_COMPACTION(pRepo)) {
+      *aborted = true;
+      tsdbTrace("vgId:%d, compaction of file group %d is given up for a commit", pCfg->tsdbId, pGroup->fileId);
+      tsdbCloseHelperFile(&whelper, true);
+      goto _clear;
+    }
+
+    if (tsdbCompactTable(pRepo, pRHelper, &whelper, pTable, pDataCols, &bytesRead) < 0) goto _err;
+    tsdbUpdateTableUsage(&whelper, &usage);
+
+    SFile *pLastF = (whelper.files.nLastF.fd > 0) ? &whelper.files.nLastF : &whelper.files.lastF;
+    bytesWritten = lseek(whelper.files.dataF.fd, 0, SEEK_END) + lseek(pLastF->fd, 0, SEEK_END);
+    tsdbThrottleCompaction(bytesRead + bytesWritten, stime);
+  }
+
+  if (tsdbWriteCompIdx(&whelper) < 0) goto _err;
+  tsdbSetGroupUsage(&whelper, &usage);
+  tsdbCloseHelperFile(&whelper, false);
+  nGroup.files[TSDB_FILE_TYPE_HEAD] = whelper.files.headF;
+  nGroup.files[TSDB_FILE_TYPE_DATA] = whelper.files.dataF;
+  nGroup.files[TSDB_FILE_TYPE_LAST] = whelper.files.lastF;
+
+  // The data is not changed, so the rollups of the tables are copied
+  if (tsdbCommitRollup(pRepo, pGroup, &whelper.files, NULL) < 0) {
+    tsdbError("vgId:%d, failed to copy rollups of file group %d", pCfg->tsdbId, pGroup->fileId);
+  }
+
+  if (tsdbReplaceFileGroup(pRepo, dataDir, pGroup, &nGroup) < 0) goto _err;
+
+  tsdbLockRepo((TsdbRepoT *)pRepo);
+  pRepo->compactStat.bytesRead += bytesRead;
+  pRepo->compactStat.bytesWritten += bytesWritten;
+  tsdbUnLockRepo((TsdbRepoT *)pRepo);
+
+  tsdbTrace("vgId:%d, file group %d is compacted, %" PRId64 " bytes read, %" PRId64 " bytes written in %" PRId64
+            " us",
+            pCfg->tsdbId, pGroup->fileId, bytesRead, bytesWritten, taosGetTimestampUs() - stime);
+
+_clear:
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) remove(nGroup.files[type].fname);
+  tdFreeDataCols(pDataCols);
+  tsdbDestroyHelper(&whelper);
+  free(fnameDup);
+  return 0;
+
+_err:
+  tsdbCloseHelperFile(&whelper, true);
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) remove(nGroup.files[type].fname);
+  tdFreeDataCols(pDataCols);
+  tsdbDestroyHelper(&whelper);
+  free(fnameDup);
+  return -1;
+}
+
+/**
+ * Replace the files of pGroup by the ones of pNGroup. The new files and links to the old ones are synced before the
+ * marker is created, which is the commit point: a crash before it leaves the old files, a crash after it is rolled
+ * forward by tsdbRecoverCompaction when the group is opened again. A failed rename is rolled back by the links, so
+ * that a head file never indexes the data and last files of another version.
+ *
+ * @return 0 for success, -1 for failure with the old files kept
+ */
+static int tsdbReplaceFileGroup(STsdbRepo *pRepo, char *dataDir, SFileGroup *pGroup, SFileGroup *pNGroup) {
+  int  fid = pGroup->fileId;
+  char oname[TSDB_FILENAME_LEN] = "\0";
+  char mark[TSDB_FILENAME_LEN] = "\0";
+
+  tsdbGetFileName(dataDir, fid, TSDB_COMPACT_MARK_SUFFIX, mark);
+
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    if (tsdbSyncFile(pNGroup->files[type].fname) < 0) goto _err;
+
+    tsdbGetFileName(dataDir, fid, tsdbCompactOldFileSuffix[type], oname);
+    remove(oname);
+    if (link(pGroup->files[type].fname, oname) < 0) goto _err;
+  }
+
+  int fd = open(mark, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+  if (fd < 0) goto _err;
+  if (fsync(fd) < 0) {
+    close(fd);
+    goto _err;
+  }
+  close(fd);
+  if (tsdbSyncFile(dataDir) < 0) goto _err;
+
+  tsdbLockRepo((TsdbRepoT *)pRepo);
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    if (rename(pNGroup->files[type].fname, pGroup->files[type].fname) < 0) {
+      tsdbError("vgId:%d, failed to rename %s, reason:%s", pRepo->config.tsdbId, pNGroup->files[type].fname,
+                strerror(errno));
+      int code = tsdbRollbackFileGroup(dataDir, fid);
+      tsdbUnLockRepo((TsdbRepoT *)pRepo);
+      if (code < 0) {
+        tsdbError("vgId:%d, failed to roll back file group %d, it is recovered when opened again",
+                  pRepo->config.tsdbId, fid);
+      }
+      return -1;
+    }
+  }
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    pGroup->files[type].info = pNGroup->files[type].info;
+  }
+  pGroup->version = ++pRepo->tsdbFileH->version;  // the cached blocks of the old files are not hit any more
+  tsdbUnLockRepo((TsdbRepoT *)pRepo);
+
+  // The links are removed before the marker, so that the replacement is never rolled back once done
+  tsdbSyncFile(dataDir);
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    tsdbGetFileName(dataDir, fid, tsdbCompactOldFileSuffix[type], oname);
+    remove(oname);
+  }
+  remove(mark);
+  tsdbSyncFile(dataDir);
+  return 0;
+
+_err:
+  tsdbError("vgId:%d, failed to prepare the replacement of file group %d, reason:%s", pRepo->config.tsdbId, fid,
+            strerror(errno));
+  remove(mark);
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    tsdbGetFileName(dataDir, fid, tsdbCompactOldFileSuffix[type], oname);
+    remove(oname);
+  }
+  return -1;
+}
+
+// Restore the files of a group from the links to the old files. The marker is removed first, so that a crash in the
+// middle is rolled back again when the group is opened.
+static int tsdbRollbackFileGroup(char *dataDir, int fid) {
+  char fname[TSDB_FILENAME_LEN] = "\0";
+  char oname[TSDB_FILENAME_LEN] = "\0";
+  int  code = 0;
+
+  tsdbGetFileName(dataDir, fid, TSDB_COMPACT_MARK_SUFFIX, fname);
+  if (remove(fname) < 0 && errno != ENOENT) return -1;
+  if (tsdbSyncFile(dataDir) < 0) return -1;
+
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    tsdbGetFileName(dataDir, fid, tsdbFileSuffix[type], fname);
+    tsdbGetFileName(dataDir, fid, tsdbCompactOldFileSuffix[type], oname);
+    if (access(oname, F_OK) < 0) continue;
+    // Nothing is done if the file is not replaced yet, as both names link to the same file
+    if (rename(oname, fname) < 0) code = -1;
+    remove(oname);
+  }
+
+  if (tsdbSyncFile(dataDir) < 0) code = -1;
+  return code;
+}
+
+/**
+ * Finish the replacement of the files of a group by a compaction interrupted by a crash, before the group is opened.
+ * The replacement is rolled forward if the marker exists, and back otherwise.
+ *
+ * @return 0 for success, -1 for failure
+ */
+int tsdbRecoverCompaction(char *dataDir, int fid) {
+  char fname[TSDB_FILENAME_LEN] = "\0";
+  char cname[TSDB_FILENAME_LEN] = "\0";
+  char mark[TSDB_FILENAME_LEN] = "\0";
+
+  tsdbGetFileName(dataDir, fid, TSDB_COMPACT_MARK_SUFFIX, mark);
+  if (access(mark, F_OK) < 0) {
+    bool found = false;
+    for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+      tsdbGetFileName(dataDir, fid, tsdbCompactFileSuffix[type], cname);
+      if (remove(cname) == 0) found = true;
+      tsdbGetFileName(dataDir, fid, tsdbCompactOldFileSuffix[type], fname);
+      if (access(fname, F_OK) == 0) found = true;
+    }
+    return found ? tsdbRollbackFileGroup(dataDir, fid) : 0;
+  }
+
+  tsdbPrint("file group %d in %s is replaced by the files of an interrupted compaction", fid, dataDir);
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    tsdbGetFileName(dataDir, fid, tsdbFileSuffix[type], fname);
+    tsdbGetFileName(dataDir, fid, tsdbCompactFileSuffix[type], cname);
+    if (access(cname, F_OK) == 0 && rename(cname, fname) < 0) return -1;
+  }
+  if (tsdbSyncFile(dataDir) < 0) return -1;
+
+  for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
+    tsdbGetFileName(dataDir, fid, tsdbCompactOldFileSuffix[type], fname);
+    remove(fname);
+  }
+  remove(mark);
+  return tsdbSyncFile(dataDir);
+}
+
+// Flush a file or a directory to the disk
+static int tsdbSyncFile(const char *fname) {
+  int fd = open(fname, O_RDONLY);
+  if (fd < 0) return -1;
+
+  int code = fsync(fd);
+  close(fd);
+  return code;
+}
+
+// Read the blocks of a table, and write the rows to the new files in blocks of maxRowsPerFileBlock rows
+static int tsdbCompactTable(STsdbRepo *pRepo, SRWHelper *pRHelper, SRWHelper *pWHelper, STable *pTable,
+                            SDataCols *pDataCols, int64_t *bytesRead) {
+  STSchema *pSchema = tsdbGetTableSchema(pRepo->tsdbMeta, pTable);
+  SCompIdx *pIdx = pRHelper->pCompIdx + pTable->tableId.tid;
+  int       maxRows = pRepo->config.maxRowsPerFileBlock;
+
+  tsdbSetHelperTable(pRHelper, pTable, pRepo);
+  tsdbSetHelperTable(pWHelper, pTable, pRepo);
+  tdInitDataCols(pDataCols, pSchema);
+  if (tsdbLoadCompInfo(pRHelper, NULL) < 0) return -1;
+
+  for (int i = 0; i < pIdx->numOfBlocks; i++) {
+    SCompBlock *pCompBlock = pRHelper->pCompInfo->blocks + i;
+    *bytesRead += tsdbGetBlockDiskSize(pRHelper->pCompInfo, pCompBlock);
+
+    // The sub-blocks are merged by the load
+    if (tsdbLoadBlockData(pRHelper, pCompBlock, NULL) < 0) return -1;
+    SDataCols *pBlockCols = pRHelper->pDataCols[0];
+
+    while (pBlockCols->numOfPoints > 0) {
+      int rows = MIN(pBlockCols->numOfPoints, maxRows - pDataCols->numOfPoints);
+      if (tdMergeDataCols(pDataCols, pBlockCols, rows) < 0) return -1;
+      tdPopDataColsPoints(pBlockCols, rows);
+
+      if (pDataCols->numOfPoints == maxRows) {
+        if (tsdbWriteDataBlock(pWHelper, pDataCols) != maxRows) return -1;
+        tdResetDataCols(pDataCols);
+      }
+    }
+  }
+
+  // The rows fewer than minRowsPerFileBlock go to the last file
+  if (pDataCols->numOfPoints > 0) {
+    if (tsdbWriteDataBlock(pWHelper, pDataCols) != pDataCols->numOfPoints) return -1;
+    tdResetDataCols(pDataCols);
+  }
+
+  if (tsdbMoveLastBlockIfNeccessary(pWHelper) < 0) return -1;
+  return tsdbWriteCompInfo(pWHelper);
+}
+
+// Sleep to keep the bytes read and written since startUs within the I/O budget
+static void tsdbThrottleCompaction(int64_t bytes, int64_t startUs) {
+  if (tsCompactIORate <= 0) return;
+
+  int64_t expectedUs = bytes * 1000000 / ((int64_t)tsCompactIORate * 1024 * 1024);
+  int64_t elapsedUs = taosGetTimestampUs() - startUs;
+  if (expectedUs > elapsedUs) usleep(expectedUs - elapsedUs);
+}
@@ -105,8 +105,12 @@ static int tsdbInitFile(char *dataDir, int fid, const char *suffix, SFile *pFile
 static int tsdbOpenFGroup(STsdbFileH *pFileH, char *dataDir, int fid) {
   if (tsdbSearchFGroup(pFileH, fid) != NULL) return 0;
 
+  // Finish the replacement of the files by a compaction interrupted by a crash
+  if (tsdbRecoverCompaction(dataDir, fid) < 0) return -1;
+
   SFileGroup fGroup = {0};
   fGroup.fileId = fid;
+  fGroup.version = ++pFileH->version;
 
   for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
     if (tsdbInitFile(dataDir, fid, tsdbFileSuffix[type], &fGroup.files[type]) < 0) return -1;
@@ -130,6 +134,7 @@ SFileGroup *tsdbCreateFGroup(STsdbFileH *pFileH, char *dataDir, int fid, int max
   SFileGroup *pGroup = tsdbSearchFGroup(pFileH, fid);
   if (pGroup == NULL) {  // if not exists, create one
     pFGroup->fileId = fid;
+    pFGroup->version = ++pFileH->version;
     for (int type = TSDB_FILE_TYPE_HEAD; type < TSDB_FILE_TYPE_MAX; type++) {
       if (tsdbCreateFile(dataDir, fid, tsdbFileSuffix[type], &(pFGroup->files[type])) < 0)
         goto _err;
@@ -157,6 +162,9 @@ int tsdbRemoveFileGroup(STsdbFileH *pFileH, int fid) {
     remove(pGroup->files[type].fname);
   }
 
+  char fname[128] = "\0";
+  if (tsdbGetRollupFileName(pGroup, TSDB_ROLLUP_FILE_SUFFIX, fname) == 0) remove(fname);
+
   // Adjust the memory
   int filesBehind = pFileH->numOfFGroups - (((char *)pGroup - (char *)(pFileH->fGroup)) / sizeof(SFileGroup) + 1);
   if (filesBehind > 0) {
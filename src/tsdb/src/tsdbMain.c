@@ -12,7 +12,7 @@
 #define TSDB_DEFAULT_PRECISION TSDB_PRECISION_MILLI  // default precision
 #define IS_VALID_PRECISION(precision) (((precision) >= TSDB_PRECISION_MILLI) && ((precision) <= TSDB_PRECISION_NANO))
 #define TSDB_DEFAULT_COMPRESSION TWO_STAGE_COMP
-#define IS_VALID_COMPRESSION(compression) (((compression) >= NO_COMPRESSION) && ((compression) <= TWO_STAGE_COMP))
+#define IS_VALID_COMPRESSION(compression) (((compression) >= NO_COMPRESSION) && ((compression) <= CHIMP_COMP))
 #define TSDB_MIN_ID 0
 #define TSDB_MAX_ID INT_MAX
 
@@ -23,6 +23,12 @@
 
 enum { TSDB_REPO_STATE_ACTIVE, TSDB_REPO_STATE_CLOSED, TSDB_REPO_STATE_CONFIGURING };
 
+// The block index of a table committed to a file group, put to the block index cache with the new version of the group
+typedef struct {
+  uint64_t   uid;
+  SBlockIdx *pBlockIdx;
+} SCommitBlockIdx;
+
 static int32_t tsdbCheckAndSetDefaultCfg(STsdbCfg *pCfg);
 static int32_t tsdbSetRepoEnv(STsdbRepo *pRepo);
 static int32_t tsdbDestroyRepoEnv(STsdbRepo *pRepo);
@@ -31,14 +37,23 @@ static int32_t tsdbInsertDataToTable(TsdbRepoT *repo, SSubmitBlk *pBlock, TSKEY
 static int32_t tsdbRestoreCfg(STsdbRepo *pRepo, STsdbCfg *pCfg);
 static int32_t tsdbGetDataDirName(STsdbRepo *pRepo, char *fname);
 static void *  tsdbCommitData(void *arg);
-static int     tsdbCommitToFile(STsdbRepo *pRepo, int fid, SSkipListIterator **iters, SRWHelper *pHelper,
-                                SDataCols *pDataCols);
-static TSKEY   tsdbNextIterKey(SSkipListIterator *pIter);
-static int     tsdbHasDataToCommit(SSkipListIterator **iters, int nIters, TSKEY minKey, TSKEY maxKey);
+static void    tsdbWaitForCompaction(STsdbRepo *pRepo);
+static int     tsdbCommitToFile(STsdbRepo *pRepo, SFileGroup *pGroup, SRWHelper *pHelper, SDataCols *pDataCols,
+                                int64_t *numOfRows);
+static TSKEY   tsdbNextIterKey(SMemTableIter *pIter);
+static int     tsdbHasDataToCommit(STsdbMeta *pMeta, int maxTables, TSKEY minKey, TSKEY maxKey);
 static void    tsdbAlterCompression(STsdbRepo *pRepo, int8_t compression);
 static void    tsdbAlterKeep(STsdbRepo *pRepo, int32_t keep);
 static void    tsdbAlterMaxTables(STsdbRepo *pRepo, int32_t maxTables);
 static int32_t tsdbSaveConfig(STsdbRepo *pRepo);
+static STsdbDecompPool *tsdbAcquireDecompPool(int32_t vgId);
+static void    tsdbReleaseDecompPool(STsdbDecompPool *pPool);
+static int     tsdbKeepBlockIdx(STsdbRepo *pRepo, SFileGroup *pGroup, SRWHelper *pHelper, bool committed,
+                                SArray *pBlockIdxes);
+static void    tsdbPutBlockIdxes(STsdbRepo *pRepo, SFileGroup *pGroup, SArray *pBlockIdxes);
+
+static STsdbDecompPool tsdbDecompPool = {0};
+static pthread_mutex_t tsdbDecompPoolMutex = PTHREAD_MUTEX_INITIALIZER;
 
 #define TSDB_GET_TABLE_BY_ID(pRepo, sid) (((STSDBRepo *)pRepo)->pTableList)[sid]
 #define TSDB_GET_TABLE_BY_NAME(pRepo, name)
@@ -205,6 +220,10 @@ TsdbRepoT *tsdbOpenRepo(char *tsdbDir, STsdbAppH *pAppH) {
   tsdbRestoreCfg(pRepo, &(pRepo->config));
   if (pAppH) pRepo->appH = *pAppH;
 
+  if (tsdbParseRollupCfg(tsRollupIntervals, pRepo->config.precision, &pRepo->rollup) < 0) {
+    tsdbError("vgId:%d, invalid rollup intervals %s, rollups are disabled", pRepo->config.tsdbId, tsRollupIntervals);
+  }
+
   pRepo->tsdbMeta = tsdbInitMeta(tsdbDir, pRepo->config.maxTables);
   if (pRepo->tsdbMeta == NULL) {
     free(pRepo->rootDir);
@@ -240,6 +259,34 @@ TsdbRepoT *tsdbOpenRepo(char *tsdbDir, STsdbAppH *pAppH) {
     return NULL;
   }
 
+  // Queries run without the block cache if it fails to be created
+  if (tsBlockCacheSize > 0) {
+    pRepo->pBlockCache = taosLRUCacheInit((int64_t)tsBlockCacheSize * 1024 * 1024, TSDB_BLOCK_CACHE_SHARDS);
+    if (pRepo->pBlockCache == NULL) {
+      tsdbError("vgId:%d, failed to create block cache of %dMB", pRepo->config.tsdbId, tsBlockCacheSize);
+    }
+  }
+
+  // Queries load the whole SCompInfo of the tables if the block index cache fails to be created
+  if (tsBlockIdxCacheSize > 0) {
+    pRepo->pBlockIdxCache =
+        taosLRUCacheInit((int64_t)tsBlockIdxCacheSize * 1024 * 1024, TSDB_BLOCK_IDX_CACHE_SHARDS);
+    if (pRepo->pBlockIdxCache == NULL) {
+      tsdbError("vgId:%d, failed to create block index cache of %dMB", pRepo->config.tsdbId, tsBlockIdxCacheSize);
+    }
+  }
+
+  // Queries resolve the tag conditions every time if the tag condition cache fails to be created
+  if (tsTagCondCacheSize > 0) {
+    pRepo->pTagCondCache = taosLRUCacheInit((int64_t)tsTagCondCacheSize * 1024 * 1024, TSDB_TAG_COND_CACHE_SHARDS);
+    if (pRepo->pTagCondCache == NULL) {
+      tsdbError("vgId:%d, failed to create tag condition cache of %dMB", pRepo->config.tsdbId, tsTagCondCacheSize);
+    }
+  }
+
+  // The columns of blocks are decoded one by one if the pool fails to be created
+  if (tsDecompressThreads > 0) pRepo->pDecompPool = tsdbAcquireDecompPool(pRepo->config.tsdbId);
+
   pRepo->state = TSDB_REPO_STATE_ACTIVE;
 
   tsdbTrace("vgId:%d, open tsdb repository successfully!", pRepo->config.tsdbId);
@@ -284,11 +331,36 @@ int32_t tsdbCloseRepo(TsdbRepoT *repo, int toCommit) {
   pRepo->tsdbCache->curBlock = NULL;
   tsdbUnLockRepo(repo);
 
+  tsdbWaitForCompaction(pRepo);
+
   if (pRepo->appH.notifyStatus) pRepo->appH.notifyStatus(pRepo->appH.appH, TSDB_STATUS_COMMIT_START);
   if (toCommit) tsdbCommitData((void *)repo);
 
   tsdbCloseFileH(pRepo->tsdbFileH);
 
+  if (pRepo->pBlockCache != NULL) {
+    SCacheStatis statis;
+    taosLRUCacheGetStatis(pRepo->pBlockCache, &statis);
+    tsdbTrace("vgId:%d, block cache hit:%" PRId64 " miss:%" PRId64, id, statis.hitCount, statis.missCount);
+    taosLRUCacheCleanup(pRepo->pBlockCache);
+  }
+
+  if (pRepo->pBlockIdxCache != NULL) {
+    SCacheStatis statis;
+    taosLRUCacheGetStatis(pRepo->pBlockIdxCache, &statis);
+    tsdbTrace("vgId:%d, block index cache hit:%" PRId64 " miss:%" PRId64, id, statis.hitCount, statis.missCount);
+    taosLRUCacheCleanup(pRepo->pBlockIdxCache);
+  }
+
+  if (pRepo->pTagCondCache != NULL) {
+    SCacheStatis statis;
+    taosLRUCacheGetStatis(pRepo->pTagCondCache, &statis);
+    tsdbTrace("vgId:%d, tag condition cache hit:%" PRId64 " miss:%" PRId64, id, statis.hitCount, statis.missCount);
+    taosLRUCacheCleanup(pRepo->pTagCondCache);
+  }
+
+  if (pRepo->pDecompPool != NULL) tsdbReleaseDecompPool(pRepo->pDecompPool);
+
   tsdbFreeMeta(pRepo->tsdbMeta);
 
   tsdbFreeCache(pRepo->tsdbCache);
@@ -401,6 +473,41 @@ STsdbRepoInfo *tsdbGetStatus(TsdbRepoT *pRepo) {
   return NULL;
 }
 
+void tsdbGetCommitStat(TsdbRepoT *repo, STsdbCommitStat *pStat) {
+  STsdbRepo *pRepo = (STsdbRepo *)repo;
+
+  tsdbLockRepo(repo);
+  *pStat = pRepo->commitStat;
+  tsdbUnLockRepo(repo);
+}
+
+void tsdbGetCompactStat(TsdbRepoT *repo, STsdbCompactStat *pStat) {
+  STsdbRepo *pRepo = (STsdbRepo *)repo;
+
+  tsdbLockRepo(repo);
+  *pStat = pRepo->compactStat;
+  tsdbUnLockRepo(repo);
+}
+
+int32_t tsdbCompact(TsdbRepoT *repo) {
+  STsdbRepo *pRepo = (STsdbRepo *)repo;
+
+  tsdbLockRepo(repo);
+  if (pRepo->commit || pRepo->compacting) {
+    tsdbUnLockRepo(repo);
+    return -1;
+  }
+  pRepo->compacting = 1;
+  tsdbUnLockRepo(repo);
+
+  return tsdbCompactFileGroups(pRepo, NULL, 0);
+}
+
+// The compaction gives up as soon as it sees the commit flag, so the wait is short
+static void tsdbWaitForCompaction(STsdbRepo *pRepo) {
+  while (atomic_load_32(&pRepo->compacting)) usleep(1000);
+}
+
 int tsdbAlterTable(TsdbRepoT *pRepo, STableCfg *pCfg) {
   // TODO
   return 0;
@@ -712,6 +819,37 @@ static int32_t tsdbCheckAndSetDefaultCfg(STsdbCfg *pCfg) {
   return 0;
 }
 
+// The pool is created by the first repository opened, and destroyed when the last one using it is closed
+static STsdbDecompPool *tsdbAcquireDecompPool(int32_t vgId) {
+  STsdbDecompPool *pPool = &tsdbDecompPool;
+
+  pthread_mutex_lock(&tsdbDecompPoolMutex);
+  if (pPool->refCount == 0) {
+    // The tasks of up to 16 blocks decoded at the same time are queued, the threads decoding more blocks wait
+    pPool->qhandle = taosInitScheduler(tsDecompressThreads * 16, tsDecompressThreads, "tsdbDecomp");
+    if (pPool->qhandle == NULL) {
+      pthread_mutex_unlock(&tsdbDecompPoolMutex);
+      tsdbError("vgId:%d, failed to create decompression pool of %d threads", vgId, tsDecompressThreads);
+      return NULL;
+    }
+    pPool->numOfThreads = tsDecompressThreads;
+  }
+  pPool->refCount++;
+  pthread_mutex_unlock(&tsdbDecompPoolMutex);
+
+  return pPool;
+}
+
+static void tsdbReleaseDecompPool(STsdbDecompPool *pPool) {
+  pthread_mutex_lock(&tsdbDecompPoolMutex);
+  if (--pPool->refCount == 0) {
+    taosCleanUpScheduler(pPool->qhandle);
+    pPool->qhandle = NULL;
+    pPool->numOfThreads = 0;
+  }
+  pthread_mutex_unlock(&tsdbDecompPoolMutex);
+}
+
 static int32_t tsdbGetCfgFname(STsdbRepo *pRepo, char *fname) {
   if (pRepo == NULL) return -1;
   sprintf(fname, "%s/%s", pRepo->rootDir, TSDB_CFG_FILE_NAME);
@@ -815,49 +953,18 @@ static int32_t tsdbDestroyRepoEnv(STsdbRepo *pRepo) {
 // }
 
 static int32_t tdInsertRowToTable(STsdbRepo *pRepo, SDataRow row, STable *pTable) {
-  // TODO
-  int32_t level = 0;
-  int32_t headSize = 0;
+  TSKEY key = dataRowKey(row);
 
-  if (pTable->mem == NULL) {
-    pTable->mem = (SMemTable *)calloc(1, sizeof(SMemTable));
-    if (pTable->mem == NULL) return -1;
-    pTable->mem->pData = tSkipListCreate(5, TSDB_DATA_TYPE_TIMESTAMP, TYPE_BYTES[TSDB_DATA_TYPE_TIMESTAMP], 0, 0, 0, getTSTupleKey);
-    pTable->mem->keyFirst = INT64_MAX;
-    pTable->mem->keyLast = 0;
+  if (tsdbInsertRowToMem(pRepo->tsdbCache, &(pTable->mem), row) < 0) {
+    tsdbError("vgId:%d, tid:%d, uid:%" PRId64 ", table:%s failed to insert row to mem table! key:%" PRId64,
+              pRepo->config.tsdbId, pTable->tableId.tid, pTable->tableId.uid, varDataVal(pTable->name), key);
+    return -1;
   }
 
-  tSkipListNewNodeInfo(pTable->mem->pData, &level, &headSize);
-
-  TSKEY key = dataRowKey(row);
-  // printf("insert:%lld, size:%d\n", key, pTable->mem->numOfPoints);
-  
-  // Copy row into the memory
-  SSkipListNode *pNode = tsdbAllocFromCache(pRepo->tsdbCache, headSize + dataRowLen(row), key);
-  if (pNode == NULL) {
-    // TODO: deal with allocate failure
-  }
-
-  pNode->level = level;
-  dataRowCpy(SL_GET_NODE_DATA(pNode), row);
-
-  // Insert the skiplist node into the data
-  if (pTable->mem == NULL) {
-    pTable->mem = (SMemTable *)calloc(1, sizeof(SMemTable));
-    if (pTable->mem == NULL) return -1;
-    pTable->mem->pData = tSkipListCreate(5, TSDB_DATA_TYPE_TIMESTAMP, TYPE_BYTES[TSDB_DATA_TYPE_TIMESTAMP], 0, 0, 0, getTSTupleKey);
-    pTable->mem->keyFirst = INT64_MAX;
-    pTable->mem->keyLast = 0;
-  }
-  tSkipListPut(pTable->mem->pData, pNode);
-  if (key > pTable->mem->keyLast) pTable->mem->keyLast = key;
-  if (key < pTable->mem->keyFirst) pTable->mem->keyFirst = key;
   if (key > pTable->lastKey) pTable->lastKey = key;
-  
-  pTable->mem->numOfPoints = tSkipListGetSize(pTable->mem->pData);
 
   tsdbTrace("vgId:%d, tid:%d, uid:%" PRId64 ", table:%s a row is inserted to table! key:%" PRId64, pRepo->config.tsdbId,
-            pTable->tableId.tid, pTable->tableId.uid, varDataVal(pTable->name), dataRowKey(row));
+            pTable->tableId.tid, pTable->tableId.uid, varDataVal(pTable->name), key);
 
   return 0;
 }
@@ -897,7 +1004,7 @@ static int32_t tsdbInsertDataToTable(TsdbRepoT *repo, SSubmitBlk *pBlock, TSKEY
   return TSDB_CODE_SUCCESS;
 }
 
-static int tsdbReadRowsFromCache(SSkipListIterator *pIter, TSKEY maxKey, int maxRowsToRead, SDataCols *pCols) {
+static int tsdbReadRowsFromCache(SMemTableIter *pIter, TSKEY maxKey, int maxRowsToRead, SDataCols *pCols) {
   ASSERT(maxRowsToRead > 0);
   if (pIter == NULL) return 0;
 
@@ -906,101 +1013,212 @@ static int tsdbReadRowsFromCache(SSkipListIterator *pIter, TSKEY maxKey, int max
   do {
     if (numOfRows >= maxRowsToRead) break;
 
-    SSkipListNode *node = tSkipListIterGet(pIter);
-    if (node == NULL) break;
+    SDataRow row = tsdbMemTableIterGet(pIter);
+    if (row == NULL) break;
 
-    SDataRow row = SL_GET_NODE_DATA(node);
     if (dataRowKey(row) > maxKey) break;
 
     tdAppendDataRowToDataCol(row, pCols);
     numOfRows++;
-  } while (tSkipListIterNext(pIter));
+  } while (tsdbMemTableIterNext(pIter));
 
   return numOfRows;
 }
 
-static void tsdbDestroyTableIters(SSkipListIterator **iters, int maxTables) {
-  if (iters == NULL) return;
-
-  for (int tid = 1; tid < maxTables; tid++) {
-    if (iters[tid] == NULL) continue;
-    tSkipListDestroyIter(iters[tid]);
+// The jobs of a commit, each file group to commit is a job picked by the commit workers
+typedef struct {
+  STsdbRepo *  pRepo;
+  SFileGroup **groups;
+  int32_t      numOfGroups;
+  int32_t      nextGroup;  // index of the next group to commit, taken atomically
+  int32_t      code;
+  int64_t      numOfRows;
+  int64_t      numOfColsByAlgorithm[TSDB_COMP_ALGORITHMS];
+} SCommitJobs;
+
+static SMemTableIter *tsdbCreateCommitIter(STable *pTable, TSKEY minKey, TSKEY maxKey) {
+  SMemTable *pMem = pTable->imem;
+  if (pMem == NULL || pMem->keyLast < minKey || pMem->keyFirst > maxKey) return NULL;
+
+  SMemTableIter *pIter = tsdbCreateMemTableIter(pMem, &minKey, TSDB_ORDER_ASC);
+  if (pIter == NULL) return NULL;
+
+  if (!tsdbMemTableIterNext(pIter) || tsdbNextIterKey(pIter) > maxKey) {
+    tsdbDestroyMemTableIter(pIter);
+    return NULL;
   }
 
-  free(iters);
+  return pIter;
+}
+
+static void tsdbAddCommitAlgorithms(SCommitJobs *pJobs, SRWHelper *pHelper) {
+  for (int i = 0; i < TSDB_COMP_ALGORITHMS; i++) {
+    atomic_add_fetch_64(&pJobs->numOfColsByAlgorithm[i], pHelper->numOfColsByAlgorithm[i]);
+  }
 }
 
-static SSkipListIterator **tsdbCreateTableIters(STsdbMeta *pMeta, int maxTables) {
-  SSkipListIterator **iters = (SSkipListIterator **)calloc(maxTables, sizeof(SSkipListIterator *));
-  if (iters == NULL) return NULL;
+static void *tsdbCommitWorker(void *arg) {
+  SCommitJobs *pJobs = (SCommitJobs *)arg;
+  STsdbRepo *  pRepo = pJobs->pRepo;
+  STsdbMeta *  pMeta = pRepo->tsdbMeta;
+  STsdbCfg *   pCfg = &(pRepo->config);
+  SDataCols *  pDataCols = NULL;
+  SRWHelper    whelper = {{0}};
+  int64_t      numOfRows = 0;
 
-  for (int tid = 1; tid < maxTables; tid++) {
-    STable *pTable = pMeta->tables[tid];
-    if (pTable == NULL || pTable->imem == NULL) continue;
+  if (tsdbInitWriteHelper(&whelper, pRepo) < 0) goto _err;
+  if ((pDataCols = tdNewDataCols(pMeta->maxRowBytes, pMeta->maxCols, pCfg->maxRowsPerFileBlock)) == NULL) goto _err;
 
-    iters[tid] = tSkipListCreateIter(pTable->imem->pData);
-    if (iters[tid] == NULL) goto _err;
+  while (atomic_load_32(&pJobs->code) == TSDB_CODE_SUCCESS) {
+    int32_t idx = atomic_fetch_add_32(&pJobs->nextGroup, 1);
+    if (idx >= pJobs->numOfGroups) break;
 
-    if (!tSkipListIterNext(iters[tid])) goto _err;
+    if (tsdbCommitToFile(pRepo, pJobs->groups[idx], &whelper, pDataCols, &numOfRows) < 0) goto _err;
   }
 
-  return iters;
+  tsdbAddCommitAlgorithms(pJobs, &whelper);
+  atomic_add_fetch_64(&pJobs->numOfRows, numOfRows);
+  tdFreeDataCols(pDataCols);
+  tsdbDestroyHelper(&whelper);
+  return NULL;
 
-  _err:
-  tsdbDestroyTableIters(iters, maxTables);
+_err:
+  atomic_store_32(&pJobs->code, -1);
+  tsdbAddCommitAlgorithms(pJobs, &whelper);
+  atomic_add_fetch_64(&pJobs->numOfRows, numOfRows);
+  tdFreeDataCols(pDataCols);
+  tsdbDestroyHelper(&whelper);
   return NULL;
 }
 
-static void tsdbFreeMemTable(SMemTable *pMemTable) {
-  if (pMemTable) {
-    tSkipListDestroy(pMemTable->pData);
-    free(pMemTable);
+/**
+ * Create the file groups which have data to commit. All groups are created before the commit workers start,
+ * since creating a group re-sorts the group array of the file handle.
+ *
+ * @return the number of groups on success, -1 for failure
+ */
+static int tsdbCreateCommitGroups(STsdbRepo *pRepo, SFileGroup **groups, int sfid, int efid) {
+  char        dataDir[128] = {0};
+  STsdbMeta * pMeta = pRepo->tsdbMeta;
+  STsdbFileH *pFileH = pRepo->tsdbFileH;
+  STsdbCfg *  pCfg = &(pRepo->config);
+  int         numOfGroups = 0;
+
+  int *fids = (int *)calloc(efid - sfid + 1, sizeof(int));
+  if (fids == NULL) return -1;
+
+  tsdbGetDataDirName(pRepo, dataDir);
+
+  for (int fid = sfid; fid <= efid; fid++) {
+    TSKEY minKey = 0, maxKey = 0;
+    tsdbGetKeyRangeOfFileId(pCfg->daysPerFile, pCfg->precision, fid, &minKey, &maxKey);
+
+    // Check if there are data to commit to this file
+    if (!tsdbHasDataToCommit(pMeta, pCfg->maxTables, minKey, maxKey)) continue;
+
+    if (tsdbCreateFGroup(pFileH, dataDir, fid, pCfg->maxTables) == NULL) {
+      tsdbError("vgId:%d, failed to create file group %d", pCfg->tsdbId, fid);
+      free(fids);
+      return -1;
+    }
+    fids[numOfGroups++] = fid;
   }
+
+  // Positions in the group array are stable from now on
+  for (int i = 0; i < numOfGroups; i++) {
+    groups[i] = tsdbSearchFGroup(pFileH, fids[i]);
+    ASSERT(groups[i] != NULL);
+  }
+
+  free(fids);
+  return numOfGroups;
 }
 
 // Commit to file
 static void *tsdbCommitData(void *arg) {
-  STsdbRepo * pRepo = (STsdbRepo *)arg;
-  STsdbMeta * pMeta = pRepo->tsdbMeta;
-  STsdbCache *pCache = pRepo->tsdbCache;
-  STsdbCfg *  pCfg = &(pRepo->config);
-  SDataCols * pDataCols = NULL;
-  SRWHelper   whelper = {{0}};
+  STsdbRepo *  pRepo = (STsdbRepo *)arg;
+  STsdbMeta *  pMeta = pRepo->tsdbMeta;
+  STsdbCache * pCache = pRepo->tsdbCache;
+  STsdbCfg *   pCfg = &(pRepo->config);
+  SFileGroup **groups = NULL;
+  pthread_t *  threads = NULL;
+  SCommitJobs  jobs = {0};
+  int          numOfThreads = 0;
+  int *        fids = NULL;
+  int          numOfFids = 0;
   if (pCache->imem == NULL) return NULL;
 
-  tsdbPrint("vgId: %d, starting to commit....", pRepo->config.tsdbId);
-
-  // Create the iterator to read from cache
-  SSkipListIterator **iters = tsdbCreateTableIters(pMeta, pCfg->maxTables);
-  if (iters == NULL) {
-    // TODO: deal with the error
-    return NULL;
-  }
+  tsdbWaitForCompaction(pRepo);
 
-  if (tsdbInitWriteHelper(&whelper, pRepo) < 0) goto _exit;
-  if ((pDataCols = tdNewDataCols(pMeta->maxRowBytes, pMeta->maxCols, pCfg->maxRowsPerFileBlock)) == NULL) goto _exit;
+  tsdbPrint("vgId: %d, starting to commit....", pRepo->config.tsdbId);
+  int64_t stime = taosGetTimestampUs();
 
   int sfid = tsdbGetKeyFileId(pCache->imem->keyFirst, pCfg->daysPerFile, pCfg->precision);
   int efid = tsdbGetKeyFileId(pCache->imem->keyLast, pCfg->daysPerFile, pCfg->precision);
 
-  // Loop to commit to each file
-  for (int fid = sfid; fid <= efid; fid++) {
-    if (tsdbCommitToFile(pRepo, fid, iters, &whelper, pDataCols) < 0) {
-      ASSERT(false);
-      goto _exit;
+  groups = (SFileGroup **)calloc(efid - sfid + 1, sizeof(SFileGroup *));
+  if (groups == NULL) goto _exit;
+
+  jobs.pRepo = pRepo;
+  jobs.groups = groups;
+  jobs.numOfGroups = tsdbCreateCommitGroups(pRepo, groups, sfid, efid);
+  if (jobs.numOfGroups < 0) goto _exit;
+
+  // Independent file groups are committed by a pool of workers, the commit thread is one of them
+  numOfThreads = MIN(tsCommitThreads, jobs.numOfGroups);
+  if (numOfThreads > 1) {
+    threads = (pthread_t *)calloc(numOfThreads - 1, sizeof(pthread_t));
+    if (threads == NULL) numOfThreads = 1;
+  }
+
+  int numOfStarted = 0;
+  for (; numOfStarted < numOfThreads - 1; numOfStarted++) {
+    if (pthread_create(threads + numOfStarted, NULL, tsdbCommitWorker, (void *)(&jobs)) != 0) {
+      tsdbError("vgId:%d, failed to create commit worker, reason:%s", pCfg->tsdbId, strerror(errno));
+      break;
     }
   }
+  tsdbCommitWorker((void *)(&jobs));
+  for (int i = 0; i < numOfStarted; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  if (jobs.code != TSDB_CODE_SUCCESS) {
+    ASSERT(false);
+    goto _exit;
+  }
+
+  // Only the groups committed to are checked for compaction
+  fids = (int *)malloc(sizeof(int) * MAX(jobs.numOfGroups, 1));
+  if (fids != NULL) {
+    for (int i = 0; i < jobs.numOfGroups; i++) fids[numOfFids++] = groups[i]->fileId;
+  }
 
   // Do retention actions
   tsdbFitRetention(pRepo);
   if (pRepo->appH.notifyStatus) pRepo->appH.notifyStatus(pRepo->appH.appH, TSDB_STATUS_COMMIT_OVER);
 
 _exit:
-  tdFreeDataCols(pDataCols);
-  tsdbDestroyTableIters(iters, pCfg->maxTables);
-  tsdbDestroyHelper(&whelper);
+  tfree(threads);
+  tfree(groups);
+
+  int64_t elapsed = taosGetTimestampUs() - stime;
+  tsdbPrint("vgId:%d, commit over, %d file groups %" PRId64 " rows committed by %d threads in %" PRId64
+            " us, %.2f rows/s",
+            pCfg->tsdbId, MAX(jobs.numOfGroups, 0), jobs.numOfRows, numOfThreads, elapsed,
+            (elapsed > 0) ? jobs.numOfRows * 1000000.0 / elapsed : 0.0);
 
   tsdbLockRepo(arg);
+  pRepo->commitStat.numOfCommits++;
+  pRepo->commitStat.numOfFGroups += MAX(jobs.numOfGroups, 0);
+  pRepo->commitStat.numOfRows += jobs.numOfRows;
+  pRepo->commitStat.lastCommitUs = elapsed;
+  pRepo->commitStat.lastCommitRows = jobs.numOfRows;
+  pRepo->commitStat.totalCommitUs += elapsed;
+  for (int i = 0; i < TSDB_COMP_ALGORITHMS; i++) {
+    pRepo->commitStat.numOfColsByAlgorithm[i] += jobs.numOfColsByAlgorithm[i];
+  }
+
   tdListMove(pCache->imem->list, pCache->pool.memPool);
   tsdbAdjustCacheBlocks(pCache);
   tdListFree(pCache->imem->list);
@@ -1014,30 +1232,39 @@ _exit:
       pTable->imem = NULL;
     }
   }
+
+  // The flag is set with the lock, so that a closing repository waits for the compaction
+  int compact = TSDB_IS_REPO_ACTIVE(pRepo) && numOfFids > 0 && (tsCompactSubBlocks > 0 || tsCompactTombSize > 0);
+  if (compact) pRepo->compacting = 1;
   tsdbUnLockRepo(arg);
 
+  if (compact) tsdbCompactFileGroups(pRepo, fids, numOfFids);
+  tfree(fids);
+
   return NULL;
 }
 
-static int tsdbCommitToFile(STsdbRepo *pRepo, int fid, SSkipListIterator **iters, SRWHelper *pHelper, SDataCols *pDataCols) {
-  char dataDir[128] = {0};
-  STsdbMeta * pMeta = pRepo->tsdbMeta;
-  STsdbFileH *pFileH = pRepo->tsdbFileH;
-  STsdbCfg *  pCfg = &pRepo->config;
-  SFileGroup *pGroup = NULL;
+static int tsdbCommitToFile(STsdbRepo *pRepo, SFileGroup *pGroup, SRWHelper *pHelper, SDataCols *pDataCols,
+                            int64_t *numOfRows) {
+  STsdbMeta *    pMeta = pRepo->tsdbMeta;
+  STsdbCfg *     pCfg = &pRepo->config;
+  SMemTableIter *pIter = NULL;
+  SArray *       pRanges = NULL;
+  SArray *       pBlockIdxes = NULL;
+  SBlockUsage    usage = {0};
 
   TSKEY minKey = 0, maxKey = 0;
-  tsdbGetKeyRangeOfFileId(pCfg->daysPerFile, pCfg->precision, fid, &minKey, &maxKey);
+  tsdbGetKeyRangeOfFileId(pCfg->daysPerFile, pCfg->precision, pGroup->fileId, &minKey, &maxKey);
 
-  // Check if there are data to commit to this file
-  int hasDataToCommit = tsdbHasDataToCommit(iters, pCfg->maxTables, minKey, maxKey);
-  if (!hasDataToCommit) return 0;  // No data to commit, just return
+  // The committed key ranges tell which buckets of the rollups to compute again
+  if (pRepo->rollup.numOfLevels > 0) {
+    pRanges = taosArrayInit(16, sizeof(SRollupRange));
+    if (pRanges == NULL) goto _err;
+  }
 
-  // Create and open files for commit
-  tsdbGetDataDirName(pRepo, dataDir);
-  if ((pGroup = tsdbCreateFGroup(pFileH, dataDir, fid, pCfg->maxTables)) == NULL) {
-    tsdbError("vgId:%d, failed to create file group %d", pRepo->config.tsdbId, fid);
-    goto _err;
+  if (pRepo->pBlockIdxCache != NULL) {
+    pBlockIdxes = taosArrayInit(16, sizeof(SCommitBlockIdx));
+    if (pBlockIdxes == NULL) goto _err;
   }
 
   // Open files for write/read
@@ -1046,12 +1273,28 @@ static int tsdbCommitToFile(STsdbRepo *pRepo, int fid, SSkipListIterator **iters
     goto _err;
   }
 
+  // The blocks of the group are counted as they are changed, for the compaction to check without reading them
+  if (tsdbInitGroupUsage(pRepo, pHelper, &usage) < 0) {
+    tsdbError("vgId:%d, failed to get the usage of file group %d", pRepo->config.tsdbId, pGroup->fileId);
+    goto _err;
+  }
+
   // Loop to commit data in each table
   for (int tid = 1; tid < pCfg->maxTables; tid++) {
     STable *           pTable = pMeta->tables[tid];
+    SCompIdx *         pIdx = pHelper->pCompIdx + tid;
+
+    // The blocks of a dropped table are unused from now on
+    if (pIdx->offset > 0 && (pTable == NULL || pTable->tableId.uid != pIdx->uid)) {
+      if (tsdbDropTableUsage(pHelper, tid, &usage) < 0) {
+        tsdbError("vgId:%d, failed to remove dropped table %d", pRepo->config.tsdbId, tid);
+        goto _err;
+      }
+    }
     if (pTable == NULL) continue;
 
-    SSkipListIterator *pIter = iters[tid];
+    // Each file group is committed with its own iterators, so groups do not depend on each other
+    pIter = tsdbCreateCommitIter(pTable, minKey, maxKey);
 
     // Set the helper and the buffer dataCols object to help to write this table
     tsdbSetHelperTable(pHelper, pTable, pRepo);
@@ -1069,6 +1312,14 @@ static int tsdbCommitToFile(STsdbRepo *pRepo, int fid, SSkipListIterator **iters
       ASSERT(dataColsKeyFirst(pDataCols) >= minKey && dataColsKeyFirst(pDataCols) <= maxKey);
       ASSERT(dataColsKeyLast(pDataCols) >= minKey && dataColsKeyLast(pDataCols) <= maxKey);
 
+      if (pRanges != NULL) {
+        if (nLoop == 1) {
+          SRollupRange range = {.tid = tid, .keyFirst = dataColsKeyFirst(pDataCols)};
+          taosArrayPush(pRanges, &range);
+        }
+        ((SRollupRange *)taosArrayGet(pRanges, taosArrayGetSize(pRanges) - 1))->keyLast = dataColsKeyLast(pDataCols);
+      }
+
       int rowsWritten = tsdbWriteDataBlock(pHelper, pDataCols);
       ASSERT(rowsWritten != 0);
       if (rowsWritten < 0) goto _err;
@@ -1076,9 +1327,11 @@ static int tsdbCommitToFile(STsdbRepo *pRepo, int fid, SSkipListIterator **iters
 
       tdPopDataColsPoints(pDataCols, rowsWritten);
       maxRowsToRead = pCfg->maxRowsPerFileBlock * 4 / 5 - pDataCols->numOfPoints;
+      *numOfRows += rowsWritten;
     }
 
     ASSERT(pDataCols->numOfPoints == 0);
+    if (pIter) pIter = tsdbDestroyMemTableIter(pIter);
 
     // Move the last block to the new .l file if neccessary
     if (tsdbMoveLastBlockIfNeccessary(pHelper) < 0) {
@@ -1091,6 +1344,9 @@ static int tsdbCommitToFile(STsdbRepo *pRepo, int fid, SSkipListIterator **iters
       tsdbError("vgId:%d, failed to write compInfo part", pRepo->config.tsdbId);
       goto _err;
     }
+    tsdbUpdateTableUsage(pHelper, &usage);
+
+    if (pBlockIdxes != NULL && tsdbKeepBlockIdx(pRepo, pGroup, pHelper, nLoop > 0, pBlockIdxes) < 0) goto _err;
   }
 
   if (tsdbWriteCompIdx(pHelper) < 0) {
@@ -1098,42 +1354,113 @@ static int tsdbCommitToFile(STsdbRepo *pRepo, int fid, SSkipListIterator **iters
     goto _err;
   }
 
+  tsdbSetGroupUsage(pHelper, &usage);
   tsdbCloseHelperFile(pHelper, 0);
-  // TODO: make it atomic with some methods
+
+  // The rollups are only an acceleration of queries, which fall back to the data blocks without them
+  if (tsdbCommitRollup(pRepo, pGroup, &pHelper->files, pRanges) < 0) {
+    tsdbError("vgId:%d, failed to commit rollups of file group %d", pRepo->config.tsdbId, pGroup->fileId);
+  }
+  taosArrayDestroy(pRanges);
+
+  // Switch the three files of the group together, other groups may be committing concurrently
+  tsdbLockRepo((TsdbRepoT *)pRepo);
   pGroup->files[TSDB_FILE_TYPE_HEAD] = pHelper->files.headF;
   pGroup->files[TSDB_FILE_TYPE_DATA] = pHelper->files.dataF;
   pGroup->files[TSDB_FILE_TYPE_LAST] = pHelper->files.lastF;
+  pGroup->version = ++pRepo->tsdbFileH->version;  // the cached blocks of the old files are not hit any more
+  tsdbUnLockRepo((TsdbRepoT *)pRepo);
+
+  if (pBlockIdxes != NULL) tsdbPutBlockIdxes(pRepo, pGroup, pBlockIdxes);
 
   return 0;
 
   _err:
   ASSERT(false);
+  if (pIter) tsdbDestroyMemTableIter(pIter);
+  taosArrayDestroy(pRanges);
+  if (pBlockIdxes != NULL) {
+    for (int i = 0; i < taosArrayGetSize(pBlockIdxes); i++) {
+      free(((SCommitBlockIdx *)taosArrayGet(pBlockIdxes, i))->pBlockIdx);
+    }
+    taosArrayDestroy(pBlockIdxes);
+  }
   tsdbCloseHelperFile(pHelper, 1);
   return -1;
 }
 
+/**
+ * Keep the block index of the table just written by pHelper, to be put to the cache when the files of the group are
+ * switched. The index of a table with rows committed is built from its SCompInfo in the helper, the index of other
+ * tables is the one of the old files if it is cached, as their SCompInfo is copied as it is.
+ */
+static int tsdbKeepBlockIdx(STsdbRepo *pRepo, SFileGroup *pGroup, SRWHelper *pHelper, bool committed,
+                            SArray *pBlockIdxes) {
+  SCompIdx *pIdx = pHelper->pCompIdx + pHelper->tableInfo.tid;
+  if (pIdx->offset == 0 || pIdx->numOfBlocks < TSDB_BLOCK_IDX_MIN_BLOCKS) return 0;
+
+  size_t          size = TSDB_BLOCK_IDX_SIZE(pIdx->numOfBlocks);
+  SCommitBlockIdx idx = {.uid = pIdx->uid, .pBlockIdx = (SBlockIdx *)malloc(size)};
+  if (idx.pBlockIdx == NULL) return -1;
+
+  if (committed) {
+    ASSERT(helperHasState(pHelper, TSDB_HELPER_INFO_LOAD));
+    tsdbBuildBlockIdx(pHelper->pCompInfo, pIdx->numOfBlocks, idx.pBlockIdx);
+  } else {
+    SBlockIdxKey key = {.fid = pGroup->fileId, .version = pGroup->version, .uid = pIdx->uid};
+    if (taosLRUCacheGet(pRepo->pBlockIdxCache, &key, sizeof(key), idx.pBlockIdx, size) != size) {
+      free(idx.pBlockIdx);
+      return 0;
+    }
+  }
+
+  taosArrayPush(pBlockIdxes, &idx);
+  return 0;
+}
+
+static void tsdbPutBlockIdxes(STsdbRepo *pRepo, SFileGroup *pGroup, SArray *pBlockIdxes) {
+  for (int i = 0; i < taosArrayGetSize(pBlockIdxes); i++) {
+    SCommitBlockIdx *pIdx = (SCommitBlockIdx *)taosArrayGet(pBlockIdxes, i);
+    SBlockIdxKey     key = {.fid = pGroup->fileId, .version = pGroup->version, .uid = pIdx->uid};
+
+    taosLRUCachePut(pRepo->pBlockIdxCache, &key, sizeof(key), pIdx->pBlockIdx,
+                    TSDB_BLOCK_IDX_SIZE(pIdx->pBlockIdx->numOfBlocks));
+    free(pIdx->pBlockIdx);
+  }
+
+  taosArrayDestroy(pBlockIdxes);
+}
+
 /**
  * Return the next iterator key.
  *
  * @return the next key if iter has
  *         -1 if iter not
  */
-static TSKEY tsdbNextIterKey(SSkipListIterator *pIter) {
+static TSKEY tsdbNextIterKey(SMemTableIter *pIter) {
   if (pIter == NULL) return -1;
 
-  SSkipListNode *node = tSkipListIterGet(pIter);
-  if (node == NULL) return -1;
+  SDataRow row = tsdbMemTableIterGet(pIter);
+  if (row == NULL) return -1;
 
-  SDataRow row = SL_GET_NODE_DATA(node);
   return dataRowKey(row);
 }
 
-static int tsdbHasDataToCommit(SSkipListIterator **iters, int nIters, TSKEY minKey, TSKEY maxKey) {
-  TSKEY nextKey;
-  for (int i = 0; i < nIters; i++) {
-    SSkipListIterator *pIter = iters[i];
-    nextKey = tsdbNextIterKey(pIter);
-    if (nextKey > 0 && (nextKey >= minKey && nextKey <= maxKey)) return 1;
+static int tsdbHasDataToCommit(STsdbMeta *pMeta, int maxTables, TSKEY minKey, TSKEY maxKey) {
+  for (int tid = 1; tid < maxTables; tid++) {
+    STable *pTable = pMeta->tables[tid];
+    if (pTable == NULL) continue;
+
+    SMemTable *pMem = pTable->imem;
+    if (pMem == NULL || pMem->keyLast < minKey || pMem->keyFirst > maxKey) continue;
+    if (pMem->keyFirst >= minKey || pMem->keyLast <= maxKey) return 1;
+
+    // the key range covers the file group, but the rows may skip over it
+    SMemTableIter *pIter = tsdbCreateCommitIter(pTable, minKey, maxKey);
+    if (pIter != NULL) {
+      tsdbDestroyMemTableIter(pIter);
+      return 1;
+    }
   }
   return 0;
 }
@@ -17,6 +17,10 @@ static int     tsdbAddTableIntoIndex(STsdbMeta *pMeta, STable *pTable);
 static int     tsdbRemoveTableFromIndex(STsdbMeta *pMeta, STable *pTable);
 static int     tsdbEstimateTableEncodeSize(STable *pTable);
 static int     tsdbRemoveTableFromMeta(STsdbMeta *pMeta, STable *pTable, bool rmFromIdx);
+static void *  tsdbNewTagIndex(STSchema *pTagSchema);
+static void    tsdbFreeTagIndex(void *pTagIndex);
+static int     tsdbAddTableIntoTagIndex(STable *pSTable, STable *pTable);
+static void    tsdbRemoveTableFromTagIndex(STable *pSTable, STable *pTable);
 
 /**
  * Encode a TSDB table object as a binary content
@@ -128,6 +132,7 @@ int tsdbRestoreTable(void *pHandle, void *cont, int contLen) {
     STColumn* pColSchema = schemaColAt(pTable->tagSchema, 0);
     pTable->pIndex = tSkipListCreate(TSDB_SUPER_TABLE_SL_LEVEL, pColSchema->type, pColSchema->bytes,
                                     1, 0, 1, getTagIndexKey);
+    if (tsTagHashIndex) pTable->pTagIndex = tsdbNewTagIndex(pTable->tagSchema);
   }
 
   tsdbAddTableToMeta(pMeta, pTable, false);
@@ -160,6 +165,7 @@ STsdbMeta *tsdbInitMeta(char *rootDir, int32_t maxTables) {
   pMeta->tables = (STable **)calloc(maxTables, sizeof(STable *));
   pMeta->maxRowBytes = 0;
   pMeta->maxCols = 0;
+  pMeta->tversion = 0;
   if (pMeta->tables == NULL) {
     free(pMeta);
     return NULL;
@@ -332,6 +338,9 @@ int tsdbCreateTable(TsdbRepoT *repo, STableCfg *pCfg) {
         free(super);
         return -1;
       }
+
+      // index all the tags by hash, a NULL index only makes the tag filters scan the child tables
+      if (tsTagHashIndex) super->pTagIndex = tsdbNewTagIndex(super->tagSchema);
     } else {
       if (super->type != TSDB_SUPER_TABLE) return -1;
     }
@@ -429,14 +438,6 @@ int tsdbDropTable(TsdbRepoT *repo, STableId tableId) {
 //   return 0;
 // }
 
-static void tsdbFreeMemTable(SMemTable *pMemTable) {
-  if (pMemTable) {
-    tSkipListDestroy(pMemTable->pData);
-  }
-
-  free(pMemTable);
-}
-
 static int tsdbFreeTable(STable *pTable) {
   // TODO: finish this function
   if (pTable->type == TSDB_CHILD_TABLE) {
@@ -449,6 +450,7 @@ static int tsdbFreeTable(STable *pTable) {
   if (TSDB_TABLE_IS_SUPER_TABLE(pTable)) {
     tdFreeSchema(pTable->tagSchema);
     tSkipListDestroy(pTable->pIndex);
+    tsdbFreeTagIndex(pTable->pTagIndex);
   }
 
   tsdbFreeMemTable(pTable->mem);
@@ -474,6 +476,8 @@ STable *tsdbGetTableByUid(STsdbMeta *pMeta, uint64_t uid) {
 
 static int tsdbAddTableToMeta(STsdbMeta *pMeta, STable *pTable, bool addIdx) {
   if (pTable->type == TSDB_SUPER_TABLE) { 
+    pTable->tversion = atomic_add_fetch_32(&pMeta->tversion, 1);
+
     // add super table to the linked list
     if (pMeta->superList == NULL) {
       pMeta->superList = pTable;
@@ -567,6 +571,16 @@ static int tsdbAddTableIntoIndex(STsdbMeta *pMeta, STable *pTable) {
   elem->pMeta = pMeta;
   
   tSkipListPut(list, pNode);
+
+  if (pSTable->pTagIndex != NULL && tsdbAddTableIntoTagIndex(pSTable, pTable) < 0) {
+    tsdbError("failed to add table %s into the tag index of super table %s, drop the tag index",
+              varDataVal(pTable->name), varDataVal(pSTable->name));
+    tsdbFreeTagIndex(pSTable->pTagIndex);
+    pSTable->pTagIndex = NULL;
+  }
+
+  // changed after the indexes, so that a query never caches the tables of an index being changed with a new version
+  atomic_store_32(&pSTable->tversion, atomic_add_fetch_32(&pMeta->tversion, 1));
   return 0;
 }
 
@@ -595,9 +609,149 @@ static int tsdbRemoveTableFromIndex(STsdbMeta *pMeta, STable *pTable) {
   }
   
   taosArrayDestroy(res);
+
+  if (pSTable->pTagIndex != NULL) tsdbRemoveTableFromTagIndex(pSTable, pTable);
+  atomic_store_32(&pSTable->tversion, atomic_add_fetch_32(&pMeta->tversion, 1));
+  return 0;
+}
+
+static void tsdbFreeTagPostings(void *data) { taosArrayDestroy(*(SArray **)data); }
+
+static void *tsdbNewTagIndex(STSchema *pTagSchema) {
+  int32_t    numOfTags = schemaNCols(pTagSchema);
+  STagIndex *pTagIndex = (STagIndex *)calloc(1, sizeof(STagIndex) + sizeof(void *) * numOfTags);
+  if (pTagIndex == NULL) return NULL;
+
+  pTagIndex->numOfTags = numOfTags;
+  for (int32_t i = 0; i < numOfTags; i++) {
+    STColumn *pCol = schemaColAt(pTagSchema, i);
+    // float and double values are compared with a tolerance, equal values may differ in bytes
+    if (pCol->type == TSDB_DATA_TYPE_FLOAT || pCol->type == TSDB_DATA_TYPE_DOUBLE) continue;
+
+    pTagIndex->index[i] =
+        taosHashInit(TSDB_TAG_INDEX_HASH_SIZE, taosGetDefaultHashFunction(TSDB_DATA_TYPE_BINARY), false);
+    if (pTagIndex->index[i] == NULL) {
+      tsdbFreeTagIndex(pTagIndex);
+      return NULL;
+    }
+    taosHashSetFreecb(pTagIndex->index[i], tsdbFreeTagPostings);
+  }
+
+  return pTagIndex;
+}
+
+static void tsdbFreeTagIndex(void *pTagIndex) {
+  STagIndex *pIndex = (STagIndex *)pTagIndex;
+  if (pIndex == NULL) return;
+
+  for (int32_t i = 0; i < pIndex->numOfTags; i++) {
+    if (pIndex->index[i] != NULL) taosHashCleanup(pIndex->index[i]);
+  }
+  free(pIndex);
+}
+
+static int tsdbTagValueLen(int8_t type, int16_t bytes, const char *val) {
+  if (type == TSDB_DATA_TYPE_BINARY || type == TSDB_DATA_TYPE_NCHAR) return (int)varDataTLen(val);
+  return bytes;
+}
+
+// position of tid in the sorted tids, or where to insert it if not found
+static int tsdbSearchTid(SArray *pTids, int32_t tid) {
+  int lo = 0, hi = (int)taosArrayGetSize(pTids);
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (*(int32_t *)taosArrayGet(pTids, mid) < tid) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static int tsdbAddTableIntoTagIndex(STable *pSTable, STable *pTable) {
+  STagIndex *pTagIndex = (STagIndex *)pSTable->pTagIndex;
+  int32_t    tid = pTable->tableId.tid;
+
+  for (int32_t i = 0; i < pTagIndex->numOfTags; i++) {
+    if (pTagIndex->index[i] == NULL) continue;
+
+    STColumn *pCol = schemaColAt(pSTable->tagSchema, i);
+    char *    val = tdGetRowDataOfCol(pTable->tagVal, pCol->type, TD_DATA_ROW_HEAD_SIZE + pCol->offset);
+    int       len = tsdbTagValueLen(pCol->type, pCol->bytes, val);
+
+    SArray **ppTids = (SArray **)taosHashGet(pTagIndex->index[i], val, len);
+    if (ppTids == NULL) {
+      SArray *pTids = taosArrayInit(1, sizeof(int32_t));
+      if (pTids == NULL) return -1;
+      taosArrayPush(pTids, &tid);
+      if (taosHashPut(pTagIndex->index[i], val, len, &pTids, sizeof(pTids)) < 0) {
+        taosArrayDestroy(pTids);
+        return -1;
+      }
+      continue;
+    }
+
+    // tids are mostly allocated in ascending order, so appending is the common case
+    SArray *pTids = *ppTids;
+    size_t  size = taosArrayGetSize(pTids);
+    if (size == 0 || *(int32_t *)taosArrayGet(pTids, size - 1) < tid) {
+      if (taosArrayPush(pTids, &tid) == NULL) return -1;
+    } else {
+      int pos = tsdbSearchTid(pTids, tid);
+      if (*(int32_t *)taosArrayGet(pTids, pos) == tid) continue;
+      if (taosArrayInsert(pTids, pos, &tid) == NULL) return -1;
+    }
+  }
+
   return 0;
 }
 
+static void tsdbRemoveTableFromTagIndex(STable *pSTable, STable *pTable) {
+  STagIndex *pTagIndex = (STagIndex *)pSTable->pTagIndex;
+  int32_t    tid = pTable->tableId.tid;
+
+  for (int32_t i = 0; i < pTagIndex->numOfTags; i++) {
+    if (pTagIndex->index[i] == NULL) continue;
+
+    STColumn *pCol = schemaColAt(pSTable->tagSchema, i);
+    char *    val = tdGetRowDataOfCol(pTable->tagVal, pCol->type, TD_DATA_ROW_HEAD_SIZE + pCol->offset);
+    int       len = tsdbTagValueLen(pCol->type, pCol->bytes, val);
+
+    SArray **ppTids = (SArray **)taosHashGet(pTagIndex->index[i], val, len);
+    if (ppTids == NULL) continue;
+
+    SArray *pTids = *ppTids;
+    int     pos = tsdbSearchTid(pTids, tid);
+    if (pos < taosArrayGetSize(pTids) && *(int32_t *)taosArrayGet(pTids, pos) == tid) taosArrayRemove(pTids, pos);
+
+    if (taosArrayGetSize(pTids) == 0) {
+      taosArrayDestroy(pTids);
+      taosHashRemove(pTagIndex->index[i], val, len);
+    }
+  }
+}
+
+bool tsdbIsTagIndexed(STable *pSTable, int32_t colIndex) {
+  STagIndex *pTagIndex = (STagIndex *)pSTable->pTagIndex;
+  if (pTagIndex == NULL || colIndex < 0 || colIndex >= pTagIndex->numOfTags) return false;
+
+  return pTagIndex->index[colIndex] != NULL;
+}
+
+/**
+ * Get the sorted tids of the child tables whose tag of colIndex equals to val, NULL if there is no such table.
+ * ASSUMPTIONS: the tag of colIndex is indexed
+ */
+SArray *tsdbGetTablesOfTagValue(STable *pSTable, int32_t colIndex, const char *val) {
+  STagIndex *pTagIndex = (STagIndex *)pSTable->pTagIndex;
+  STColumn * pCol = schemaColAt(pSTable->tagSchema, colIndex);
+
+  SArray **ppTids =
+      (SArray **)taosHashGet(pTagIndex->index[colIndex], val, tsdbTagValueLen(pCol->type, pCol->bytes, val));
+  return (ppTids == NULL) ? NULL : *ppTids;
+}
+
 static int tsdbEstimateTableEncodeSize(STable *pTable) {
   int size = 0;
   size += T_MEMBER_SIZE(STable, type);
@@ -64,6 +64,7 @@ static void tsdbDestroyHelperFile(SRWHelper *pHelper) {
 // ---------- Operations on Helper Table part
 static void tsdbResetHelperTableImpl(SRWHelper *pHelper) {
   memset((void *)&pHelper->tableInfo, 0, sizeof(SHelperTable));
+  memset((void *)&pHelper->oldUsage, 0, sizeof(SBlockUsage));
   pHelper->hasOldLastBlock = false;
 }
 
@@ -121,6 +122,8 @@ static int tsdbInitHelper(SRWHelper *pHelper, STsdbRepo *pRepo, tsdb_rw_helper_t
   pHelper->config.maxRowsPerFileBlock = pRepo->config.maxRowsPerFileBlock;
   pHelper->config.compress = pRepo->config.compression;
 
+  pHelper->pDecompPool = pRepo->pDecompPool;
+
   pHelper->state = TSDB_HELPER_CLEAR_STATE;
 
   // Init file part
@@ -157,6 +160,7 @@ void tsdbDestroyHelper(SRWHelper *pHelper) {
   if (pHelper) {
     tzfree(pHelper->pBuffer);
     tzfree(pHelper->compBuffer);
+    for (int i = 0; i < TSDB_MAX_DECOMPRESS_THREADS; i++) tzfree(pHelper->decompBuffers[i]);
     tsdbDestroyHelperFile(pHelper);
     tsdbDestroyHelperTable(pHelper);
     tsdbDestroyHelperBlock(pHelper);
@@ -191,6 +195,7 @@ int tsdbSetAndOpenHelperFile(SRWHelper *pHelper, SFileGroup *pGroup) {
 
   // Set the files
   pHelper->files.fid = pGroup->fileId;
+  pHelper->files.version = pGroup->version;
   pHelper->files.headF = pGroup->files[TSDB_FILE_TYPE_HEAD];
   pHelper->files.dataF = pGroup->files[TSDB_FILE_TYPE_DATA];
   pHelper->files.lastF = pGroup->files[TSDB_FILE_TYPE_LAST];
@@ -212,6 +217,7 @@ int tsdbSetAndOpenHelperFile(SRWHelper *pHelper, SFileGroup *pGroup) {
 
     // Create and open .h
     if (tsdbOpenFile(&(pHelper->files.nHeadF), O_WRONLY | O_CREAT) < 0) return -1;
+    pHelper->files.nHeadF.info.version = pHelper->files.headF.info.version + 1;
     // size_t tsize = TSDB_FILE_HEAD_SIZE + sizeof(SCompIdx) * pHelper->config.maxTables + sizeof(TSCKSUM);
     if (tsendfile(pHelper->files.nHeadF.fd, pHelper->files.headF.fd, NULL, TSDB_FILE_HEAD_SIZE) < TSDB_FILE_HEAD_SIZE)
       goto _err;
@@ -407,11 +413,13 @@ int tsdbWriteCompInfo(SRWHelper *pHelper) {
   SCompIdx *pIdx = pHelper->pCompIdx + pHelper->tableInfo.tid;
   if (!helperHasState(pHelper, TSDB_HELPER_INFO_LOAD)) {
     if (pIdx->offset > 0) {
+      // Copied from its offset, as the SCompInfo of other tables may be read in between
+      off_t offset = pIdx->offset;
       pIdx->offset = lseek(pHelper->files.nHeadF.fd, 0, SEEK_END);
       if (pIdx->offset < 0) return -1;
       ASSERT(pIdx->offset >= TSDB_FILE_HEAD_SIZE);
 
-      if (tsendfile(pHelper->files.nHeadF.fd, pHelper->files.headF.fd, NULL, pIdx->len) < pIdx->len) return -1;
+      if (tsendfile(pHelper->files.nHeadF.fd, pHelper->files.headF.fd, &offset, pIdx->len) < pIdx->len) return -1;
     }
   } else {
     pHelper->pCompInfo->delimiter = TSDB_FILE_DELIMITER;
@@ -515,6 +523,11 @@ int tsdbLoadCompInfo(SRWHelper *pHelper, void *target) {
       pHelper->pCompInfo = trealloc((void *)pHelper->pCompInfo, pIdx->len);
       if (tread(fd, (void *)(pHelper->pCompInfo), pIdx->len) < pIdx->len) return -1;
       if (!taosCheckChecksumWhole((uint8_t *)pHelper->pCompInfo, pIdx->len)) return -1;
+
+      // Commits count the blocks changed from it
+      if (TSDB_HELPER_TYPE(pHelper) == TSDB_WRITE_HELPER) {
+        tsdbGetCompInfoUsage(pHelper->pCompInfo, pIdx->numOfBlocks, &pHelper->oldUsage);
+      }
     }
 
     helperSetState(pHelper, TSDB_HELPER_INFO_LOAD);
@@ -525,6 +538,101 @@ int tsdbLoadCompInfo(SRWHelper *pHelper, void *target) {
   return 0;
 }
 
+/**
+ * Load the SCompBlock of the blocks [start, start + numOfBlocks) of the table set, and the ones of their sub-blocks,
+ * to *ppTarget as the SCompInfo of these blocks only. *ppTarget is enlarged if its size *size is not enough. The
+ * checksum of the SCompInfo is not verified as only a part of it is read.
+ *
+ * @return 0 for success, -1 for failure
+ */
+int tsdbLoadCompInfoPart(SRWHelper *pHelper, int start, int numOfBlocks, SCompInfo **ppTarget, int32_t *size) {
+  ASSERT(helperHasState(pHelper, TSDB_HELPER_TABLE_SET));
+
+  SCompIdx *pIdx = pHelper->pCompIdx + pHelper->tableInfo.tid;
+  int       fd = pHelper->files.headF.fd;
+
+  ASSERT(pIdx->offset > 0 && start >= 0 && start + numOfBlocks <= pIdx->numOfBlocks);
+
+  // The sub-blocks of a super-block take no more than TSDB_MAX_SUBBLOCKS SCompBlock
+  int32_t tsize = sizeof(SCompInfo) + sizeof(SCompBlock) * numOfBlocks * (TSDB_MAX_SUBBLOCKS + 1);
+  if (*size < tsize) {
+    void *ptr = realloc((void *)(*ppTarget), tsize);
+    if (ptr == NULL) return -1;
+    *ppTarget = (SCompInfo *)ptr;
+    *size = tsize;
+  }
+
+  SCompInfo *pCompInfo = *ppTarget;
+  if (lseek(fd, pIdx->offset, SEEK_SET) < 0) return -1;
+  if (tread(fd, (void *)pCompInfo, sizeof(SCompInfo)) < sizeof(SCompInfo)) return -1;
+  if (pCompInfo->delimiter != TSDB_FILE_DELIMITER || pCompInfo->uid != pIdx->uid) return -1;
+
+  if (lseek(fd, pIdx->offset + sizeof(SCompInfo) + sizeof(SCompBlock) * start, SEEK_SET) < 0) return -1;
+  if (tread(fd, (void *)pCompInfo->blocks, sizeof(SCompBlock) * numOfBlocks) < sizeof(SCompBlock) * numOfBlocks) {
+    return -1;
+  }
+
+  // The sub-blocks are put after the blocks, with the offsets of the super-blocks changed to there
+  int64_t offset = sizeof(SCompInfo) + sizeof(SCompBlock) * numOfBlocks;
+  for (int i = 0; i < numOfBlocks; i++) {
+    SCompBlock *pCompBlock = pCompInfo->blocks + i;
+    if (pCompBlock->numOfSubBlocks <= 1) continue;
+
+    size_t len = sizeof(SCompBlock) * pCompBlock->numOfSubBlocks;
+    if (pCompBlock->numOfSubBlocks > TSDB_MAX_SUBBLOCKS) return -1;
+    if (lseek(fd, pIdx->offset + pCompBlock->offset, SEEK_SET) < 0) return -1;
+    if (tread(fd, (char *)pCompInfo + offset, len) < len) return -1;
+
+    pCompBlock->offset = offset;
+    offset += len;
+  }
+
+  return 0;
+}
+
+void tsdbBuildBlockIdx(SCompInfo *pCompInfo, int numOfBlocks, SBlockIdx *pBlockIdx) {
+  pBlockIdx->numOfBlocks = numOfBlocks;
+  pBlockIdx->numOfEntries = 0;
+
+  for (int i = 0; i < numOfBlocks; i += TSDB_BLOCK_IDX_STEP) {
+    SBlockIdxEntry *pEntry = pBlockIdx->entries + pBlockIdx->numOfEntries++;
+    pEntry->keyFirst = pCompInfo->blocks[i].keyFirst;
+    pEntry->keyLast = pCompInfo->blocks[MIN(i + TSDB_BLOCK_IDX_STEP, numOfBlocks) - 1].keyLast;
+  }
+}
+
+// Get the range of the blocks which may have keys in [skey, ekey], numOfBlocks is 0 if there is none
+void tsdbSearchBlockIdx(SBlockIdx *pBlockIdx, TSKEY skey, TSKEY ekey, int *start, int *numOfBlocks) {
+  SBlockIdxEntry *entries = pBlockIdx->entries;
+
+  // The first entry ending at or after skey
+  int first = 0, last = pBlockIdx->numOfEntries;
+  while (first < last) {
+    int mid = (first + last) / 2;
+    if (entries[mid].keyLast < skey) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+  int from = first;
+
+  // The first entry starting after ekey
+  last = pBlockIdx->numOfEntries;
+  while (first < last) {
+    int mid = (first + last) / 2;
+    if (entries[mid].keyFirst <= ekey) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+  int to = first;
+
+  *start = from * TSDB_BLOCK_IDX_STEP;
+  *numOfBlocks = (to > from) ? MIN(to * TSDB_BLOCK_IDX_STEP, pBlockIdx->numOfBlocks) - *start : 0;
+}
+
 int tsdbLoadCompData(SRWHelper *pHelper, SCompBlock *pCompBlock, void *target) {
   ASSERT(pCompBlock->numOfSubBlocks <= 1);
   int fd = (pCompBlock->last) ? pHelper->files.lastF.fd : pHelper->files.dataF.fd;
@@ -535,6 +643,7 @@ int tsdbLoadCompData(SRWHelper *pHelper, SCompBlock *pCompBlock, void *target) {
   pHelper->pCompData = trealloc((void *)pHelper->pCompData, tsize);
   if (pHelper->pCompData == NULL) return -1;
   if (tread(fd, (void *)pHelper->pCompData, tsize) < tsize) return -1;
+  if (!taosCheckChecksumWhole((uint8_t *)pHelper->pCompData, tsize)) return -1;
 
   ASSERT(pCompBlock->numOfCols == pHelper->pCompData->numOfCols);
 
@@ -543,7 +652,13 @@ int tsdbLoadCompData(SRWHelper *pHelper, SCompBlock *pCompBlock, void *target) {
   return 0;
 }
 
-void tsdbGetDataStatis(SRWHelper *pHelper, SDataStatis *pStatis, int numOfCols) {
+/**
+ * Get the statistics of the columns of pStatis from the SCompData loaded, numOfNull is -1 for a column not in the
+ * block.
+ *
+ * @return 0 for success, -1 if the statistics of a float or double column are in the layout before the flags
+ */
+int tsdbGetDataStatis(SRWHelper *pHelper, SDataStatis *pStatis, int numOfCols) {
   SCompData *pCompData = pHelper->pCompData;
 
   for (int i = 0, j = 0; i < numOfCols;) {
@@ -554,6 +669,12 @@ void tsdbGetDataStatis(SRWHelper *pHelper, SDataStatis *pStatis, int numOfCols)
     }
 
     if (pStatis[i].colId == pCompData->cols[j].colId) {
+      SCompCol *pCompCol = pCompData->cols + j;
+      if ((pCompCol->type == TSDB_DATA_TYPE_FLOAT || pCompCol->type == TSDB_DATA_TYPE_DOUBLE) &&
+          !(pCompCol->flags & TSDB_COL_FLAG_DOUBLE_STATIS)) {
+        return -1;
+      }
+
       pStatis[i].sum = pCompData->cols[j].sum;
       pStatis[i].max = pCompData->cols[j].max;
       pStatis[i].min = pCompData->cols[j].min;
@@ -569,6 +690,8 @@ void tsdbGetDataStatis(SRWHelper *pHelper, SDataStatis *pStatis, int numOfCols)
       j++;
     }
   }
+
+  return 0;
 }
 
 static int comparColIdCompCol(const void *arg1, const void *arg2) {
@@ -579,64 +702,13 @@ static int comparColIdDataCol(const void *arg1, const void *arg2) {
   return (*(int16_t *)arg1) - ((SDataCol *)arg2)->colId;
 }
 
-static int tsdbLoadSingleColumnData(int fd, SCompBlock *pCompBlock, SCompCol *pCompCol, void *buf) {
-  size_t tsize = sizeof(SCompData) + sizeof(SCompCol) * pCompBlock->numOfCols;
-  if (lseek(fd, pCompBlock->offset + tsize + pCompCol->offset, SEEK_SET) < 0) return -1;
-  if (tread(fd, buf, pCompCol->len) < pCompCol->len) return -1;
-
-  return 0;
-}
-
-static int tsdbLoadSingleBlockDataCols(SRWHelper *pHelper, SCompBlock *pCompBlock, int16_t *colIds, int numOfColIds,
-                                       SDataCols *pDataCols) {
-  if (tsdbLoadCompData(pHelper, pCompBlock, NULL) < 0) return -1;
-  int fd = (pCompBlock->last) ? pHelper->files.lastF.fd : pHelper->files.dataF.fd;
-
-  void *ptr = NULL;
-  for (int i = 0; i < numOfColIds; i++) {
-    int16_t colId = colIds[i];
-
-    ptr = bsearch((void *)&colId, (void *)pHelper->pCompData->cols, pHelper->pCompData->numOfCols, sizeof(SCompCol), comparColIdCompCol);
-    if (ptr == NULL) continue;
-    SCompCol *pCompCol = (SCompCol *)ptr;
-
-    ptr = bsearch((void *)&colId, (void *)(pDataCols->cols), pDataCols->numOfCols, sizeof(SDataCol), comparColIdDataCol);
-    ASSERT(ptr != NULL);
-    SDataCol *pDataCol = (SDataCol *)ptr;
-
-    pDataCol->len = pCompCol->len;
-    if (tsdbLoadSingleColumnData(fd, pCompBlock, pCompCol, pDataCol->pData) < 0) return -1;
-  }
-
-  return 0;
-}
-
-// Load specific column data from file
-int tsdbLoadBlockDataCols(SRWHelper *pHelper, SDataCols *pDataCols, int blkIdx, int16_t *colIds, int numOfColIds) {
-  SCompBlock *pCompBlock = pHelper->pCompInfo->blocks + blkIdx;
-
-  ASSERT(pCompBlock->numOfSubBlocks >= 1); // Must be super block
-
-  int numOfSubBlocks = pCompBlock->numOfSubBlocks;
-  SCompBlock *pStartBlock =
-      (numOfSubBlocks == 1) ? pCompBlock : (SCompBlock *)((char *)pHelper->pCompInfo->blocks + pCompBlock->offset);
-
-  if (tsdbLoadSingleBlockDataCols(pHelper, pStartBlock, colIds, numOfColIds, pDataCols) < 0) return -1;
-  for (int i = 1; i < numOfSubBlocks; i++) {
-    pStartBlock++;
-    if (tsdbLoadSingleBlockDataCols(pHelper, pStartBlock, colIds, numOfColIds, pHelper->pDataCols[1]) < 0) return -1;
-    tdMergeDataCols(pDataCols, pHelper->pDataCols[1], pHelper->pDataCols[1]->numOfPoints);
-  }
-
-  return 0;
-}
-
 static int tsdbCheckAndDecodeColumnData(SDataCol *pDataCol, char *content, int32_t len, int8_t comp, int numOfPoints,
                                         int maxPoints, char *buffer, int bufferSize) {
   // Verify by checksum
   if (!taosCheckChecksumWhole((uint8_t *)content, len)) return -1;
 
   // Decode the data
+  pDataCol->dictSize = 0;
   if (comp) {
     // // Need to decompress
     pDataCol->len = (*(tDataTypeDesc[pDataCol->type].decompFunc))(
@@ -655,6 +727,164 @@ static int tsdbCheckAndDecodeColumnData(SDataCol *pDataCol, char *content, int32
   return 0;
 }
 
+// Decode a dictionary encoded column, which is compressed by LZ4 again with the two stage compression. The code of
+// each row is kept, with which a filter on the column is evaluated for each distinct value only
+static int tsdbCheckAndDecodeDictColumnData(SDataCol *pDataCol, char *content, int32_t len, int8_t comp,
+                                            int numOfPoints, int maxPoints, char *buffer, int bufferSize) {
+  if (!taosCheckChecksumWhole((uint8_t *)content, len)) return -1;
+
+  len -= sizeof(TSCKSUM);
+  if (comp == TWO_STAGE_COMP) {
+    len = tsDecompressStringImp(content, len, buffer, bufferSize);
+    content = buffer;
+  }
+
+  if (pDataCol->codes == NULL) {
+    pDataCol->codes = (uint8_t *)malloc(maxPoints);
+    if (pDataCol->codes == NULL) return -1;
+  }
+
+  pDataCol->len = tsDecompressDictImp(content, len, numOfPoints, pDataCol->pData, pDataCol->spaceSize, pDataCol->codes);
+  if (pDataCol->len < 0) return -1;
+
+  pDataCol->dictSize = *(uint16_t *)content;
+  dataColSetOffset(pDataCol, numOfPoints);
+  return 0;
+}
+
+// Decode a column of the block, pData points to the start of the column data part in the block. *ppBuffer is the
+// buffer for the two stage decompression, which is owned by the caller
+static int tsdbDecodeBlockColumn(SCompBlock *pCompBlock, SCompCol *pCompCol, SDataCol *pDataCol, char *pData,
+                                 int maxPoints, void **ppBuffer) {
+  int8_t comp = TSDB_COL_ALGORITHM(pCompBlock, pCompCol);
+
+  // a dictionary encoded column is compressed by LZ4 again with the two stage compression of the block
+  if (comp == TWO_STAGE_COMP || (comp == DICT_COMP && pCompBlock->algorithm == TWO_STAGE_COMP)) {
+    int zsize = pDataCol->bytes * pCompBlock->numOfPoints + COMP_OVERFLOW_BYTES;
+    if (pCompCol->type == TSDB_DATA_TYPE_BINARY || pCompCol->type == TSDB_DATA_TYPE_NCHAR) {
+      zsize += (sizeof(VarDataLenT) * pCompBlock->numOfPoints);
+    }
+    *ppBuffer = trealloc(*ppBuffer, zsize);
+    if (*ppBuffer == NULL) return -1;
+  }
+
+  if (comp == DICT_COMP) {
+    return tsdbCheckAndDecodeDictColumnData(pDataCol, pData + pCompCol->offset, pCompCol->len, pCompBlock->algorithm,
+                                            pCompBlock->numOfPoints, maxPoints, *ppBuffer, tsizeof(*ppBuffer));
+  }
+
+  return tsdbCheckAndDecodeColumnData(pDataCol, pData + pCompCol->offset, pCompCol->len, comp, pCompBlock->numOfPoints,
+                                      maxPoints, *ppBuffer, tsizeof(*ppBuffer));
+}
+
+// Get the i-th column to load, all the columns of pDataCols are loaded if colIds is NULL
+static SDataCol *tsdbGetColumnToLoad(SDataCols *pDataCols, int16_t *colIds, int i) {
+  if (colIds == NULL) return pDataCols->cols + i;
+  return (SDataCol *)bsearch((void *)(colIds + i), (void *)(pDataCols->cols), pDataCols->numOfCols, sizeof(SDataCol),
+                             comparColIdDataCol);
+}
+
+typedef struct {
+  SCompBlock *pCompBlock;
+  SCompData * pCompData;
+  SDataCols * pDataCols;
+  int16_t *   colIds;  // NULL for all the columns of pDataCols
+  int         from;    // the columns in [from, to) are decoded by the task
+  int         to;
+  void **     ppBuffer;
+  int         code;
+  tsem_t *    pDone;  // posted when the task is done if it runs in a worker
+} SDecodeTask;
+
+static void tsdbDecodeColumns(SDecodeTask *pTask) {
+  SCompBlock *pCompBlock = pTask->pCompBlock;
+  SCompData * pCompData = pTask->pCompData;
+  SDataCols * pDataCols = pTask->pDataCols;
+  int32_t     tsize = sizeof(SCompData) + sizeof(SCompCol) * pCompBlock->numOfCols + sizeof(TSCKSUM);
+
+  pTask->code = 0;
+  for (int i = pTask->from; i < pTask->to; i++) {
+    SDataCol *pDataCol = tsdbGetColumnToLoad(pDataCols, pTask->colIds, i);
+    if (pDataCol == NULL) continue;
+
+    SCompCol *pCompCol = (SCompCol *)bsearch((void *)(&pDataCol->colId), (void *)(pCompData->cols),
+                                             pCompData->numOfCols, sizeof(SCompCol), comparColIdCompCol);
+    if (pCompCol == NULL) {
+      // The column is added after the block is written
+      dataColSetNEleNull(pDataCol, pCompBlock->numOfPoints, pDataCols->maxPoints);
+      continue;
+    }
+
+    if (tsdbDecodeBlockColumn(pCompBlock, pCompCol, pDataCol, (char *)pCompData + tsize, pDataCols->maxPoints,
+                              pTask->ppBuffer) < 0) {
+      pTask->code = -1;
+      return;
+    }
+  }
+}
+
+static void tsdbProcessDecodeTask(SSchedMsg *pMsg) {
+  SDecodeTask *pTask = (SDecodeTask *)pMsg->ahandle;
+  tsdbDecodeColumns(pTask);
+  tsem_post(pTask->pDone);
+}
+
+/**
+ * Decode the given columns of a block read into pCompData. With a decompression pool the columns are split into
+ * several tasks, the first one of which is run by the calling thread and the others by the workers, each task with
+ * its own decompression buffer.
+ */
+static int tsdbDecodeBlockColumns(SRWHelper *pHelper, SCompBlock *pCompBlock, SCompData *pCompData,
+                                  SDataCols *pDataCols, int16_t *colIds, int numOfColIds) {
+  if (colIds == NULL) numOfColIds = pDataCols->numOfCols;
+  pDataCols->numOfPoints = pCompBlock->numOfPoints;
+
+  int numOfTasks = 1;
+  if (pHelper->pDecompPool != NULL) {
+    numOfTasks = MIN(pHelper->pDecompPool->numOfThreads + 1, numOfColIds / TSDB_MIN_COLS_PER_DECODE_TASK);
+    numOfTasks = MAX(numOfTasks, 1);
+  }
+
+  SDecodeTask tasks[TSDB_MAX_DECOMPRESS_THREADS + 1];
+  tsem_t      done;
+  if (numOfTasks > 1 && tsem_init(&done, 0, 0) != 0) numOfTasks = 1;
+
+  for (int i = 0; i < numOfTasks; i++) {
+    SDecodeTask *pTask = tasks + i;
+    pTask->pCompBlock = pCompBlock;
+    pTask->pCompData = pCompData;
+    pTask->pDataCols = pDataCols;
+    pTask->colIds = colIds;
+    pTask->from = numOfColIds * i / numOfTasks;
+    pTask->to = numOfColIds * (i + 1) / numOfTasks;
+    pTask->ppBuffer = (i == 0) ? &(pHelper->compBuffer) : &(pHelper->decompBuffers[i - 1]);
+    pTask->pDone = &done;
+
+    if (i > 0) {
+      SSchedMsg msg = {0};
+      msg.fp = tsdbProcessDecodeTask;
+      msg.ahandle = pTask;
+      taosScheduleTask(pHelper->pDecompPool->qhandle, &msg);
+    }
+  }
+
+  tsdbDecodeColumns(tasks);
+
+  int code = tasks[0].code;
+  if (numOfTasks > 1) {
+    for (int i = 1; i < numOfTasks; i++) {
+      while (tsem_wait(&done) != 0 && errno == EINTR) {
+      }
+    }
+    tsem_destroy(&done);
+    for (int i = 1; i < numOfTasks; i++) {
+      if (tasks[i].code < 0) code = -1;
+    }
+  }
+
+  return code;
+}
+
 /**
  * Interface to read the data of a sub-block OR the data of a super-block of which (numOfSubBlocks == 1)
  */
@@ -673,50 +903,63 @@ static int tsdbLoadBlockDataImpl(SRWHelper *pHelper, SCompBlock *pCompBlock, SDa
   int32_t tsize = sizeof(SCompData) + sizeof(SCompCol) * pCompBlock->numOfCols + sizeof(TSCKSUM);
   if (!taosCheckChecksumWhole((uint8_t *)pCompData, tsize)) goto _err;
 
-  pDataCols->numOfPoints = pCompBlock->numOfPoints;
-
   // Recover the data
-  int ccol = 0;
-  int dcol = 0;
-  while (dcol < pDataCols->numOfCols) {
-    SDataCol *pDataCol = &(pDataCols->cols[dcol]);
-    if (ccol >= pCompData->numOfCols) {
-      // Set current column as NULL and forward
-      dataColSetNEleNull(pDataCol, pCompBlock->numOfPoints, pDataCols->maxPoints);
-      dcol++;
-      continue;
-    }
+  if (tsdbDecodeBlockColumns(pHelper, pCompBlock, pCompData, pDataCols, NULL, 0) < 0) goto _err;
 
-    SCompCol *pCompCol = &(pCompData->cols[ccol]);
+  return 0;
 
-    if (pCompCol->colId == pDataCol->colId) {
-      if (pCompBlock->algorithm == TWO_STAGE_COMP) {
-        int zsize = pDataCol->bytes * pCompBlock->numOfPoints + COMP_OVERFLOW_BYTES;
-        if (pCompCol->type == TSDB_DATA_TYPE_BINARY || pCompCol->type == TSDB_DATA_TYPE_NCHAR) {
-          zsize += (sizeof(VarDataLenT) * pCompBlock->numOfPoints);
-        }
-        pHelper->compBuffer = trealloc(pHelper->compBuffer, zsize);
-        if (pHelper->compBuffer == NULL) goto _err;
-      }
-      if (tsdbCheckAndDecodeColumnData(pDataCol, (char *)pCompData + tsize + pCompCol->offset, pCompCol->len,
-                                       pCompBlock->algorithm, pCompBlock->numOfPoints, pDataCols->maxPoints,
-                                       pHelper->compBuffer, tsizeof(pHelper->compBuffer)) < 0)
-        goto _err;
-      dcol++;
-      ccol++;
-    } else if (pCompCol->colId < pDataCol->colId) {
-      ccol++;
-    } else {
-      // Set current column as NULL and forward
-      dataColSetNEleNull(pDataCol, pCompBlock->numOfPoints, pDataCols->maxPoints);
-      dcol++;
+_err:
+  return -1;
+}
+
+static void tsdbInitBlockCacheKey(SRWHelper *pHelper, SCompBlock *pCompBlock, SBlockCacheKey *pKey) {
+  memset((void *)pKey, 0, sizeof(*pKey));
+  pKey->fid = pHelper->files.fid;
+  pKey->version = pHelper->files.version;
+  pKey->uid = pHelper->tableInfo.uid;
+  pKey->offset = pCompBlock->offset;
+  pKey->last = pCompBlock->last;
+}
+
+// Load the columns of a block from the block cache, return false if any of them is not cached
+static bool tsdbLoadBlockDataFromCache(SRWHelper *pHelper, SCompBlock *pCompBlock, int numOfPoints,
+                                       SDataCols *pDataCols, int16_t *colIds, int numOfColIds) {
+  SBlockCacheKey key;
+  tsdbInitBlockCacheKey(pHelper, pCompBlock, &key);
+
+  if (colIds == NULL) numOfColIds = pDataCols->numOfCols;
+  for (int i = 0; i < numOfColIds; i++) {
+    SDataCol *pDataCol = tsdbGetColumnToLoad(pDataCols, colIds, i);
+    if (pDataCol == NULL) continue;
+
+    key.colId = pDataCol->colId;
+    int32_t len = taosLRUCacheGet(pHelper->pBlockCache, &key, sizeof(key), pDataCol->pData, pDataCol->spaceSize);
+    if (len < 0) return false;
+
+    pDataCol->len = len;
+    pDataCol->dictSize = 0;  // the codes are not cached
+    if (pDataCol->type == TSDB_DATA_TYPE_BINARY || pDataCol->type == TSDB_DATA_TYPE_NCHAR) {
+      dataColSetOffset(pDataCol, numOfPoints);
     }
   }
 
-  return 0;
+  pDataCols->numOfPoints = numOfPoints;
+  return true;
+}
 
-_err:
-  return -1;
+static void tsdbPutBlockDataToCache(SRWHelper *pHelper, SCompBlock *pCompBlock, SDataCols *pDataCols,
+                                    int16_t *colIds, int numOfColIds) {
+  SBlockCacheKey key;
+  tsdbInitBlockCacheKey(pHelper, pCompBlock, &key);
+
+  if (colIds == NULL) numOfColIds = pDataCols->numOfCols;
+  for (int i = 0; i < numOfColIds; i++) {
+    SDataCol *pDataCol = tsdbGetColumnToLoad(pDataCols, colIds, i);
+    if (pDataCol == NULL) continue;
+
+    key.colId = pDataCol->colId;
+    taosLRUCachePut(pHelper->pBlockCache, &key, sizeof(key), pDataCol->pData, pDataCol->len);
+  }
 }
 
 // Load the whole block data
@@ -724,8 +967,16 @@ int tsdbLoadBlockData(SRWHelper *pHelper, SCompBlock *pCompBlock, SDataCols *tar
   // SCompBlock *pCompBlock = pHelper->pCompInfo->blocks + blkIdx;
 
   int numOfSubBlock = pCompBlock->numOfSubBlocks;
+  int numOfPoints = pCompBlock->numOfPoints;
   if (numOfSubBlock > 1) pCompBlock = (SCompBlock *)((char *)pHelper->pCompInfo + pCompBlock->offset);
 
+  if (pHelper->pBlockCache != NULL &&
+      tsdbLoadBlockDataFromCache(pHelper, pCompBlock, numOfPoints, pHelper->pDataCols[0], NULL, 0)) {
+    return 0;
+  }
+
+  SCompBlock *pStartBlock = pCompBlock;
+
   tdResetDataCols(pHelper->pDataCols[0]);
   if (tsdbLoadBlockDataImpl(pHelper, pCompBlock, pHelper->pDataCols[0]) < 0) goto _err;
   for (int i = 1; i < numOfSubBlock; i++) {
@@ -735,6 +986,8 @@ int tsdbLoadBlockData(SRWHelper *pHelper, SCompBlock *pCompBlock, SDataCols *tar
     if (tdMergeDataCols(pHelper->pDataCols[0], pHelper->pDataCols[1], pHelper->pDataCols[1]->numOfPoints) < 0) goto _err;
   }
 
+  if (pHelper->pBlockCache != NULL) tsdbPutBlockDataToCache(pHelper, pStartBlock, pHelper->pDataCols[0], NULL, 0);
+
   // if (target) TODO
 
   return 0;
@@ -743,6 +996,94 @@ _err:
   return -1;
 }
 
+/**
+ * Read the SCompData part and the data of the given columns of a block into pHelper->pBuffer, at the same positions as
+ * in the file, and decode them into pDataCols. Only (numOfSubBlocks <= 1) blocks are accepted. The column ranges with
+ * small gaps between them are read together, so that a scan of a few adjacent columns reads the file only twice.
+ */
+static int tsdbLoadBlockDataColsImpl(SRWHelper *pHelper, SCompBlock *pCompBlock, SDataCols *pDataCols,
+                                     int16_t *colIds, int numOfColIds) {
+  ASSERT(pCompBlock->numOfSubBlocks <= 1);
+  ASSERT(tsizeof(pHelper->pBuffer) >= pCompBlock->len);
+
+  SCompData *pCompData = (SCompData *)pHelper->pBuffer;
+
+  int fd = (pCompBlock->last) ? pHelper->files.lastF.fd : pHelper->files.dataF.fd;
+  int32_t tsize = sizeof(SCompData) + sizeof(SCompCol) * pCompBlock->numOfCols + sizeof(TSCKSUM);
+  if (lseek(fd, pCompBlock->offset, SEEK_SET) < 0) return -1;
+  if (tread(fd, (void *)pCompData, tsize) < tsize) return -1;
+  if (!taosCheckChecksumWhole((uint8_t *)pCompData, tsize)) return -1;
+  ASSERT(pCompData->numOfCols == pCompBlock->numOfCols);
+
+  // Read the column ranges, [start, end) is the range to read next, relative to the block
+  int64_t start = -1, end = -1;
+  for (int i = 0; i <= numOfColIds; i++) {
+    SCompCol *pCompCol = NULL;
+    if (i < numOfColIds) {
+      pCompCol = (SCompCol *)bsearch((void *)(colIds + i), (void *)(pCompData->cols), pCompData->numOfCols,
+                                     sizeof(SCompCol), comparColIdCompCol);
+      if (pCompCol == NULL) continue;
+
+      int64_t cstart = tsize + pCompCol->offset;
+      if (start >= 0 && cstart >= end && cstart - end <= TSDB_COALESCE_READ_GAP) {
+        end = MAX(end, cstart + pCompCol->len);
+        continue;
+      }
+    }
+
+    if (start >= 0) {
+      if (lseek(fd, pCompBlock->offset + start, SEEK_SET) < 0) return -1;
+      if (tread(fd, (char *)pCompData + start, end - start) < end - start) return -1;
+    }
+
+    if (pCompCol != NULL) {
+      start = tsize + pCompCol->offset;
+      end = start + pCompCol->len;
+    }
+  }
+
+  if (tsdbDecodeBlockColumns(pHelper, pCompBlock, pCompData, pDataCols, colIds, numOfColIds) < 0) return -1;
+
+  return 0;
+}
+
+/**
+ * Load the given columns of a block into pHelper->pDataCols[0], the other columns are left untouched. The column ids
+ * must be in ascending order. The whole block is loaded if it has sub-blocks, which are merged with all columns.
+ */
+int tsdbLoadBlockDataCols(SRWHelper *pHelper, SCompBlock *pCompBlock, int16_t *colIds, int numOfColIds) {
+  SDataCols *pDataCols = pHelper->pDataCols[0];
+
+  if (pCompBlock->numOfSubBlocks > 1 || numOfColIds >= pCompBlock->numOfCols) {
+    return tsdbLoadBlockData(pHelper, pCompBlock, NULL);
+  }
+
+  if (pHelper->pBlockCache != NULL &&
+      tsdbLoadBlockDataFromCache(pHelper, pCompBlock, pCompBlock->numOfPoints, pDataCols, colIds, numOfColIds)) {
+    return 0;
+  }
+
+  if (tsdbLoadBlockDataColsImpl(pHelper, pCompBlock, pDataCols, colIds, numOfColIds) < 0) return -1;
+
+  if (pHelper->pBlockCache != NULL) tsdbPutBlockDataToCache(pHelper, pCompBlock, pDataCols, colIds, numOfColIds);
+
+  return 0;
+}
+
+/**
+ * Ask the kernel to read the data of a block into the page cache in background, so that the disk read of the
+ * following blocks overlaps the decoding of current one. pCompInfo is the one of the table the block belongs to.
+ */
+void tsdbReadAheadBlockData(SRWHelper *pHelper, SCompInfo *pCompInfo, SCompBlock *pCompBlock) {
+  int numOfSubBlocks = pCompBlock->numOfSubBlocks;
+  if (numOfSubBlocks > 1) pCompBlock = (SCompBlock *)((char *)pCompInfo + pCompBlock->offset);
+
+  for (int i = 0; i < numOfSubBlocks; i++, pCompBlock++) {
+    int fd = (pCompBlock->last) ? pHelper->files.lastF.fd : pHelper->files.dataF.fd;
+    posix_fadvise(fd, pCompBlock->offset, pCompBlock->len, POSIX_FADV_WILLNEED);
+  }
+}
+
 static bool tsdbShouldCreateNewLast(SRWHelper *pHelper) {
   ASSERT(pHelper->files.lastF.fd > 0);
   struct stat st;
@@ -751,6 +1092,62 @@ static bool tsdbShouldCreateNewLast(SRWHelper *pHelper) {
   return false;
 }
 
+// The candidate algorithms of a column, from the fastest to decode to the slowest
+static int tsdbGetCompCandidates(int8_t type, int8_t compress, int8_t *candidates) {
+  int n = 0;
+
+  candidates[n++] = NO_COMPRESSION;
+  switch (type) {
+    case TSDB_DATA_TYPE_TINYINT:
+    case TSDB_DATA_TYPE_SMALLINT:
+    case TSDB_DATA_TYPE_INT:
+    case TSDB_DATA_TYPE_BIGINT:
+      candidates[n++] = BITPACK_COMP;
+      candidates[n++] = ONE_STAGE_COMP;
+      break;
+    case TSDB_DATA_TYPE_FLOAT:
+    case TSDB_DATA_TYPE_DOUBLE:
+      candidates[n++] = ONE_STAGE_COMP;
+      candidates[n++] = CHIMP_COMP;
+      break;
+    case TSDB_DATA_TYPE_BINARY:
+    case TSDB_DATA_TYPE_NCHAR:
+      // binary and nchar values are compressed by LZ4 whatever the level is
+      candidates[n++] = compress;
+      return n;
+    default:
+      candidates[n++] = ONE_STAGE_COMP;
+      break;
+  }
+  candidates[n++] = TWO_STAGE_COMP;
+
+  return n;
+}
+
+// Choose the algorithm of a column by compressing its first rows with each candidate. The sample is compressed to
+// pOut, which is overwritten by the column later
+static int8_t tsdbChooseColumnAlgorithm(SRWHelper *pHelper, SDataCol *pDataCol, int rowsToWrite, char *pOut,
+                                        int outSize) {
+  int8_t  candidates[4];
+  int     numOfCandidates = tsdbGetCompCandidates(pDataCol->type, pHelper->config.compress, candidates);
+  int     rows = MIN(rowsToWrite, TSDB_COMP_SAMPLE_ROWS);
+  int32_t slen = dataColGetNEleLen(pDataCol, rows);
+  int8_t  algorithm = NO_COMPRESSION;
+  int32_t minLen = slen;
+
+  for (int i = 1; i < numOfCandidates; i++) {
+    int32_t len = (*(tDataTypeDesc[pDataCol->type].compFunc))((char *)pDataCol->pData, slen, rows, pOut, outSize,
+                                                               candidates[i], pHelper->compBuffer,
+                                                               tsizeof(pHelper->compBuffer));
+    if (len < minLen - minLen / TSDB_COMP_MIN_GAIN) {
+      algorithm = candidates[i];
+      minLen = len;
+    }
+  }
+
+  return algorithm;
+}
+
 static int tsdbWriteBlockToFile(SRWHelper *pHelper, SFile *pFile, SDataCols *pDataCols, int rowsToWrite, SCompBlock *pCompBlock,
                                 bool isLast, bool isSuperBlock) {
   ASSERT(rowsToWrite > 0 && rowsToWrite <= pDataCols->numOfPoints &&
@@ -780,6 +1177,9 @@ static int tsdbWriteBlockToFile(SRWHelper *pHelper, SFile *pFile, SDataCols *pDa
       (*tDataTypeDesc[pDataCol->type].getStatisFunc)(
           (TSKEY *)(pDataCols->cols[0].pData), pDataCol->pData, rowsToWrite, &(pCompCol->min), &(pCompCol->max),
           &(pCompCol->sum), &(pCompCol->minIndex), &(pCompCol->maxIndex), &(pCompCol->numOfNull));
+      if (pDataCol->type == TSDB_DATA_TYPE_FLOAT || pDataCol->type == TSDB_DATA_TYPE_DOUBLE) {
+        pCompCol->flags |= TSDB_COL_FLAG_DOUBLE_STATIS;
+      }
     }
     nColsNotAllNull++;
   }
@@ -803,21 +1203,47 @@ static int tsdbWriteBlockToFile(SRWHelper *pHelper, SFile *pFile, SDataCols *pDa
     pCompCol->offset = toffset;
 
     int32_t tlen = dataColGetNEleLen(pDataCol, rowsToWrite);
+    int8_t  algorithm = pHelper->config.compress;
 
-    if (pHelper->config.compress) {
-      if (pHelper->config.compress == TWO_STAGE_COMP) {
-        pHelper->compBuffer = trealloc(pHelper->compBuffer, tlen + COMP_OVERFLOW_BYTES);
-        if (pHelper->compBuffer == NULL) goto _err;
+    if (algorithm == TWO_STAGE_COMP || (algorithm != NO_COMPRESSION && tsAdaptiveComp)) {
+      pHelper->compBuffer = trealloc(pHelper->compBuffer, tlen + COMP_OVERFLOW_BYTES);
+      if (pHelper->compBuffer == NULL) goto _err;
+    }
+
+    // binary and nchar columns of few distinct values are dictionary encoded, and compressed by LZ4 again with the
+    // two stage compression
+    int32_t dlen = 0;
+    if (algorithm != NO_COMPRESSION && (pDataCol->type == TSDB_DATA_TYPE_BINARY || pDataCol->type == TSDB_DATA_TYPE_NCHAR)) {
+      if (algorithm == TWO_STAGE_COMP) {
+        dlen = tsCompressDictImp((char *)pDataCol->pData, tlen, rowsToWrite, pHelper->compBuffer,
+                                 tsizeof(pHelper->compBuffer));
+        if (dlen > 0) dlen = tsCompressStringImp(pHelper->compBuffer, dlen, tptr, tsizeof(pHelper->pBuffer) - lsize);
+      } else {
+        dlen = tsCompressDictImp((char *)pDataCol->pData, tlen, rowsToWrite, tptr, tsizeof(pHelper->pBuffer) - lsize);
       }
+    }
 
-      pCompCol->len = (*(tDataTypeDesc[pDataCol->type].compFunc))(
-          (char *)pDataCol->pData, tlen, rowsToWrite, tptr, tsizeof(pHelper->pBuffer) - lsize,
-          pHelper->config.compress, pHelper->compBuffer, tsizeof(pHelper->compBuffer));
+    if (dlen > 0) {
+      algorithm = DICT_COMP;
+      pCompCol->len = dlen;
     } else {
-      pCompCol->len = tlen;
-      memcpy(tptr, pDataCol->pData, pCompCol->len);
+      if (algorithm != NO_COMPRESSION && tsAdaptiveComp) {
+        algorithm = tsdbChooseColumnAlgorithm(pHelper, pDataCol, rowsToWrite, tptr, tsizeof(pHelper->pBuffer) - lsize);
+      }
+
+      if (algorithm != NO_COMPRESSION) {
+        pCompCol->len = (*(tDataTypeDesc[pDataCol->type].compFunc))(
+            (char *)pDataCol->pData, tlen, rowsToWrite, tptr, tsizeof(pHelper->pBuffer) - lsize, algorithm,
+            pHelper->compBuffer, tsizeof(pHelper->compBuffer));
+      } else {
+        pCompCol->len = tlen;
+        memcpy(tptr, pDataCol->pData, pCompCol->len);
+      }
     }
 
+    if (algorithm != pHelper->config.compress) TSDB_SET_COL_ALGORITHM(pCompCol, algorithm);
+    pHelper->numOfColsByAlgorithm[algorithm]++;
+
     // Add checksum
     pCompCol->len += sizeof(TSCKSUM);
     taosCalcChecksumAppend(0, (uint8_t *)tptr, pCompCol->len);
@@ -1295,6 +1721,7 @@ void *tsdbEncodeSFileInfo(void *buf, const STsdbFileInfo *pInfo) {
   buf = taosEncodeFixed64(buf, pInfo->tombSize);
   buf = taosEncodeFixed32(buf, pInfo->totalBlocks);
   buf = taosEncodeFixed32(buf, pInfo->totalSubBlocks);
+  buf = taosEncodeFixed32(buf, pInfo->version);
 
   return buf;
 }
@@ -1306,6 +1733,7 @@ void *tsdbDecodeSFileInfo(void *buf, STsdbFileInfo *pInfo) {
   buf = taosDecodeFixed64(buf, &(pInfo->tombSize));
   buf = taosDecodeFixed32(buf, &(pInfo->totalBlocks));
   buf = taosDecodeFixed32(buf, &(pInfo->totalSubBlocks));
+  buf = taosDecodeFixed32(buf, &(pInfo->version));  // 0 in the files written before it is added
 
   return buf;
 }
\ No newline at end of file
@@ -52,6 +52,7 @@ typedef struct SQueryFilePos {
   int32_t rows;
   bool    mixBlock;
   bool    blockCompleted;
+  bool    rollup;  // current block is a rollup entry
   STimeWindow win;
 } SQueryFilePos;
 
@@ -77,8 +78,8 @@ typedef struct STableCheckInfo {
   int32_t    numOfBlocks;    // number of qualified data blocks not the original blocks
   SDataCols* pDataCols;
   
-  SSkipListIterator* iter;   // skip list iterator
-  SSkipListIterator* iiter;  // imem iterator
+  SMemTableIter* iter;   // mem table iterator
+  SMemTableIter* iiter;  // imem iterator
   
   bool       initBuf;   // if we should initialize the in-memory skip list iterator
 } STableCheckInfo;
@@ -115,6 +116,7 @@ typedef struct STsdbQueryHandle {
   int32_t     numOfBlocks;
   SField**    pFields;
   SArray*     pColumns;    // column list, SColumnInfoData array list
+  SDataStatis* statis;     // statistics of the columns in pColumns for current data block
   bool        locateStart;
   int32_t     outputCapacity;
   int32_t     realNumOfRows;
@@ -128,6 +130,15 @@ typedef struct STsdbQueryHandle {
   SFileGroup*    pFileGroup;
   SFileGroupIter fileIter;
   SRWHelper      rhelper;
+  int32_t        readAheadSlot;  // the blocks from cur.slot to it in the scan order have been read ahead
+  SBlockIdx*     pBlockIdx;      // buffer of the block index of a table got from the cache
+  int32_t        blockIdxSize;
+
+  int32_t        rollupLevel;  // index of the rollup level to read, -1 if rollups are not used
+  SRollupInfo**  pRollupInfo;  // rollups of each table in current file group
+  int32_t        rollupTable;  // current table and entry of the rollups
+  int32_t        rollupEntry;
+  int32_t        code;         // error of the scan, the query fails with it instead of returning partial results
 } STsdbQueryHandle;
 
 static void changeQueryHandleForLastrowQuery(TsdbQueryHandleT pqHandle);
@@ -153,6 +164,7 @@ TsdbQueryHandleT* tsdbQueryTables(TsdbRepoT* tsdb, STsdbQueryCond* pCond, STable
   pQueryHandle->pTsdb  = tsdb;
   pQueryHandle->type   = TSDB_QUERY_TYPE_ALL;
   tsdbInitReadHelper(&pQueryHandle->rhelper, (STsdbRepo*) tsdb);
+  pQueryHandle->rhelper.pBlockCache = ((STsdbRepo*) tsdb)->pBlockCache;
 
   pQueryHandle->cur.fid = -1;
   pQueryHandle->cur.win = TSWINDOW_INITIALIZER;
@@ -204,6 +216,18 @@ TsdbQueryHandleT* tsdbQueryTables(TsdbRepoT* tsdb, STsdbQueryCond* pCond, STable
     taosArrayPush(pQueryHandle->pColumns, &colInfo);
   }
 
+  pQueryHandle->statis = calloc(numOfCols, sizeof(SDataStatis));
+
+  // rollups are only returned in ascending order, since the entries of a table are ordered by time
+  pQueryHandle->rollupLevel = -1;
+  if (pCond->rollup > 0 && ASCENDING_TRAVERSE(pCond->order)) {
+    pQueryHandle->rollupLevel = tsdbGetRollupLevelIdx(&((STsdbRepo*)tsdb)->rollup, pCond->rollup);
+  }
+
+  if (pQueryHandle->rollupLevel >= 0) {
+    pQueryHandle->pRollupInfo = calloc(taosArrayGetSize(pQueryHandle->pTableCheckInfo), POINTER_BYTES);
+  }
+
   tsdbInitDataBlockLoadInfo(&pQueryHandle->dataBlockLoadInfo);
   tsdbInitCompBlockLoadInfo(&pQueryHandle->compBlockLoadInfo);
 
@@ -230,6 +254,18 @@ TsdbQueryHandleT tsdbQueryRowsInExternalWindow(TsdbRepoT *tsdb, STsdbQueryCond*
   return pQueryHandle;
 }
 
+int64_t tsdbGetRollupInterval(TsdbRepoT *tsdb, int64_t interval, TSKEY skey) {
+  SRollupCfg* pCfg = &((STsdbRepo*)tsdb)->rollup;
+
+  for (int32_t i = pCfg->numOfLevels - 1; i >= 0; --i) {
+    if (interval % pCfg->levels[i] == 0 && skey % pCfg->levels[i] == 0) {
+      return pCfg->levels[i];
+    }
+  }
+
+  return 0;
+}
+
 static bool initTableMemIterator(STsdbQueryHandle* pHandle, STableCheckInfo* pCheckInfo) {
   STable* pTable = pCheckInfo->pTableObj;
   assert(pTable != NULL);
@@ -249,13 +285,11 @@ static bool initTableMemIterator(STsdbQueryHandle* pHandle, STableCheckInfo* pCh
   assert(pCheckInfo->iter == NULL && pCheckInfo->iiter == NULL);
   
   if (pTable->mem) {
-    pCheckInfo->iter = tSkipListCreateIterFromVal(pTable->mem->pData, (const char*) &pCheckInfo->lastKey,
-                                                  TSDB_DATA_TYPE_TIMESTAMP, order);
+    pCheckInfo->iter = tsdbCreateMemTableIter(pTable->mem, &pCheckInfo->lastKey, order);
   }
   
   if (pTable->imem) {
-    pCheckInfo->iiter = tSkipListCreateIterFromVal(pTable->imem->pData, (const char*) &pCheckInfo->lastKey,
-                                                   TSDB_DATA_TYPE_TIMESTAMP, order);
+    pCheckInfo->iiter = tsdbCreateMemTableIter(pTable->imem, &pCheckInfo->lastKey, order);
   }
   
   // both iterators are NULL, no data in buffer right now
@@ -263,17 +297,16 @@ static bool initTableMemIterator(STsdbQueryHandle* pHandle, STableCheckInfo* pCh
     return false;
   }
   
-  bool memEmpty  = (pCheckInfo->iter == NULL) || (pCheckInfo->iter != NULL && !tSkipListIterNext(pCheckInfo->iter));
-  bool imemEmpty = (pCheckInfo->iiter == NULL) || (pCheckInfo->iiter != NULL && !tSkipListIterNext(pCheckInfo->iiter));
+  bool memEmpty  = (pCheckInfo->iter == NULL) || (pCheckInfo->iter != NULL && !tsdbMemTableIterNext(pCheckInfo->iter));
+  bool imemEmpty = (pCheckInfo->iiter == NULL) || (pCheckInfo->iiter != NULL && !tsdbMemTableIterNext(pCheckInfo->iiter));
   if (memEmpty && imemEmpty) { // buffer is empty
     return false;
   }
   
   if (!memEmpty) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iter);
-    assert(node != NULL);
+    SDataRow row = tsdbMemTableIterGet(pCheckInfo->iter);
+    assert(row != NULL);
   
-    SDataRow row = SL_GET_NODE_DATA(node);
     TSKEY key = dataRowKey(row);  // first timestamp in buffer
     uTrace("%p uid:%" PRId64", tid:%d check data in mem from skey:%" PRId64 ", order:%d, %p", pHandle,
            pCheckInfo->tableId.uid, pCheckInfo->tableId.tid, key, order, pHandle->qinfo);
@@ -282,10 +315,9 @@ static bool initTableMemIterator(STsdbQueryHandle* pHandle, STableCheckInfo* pCh
   }
   
   if (!imemEmpty) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iiter);
-    assert(node != NULL);
+    SDataRow row = tsdbMemTableIterGet(pCheckInfo->iiter);
+    assert(row != NULL);
   
-    SDataRow row = SL_GET_NODE_DATA(node);
     TSKEY key = dataRowKey(row);  // first timestamp in buffer
     uTrace("%p uid:%" PRId64", tid:%d check data in imem from skey:%" PRId64 ", order:%d, %p", pHandle,
            pCheckInfo->tableId.uid, pCheckInfo->tableId.tid, key, order, pHandle->qinfo);
@@ -312,24 +344,22 @@ static bool hasMoreDataInCache(STsdbQueryHandle* pHandle) {
   }
   
   if (pCheckInfo->iter == NULL && pTable->mem) {
-    pCheckInfo->iter = tSkipListCreateIterFromVal(pTable->mem->pData, (const char*) &pCheckInfo->lastKey,
-        TSDB_DATA_TYPE_TIMESTAMP, pHandle->order);
+    pCheckInfo->iter = tsdbCreateMemTableIter(pTable->mem, &pCheckInfo->lastKey, pHandle->order);
     
     if (pCheckInfo->iter == NULL) {
       return false;
     }
   
-    if (!tSkipListIterNext(pCheckInfo->iter)) {  // buffer is empty
+    if (!tsdbMemTableIterNext(pCheckInfo->iter)) {  // buffer is empty
       return false;
     }
   }
   
-  SSkipListNode* node = tSkipListIterGet(pCheckInfo->iter);
-  if (node == NULL) {
+  SDataRow row = tsdbMemTableIterGet(pCheckInfo->iter);
+  if (row == NULL) {
     return false;
   }
 
-  SDataRow row = SL_GET_NODE_DATA(node);
   pCheckInfo->lastKey = dataRowKey(row);  // first timestamp in buffer
   uTrace("%p uid:%" PRId64", tid:%d check data in buffer from skey:%" PRId64 ", order:%d, %p", pHandle,
       pCheckInfo->tableId.uid, pCheckInfo->tableId.tid, pCheckInfo->lastKey, pHandle->order, pHandle->qinfo);
@@ -379,12 +409,78 @@ static int32_t binarySearchForBlockImpl(SCompBlock* pBlock, int32_t numOfBlocks,
   return midSlot;
 }
 
+/*
+ * Load the SCompBlock of the blocks of the table with keys in [s, e] to pCheckInfo->pCompInfo if the block index of
+ * the table is cached, or the SCompBlock of all the blocks otherwise, and put the block index to the cache.
+ * Return the number of blocks loaded, or -1 for failure with terrno set.
+ */
+static int32_t loadCompBlocks(STsdbQueryHandle* pQueryHandle, STableCheckInfo* pCheckInfo, SCompIdx* compIndex,
+                              TSKEY s, TSKEY e) {
+  SRWHelper* pHelper = &pQueryHandle->rhelper;
+  SLRUCache* pCache = pQueryHandle->pTsdb->pBlockIdxCache;
+  bool       indexed = (pCache != NULL && compIndex->numOfBlocks >= TSDB_BLOCK_IDX_MIN_BLOCKS);
+  int32_t    size = TSDB_BLOCK_IDX_SIZE(compIndex->numOfBlocks);
+
+  if (indexed && pQueryHandle->blockIdxSize < size) {
+    char* t = realloc(pQueryHandle->pBlockIdx, size);
+    if (t == NULL) {
+      terrno = TSDB_CODE_SERV_OUT_OF_MEMORY;
+      return -1;
+    }
+
+    pQueryHandle->pBlockIdx = (SBlockIdx*) t;
+    pQueryHandle->blockIdxSize = size;
+  }
+
+  SBlockIdxKey key = {.fid = pHelper->files.fid, .version = pHelper->files.version, .uid = compIndex->uid};
+  if (indexed && taosLRUCacheGet(pCache, &key, sizeof(key), pQueryHandle->pBlockIdx, size) == size) {
+    int32_t start = 0, num = 0;
+    tsdbSearchBlockIdx(pQueryHandle->pBlockIdx, s, e, &start, &num);
+    if (num == 0) return 0;
+
+    if (tsdbLoadCompInfoPart(pHelper, start, num, &pCheckInfo->pCompInfo, &pCheckInfo->compSize) < 0) {
+      terrno = TSDB_CODE_FILE_CORRUPTED;
+      return -1;
+    }
+    return num;
+  }
+
+  if (pCheckInfo->compSize < compIndex->len) {
+    assert(compIndex->len > 0);
+
+    char* t = realloc(pCheckInfo->pCompInfo, compIndex->len);
+    if (t == NULL) {
+      terrno = TSDB_CODE_SERV_OUT_OF_MEMORY;
+      return -1;
+    }
+
+    pCheckInfo->pCompInfo = (SCompInfo*) t;
+    pCheckInfo->compSize = compIndex->len;
+  }
+
+  if (tsdbLoadCompInfo(pHelper, (void *)(pCheckInfo->pCompInfo)) < 0) {
+    terrno = TSDB_CODE_FILE_CORRUPTED;
+    return -1;
+  }
+
+  if (indexed) {
+    tsdbBuildBlockIdx(pCheckInfo->pCompInfo, compIndex->numOfBlocks, pQueryHandle->pBlockIdx);
+    taosLRUCachePut(pCache, &key, sizeof(key), pQueryHandle->pBlockIdx, size);
+  }
+
+  return compIndex->numOfBlocks;
+}
+
 static int32_t getFileCompInfo(STsdbQueryHandle* pQueryHandle, int32_t* numOfBlocks, int32_t type) {
   // todo check open file failed
   SFileGroup* fileGroup = pQueryHandle->pFileGroup;
   
   assert(fileGroup->files[TSDB_FILE_TYPE_HEAD].fname > 0);
+
+  // The files of a group are replaced together with the lock held, by commits and compactions
+  tsdbLockRepo(pQueryHandle->pTsdb);
   tsdbSetAndOpenHelperFile(&pQueryHandle->rhelper, fileGroup);
+  tsdbUnLockRepo(pQueryHandle->pTsdb);
 
   // load all the comp offset value for all tables in this file
   *numOfBlocks = 0;
@@ -399,26 +495,26 @@ static int32_t getFileCompInfo(STsdbQueryHandle* pQueryHandle, int32_t* numOfBlo
       pCheckInfo->numOfBlocks = 0;
       continue;  // no data blocks in the file belongs to pCheckInfo->pTable
     } else {
-      if (pCheckInfo->compSize < compIndex->len) {
-        assert(compIndex->len > 0);
-        
-        char* t = realloc(pCheckInfo->pCompInfo, compIndex->len);
-        assert(t != NULL);
-        
-        pCheckInfo->pCompInfo = (SCompInfo*) t;
-        pCheckInfo->compSize = compIndex->len;
-      }
-      
       tsdbSetHelperTable(&pQueryHandle->rhelper, pCheckInfo->pTableObj, pQueryHandle->pTsdb);
 
-      tsdbLoadCompInfo(&(pQueryHandle->rhelper), (void *)(pCheckInfo->pCompInfo));
-      SCompInfo* pCompInfo = pCheckInfo->pCompInfo;
-      
       TSKEY s = MIN(pCheckInfo->lastKey, pQueryHandle->window.ekey);
       TSKEY e = MAX(pCheckInfo->lastKey, pQueryHandle->window.ekey);
+
+      // only the blocks around [s, e] are loaded if the block index of the table is cached
+      int32_t numOfCompBlocks = loadCompBlocks(pQueryHandle, pCheckInfo, compIndex, s, e);
+      if (numOfCompBlocks < 0) {
+        uError("%p failed to load blocks of table tid:%d, fid:%d", pQueryHandle, pCheckInfo->tableId.tid,
+               fileGroup->fileId);
+        return terrno;
+      } else if (numOfCompBlocks == 0) {
+        pCheckInfo->numOfBlocks = 0;
+        continue;
+      }
+
+      SCompInfo* pCompInfo = pCheckInfo->pCompInfo;
       
       // discard the unqualified data block based on the query time window
-      int32_t start = binarySearchForBlockImpl(pCompInfo->blocks, compIndex->numOfBlocks, s, TSDB_ORDER_ASC);
+      int32_t start = binarySearchForBlockImpl(pCompInfo->blocks, numOfCompBlocks, s, TSDB_ORDER_ASC);
       int32_t end = start;
       
       if (s > pCompInfo->blocks[start].keyLast) {
@@ -426,7 +522,7 @@ static int32_t getFileCompInfo(STsdbQueryHandle* pQueryHandle, int32_t* numOfBlo
       }
 
       // todo speedup the procedure of located end block
-      while (end < compIndex->numOfBlocks && (pCompInfo->blocks[end].keyFirst <= e)) {
+      while (end < numOfCompBlocks && (pCompInfo->blocks[end].keyFirst <= e)) {
         end += 1;
       }
 
@@ -486,9 +582,38 @@ static SArray* getDefaultLoadColumns(STsdbQueryHandle* pQueryHandle, bool loadTS
 static void    doMergeTwoLevelData(STsdbQueryHandle* pQueryHandle, STableCheckInfo* pCheckInfo, SCompBlock* pBlock,
                                      SArray* sa);
 static int32_t binarySearchForKey(char* pValue, int num, TSKEY key, int order);
-static int tsdbReadRowsFromCache(SSkipListIterator* pIter, STable* pTable, TSKEY maxKey, int maxRowsToRead, TSKEY* skey, TSKEY* ekey,
+static int tsdbReadRowsFromCache(SMemTableIter* pIter, STable* pTable, TSKEY maxKey, int maxRowsToRead, TSKEY* skey, TSKEY* ekey,
                                  STsdbQueryHandle* pQueryHandle);
 
+// read ahead the next blocks of current file in the scan order, only done when blocks are really loaded, so that
+// the scans served by the block statistics do not read the data blocks
+static void readAheadDataBlocks(STsdbQueryHandle* pQueryHandle) {
+  SQueryFilePos* cur = &pQueryHandle->cur;
+  if (tsReadAheadBlocks <= 0) {
+    return;
+  }
+
+  int32_t slot = 0, end = 0;
+  if (ASCENDING_TRAVERSE(pQueryHandle->order)) {
+    slot = MAX(cur->slot, pQueryHandle->readAheadSlot) + 1;
+    end = MIN(cur->slot + tsReadAheadBlocks, pQueryHandle->numOfBlocks - 1);
+  } else {
+    slot = MIN(cur->slot, pQueryHandle->readAheadSlot) - 1;
+    end = MAX(cur->slot - tsReadAheadBlocks, 0);
+  }
+
+  int32_t step = ASCENDING_TRAVERSE(pQueryHandle->order) ? 1 : -1;
+  for (; (slot - end) * step <= 0; slot += step) {
+    STableBlockInfo* pBlockInfo = &pQueryHandle->pDataBlockInfo[slot];
+    tsdbReadAheadBlockData(&pQueryHandle->rhelper, pBlockInfo->pTableCheckInfo->pCompInfo, pBlockInfo->pBlock.compBlock);
+    pQueryHandle->readAheadSlot = slot;
+  }
+}
+
+static int32_t compareColId(const void* p1, const void* p2) {
+  return (int32_t)(*(int16_t*)p1) - (int32_t)(*(int16_t*)p2);
+}
+
 static bool doLoadFileDataBlock(STsdbQueryHandle* pQueryHandle, SCompBlock* pBlock, STableCheckInfo* pCheckInfo) {
   STsdbRepo *pRepo = pQueryHandle->pTsdb;
   SCompData* data = calloc(1, sizeof(SCompData) + sizeof(SCompCol) * pBlock->numOfCols);
@@ -505,7 +630,25 @@ static bool doLoadFileDataBlock(STsdbQueryHandle* pQueryHandle, SCompBlock* pBlo
 
   tdInitDataCols(pCheckInfo->pDataCols, tsdbGetTableSchema(tsdbGetMeta(pQueryHandle->pTsdb), pCheckInfo->pTableObj));
 
-  if (tsdbLoadBlockData(&(pQueryHandle->rhelper), pBlock, NULL) == 0) {
+  readAheadDataBlocks(pQueryHandle);
+
+  // only the columns required by the query are read and decoded
+  taosArraySort(sa, compareColId);
+  int32_t numOfCols = 0;
+  int16_t* colIds = (int16_t*) sa->pData;
+  for (int32_t i = 0; i < taosArrayGetSize(sa); ++i) {
+    if (i == 0 || colIds[i] != colIds[numOfCols - 1]) {
+      colIds[numOfCols++] = colIds[i];
+    }
+  }
+
+  // the sub-blocks of the block are in the SCompInfo loaded for its table, the helper keeps the one of the last table
+  SCompInfo* pCompInfo = pQueryHandle->rhelper.pCompInfo;
+  pQueryHandle->rhelper.pCompInfo = pCheckInfo->pCompInfo;
+  int32_t code = tsdbLoadBlockDataCols(&(pQueryHandle->rhelper), pBlock, colIds, numOfCols);
+  pQueryHandle->rhelper.pCompInfo = pCompInfo;
+
+  if (code == 0) {
     SDataBlockLoadInfo* pBlockLoadInfo = &pQueryHandle->dataBlockLoadInfo;
 
     pBlockLoadInfo->fileGroup = pQueryHandle->pFileGroup;
@@ -529,16 +672,13 @@ static void handleDataMergeIfNeeded(STsdbQueryHandle* pQueryHandle, SCompBlock*
   /*bool hasData = */ initTableMemIterator(pQueryHandle, pCheckInfo);
   
   TSKEY k1 = TSKEY_INITIAL_VAL, k2 = TSKEY_INITIAL_VAL;
-  if (pCheckInfo->iter != NULL && tSkipListIterGet(pCheckInfo->iter) != NULL) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iter);
-    
-    SDataRow row = SL_GET_NODE_DATA(node);
+  if (pCheckInfo->iter != NULL && tsdbMemTableIterGet(pCheckInfo->iter) != NULL) {
+    SDataRow row = tsdbMemTableIterGet(pCheckInfo->iter);
     k1 = dataRowKey(row);
     
     if (k1 == binfo.window.skey) {
-      if (tSkipListIterNext(pCheckInfo->iter)) {
-        node = tSkipListIterGet(pCheckInfo->iter);
-        row = SL_GET_NODE_DATA(node);
+      if (tsdbMemTableIterNext(pCheckInfo->iter)) {
+        row = tsdbMemTableIterGet(pCheckInfo->iter);
         k1 = dataRowKey(row);
       } else {
         k1 = TSKEY_INITIAL_VAL;
@@ -546,16 +686,13 @@ static void handleDataMergeIfNeeded(STsdbQueryHandle* pQueryHandle, SCompBlock*
     }
   }
   
-  if (pCheckInfo->iiter != NULL && tSkipListIterGet(pCheckInfo->iiter) != NULL) {
-    SSkipListNode* node = tSkipListIterGet(pCheckInfo->iiter);
-    
-    SDataRow row = SL_GET_NODE_DATA(node);
+  if (pCheckInfo->iiter != NULL && tsdbMemTableIterGet(pCheckInfo->iiter) != NULL) {
+    SDataRow row = tsdbMemTableIterGet(pCheckInfo->iiter);
     k2 = dataRowKey(row);
     
     if (k2 == binfo.window.skey) {
-      if (tSkipListIterNext(pCheckInfo->iiter)) {
-        node = tSkipListIterGet(pCheckInfo->iiter);
-        row = SL_GET_NODE_DATA(node);
+      if (tsdbMemTableIterNext(pCheckInfo->iiter)) {
+        row = tsdbMemTableIterGet(pCheckInfo->iiter);
         k2 = dataRowKey(row);
       } else {
         k2 = TSKEY_INITIAL_VAL;
@@ -871,15 +1008,14 @@ static void doMergeTwoLevelData(STsdbQueryHandle* pQueryHandle, STableCheckInfo*
     //  } else if (pCheckInfo->iter == NULL && pCheckInfo->iiter != NULL) {
     //  } else { // iter and iiter are all not NULL, three-way merge data block
     STSchema* pSchema = tsdbGetTableSchema(tsdbGetMeta(pQueryHandle->pTsdb), pCheckInfo->pTableObj);
-    SSkipListNode* node = NULL;
+    SDataRow row = NULL;
     
     do {
-      node = tSkipListIterGet(pCheckInfo->iter);
-      if (node == NULL) {
+      row = tsdbMemTableIterGet(pCheckInfo->iter);
+      if (row == NULL) {
         break;
       }
 
-      SDataRow row = SL_GET_NODE_DATA(node);
       TSKEY    key = dataRowKey(row);
       if ((key > pQueryHandle->window.ekey && ASCENDING_TRAVERSE(pQueryHandle->order)) ||
           (key < pQueryHandle->window.ekey && !ASCENDING_TRAVERSE(pQueryHandle->order))) {
@@ -903,9 +1039,9 @@ static void doMergeTwoLevelData(STsdbQueryHandle* pQueryHandle, STableCheckInfo*
         cur->lastKey  = key + step;
         cur->mixBlock = true;
 
-        tSkipListIterNext(pCheckInfo->iter);
+        tsdbMemTableIterNext(pCheckInfo->iter);
       } else if (key == tsArray[pos]) {  // data in buffer has the same timestamp of data in file block, ignore it
-        tSkipListIterNext(pCheckInfo->iter);
+        tsdbMemTableIterNext(pCheckInfo->iter);
       } else if ((key > tsArray[pos] && ASCENDING_TRAVERSE(pQueryHandle->order)) ||
                   (key < tsArray[pos] && !ASCENDING_TRAVERSE(pQueryHandle->order))) {
         if (cur->win.skey == TSKEY_INITIAL_VAL) {
@@ -915,7 +1051,7 @@ static void doMergeTwoLevelData(STsdbQueryHandle* pQueryHandle, STableCheckInfo*
         int32_t order = ASCENDING_TRAVERSE(pQueryHandle->order) ? TSDB_ORDER_DESC : TSDB_ORDER_ASC;
         int32_t end = vnodeBinarySearchKey(pCols->cols[0].pData, pCols->numOfPoints, key, order);
         if (tsArray[end] == key) { // the value of key in cache equals to the end timestamp value, ignore it
-          tSkipListIterNext(pCheckInfo->iter);
+          tsdbMemTableIterNext(pCheckInfo->iter);
         }
         
         int32_t start = -1;
@@ -946,9 +1082,9 @@ static void doMergeTwoLevelData(STsdbQueryHandle* pQueryHandle, STableCheckInfo*
        * if cache is empty, load remain file block data. In contrast, if there are remain data in cache, do NOT
        * copy them all to result buffer, since it may be overlapped with file data block.
        */
-      if (node == NULL ||
-          ((dataRowKey(SL_GET_NODE_DATA(node)) > pQueryHandle->window.ekey) && ASCENDING_TRAVERSE(pQueryHandle->order)) ||
-          ((dataRowKey(SL_GET_NODE_DATA(node)) < pQueryHandle->window.ekey) && !ASCENDING_TRAVERSE(pQueryHandle->order))) {
+      if (row == NULL ||
+          ((dataRowKey(row) > pQueryHandle->window.ekey) && ASCENDING_TRAVERSE(pQueryHandle->order)) ||
+          ((dataRowKey(row) < pQueryHandle->window.ekey) && !ASCENDING_TRAVERSE(pQueryHandle->order))) {
         // no data in cache or data in cache is greater than the ekey of time window, load data from file block
         if (cur->win.skey == TSKEY_INITIAL_VAL) {
           cur->win.skey = tsArray[pos];
@@ -1211,6 +1347,156 @@ static int32_t createDataBlocksInfo(STsdbQueryHandle* pQueryHandle, int32_t numO
 }
 
 // todo opt for only one table case
+static bool moveToNextRollupEntry(STsdbQueryHandle* pQueryHandle) {
+  SQueryFilePos* cur = &pQueryHandle->cur;
+  int32_t        level = pQueryHandle->rollupLevel;
+  size_t         numOfTables = taosArrayGetSize(pQueryHandle->pTableCheckInfo);
+
+  pQueryHandle->rollupEntry += 1;
+  while (pQueryHandle->rollupTable < numOfTables) {
+    SRollupInfo* pInfo = pQueryHandle->pRollupInfo[pQueryHandle->rollupTable];
+
+    if (pInfo != NULL && pQueryHandle->rollupEntry < pInfo->numOfEntries[level]) {
+      SRollupEntry*    pEntry = TSDB_ROLLUP_ENTRY_AT(pInfo, level, pQueryHandle->rollupEntry);
+      STableCheckInfo* pCheckInfo = taosArrayGet(pQueryHandle->pTableCheckInfo, pQueryHandle->rollupTable);
+
+      cur->rows = pEntry->numOfRows;
+      cur->win = (STimeWindow){.skey = pEntry->keyFirst, .ekey = pEntry->keyLast};
+      cur->lastKey = pEntry->keyLast + 1;
+      cur->mixBlock = false;
+      cur->blockCompleted = true;
+
+      pQueryHandle->realNumOfRows = pEntry->numOfRows;
+      pCheckInfo->lastKey = pEntry->keyLast + 1;
+      return true;
+    }
+
+    pQueryHandle->rollupTable += 1;
+    pQueryHandle->rollupEntry = 0;
+  }
+
+  return false;
+}
+
+/*
+ * The rollups of a file group are returned instead of its data blocks if the file group is covered by the query
+ * window, no data of the group is in cache, and the rollups of all tables are valid and have all query columns.
+ */
+static bool loadRollupOfFileGroup(STsdbQueryHandle* pQueryHandle) {
+  STsdbRepo*  pTsdb = pQueryHandle->pTsdb;
+  SFileGroup* pGroup = pQueryHandle->pFileGroup;
+  int32_t     level = pQueryHandle->rollupLevel;
+  size_t      numOfTables = taosArrayGetSize(pQueryHandle->pTableCheckInfo);
+  size_t      numOfCols = QH_GET_NUM_OF_COLS(pQueryHandle);
+  SRollupFile file = {0};
+
+  if (level < 0 || !ASCENDING_TRAVERSE(pQueryHandle->order)) {
+    return false;
+  }
+
+  TSKEY minKey = 0, maxKey = 0;
+  tsdbGetKeyRangeOfFileId(pTsdb->config.daysPerFile, pTsdb->config.precision, pGroup->fileId, &minKey, &maxKey);
+  if (minKey < pQueryHandle->window.skey || maxKey > pQueryHandle->window.ekey) {
+    return false;
+  }
+
+  for (int32_t i = 0; i < numOfTables; ++i) {
+    STable* pTable = ((STableCheckInfo*)taosArrayGet(pQueryHandle->pTableCheckInfo, i))->pTableObj;
+    SMemTable* pMem[2] = {pTable->mem, pTable->imem};
+    for (int32_t j = 0; j < 2; ++j) {
+      if (pMem[j] != NULL && pMem[j]->keyFirst <= maxKey && pMem[j]->keyLast >= minKey) {
+        return false;
+      }
+    }
+  }
+
+  if (tsdbOpenRollupFile(pTsdb, pGroup, &file) < 0) {
+    return false;
+  }
+
+  bool ret = true;
+  for (int32_t i = 0; i < numOfTables && ret; ++i) {
+    STableCheckInfo* pCheckInfo = taosArrayGet(pQueryHandle->pTableCheckInfo, i);
+
+    tfree(pQueryHandle->pRollupInfo[i]);
+    if (tsdbLoadRollupInfo(&file, pCheckInfo->tableId, level, &pQueryHandle->pRollupInfo[i]) < 0) {
+      uError("%p failed to load rollups of table tid:%d, fid:%d", pQueryHandle, pCheckInfo->tableId.tid,
+             pGroup->fileId);
+      ret = false;
+      break;
+    }
+
+    SRollupInfo* pInfo = pQueryHandle->pRollupInfo[i];
+    if (pInfo == NULL) continue;
+
+    // all query columns must be in the rollups, and the number of null values must fit in SDataStatis
+    for (int32_t j = 0; j < numOfCols && ret; ++j) {
+      SColumnInfoData* pColInfo = taosArrayGet(pQueryHandle->pColumns, j);
+      if (pColInfo->info.colId == PRIMARYKEY_TIMESTAMP_COL_INDEX) continue;
+
+      int32_t k = 0;
+      while (k < pInfo->numOfCols && pInfo->cols[k].colId != pColInfo->info.colId) k++;
+      if (k >= pInfo->numOfCols) {
+        ret = false;
+        break;
+      }
+
+      for (int32_t e = 0; e < pInfo->numOfEntries[level]; ++e) {
+        if (TSDB_ROLLUP_STAT_AT(TSDB_ROLLUP_ENTRY_AT(pInfo, level, e), k)->numOfNull > INT16_MAX) {
+          ret = false;
+          break;
+        }
+      }
+    }
+  }
+
+  tsdbCloseRollupFile(&file);
+
+  pQueryHandle->rollupTable = 0;
+  pQueryHandle->rollupEntry = -1;
+  if (ret && moveToNextRollupEntry(pQueryHandle)) {
+    return true;
+  }
+
+  for (int32_t i = 0; i < numOfTables; ++i) {
+    tfree(pQueryHandle->pRollupInfo[i]);
+  }
+
+  return false;
+}
+
+static void getRollupEntryStatis(STsdbQueryHandle* pQueryHandle) {
+  SRollupInfo*  pInfo = pQueryHandle->pRollupInfo[pQueryHandle->rollupTable];
+  SRollupEntry* pEntry = TSDB_ROLLUP_ENTRY_AT(pInfo, pQueryHandle->rollupLevel, pQueryHandle->rollupEntry);
+  size_t        numOfCols = QH_GET_NUM_OF_COLS(pQueryHandle);
+
+  for (int32_t i = 0; i < numOfCols; ++i) {
+    SColumnInfoData* pColInfo = taosArrayGet(pQueryHandle->pColumns, i);
+    SDataStatis*     pStatis = &pQueryHandle->statis[i];
+
+    memset(pStatis, 0, sizeof(SDataStatis));
+    pStatis->colId = pColInfo->info.colId;
+
+    if (pColInfo->info.colId == PRIMARYKEY_TIMESTAMP_COL_INDEX) {
+      pStatis->min = pEntry->keyFirst;
+      pStatis->max = pEntry->keyLast;
+      continue;
+    }
+
+    // the columns have been checked when the rollups are loaded
+    for (int32_t k = 0; k < pInfo->numOfCols; ++k) {
+      if (pInfo->cols[k].colId == pColInfo->info.colId) {
+        SRollupStat* pStat = TSDB_ROLLUP_STAT_AT(pEntry, k);
+        pStatis->sum = pStat->sum;
+        pStatis->max = pStat->max;
+        pStatis->min = pStat->min;
+        pStatis->numOfNull = pStat->numOfNull;
+        break;
+      }
+    }
+  }
+}
+
 static bool getDataBlocksInFilesImpl(STsdbQueryHandle* pQueryHandle) {
   pQueryHandle->numOfBlocks = 0;
   SQueryFilePos* cur = &pQueryHandle->cur;
@@ -1219,9 +1505,19 @@ static bool getDataBlocksInFilesImpl(STsdbQueryHandle* pQueryHandle) {
   int32_t numOfTables = taosArrayGetSize(pQueryHandle->pTableCheckInfo);
   
   while ((pQueryHandle->pFileGroup = tsdbGetFileGroupNext(&pQueryHandle->fileIter)) != NULL) {
+    cur->rollup = loadRollupOfFileGroup(pQueryHandle);
+    if (cur->rollup) {
+      cur->fid = pQueryHandle->pFileGroup->fileId;
+      uTrace("%p rollups of level %d used for fid:%d", pQueryHandle, pQueryHandle->rollupLevel, cur->fid);
+      return true;
+    }
+
     int32_t type = ASCENDING_TRAVERSE(pQueryHandle->order)? QUERY_RANGE_GREATER_EQUAL:QUERY_RANGE_LESS_EQUAL;
-    if (getFileCompInfo(pQueryHandle, &numOfBlocks, type) != TSDB_CODE_SUCCESS) {
-      break;
+    int32_t code = getFileCompInfo(pQueryHandle, &numOfBlocks, type);
+    if (code != TSDB_CODE_SUCCESS) {
+      pQueryHandle->code = code;
+      cur->fid = -1;
+      return false;
     }
     
     uTrace("%p %d blocks found in file for %d table(s), fid:%d", pQueryHandle, numOfBlocks,
@@ -1253,6 +1549,7 @@ static bool getDataBlocksInFilesImpl(STsdbQueryHandle* pQueryHandle) {
   
   cur->slot = ASCENDING_TRAVERSE(pQueryHandle->order)? 0:pQueryHandle->numOfBlocks-1;
   cur->fid = pQueryHandle->pFileGroup->fileId;
+  pQueryHandle->readAheadSlot = cur->slot;
   
   STableBlockInfo* pBlockInfo = &pQueryHandle->pDataBlockInfo[cur->slot];
   return loadFileDataBlock(pQueryHandle, pBlockInfo->pBlock.compBlock, pBlockInfo->pTableCheckInfo);
@@ -1270,6 +1567,13 @@ static bool getDataBlocksInFiles(STsdbQueryHandle* pQueryHandle) {
     tsdbInitFileGroupIter(pFileHandle, &pQueryHandle->fileIter, pQueryHandle->order);
     tsdbSeekFileGroupIter(&pQueryHandle->fileIter, fid);
 
+    return getDataBlocksInFilesImpl(pQueryHandle);
+  } else if (cur->rollup) {
+    // all rollup entries of current file group have been returned, try next file
+    if (moveToNextRollupEntry(pQueryHandle)) {
+      return true;
+    }
+
     return getDataBlocksInFilesImpl(pQueryHandle);
   } else {
     // check if current file block is all consumed
@@ -1326,6 +1630,10 @@ bool tsdbNextDataBlock(TsdbQueryHandleT* pqHandle) {
     if (getDataBlocksInFiles(pQueryHandle)) {
       return true;
     }
+
+    if (pQueryHandle->code != TSDB_CODE_SUCCESS) {
+      return false;
+    }
   
     pQueryHandle->activeIndex = 0;
     pQueryHandle->checkFiles  = false;
@@ -1336,6 +1644,10 @@ bool tsdbNextDataBlock(TsdbQueryHandleT* pqHandle) {
   return doHasDataInBuffer(pQueryHandle);
 }
 
+int32_t tsdbGetQueryCode(TsdbQueryHandleT* pqHandle) {
+  return ((STsdbQueryHandle*) pqHandle)->code;
+}
+
 void changeQueryHandleForLastrowQuery(TsdbQueryHandleT pqHandle) {
   STsdbQueryHandle* pQueryHandle = (STsdbQueryHandle*) pqHandle;
   assert(!ASCENDING_TRAVERSE(pQueryHandle->order));
@@ -1369,7 +1681,8 @@ void changeQueryHandleForLastrowQuery(TsdbQueryHandleT pqHandle) {
     }
     
     STableCheckInfo* pTableCheckInfo = taosArrayGet(pQueryHandle->pTableCheckInfo, i);
-    tSkipListDestroyIter(pTableCheckInfo->iter);
+    tsdbDestroyMemTableIter(pTableCheckInfo->iter);
+    tsdbDestroyMemTableIter(pTableCheckInfo->iiter);
     
     if (pTableCheckInfo->pDataCols != NULL) {
       tfree(pTableCheckInfo->pDataCols->buf);
@@ -1391,19 +1704,18 @@ void changeQueryHandleForLastrowQuery(TsdbQueryHandleT pqHandle) {
   pQueryHandle->window = (STimeWindow) {key, key};
 }
 
-static int tsdbReadRowsFromCache(SSkipListIterator* pIter, STable* pTable, TSKEY maxKey, int maxRowsToRead, TSKEY* skey, TSKEY* ekey,
+static int tsdbReadRowsFromCache(SMemTableIter* pIter, STable* pTable, TSKEY maxKey, int maxRowsToRead, TSKEY* skey, TSKEY* ekey,
                                  STsdbQueryHandle* pQueryHandle) {
   int     numOfRows = 0;
   int32_t numOfCols = taosArrayGetSize(pQueryHandle->pColumns);
   *skey = TSKEY_INITIAL_VAL;
 
   do {
-    SSkipListNode* node = tSkipListIterGet(pIter);
-    if (node == NULL) {
+    SDataRow row = tsdbMemTableIterGet(pIter);
+    if (row == NULL) {
       break;
     }
 
-    SDataRow row = SL_GET_NODE_DATA(node);
     TSKEY key = dataRowKey(row);
     
     if ((key > maxKey && ASCENDING_TRAVERSE(pQueryHandle->order)) ||
@@ -1454,11 +1766,11 @@ static int tsdbReadRowsFromCache(SSkipListIterator* pIter, STable* pTable, TSKEY
     }
 
     if (++numOfRows >= maxRowsToRead) {
-      tSkipListIterNext(pIter);
+      tsdbMemTableIterNext(pIter);
       break;
     }
     
-  } while(tSkipListIterNext(pIter));
+  } while(tsdbMemTableIterNext(pIter));
 
   assert(numOfRows <= maxRowsToRead);
   
@@ -1482,7 +1794,19 @@ SDataBlockInfo tsdbRetrieveDataBlockInfo(TsdbQueryHandleT* pQueryHandle) {
   int32_t step = ASCENDING_TRAVERSE(pHandle->order)? 1:-1;
   
   // there are data in file
-  if (pHandle->cur.fid >= 0) {
+  if (pHandle->cur.fid >= 0 && pHandle->cur.rollup) {
+    STableCheckInfo* pCheckInfo = taosArrayGet(pHandle->pTableCheckInfo, pHandle->rollupTable);
+
+    SDataBlockInfo blockInfo = {
+        .uid = pCheckInfo->tableId.uid,
+        .tid = pCheckInfo->tableId.tid,
+        .rows = pHandle->cur.rows,
+        .numOfCols = QH_GET_NUM_OF_COLS(pHandle),
+        .window = pHandle->cur.win,
+    };
+
+    return blockInfo;
+  } else if (pHandle->cur.fid >= 0) {
     STableBlockInfo* pBlockInfo = &pHandle->pDataBlockInfo[pHandle->cur.slot];
     STableCheckInfo* pCheckInfo = pBlockInfo->pTableCheckInfo;
   
@@ -1498,7 +1822,10 @@ SDataBlockInfo tsdbRetrieveDataBlockInfo(TsdbQueryHandleT* pQueryHandle) {
   
       return blockInfo;
     } else {
-      return getTrueDataBlockInfo(pCheckInfo, pBlockInfo->pBlock.compBlock);
+      // the block statistics are returned for the columns of the query, not the columns in file block
+      SDataBlockInfo blockInfo = getTrueDataBlockInfo(pCheckInfo, pBlockInfo->pBlock.compBlock);
+      blockInfo.numOfCols = QH_GET_NUM_OF_COLS(pHandle);
+      return blockInfo;
     }
   } else {
     STableCheckInfo* pCheckInfo = taosArrayGet(pHandle->pTableCheckInfo, pHandle->activeIndex);
@@ -1530,9 +1857,72 @@ SDataBlockInfo tsdbRetrieveDataBlockInfo(TsdbQueryHandleT* pQueryHandle) {
   }
 }
 
-// return null for data block in cache
+/*
+ * Return null for data block in cache, and for the file block that is not returned as a whole, i.e., the block
+ * that overlaps the boundary of the query time window or is merged with the data in cache. For other file blocks,
+ * only the SCompData of the block is read, so the query can be answered without the block data being loaded.
+ */
 int32_t tsdbRetrieveDataBlockStatisInfo(TsdbQueryHandleT* pQueryHandle, SDataStatis** pBlockStatis) {
+  STsdbQueryHandle* pHandle = (STsdbQueryHandle*)pQueryHandle;
+  SQueryFilePos*    cur = &pHandle->cur;
+
   *pBlockStatis = NULL;
+  if (cur->fid < 0 || cur->mixBlock) {
+    return TSDB_CODE_SUCCESS;
+  }
+
+  if (cur->rollup) {
+    getRollupEntryStatis(pHandle);
+    *pBlockStatis = pHandle->statis;
+    return TSDB_CODE_SUCCESS;
+  }
+
+  STableBlockInfo* pBlockInfo = &pHandle->pDataBlockInfo[cur->slot];
+  SCompBlock*      pBlock = pBlockInfo->pBlock.compBlock;
+
+  // the statistics of a super block are kept in each of its sub-blocks
+  if (pBlock->numOfSubBlocks > 1) {
+    return TSDB_CODE_SUCCESS;
+  }
+
+  TSKEY skey = MIN(pHandle->window.skey, pHandle->window.ekey);
+  TSKEY ekey = MAX(pHandle->window.skey, pHandle->window.ekey);
+  if (pBlock->keyFirst < skey || pBlock->keyLast > ekey) {
+    return TSDB_CODE_SUCCESS;
+  }
+
+  size_t numOfCols = QH_GET_NUM_OF_COLS(pHandle);
+  for (int32_t i = 0; i < numOfCols; ++i) {
+    SColumnInfoData* pColInfo = taosArrayGet(pHandle->pColumns, i);
+
+    // no statistics is kept for bool, binary and nchar columns
+    if (pColInfo->info.colId != PRIMARYKEY_TIMESTAMP_COL_INDEX &&
+        tDataTypeDesc[pColInfo->info.type].getStatisFunc == NULL) {
+      return TSDB_CODE_SUCCESS;
+    }
+
+    memset(&pHandle->statis[i], 0, sizeof(SDataStatis));
+    pHandle->statis[i].colId = pColInfo->info.colId;
+  }
+
+  if (tsdbLoadCompData(&pHandle->rhelper, pBlock, NULL) < 0) {
+    uError("%p failed to load block statistics, fid:%d slot:%d", pHandle, cur->fid, cur->slot);
+    return TSDB_CODE_FILE_CORRUPTED;
+  }
+
+  // the block is loaded if its statistics are in an old layout
+  if (tsdbGetDataStatis(&pHandle->rhelper, pHandle->statis, numOfCols) < 0) {
+    return TSDB_CODE_SUCCESS;
+  }
+
+  // the column that is not in the block are all null values
+  for (int32_t i = 0; i < numOfCols; ++i) {
+    if (pHandle->statis[i].numOfNull == -1) {
+      pHandle->statis[i].numOfNull = pBlock->numOfPoints;
+    }
+  }
+
+  *pBlockStatis = pHandle->statis;
   return TSDB_CODE_SUCCESS;
 }
 
@@ -1545,6 +1935,9 @@ SArray* tsdbRetrieveDataBlock(TsdbQueryHandleT* pQueryHandle, SArray* pIdList) {
 
   if (pHandle->cur.fid < 0) {
     return pHandle->pColumns;
+  } else if (pHandle->cur.rollup) {
+    // the rows of a rollup entry are not loaded, only its statistics can be retrieved
+    return NULL;
   } else {
     STableBlockInfo* pBlockInfoEx = &pHandle->pDataBlockInfo[pHandle->cur.slot];
     STableCheckInfo* pCheckInfo = pBlockInfoEx->pTableCheckInfo;
@@ -1585,6 +1978,45 @@ SArray* tsdbRetrieveDataBlock(TsdbQueryHandleT* pQueryHandle, SArray* pIdList) {
   }
 }
 
+int32_t tsdbRetrieveDataBlockDictCodes(TsdbQueryHandleT* pQueryHandle, int16_t colId, const uint8_t** codes) {
+  STsdbQueryHandle* pHandle = (STsdbQueryHandle*)pQueryHandle;
+  SQueryFilePos*    cur = &pHandle->cur;
+
+  *codes = NULL;
+  if (cur->fid < 0 || cur->mixBlock || cur->rollup) {
+    return 0;
+  }
+
+  // the rows of the block in the helper are the ones returned, unless it is loaded for another block
+  STableCheckInfo*    pCheckInfo = pHandle->pDataBlockInfo[cur->slot].pTableCheckInfo;
+  SDataBlockLoadInfo* pBlockLoadInfo = &pHandle->dataBlockLoadInfo;
+  SDataCols*          pCols = pHandle->rhelper.pDataCols[0];
+  if (pBlockLoadInfo->slot != cur->slot || pBlockLoadInfo->fileGroup == NULL ||
+      pBlockLoadInfo->fileGroup->fileId != cur->fid || pBlockLoadInfo->tid != pCheckInfo->pTableObj->tableId.tid ||
+      pCols->numOfPoints != pHandle->realNumOfRows) {
+    return 0;
+  }
+
+  // only the columns of the query are loaded
+  bool required = false;
+  for (int32_t i = 0; i < QH_GET_NUM_OF_COLS(pHandle); ++i) {
+    SColumnInfoData* pColInfo = taosArrayGet(pHandle->pColumns, i);
+    if (pColInfo->info.colId == colId) required = true;
+  }
+
+  for (int32_t i = 0; required && i < pCols->numOfCols; ++i) {
+    SDataCol* pCol = &pCols->cols[i];
+    if (pCol->colId == colId) {
+      if (pCol->dictSize == 0) return 0;
+
+      *codes = pCol->codes;
+      return pCol->dictSize;
+    }
+  }
+
+  return 0;
+}
+
 SArray* tsdbRetrieveDataRow(TsdbQueryHandleT* pQueryHandle, SArray* pIdList, SQueryRowCond* pCond) { return NULL; }
 
 TsdbQueryHandleT* tsdbQueryFromTagConds(STsdbQueryCond* pCond, int16_t stableId, const char* pTagFilterStr) {
@@ -1806,22 +2238,18 @@ SArray* createTableGroup(SArray* pTableList, STSchema* pTagSchema, SColIndex* pC
   return pTableGroup;
 }
 
-bool indexedNodeFilterFp(const void* pNode, void* param) {
-  tQueryInfo* pInfo = (tQueryInfo*) param;
-  
-  STableIndexElem* elem = (STableIndexElem*)(SL_GET_NODE_DATA((SSkipListNode*)pNode));
-
+static bool tableFilterFp(STable* pTable, tQueryInfo* pInfo) {
   char*  val = NULL;
   int8_t type = pInfo->sch.type;
 
   if (pInfo->colIndex == TSDB_TBNAME_COLUMN_INDEX) {
-    val = (char*) elem->pTable->name;
+    val = (char*) pTable->name;
     type = TSDB_DATA_TYPE_BINARY;
   } else {
     STSchema* pTSchema = (STSchema*) pInfo->param; // todo table schema is identical to stable schema??
     
     int32_t offset = pTSchema->columns[pInfo->colIndex].offset;
-    val = tdGetRowDataOfCol(elem->pTable->tagVal, pInfo->sch.type, TD_DATA_ROW_HEAD_SIZE + offset);
+    val = tdGetRowDataOfCol(pTable->tagVal, pInfo->sch.type, TD_DATA_ROW_HEAD_SIZE + offset);
   }
 
   int32_t ret = 0;
@@ -1868,7 +2296,152 @@ bool indexedNodeFilterFp(const void* pNode, void* param) {
   return true;
 }
 
-static int32_t doQueryTableList(STable* pSTable, SArray* pRes, tExprNode* pExpr) {
+bool indexedNodeFilterFp(const void* pNode, void* param) {
+  STableIndexElem* elem = (STableIndexElem*)(SL_GET_NODE_DATA((SSkipListNode*)pNode));
+  return tableFilterFp(elem->pTable, (tQueryInfo*) param);
+}
+
+/*
+ * The tag conditions are evaluated with the tag hash indexes of the super table if they can avoid scanning all the
+ * child tables, i.e. an equal filter on an indexed tag, an AND of which either side can, or an OR of which both sides
+ * can. The qualified child tables are kept in a bitmap of their tids, so AND and OR are word-wise operations, and the
+ * other filters are only applied to the tables already qualified by the indexed side of an AND.
+ */
+typedef struct STidBitmap {
+  int32_t   numOfWords;
+  uint64_t* words;
+} STidBitmap;
+
+#define TID_BITMAP_SET(b, tid)  ((b)->words[(tid) >> 6] |= (1ULL << ((tid) & 63)))
+
+static bool isLeafTagExpr(tExprNode* pExpr) {
+  return pExpr->_node.pLeft->nodeType != TSQL_NODE_EXPR && pExpr->_node.pRight->nodeType != TSQL_NODE_EXPR;
+}
+
+static void tagExprPrepare(tExprNode* pExpr, STSchema* pTagSchema) {
+  if (isLeafTagExpr(pExpr)) {
+    filterPrepare(pExpr, pTagSchema);
+  } else {
+    tagExprPrepare(pExpr->_node.pLeft, pTagSchema);
+    tagExprPrepare(pExpr->_node.pRight, pTagSchema);
+  }
+}
+
+static bool tagExprUseIndex(STable* pSTable, tExprNode* pExpr) {
+  if (isLeafTagExpr(pExpr)) {
+    tQueryInfo* pInfo = pExpr->_node.info;
+    return pInfo->optr == TSDB_RELATION_EQUAL && tsdbIsTagIndexed(pSTable, pInfo->colIndex);
+  }
+
+  bool left = tagExprUseIndex(pSTable, pExpr->_node.pLeft);
+  if (pExpr->_node.optr == TSDB_RELATION_AND) {
+    return left || tagExprUseIndex(pSTable, pExpr->_node.pRight);
+  } else {
+    return left && tagExprUseIndex(pSTable, pExpr->_node.pRight);
+  }
+}
+
+static int32_t tidBitmapInit(STidBitmap* pBitmap, int32_t maxTables) {
+  pBitmap->numOfWords = (maxTables + 63) / 64;
+  pBitmap->words = calloc(pBitmap->numOfWords, sizeof(uint64_t));
+  return (pBitmap->words == NULL) ? TSDB_CODE_SERV_OUT_OF_MEMORY : TSDB_CODE_SUCCESS;
+}
+
+/*
+ * Evaluate the tag conditions into pRes. All the child tables are candidates if pCand is NULL, in which case pExpr
+ * must be able to use the tag indexes, otherwise only the tables in pCand are evaluated.
+ */
+static int32_t tagExprEvaluate(STsdbMeta* pMeta, STable* pSTable, tExprNode* pExpr, STidBitmap* pCand,
+                               STidBitmap* pRes) {
+  memset(pRes->words, 0, sizeof(uint64_t) * pRes->numOfWords);
+
+  if (isLeafTagExpr(pExpr)) {
+    tQueryInfo* pInfo = pExpr->_node.info;
+
+    if (pInfo->optr == TSDB_RELATION_EQUAL && tsdbIsTagIndexed(pSTable, pInfo->colIndex)) {
+      SArray* pTids = tsdbGetTablesOfTagValue(pSTable, pInfo->colIndex, pInfo->q);
+      size_t  size = taosArrayGetSize(pTids);
+      for (int32_t i = 0; i < size; ++i) {
+        int32_t tid = *(int32_t*)taosArrayGet(pTids, i);
+        TID_BITMAP_SET(pRes, tid);
+      }
+
+      if (pCand != NULL) {
+        for (int32_t i = 0; i < pRes->numOfWords; ++i) pRes->words[i] &= pCand->words[i];
+      }
+    } else {
+      assert(pCand != NULL);
+      for (int32_t i = 0; i < pCand->numOfWords; ++i) {
+        for (uint64_t w = pCand->words[i]; w != 0; w &= (w - 1)) {
+          int32_t tid = i * 64 + __builtin_ctzll(w);
+          STable* pTable = pMeta->tables[tid];
+          if (pTable != NULL && tableFilterFp(pTable, pInfo)) TID_BITMAP_SET(pRes, tid);
+        }
+      }
+    }
+
+    return TSDB_CODE_SUCCESS;
+  }
+
+  STidBitmap tmp = {0};
+  int32_t    code = tidBitmapInit(&tmp, pMeta->maxTables);
+  if (code != TSDB_CODE_SUCCESS) return code;
+
+  tExprNode* pLeft = pExpr->_node.pLeft;
+  tExprNode* pRight = pExpr->_node.pRight;
+
+  if (pExpr->_node.optr == TSDB_RELATION_AND) {
+    // evaluate the side using the indexes first, and the other side on the tables it qualifies only
+    if (pCand == NULL && !tagExprUseIndex(pSTable, pLeft)) {
+      pLeft = pExpr->_node.pRight;
+      pRight = pExpr->_node.pLeft;
+    }
+
+    code = tagExprEvaluate(pMeta, pSTable, pLeft, pCand, &tmp);
+    if (code == TSDB_CODE_SUCCESS) code = tagExprEvaluate(pMeta, pSTable, pRight, &tmp, pRes);
+  } else {
+    assert(pExpr->_node.optr == TSDB_RELATION_OR);
+
+    code = tagExprEvaluate(pMeta, pSTable, pLeft, pCand, &tmp);
+    if (code == TSDB_CODE_SUCCESS) code = tagExprEvaluate(pMeta, pSTable, pRight, pCand, pRes);
+    if (code == TSDB_CODE_SUCCESS) {
+      for (int32_t i = 0; i < pRes->numOfWords; ++i) pRes->words[i] |= tmp.words[i];
+    }
+  }
+
+  free(tmp.words);
+  return code;
+}
+
+static int32_t doQueryTableListByTagIndex(STsdbMeta* pMeta, STable* pSTable, SArray* pRes, tExprNode* pExpr) {
+  STidBitmap res = {0};
+  int32_t    code = tidBitmapInit(&res, pMeta->maxTables);
+  if (code != TSDB_CODE_SUCCESS) return code;
+
+  code = tagExprEvaluate(pMeta, pSTable, pExpr, NULL, &res);
+  if (code == TSDB_CODE_SUCCESS) {
+    for (int32_t i = 0; i < res.numOfWords; ++i) {
+      for (uint64_t w = res.words[i]; w != 0; w &= (w - 1)) {
+        STable* pTable = pMeta->tables[i * 64 + __builtin_ctzll(w)];
+        if (pTable != NULL) taosArrayPush(pRes, &pTable->tableId);
+      }
+    }
+  }
+
+  free(res.words);
+  return code;
+}
+
+static int32_t doQueryTableList(STsdbMeta* pMeta, STable* pSTable, SArray* pRes, tExprNode* pExpr) {
+  if (pExpr != NULL && pSTable->pTagIndex != NULL) {
+    tagExprPrepare(pExpr, pSTable->tagSchema);
+    if (tagExprUseIndex(pSTable, pExpr)) {
+      int32_t code = doQueryTableListByTagIndex(pMeta, pSTable, pRes, pExpr);
+      tExprTreeDestroy(&pExpr, destroyHelper);
+      return code;
+    }
+  }
+
   // query according to the expression tree
   SExprTraverseSupp supp = {
       .nodeFilterFn = (__result_filter_fn_t) indexedNodeFilterFp,
@@ -1886,22 +2459,107 @@ static int32_t doQueryTableList(STable* pSTable, SArray* pRes, tExprNode* pExpr)
   return TSDB_CODE_SUCCESS;
 }
 
-int32_t tsdbQuerySTableByTagCond(TsdbRepoT* tsdb, uint64_t uid, const char* pTagCond, size_t len,
-                                 int16_t tagNameRelType, const char* tbnameCond, STableGroupInfo* pGroupInfo,
-                                 SColIndex* pColIndex, int32_t numOfCols) {
-  STable* pTable = tsdbGetTableByUid(tsdbGetMeta(tsdb), uid);
-  if (pTable == NULL) {
-    uError("%p failed to get stable, uid:%" PRIu64, tsdb, uid);
-    return TSDB_CODE_INVALID_TABLE_ID;
+/*
+ * The grouped tables of super table queries are cached by the tag condition, the tbname condition and the group by
+ * columns. The key has the version of the super table, so an entry is not hit any more once a child table of it is
+ * created or dropped, and ages out of the LRU cache.
+ */
+typedef struct {
+  uint64_t suid;
+  uint32_t tversion;
+  int16_t  tagNameRelType;
+  int16_t  numOfCols;
+  int32_t  tagCondLen;
+  int32_t  tbnameCondLen;
+} STagCondKeyHead;  // followed by the colIndex of the group by columns, the tag condition and the tbname condition
+
+static char* tagCondCacheKey(STable* pSTable, const char* pTagCond, size_t len, int16_t tagNameRelType,
+                             const char* tbnameCond, SColIndex* pColIndex, int32_t numOfCols, size_t* keyLen) {
+  size_t tbnameLen = (tbnameCond == NULL) ? 0 : strlen(tbnameCond);
+  if (pTagCond == NULL) len = 0;
+
+  *keyLen = sizeof(STagCondKeyHead) + sizeof(int16_t) * numOfCols + len + tbnameLen;
+  char* key = calloc(1, *keyLen);
+  if (key == NULL) return NULL;
+
+  STagCondKeyHead* pHead = (STagCondKeyHead*)key;
+  pHead->suid = pSTable->tableId.uid;
+  pHead->tversion = atomic_load_32(&pSTable->tversion);
+  pHead->tagNameRelType = tagNameRelType;
+  pHead->numOfCols = (int16_t)numOfCols;
+  pHead->tagCondLen = (int32_t)len;
+  pHead->tbnameCondLen = (int32_t)tbnameLen;
+
+  char* p = key + sizeof(STagCondKeyHead);
+  for (int32_t i = 0; i < numOfCols; ++i) {
+    memcpy(p, &pColIndex[i].colIndex, sizeof(int16_t));
+    p += sizeof(int16_t);
   }
-  
-  if (pTable->type != TSDB_SUPER_TABLE) {
-    uError("%p query normal tag not allowed, uid:%" PRIu64 ", tid:%d, name:%s",
-           tsdb, uid, pTable->tableId.tid, pTable->name);
-    
-    return TSDB_CODE_OPS_NOT_SUPPORT; //basically, this error is caused by invalid sql issued by client
+  if (len > 0) memcpy(p, pTagCond, len);
+  if (tbnameLen > 0) memcpy(p + len, tbnameCond, tbnameLen);
+
+  return key;
+}
+
+// the groups are cached as the number of groups, followed by the number and the STableIds of the tables of each
+static void putTableGroupIntoCache(SLRUCache* pCache, const char* key, size_t keyLen, STableGroupInfo* pGroupInfo) {
+  int32_t numOfGroups = (int32_t)taosArrayGetSize(pGroupInfo->pGroupList);
+  size_t  size = sizeof(int32_t) * (1 + numOfGroups) + sizeof(STableId) * pGroupInfo->numOfTables;
+
+  char* buf = malloc(size);
+  if (buf == NULL) return;
+
+  char* p = buf;
+  *(int32_t*)p = numOfGroups;
+  p += sizeof(int32_t);
+  for (int32_t i = 0; i < numOfGroups; ++i) {
+    SArray* group = taosArrayGetP(pGroupInfo->pGroupList, i);
+    int32_t n = (int32_t)taosArrayGetSize(group);
+    if (p + sizeof(int32_t) + sizeof(STableId) * n > buf + size) {  // not consistent with numOfTables, do not cache
+      free(buf);
+      return;
+    }
+
+    *(int32_t*)p = n;
+    p += sizeof(int32_t);
+    if (n > 0) memcpy(p, taosArrayGet(group, 0), sizeof(STableId) * n);
+    p += sizeof(STableId) * n;
   }
-  
+
+  taosLRUCachePut(pCache, key, keyLen, buf, p - buf);
+  free(buf);
+}
+
+static bool getTableGroupFromCache(SLRUCache* pCache, const char* key, size_t keyLen, STableGroupInfo* pGroupInfo) {
+  char* buf = NULL;
+  if (taosLRUCacheGetDup(pCache, key, keyLen, (void**)&buf) < 0) return false;
+
+  char*   p = buf;
+  int32_t numOfGroups = *(int32_t*)p;
+  p += sizeof(int32_t);
+
+  pGroupInfo->numOfTables = 0;
+  pGroupInfo->pGroupList = taosArrayInit(MAX(numOfGroups, 1), POINTER_BYTES);
+  for (int32_t i = 0; i < numOfGroups; ++i) {
+    int32_t n = *(int32_t*)p;
+    p += sizeof(int32_t);
+
+    SArray* group = taosArrayInit(MAX(n, 1), sizeof(STableId));
+    for (int32_t j = 0; j < n; ++j) {
+      taosArrayPush(group, p);
+      p += sizeof(STableId);
+    }
+    taosArrayPush(pGroupInfo->pGroupList, &group);
+    pGroupInfo->numOfTables += n;
+  }
+
+  free(buf);
+  return true;
+}
+
+static int32_t doQuerySTableByTagCond(TsdbRepoT* tsdb, STable* pTable, const char* pTagCond, size_t len,
+                                      int16_t tagNameRelType, const char* tbnameCond, STableGroupInfo* pGroupInfo,
+                                      SColIndex* pColIndex, int32_t numOfCols) {
   SArray* res = taosArrayInit(8, sizeof(STableId));
   STSchema* pTagSchema = tsdbGetTableTagSchema(tsdbGetMeta(tsdb), pTable);
   
@@ -1952,7 +2610,8 @@ int32_t tsdbQuerySTableByTagCond(TsdbRepoT* tsdb, uint64_t uid, const char* pTag
     // TODO: more error handling
   } END_TRY
 
-  doQueryTableList(pTable, res, expr);
+  int32_t code = doQueryTableList(tsdbGetMeta(tsdb), pTable, res, expr);
+  if (code != TSDB_CODE_SUCCESS) ret = code;
   pGroupInfo->numOfTables = taosArrayGetSize(res);
   pGroupInfo->pGroupList  = createTableGroup(res, pTagSchema, pColIndex, numOfCols, tsdb);
 
@@ -1960,6 +2619,46 @@ int32_t tsdbQuerySTableByTagCond(TsdbRepoT* tsdb, uint64_t uid, const char* pTag
   return ret;
 }
 
+int32_t tsdbQuerySTableByTagCond(TsdbRepoT* tsdb, uint64_t uid, const char* pTagCond, size_t len,
+                                 int16_t tagNameRelType, const char* tbnameCond, STableGroupInfo* pGroupInfo,
+                                 SColIndex* pColIndex, int32_t numOfCols) {
+  STable* pTable = tsdbGetTableByUid(tsdbGetMeta(tsdb), uid);
+  if (pTable == NULL) {
+    uError("%p failed to get stable, uid:%" PRIu64, tsdb, uid);
+    return TSDB_CODE_INVALID_TABLE_ID;
+  }
+  
+  if (pTable->type != TSDB_SUPER_TABLE) {
+    uError("%p query normal tag not allowed, uid:%" PRIu64 ", tid:%d, name:%s",
+           tsdb, uid, pTable->tableId.tid, pTable->name);
+    
+    return TSDB_CODE_OPS_NOT_SUPPORT; //basically, this error is caused by invalid sql issued by client
+  }
+
+  // the key is built before resolving the tables, so that they are never cached with a newer version
+  SLRUCache* pCache = ((STsdbRepo*)tsdb)->pTagCondCache;
+  size_t     keyLen = 0;
+  char*      key = NULL;
+  if (pCache != NULL) {
+    key = tagCondCacheKey(pTable, pTagCond, len, tagNameRelType, tbnameCond, pColIndex, numOfCols, &keyLen);
+    if (key != NULL && getTableGroupFromCache(pCache, key, keyLen, pGroupInfo)) {
+      uTrace("%p %d tables of stable uid:%" PRIu64 " are got from the tag condition cache", tsdb,
+             pGroupInfo->numOfTables, uid);
+      free(key);
+      return TSDB_CODE_SUCCESS;
+    }
+  }
+
+  int32_t ret = doQuerySTableByTagCond(tsdb, pTable, pTagCond, len, tagNameRelType, tbnameCond, pGroupInfo, pColIndex,
+                                       numOfCols);
+  if (key != NULL) {
+    if (ret == TSDB_CODE_SUCCESS) putTableGroupIntoCache(pCache, key, keyLen, pGroupInfo);
+    free(key);
+  }
+
+  return ret;
+}
+
 int32_t tsdbGetOneTableGroup(TsdbRepoT* tsdb, uint64_t uid, STableGroupInfo* pGroupInfo) {
   STable* pTable = tsdbGetTableByUid(tsdbGetMeta(tsdb), uid);
   if (pTable == NULL) {
@@ -1987,7 +2686,8 @@ void tsdbCleanupQueryHandle(TsdbQueryHandleT queryHandle) {
   size_t size = taosArrayGetSize(pQueryHandle->pTableCheckInfo);
   for (int32_t i = 0; i < size; ++i) {
     STableCheckInfo* pTableCheckInfo = taosArrayGet(pQueryHandle->pTableCheckInfo, i);
-    tSkipListDestroyIter(pTableCheckInfo->iter);
+    tsdbDestroyMemTableIter(pTableCheckInfo->iter);
+    tsdbDestroyMemTableIter(pTableCheckInfo->iiter);
 
     if (pTableCheckInfo->pDataCols != NULL) {
       tfree(pTableCheckInfo->pDataCols->buf);
@@ -2006,9 +2706,18 @@ void tsdbCleanupQueryHandle(TsdbQueryHandleT queryHandle) {
    }
 
   taosArrayDestroy(pQueryHandle->pColumns);
+  tfree(pQueryHandle->statis);
   
   tfree(pQueryHandle->pDataBlockInfo);
+  tfree(pQueryHandle->pBlockIdx);
   tsdbDestroyHelper(&pQueryHandle->rhelper);
+
+  if (pQueryHandle->pRollupInfo != NULL) {
+    for (int32_t i = 0; i < size; ++i) {
+      tfree(pQueryHandle->pRollupInfo[i]);
+    }
+    tfree(pQueryHandle->pRollupInfo);
+  }
   
   tfree(pQueryHandle);
 }
@@ -0,0 +1,629 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "os.h"
+#include "tsdbMain.h"
+#include "tchecksum.h"
+
+#define TSDB_ROLLUP_TMP_SUFFIX ".r"
+
+static TSKEY       tsdbGetBucketStart(TSKEY key, int64_t level);
+static int         tsdbGetRollupCols(STSchema *pSchema, SRollupCol *cols);
+static uint32_t    tsdbGetRollupInfoLen(SRollupInfo *pInfo, int numOfLevels);
+static void        tsdbMergeRollupEntry(SRollupCol *cols, int numOfCols, SRollupEntry *pDst, SRollupEntry *pSrc);
+static int         tsdbRollupBlockData(SDataCols *pDataCols, SRollupCol *cols, int numOfCols, int64_t level,
+                                       TSKEY skey, TSKEY ekey, SArray *pEntries, SRollupEntry *pRun);
+static int         tsdbRollupEntries(SArray *pSrc, SRollupCol *cols, int numOfCols, int64_t level, SArray *pDst);
+static SRollupInfo *tsdbBuildRollupInfo(STsdbRepo *pRepo, SRWHelper *pHelper, STable *pTable, SRollupInfo *pOld,
+                                        TSKEY skey, TSKEY ekey);
+
+int tsdbParseRollupCfg(char *intervals, int8_t precision, SRollupCfg *pCfg) {
+  char    buf[TSDB_ROLLUP_INTERVALS_LEN] = {0};
+  char *  savePtr = NULL;
+  int64_t keysPerSecond = tsMsPerDay[precision] / 86400;
+
+  memset((void *)pCfg, 0, sizeof(*pCfg));
+  if (intervals == NULL || intervals[0] == 0) return 0;
+
+  strncpy(buf, intervals, TSDB_ROLLUP_INTERVALS_LEN - 1);
+  for (char *token = strtok_r(buf, ", ", &savePtr); token != NULL; token = strtok_r(NULL, ", ", &savePtr)) {
+    char *  end = NULL;
+    int64_t seconds = strtoll(token, &end, 10);
+    if (*end != 0 || seconds <= 0 || pCfg->numOfLevels >= TSDB_MAX_ROLLUP_LEVELS) goto _err;
+
+    // A bucket never crosses a day, so never crosses a file group. A level is made of the buckets of the last one.
+    int64_t level = seconds * keysPerSecond;
+    if (tsMsPerDay[precision] % level != 0) goto _err;
+    if (pCfg->numOfLevels > 0) {
+      int64_t last = pCfg->levels[pCfg->numOfLevels - 1];
+      if (level <= last || level % last != 0) goto _err;
+    }
+
+    pCfg->levels[pCfg->numOfLevels++] = level;
+  }
+
+  return 0;
+
+_err:
+  memset((void *)pCfg, 0, sizeof(*pCfg));
+  return -1;
+}
+
+int tsdbGetRollupLevelIdx(SRollupCfg *pCfg, int64_t level) {
+  for (int i = 0; i < pCfg->numOfLevels; i++) {
+    if (pCfg->levels[i] == level) return i;
+  }
+
+  return -1;
+}
+
+int tsdbGetRollupFileName(SFileGroup *pGroup, const char *suffix, char *fname) {
+  char *fnameDup = strdup(pGroup->files[TSDB_FILE_TYPE_HEAD].fname);
+  if (fnameDup == NULL) return -1;
+
+  tsdbGetFileName(dirname(fnameDup), pGroup->fileId, suffix, fname);
+  free(fnameDup);
+
+  return 0;
+}
+
+/**
+ * Rebuild the rollup file of the group from the new files of the commit, before the group switches to them. The
+ * rollups of the tables without data committed are copied from the old rollup file. For the others, the buckets of
+ * the largest level covering the committed keys are computed again, or all buckets if there are no old rollups.
+ *
+ * @return 0 for success, -1 for failure and the rollup file of the group is removed
+ */
+int tsdbCommitRollup(STsdbRepo *pRepo, SFileGroup *pGroup, SHelperFile *pFiles, SArray *pRanges) {
+  SRollupCfg * pCfg = &pRepo->rollup;
+  STsdbMeta *  pMeta = pRepo->tsdbMeta;
+  SRollupFile  oFile = {0};
+  SRWHelper    rhelper = {{0}};
+  SArray *     pIdxArray = NULL;
+  SRollupInfo *pOld = NULL;
+  SRollupInfo *pInfo = NULL;
+  char         fname[128] = "\0";
+  char         tname[128] = "\0";
+  int          fd = -1;
+  int          nRange = 0;
+
+  if (tsdbGetRollupFileName(pGroup, TSDB_ROLLUP_FILE_SUFFIX, fname) < 0) return -1;
+  if (tsdbGetRollupFileName(pGroup, TSDB_ROLLUP_TMP_SUFFIX, tname) < 0) return -1;
+
+  if (pCfg->numOfLevels == 0) {
+    remove(fname);
+    return 0;
+  }
+
+  TSKEY minKey = 0, maxKey = 0;
+  tsdbGetKeyRangeOfFileId(pRepo->config.daysPerFile, pRepo->config.precision, pGroup->fileId, &minKey, &maxKey);
+
+  // All tables are rolled up again if the old rollups are missing or stale
+  bool rebuild = (tsdbOpenRollupFile(pRepo, pGroup, &oFile) < 0);
+
+  SFileGroup nGroup = *pGroup;
+  nGroup.files[TSDB_FILE_TYPE_HEAD] = pFiles->headF;
+  nGroup.files[TSDB_FILE_TYPE_DATA] = pFiles->dataF;
+  nGroup.files[TSDB_FILE_TYPE_LAST] = pFiles->lastF;
+
+  if (tsdbInitReadHelper(&rhelper, pRepo) < 0) goto _err;
+  if (tsdbSetAndOpenHelperFile(&rhelper, &nGroup) < 0) goto _err;
+
+  pIdxArray = taosArrayInit(64, sizeof(SRollupIdx));
+  if (pIdxArray == NULL) goto _err;
+
+  fd = open(tname, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+  if (fd < 0) goto _err;
+
+  int64_t offset = sizeof(SRollupHead);
+  if (lseek(fd, offset, SEEK_SET) < 0) goto _err;
+
+  for (int tid = 1; tid < pRepo->config.maxTables; tid++) {
+    SCompIdx *pCompIdx = rhelper.pCompIdx + tid;
+    STable *  pTable = pMeta->tables[tid];
+    if (pCompIdx->offset == 0 || pCompIdx->numOfBlocks == 0) continue;
+    if (pTable == NULL || pTable->tableId.uid != pCompIdx->uid) continue;
+
+    // The ranges are in the order of tid
+    SRollupRange *pRange = NULL;
+    while (pRanges != NULL && nRange < taosArrayGetSize(pRanges)) {
+      SRollupRange *pNext = taosArrayGet(pRanges, nRange);
+      if (pNext->tid > tid) break;
+      nRange++;
+      if (pNext->tid == tid) {
+        pRange = pNext;
+        break;
+      }
+    }
+
+    if (!rebuild && tsdbLoadRollupInfo(&oFile, pTable->tableId, -1, &pOld) < 0) pOld = NULL;
+
+    if (pOld != NULL && pRange == NULL) {
+      pInfo = pOld;
+      pOld = NULL;
+    } else {
+      TSKEY   skey = minKey, ekey = maxKey;
+      int64_t level = pCfg->levels[pCfg->numOfLevels - 1];
+      if (pOld != NULL) {
+        skey = MAX(tsdbGetBucketStart(pRange->keyFirst, level), minKey);
+        ekey = MIN(tsdbGetBucketStart(pRange->keyLast, level) + level - 1, maxKey);
+      }
+
+      pInfo = tsdbBuildRollupInfo(pRepo, &rhelper, pTable, pOld, skey, ekey);
+      if (pInfo == NULL) goto _err;
+      tfree(pOld);
+    }
+
+    SRollupIdx idx = {.tid = tid, .uid = pTable->tableId.uid, .offset = offset};
+    idx.len = tsdbGetRollupInfoLen(pInfo, pCfg->numOfLevels);
+    if (twrite(fd, (void *)pInfo, idx.len) < idx.len) goto _err;
+    tfree(pInfo);
+
+    offset += idx.len;
+    taosArrayPush(pIdxArray, &idx);
+  }
+
+  SRollupHead head = {.delimiter = TSDB_FILE_DELIMITER, .numOfLevels = pCfg->numOfLevels};
+  memcpy(head.levels, pCfg->levels, sizeof(head.levels));
+  head.headVersion = pFiles->headF.info.version;
+  head.headOffset = pFiles->headF.info.offset;
+  head.headLen = pFiles->headF.info.len;
+  head.idxOffset = offset;
+  head.numOfTables = taosArrayGetSize(pIdxArray);
+  taosCalcChecksumAppend(0, (uint8_t *)(&head), sizeof(head));
+
+  uint32_t tsize = sizeof(SRollupIdx) * head.numOfTables + sizeof(TSCKSUM);
+  void *   pBuf = calloc(1, tsize);
+  if (pBuf == NULL) goto _err;
+  if (head.numOfTables > 0) memcpy(pBuf, pIdxArray->pData, tsize - sizeof(TSCKSUM));
+  taosCalcChecksumAppend(0, (uint8_t *)pBuf, tsize);
+
+  int32_t written = twrite(fd, pBuf, tsize);
+  free(pBuf);
+  if (written < tsize) goto _err;
+
+  if (lseek(fd, 0, SEEK_SET) < 0) goto _err;
+  if (twrite(fd, (void *)(&head), sizeof(head)) < sizeof(head)) goto _err;
+
+  close(fd);
+  fd = -1;
+  if (rename(tname, fname) < 0) goto _err;
+
+  taosArrayDestroy(pIdxArray);
+  tsdbCloseRollupFile(&oFile);
+  tsdbDestroyHelper(&rhelper);
+  return 0;
+
+_err:
+  if (fd >= 0) close(fd);
+  remove(tname);
+  remove(fname);
+  tfree(pOld);
+  tfree(pInfo);
+  taosArrayDestroy(pIdxArray);
+  tsdbCloseRollupFile(&oFile);
+  tsdbDestroyHelper(&rhelper);
+  return -1;
+}
+
+/**
+ * Open the rollup file of the group, and load its index part.
+ *
+ * @return 0 for success, -1 if the file does not exist, is broken, or is not built from the current files of the
+ *         group with the current levels
+ */
+int tsdbOpenRollupFile(STsdbRepo *pRepo, SFileGroup *pGroup, SRollupFile *pFile) {
+  SRollupCfg *pCfg = &pRepo->rollup;
+  SFile *     pHeadF = &pGroup->files[TSDB_FILE_TYPE_HEAD];
+  SRollupHead head = {0};
+  char        fname[128] = "\0";
+
+  memset((void *)pFile, 0, sizeof(*pFile));
+  pFile->fd = -1;
+
+  if (pCfg->numOfLevels == 0) return -1;
+  if (tsdbGetRollupFileName(pGroup, TSDB_ROLLUP_FILE_SUFFIX, fname) < 0) return -1;
+
+  pFile->fd = open(fname, O_RDONLY);
+  if (pFile->fd < 0) return -1;
+
+  if (tread(pFile->fd, (void *)(&head), sizeof(head)) < sizeof(head)) goto _err;
+  if (!taosCheckChecksumWhole((uint8_t *)(&head), sizeof(head)) || head.delimiter != TSDB_FILE_DELIMITER) goto _err;
+
+  // A crash between the rename of the .head file and the write of the rollups leaves rollups of the last version
+  if (head.headVersion != pHeadF->info.version || head.headOffset != pHeadF->info.offset ||
+      head.headLen != pHeadF->info.len) {
+    goto _err;
+  }
+  if (head.numOfLevels != pCfg->numOfLevels || memcmp(head.levels, pCfg->levels, sizeof(head.levels)) != 0) goto _err;
+
+  uint32_t tsize = sizeof(SRollupIdx) * head.numOfTables + sizeof(TSCKSUM);
+  pFile->pIdx = (SRollupIdx *)malloc(tsize);
+  if (pFile->pIdx == NULL) goto _err;
+
+  if (lseek(pFile->fd, head.idxOffset, SEEK_SET) < 0) goto _err;
+  if (tread(pFile->fd, (void *)pFile->pIdx, tsize) < tsize) goto _err;
+  if (!taosCheckChecksumWhole((uint8_t *)pFile->pIdx, tsize)) goto _err;
+
+  pFile->head = head;
+  return 0;
+
+_err:
+  tsdbCloseRollupFile(pFile);
+  return -1;
+}
+
+void tsdbCloseRollupFile(SRollupFile *pFile) {
+  if (pFile->fd >= 0) {
+    close(pFile->fd);
+    pFile->fd = -1;
+  }
+  tfree(pFile->pIdx);
+}
+
+static int compareRollupIdx(const void *key, const void *arg) {
+  return *(int32_t *)key - ((SRollupIdx *)arg)->tid;
+}
+
+static bool tsdbCheckRollupLevel(SRollupInfo *pInfo, int level, uint32_t len) {
+  if (pInfo->offset[level] < TSDB_ROLLUP_HEAD_SIZE(pInfo->numOfCols) || pInfo->numOfEntries[level] < 0) return false;
+  if (pInfo->offset[level] + TSDB_ROLLUP_LEVEL_SIZE(pInfo->numOfCols, pInfo->numOfEntries[level]) > len) return false;
+
+  uint32_t size = TSDB_ROLLUP_ENTRY_SIZE(pInfo->numOfCols) * pInfo->numOfEntries[level] + sizeof(TSCKSUM);
+  return taosCheckChecksumWhole((uint8_t *)pInfo + pInfo->offset[level], size);
+}
+
+/**
+ * Load the rollups of a table, of all levels if level is -1. If only one level is loaded, the entries of the other
+ * levels are set to none. *ppInfo is set to NULL if the table has no data in the group, otherwise the caller frees it.
+ *
+ * @return 0 for success, -1 for failure
+ */
+int tsdbLoadRollupInfo(SRollupFile *pFile, STableId tableId, int level, SRollupInfo **ppInfo) {
+  SRollupInfo  info = {0};
+  SRollupInfo *pInfo = NULL;
+
+  *ppInfo = NULL;
+
+  SRollupIdx *pIdx = bsearch((void *)(&tableId.tid), (void *)pFile->pIdx, pFile->head.numOfTables,
+                             sizeof(SRollupIdx), compareRollupIdx);
+  if (pIdx == NULL || pIdx->uid != tableId.uid) return 0;
+
+  if (lseek(pFile->fd, pIdx->offset, SEEK_SET) < 0) return -1;
+  if (tread(pFile->fd, (void *)(&info), sizeof(info)) < sizeof(info)) return -1;
+  if (info.delimiter != TSDB_FILE_DELIMITER || info.uid != tableId.uid || info.numOfCols < 0) return -1;
+
+  uint32_t hsize = TSDB_ROLLUP_HEAD_SIZE(info.numOfCols);
+  if (hsize > pIdx->len) return -1;
+
+  uint32_t tsize = pIdx->len;
+  if (level >= 0) {
+    if (info.offset[level] < hsize || info.numOfEntries[level] < 0) return -1;
+    tsize = hsize + TSDB_ROLLUP_LEVEL_SIZE(info.numOfCols, info.numOfEntries[level]);
+    if (info.offset[level] + tsize - hsize > pIdx->len) return -1;
+  }
+
+  pInfo = (SRollupInfo *)malloc(tsize);
+  if (pInfo == NULL) return -1;
+
+  // The head part is read again with the SRollupCol array, then all levels or the required one
+  uint32_t size = (level >= 0) ? hsize : tsize;
+  if (lseek(pFile->fd, pIdx->offset, SEEK_SET) < 0) goto _err;
+  if (tread(pFile->fd, (void *)pInfo, size) < size) goto _err;
+  if (!taosCheckChecksumWhole((uint8_t *)pInfo,
+                              sizeof(SRollupInfo) + sizeof(SRollupCol) * info.numOfCols + sizeof(TSCKSUM))) {
+    goto _err;
+  }
+
+  if (level >= 0) {
+    if (lseek(pFile->fd, pIdx->offset + pInfo->offset[level], SEEK_SET) < 0) goto _err;
+    if (tread(pFile->fd, (char *)pInfo + hsize, tsize - hsize) < tsize - hsize) goto _err;
+
+    for (int i = 0; i < TSDB_MAX_ROLLUP_LEVELS; i++) {
+      if (i != level) pInfo->numOfEntries[i] = 0;
+    }
+    pInfo->offset[level] = hsize;
+    if (!tsdbCheckRollupLevel(pInfo, level, tsize)) goto _err;
+  } else {
+    for (int i = 0; i < pFile->head.numOfLevels; i++) {
+      if (!tsdbCheckRollupLevel(pInfo, i, tsize)) goto _err;
+    }
+  }
+
+  *ppInfo = pInfo;
+  return 0;
+
+_err:
+  free(pInfo);
+  return -1;
+}
+
+static TSKEY tsdbGetBucketStart(TSKEY key, int64_t level) {
+  TSKEY rem = key % level;
+  return (rem < 0) ? (key - rem - level) : (key - rem);
+}
+
+// the columns with statistics, which are the numeric columns except the timestamp column
+static int tsdbGetRollupCols(STSchema *pSchema, SRollupCol *cols) {
+  int numOfCols = 0;
+  for (int i = 1; i < schemaNCols(pSchema); i++) {
+    STColumn *pCol = schemaColAt(pSchema, i);
+    if (tDataTypeDesc[colType(pCol)].getStatisFunc == NULL) continue;
+
+    cols[numOfCols].colId = colColId(pCol);
+    cols[numOfCols].type = colType(pCol);
+    numOfCols++;
+  }
+
+  return numOfCols;
+}
+
+static uint32_t tsdbGetRollupInfoLen(SRollupInfo *pInfo, int numOfLevels) {
+  return pInfo->offset[numOfLevels - 1] +
+         TSDB_ROLLUP_LEVEL_SIZE(pInfo->numOfCols, pInfo->numOfEntries[numOfLevels - 1]);
+}
+
+static void tsdbMergeRollupStat(int16_t type, SRollupStat *pDst, int32_t dstRows, SRollupStat *pSrc,
+                                int32_t srcRows) {
+  bool dstHasValue = pDst->numOfNull < dstRows;
+
+  pDst->numOfNull += pSrc->numOfNull;
+  if (pSrc->numOfNull >= srcRows) return;
+
+  if (!dstHasValue) {
+    pDst->sum = pSrc->sum;
+    pDst->max = pSrc->max;
+    pDst->min = pSrc->min;
+    pDst->first = pSrc->first;
+    pDst->firstKey = pSrc->firstKey;
+  } else if (type == TSDB_DATA_TYPE_FLOAT || type == TSDB_DATA_TYPE_DOUBLE) {
+    *(double *)(&pDst->sum) = GET_DOUBLE_VAL(&pDst->sum) + GET_DOUBLE_VAL(&pSrc->sum);
+    if (GET_DOUBLE_VAL(&pSrc->max) > GET_DOUBLE_VAL(&pDst->max)) pDst->max = pSrc->max;
+    if (GET_DOUBLE_VAL(&pSrc->min) < GET_DOUBLE_VAL(&pDst->min)) pDst->min = pSrc->min;
+  } else {
+    pDst->sum += pSrc->sum;
+    pDst->max = MAX(pDst->max, pSrc->max);
+    pDst->min = MIN(pDst->min, pSrc->min);
+  }
+
+  pDst->last = pSrc->last;
+  pDst->lastKey = pSrc->lastKey;
+}
+
+// merge pSrc into pDst, the rows of pSrc are after the rows of pDst
+static void tsdbMergeRollupEntry(SRollupCol *cols, int numOfCols, SRollupEntry *pDst, SRollupEntry *pSrc) {
+  for (int i = 0; i < numOfCols; i++) {
+    tsdbMergeRollupStat(cols[i].type, TSDB_ROLLUP_STAT_AT(pDst, i), pDst->numOfRows, TSDB_ROLLUP_STAT_AT(pSrc, i),
+                        pSrc->numOfRows);
+  }
+
+  if (pDst->numOfRows == 0) pDst->keyFirst = pSrc->keyFirst;
+  pDst->keyLast = pSrc->keyLast;
+  pDst->numOfRows += pSrc->numOfRows;
+}
+
+// get the entry of the bucket at the end of pEntries, pSpace is an entry outside pEntries to push a new one with
+static SRollupEntry *tsdbGetLastRollupEntry(SArray *pEntries, TSKEY bucket, SRollupEntry *pSpace) {
+  size_t size = taosArrayGetSize(pEntries);
+  if (size > 0) {
+    SRollupEntry *pEntry = taosArrayGet(pEntries, size - 1);
+    if (pEntry->skey == bucket) return pEntry;
+  }
+
+  SRollupEntry *pEntry = taosArrayPush(pEntries, (void *)pSpace);
+  if (pEntry == NULL) return NULL;
+
+  memset((void *)pEntry, 0, pEntries->elemSize);
+  pEntry->skey = bucket;
+  return pEntry;
+}
+
+static int64_t tsdbGetRollupValue(int16_t type, void *pData) {
+  switch (type) {
+    case TSDB_DATA_TYPE_TINYINT:
+      return *(int8_t *)pData;
+    case TSDB_DATA_TYPE_SMALLINT:
+      return *(int16_t *)pData;
+    case TSDB_DATA_TYPE_INT:
+      return *(int32_t *)pData;
+    case TSDB_DATA_TYPE_FLOAT: {
+      int64_t val = 0;
+      *(double *)(&val) = GET_FLOAT_VAL(pData);
+      return val;
+    }
+    default:  // bigint, timestamp and double, the bits of a double are kept as they are
+      return *(int64_t *)pData;
+  }
+}
+
+// roll up the rows of the block in [skey, ekey] into the buckets of the level, pRun is a buffer of an entry
+static int tsdbRollupBlockData(SDataCols *pDataCols, SRollupCol *cols, int numOfCols, int64_t level, TSKEY skey,
+                               TSKEY ekey, SArray *pEntries, SRollupEntry *pRun) {
+  TSKEY *keys = (TSKEY *)(pDataCols->cols[0].pData);
+  int    rows = pDataCols->numOfPoints;
+  int    i = 0;
+
+  while (i < rows && keys[i] < skey) i++;
+
+  while (i < rows && keys[i] <= ekey) {
+    TSKEY bucket = tsdbGetBucketStart(keys[i], level);
+    int   j = i + 1;
+    while (j < rows && keys[j] <= ekey && keys[j] < bucket + level) j++;
+
+    memset((void *)pRun, 0, TSDB_ROLLUP_ENTRY_SIZE(numOfCols));
+    pRun->skey = bucket;
+    pRun->keyFirst = keys[i];
+    pRun->keyLast = keys[j - 1];
+    pRun->numOfRows = j - i;
+
+    // The columns of pDataCols are in the order of the schema, so are the rollup columns
+    for (int k = 0, c = 1; k < numOfCols; k++, c++) {
+      while (pDataCols->cols[c].colId != cols[k].colId) c++;
+
+      SDataCol *   pDataCol = pDataCols->cols + c;
+      SRollupStat *pStat = TSDB_ROLLUP_STAT_AT(pRun, k);
+      int          bytes = tDataTypeDesc[cols[k].type].nSize;
+      char *       pData = (char *)pDataCol->pData + bytes * i;
+      int16_t      minIndex = 0, maxIndex = 0, numOfNull = 0;
+
+      tDataTypeDesc[cols[k].type].getStatisFunc(keys + i, pData, j - i, &pStat->min, &pStat->max, &pStat->sum,
+                                                &minIndex, &maxIndex, &numOfNull);
+      pStat->numOfNull = numOfNull;
+      if (numOfNull == j - i) continue;
+
+      int first = 0, last = j - i - 1;
+      while (isNull(pData + bytes * first, cols[k].type)) first++;
+      while (isNull(pData + bytes * last, cols[k].type)) last--;
+
+      pStat->first = tsdbGetRollupValue(cols[k].type, pData + bytes * first);
+      pStat->firstKey = keys[i + first];
+      pStat->last = tsdbGetRollupValue(cols[k].type, pData + bytes * last);
+      pStat->lastKey = keys[i + last];
+    }
+
+    SRollupEntry *pEntry = tsdbGetLastRollupEntry(pEntries, bucket, pRun);
+    if (pEntry == NULL) return -1;
+    tsdbMergeRollupEntry(cols, numOfCols, pEntry, pRun);
+
+    i = j;
+  }
+
+  return 0;
+}
+
+// roll up the entries of a level into the buckets of a larger level
+static int tsdbRollupEntries(SArray *pSrc, SRollupCol *cols, int numOfCols, int64_t level, SArray *pDst) {
+  for (size_t i = 0; i < taosArrayGetSize(pSrc); i++) {
+    SRollupEntry *pEntry = taosArrayGet(pSrc, i);
+    SRollupEntry *pBucket = tsdbGetLastRollupEntry(pDst, tsdbGetBucketStart(pEntry->skey, level), pEntry);
+    if (pBucket == NULL) return -1;
+
+    tsdbMergeRollupEntry(cols, numOfCols, pBucket, pEntry);
+  }
+
+  return 0;
+}
+
+/**
+ * Build the rollups of a table in the group. The buckets in [skey, ekey] are computed from the data blocks, and the
+ * others are taken from pOld. pOld is NULL if [skey, ekey] is the key range of the group.
+ */
+static SRollupInfo *tsdbBuildRollupInfo(STsdbRepo *pRepo, SRWHelper *pHelper, STable *pTable, SRollupInfo *pOld,
+                                        TSKEY skey, TSKEY ekey) {
+  SRollupCfg * pCfg = &pRepo->rollup;
+  STSchema *   pSchema = tsdbGetTableSchema(pRepo->tsdbMeta, pTable);
+  SArray *     pEntries[TSDB_MAX_ROLLUP_LEVELS] = {0};
+  SRollupInfo *pInfo = NULL;
+  SRollupCol * cols = NULL;
+  SRollupEntry *pRun = NULL;
+
+  cols = (SRollupCol *)calloc(schemaNCols(pSchema), sizeof(SRollupCol));
+  if (cols == NULL) return NULL;
+
+  int    numOfCols = tsdbGetRollupCols(pSchema, cols);
+  size_t eSize = TSDB_ROLLUP_ENTRY_SIZE(numOfCols);
+
+  // The old rollups are not used if the columns are changed
+  if (pOld != NULL &&
+      (pOld->numOfCols != numOfCols || memcmp(pOld->cols, cols, sizeof(SRollupCol) * numOfCols) != 0)) {
+    pOld = NULL;
+    tsdbGetKeyRangeOfFileId(pRepo->config.daysPerFile, pRepo->config.precision, pHelper->files.fid, &skey, &ekey);
+  }
+
+  pRun = (SRollupEntry *)malloc(eSize);
+  if (pRun == NULL) goto _err;
+
+  for (int level = 0; level < pCfg->numOfLevels; level++) {
+    pEntries[level] = taosArrayInit(64, eSize);
+    if (pEntries[level] == NULL) goto _err;
+  }
+
+  tsdbSetHelperTable(pHelper, pTable, pRepo);
+  if (tsdbLoadCompInfo(pHelper, NULL) < 0) goto _err;
+
+  SCompIdx *pCompIdx = pHelper->pCompIdx + pTable->tableId.tid;
+  for (int i = 0; i < pCompIdx->numOfBlocks; i++) {
+    SCompBlock *pBlock = pHelper->pCompInfo->blocks + i;
+    if (pBlock->keyLast < skey) continue;
+    if (pBlock->keyFirst > ekey) break;
+
+    if (tsdbLoadBlockData(pHelper, pBlock, NULL) < 0) goto _err;
+    if (tsdbRollupBlockData(pHelper->pDataCols[0], cols, numOfCols, pCfg->levels[0], skey, ekey, pEntries[0], pRun) <
+        0)
+      goto _err;
+  }
+
+  for (int level = 1; level < pCfg->numOfLevels; level++) {
+    if (tsdbRollupEntries(pEntries[level - 1], cols, numOfCols, pCfg->levels[level], pEntries[level]) < 0) goto _err;
+  }
+
+  // The entries of each level are the old ones before skey, the new ones and the old ones after ekey
+  int32_t nBefore[TSDB_MAX_ROLLUP_LEVELS] = {0};
+  int32_t nAfter[TSDB_MAX_ROLLUP_LEVELS] = {0};
+  size_t  tsize = TSDB_ROLLUP_HEAD_SIZE(numOfCols);
+  for (int level = 0; level < pCfg->numOfLevels; level++) {
+    if (pOld != NULL) {
+      while (nBefore[level] < pOld->numOfEntries[level] &&
+             TSDB_ROLLUP_ENTRY_AT(pOld, level, nBefore[level])->skey < skey) {
+        nBefore[level]++;
+      }
+      while (nAfter[level] < pOld->numOfEntries[level] - nBefore[level] &&
+             TSDB_ROLLUP_ENTRY_AT(pOld, level, pOld->numOfEntries[level] - nAfter[level] - 1)->skey > ekey) {
+        nAfter[level]++;
+      }
+    }
+    tsize += TSDB_ROLLUP_LEVEL_SIZE(numOfCols, nBefore[level] + taosArrayGetSize(pEntries[level]) + nAfter[level]);
+  }
+
+  pInfo = (SRollupInfo *)calloc(1, tsize);
+  if (pInfo == NULL) goto _err;
+
+  pInfo->delimiter = TSDB_FILE_DELIMITER;
+  pInfo->numOfCols = numOfCols;
+  pInfo->uid = pTable->tableId.uid;
+  memcpy(pInfo->cols, cols, sizeof(SRollupCol) * numOfCols);
+
+  size_t offset = TSDB_ROLLUP_HEAD_SIZE(numOfCols);
+  for (int level = 0; level < pCfg->numOfLevels; level++) {
+    int32_t numOfNew = taosArrayGetSize(pEntries[level]);
+
+    pInfo->offset[level] = offset;
+    pInfo->numOfEntries[level] = nBefore[level] + numOfNew + nAfter[level];
+
+    char *ptr = (char *)pInfo + offset;
+    if (nBefore[level] > 0) memcpy(ptr, TSDB_ROLLUP_ENTRY_AT(pOld, level, 0), eSize * nBefore[level]);
+    ptr += eSize * nBefore[level];
+    if (numOfNew > 0) memcpy(ptr, pEntries[level]->pData, eSize * numOfNew);
+    ptr += eSize * numOfNew;
+    if (nAfter[level] > 0) {
+      memcpy(ptr, TSDB_ROLLUP_ENTRY_AT(pOld, level, pOld->numOfEntries[level] - nAfter[level]), eSize * nAfter[level]);
+    }
+
+    taosCalcChecksumAppend(0, (uint8_t *)pInfo + offset, eSize * pInfo->numOfEntries[level] + sizeof(TSCKSUM));
+    offset += TSDB_ROLLUP_LEVEL_SIZE(numOfCols, pInfo->numOfEntries[level]);
+  }
+  taosCalcChecksumAppend(0, (uint8_t *)pInfo, sizeof(SRollupInfo) + sizeof(SRollupCol) * numOfCols + sizeof(TSCKSUM));
+
+  for (int level = 0; level < pCfg->numOfLevels; level++) taosArrayDestroy(pEntries[level]);
+  free(pRun);
+  free(cols);
+  return pInfo;
+
+_err:
+  for (int level = 0; level < pCfg->numOfLevels; level++) taosArrayDestroy(pEntries[level]);
+  tfree(pRun);
+  tfree(cols);
+  return NULL;
+}
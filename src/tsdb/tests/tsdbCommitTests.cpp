@@ -0,0 +1,421 @@
+#include <gtest/gtest.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tdataformat.h"
+#include "tscompression.h"
+#include "tsdbMain.h"
+#include "ttime.h"
+
+namespace {
+
+const int   NUM_OF_TABLES = 10;
+const int   ROWS_PER_TABLE = 200000;
+const int   ROWS_PER_SUBMIT = 100;
+const int   DAYS_OF_DATA = 40;
+const char *COMMIT_TEST_DIR = "/tmp/tsdbCommitTest";
+
+STSchema *genSchema(int numOfCols) {
+  STSchema *pSchema = tdNewSchema(numOfCols);
+  for (int i = 0; i < numOfCols; i++) {
+    tdSchemaAddCol(pSchema, (i == 0) ? TSDB_DATA_TYPE_TIMESTAMP : TSDB_DATA_TYPE_INT, i, -1);
+  }
+  return pSchema;
+}
+
+int insertRows(TsdbRepoT *pRepo, STableId tableId, STSchema *pSchema, TSKEY startKey, TSKEY interval,
+               int numOfRows = ROWS_PER_TABLE) {
+  SSubmitMsg *pMsg = (SSubmitMsg *)malloc(sizeof(SSubmitMsg) + sizeof(SSubmitBlk) +
+                                          dataRowMaxBytesFromSchema(pSchema) * ROWS_PER_SUBMIT);
+  SShellSubmitRspMsg rsp = {0};
+  TSKEY              key = startKey;
+
+  for (int k = 0; k < numOfRows / ROWS_PER_SUBMIT; k++) {
+    memset((void *)pMsg, 0, sizeof(SSubmitMsg) + sizeof(SSubmitBlk));
+    SSubmitBlk *pBlock = pMsg->blocks;
+
+    for (int i = 0; i < ROWS_PER_SUBMIT; i++) {
+      SDataRow row = (SDataRow)(pBlock->data + pBlock->len);
+      tdInitDataRow(row, pSchema);
+      for (int j = 0; j < schemaNCols(pSchema); j++) {
+        STColumn *pTCol = schemaColAt(pSchema, j);
+        if (j == 0) {
+          tdAppendColVal(row, (void *)(&key), pTCol->type, pTCol->bytes, pTCol->offset);
+        } else {
+          // a counter in the first column, and noise of fewer bits in the others
+          int val = k * ROWS_PER_SUBMIT + i;
+          if (j > 1) val = (int)(((uint32_t)val * 2654435761u) >> (12 + 4 * j));
+          tdAppendColVal(row, (void *)(&val), pTCol->type, pTCol->bytes, pTCol->offset);
+        }
+      }
+      pBlock->len += dataRowLen(row);
+      key += interval;
+    }
+
+    pMsg->length = htonl(TSDB_SUBMIT_MSG_HEAD_SIZE + sizeof(SSubmitBlk) + pBlock->len);
+    pMsg->numOfBlocks = htonl(1);
+    pBlock->len = htonl(pBlock->len);
+    pBlock->numOfRows = htons(ROWS_PER_SUBMIT);
+    pBlock->uid = htobe64(tableId.uid);
+    pBlock->tid = htonl(tableId.tid);
+    pBlock->sversion = htonl(0);
+
+    if (tsdbInsertData(pRepo, pMsg, &rsp) != TSDB_CODE_SUCCESS) {
+      free(pMsg);
+      return -1;
+    }
+  }
+
+  free(pMsg);
+  return 0;
+}
+
+int64_t getDirSize(const char *dirName) {
+  int64_t        size = 0;
+  DIR *          dir = opendir(dirName);
+  struct dirent *dp = NULL;
+  char           fname[256];
+  struct stat    st;
+
+  if (dir == NULL) return -1;
+  while ((dp = readdir(dir)) != NULL) {
+    if (dp->d_name[0] == '.') continue;
+    snprintf(fname, sizeof(fname), "%s/%s", dirName, dp->d_name);
+    if (stat(fname, &st) == 0) size += st.st_size;
+  }
+  closedir(dir);
+  return size;
+}
+
+// Decode all the blocks of the files, return the seconds taken and the sum of the counter column
+double scanFiles(STsdbRepo *pRepo, int64_t *sum, int64_t *subBlocks = NULL) {
+  SRWHelper      rhelper;
+  SFileGroupIter iter;
+  SFileGroup *   pGroup = NULL;
+
+  *sum = 0;
+  if (subBlocks != NULL) *subBlocks = 0;
+  if (tsdbInitReadHelper(&rhelper, pRepo) < 0) return -1;
+
+  double st = taosGetTimestampUs();
+  tsdbInitFileGroupIter(pRepo->tsdbFileH, &iter, TSDB_ORDER_ASC);
+  while ((pGroup = tsdbGetFileGroupNext(&iter)) != NULL) {
+    if (tsdbSetAndOpenHelperFile(&rhelper, pGroup) < 0) break;
+    for (int tid = 1; tid <= NUM_OF_TABLES; tid++) {
+      SCompIdx *pIdx = rhelper.pCompIdx + tid;
+      if (pIdx->offset <= 0) continue;
+
+      tsdbSetHelperTable(&rhelper, pRepo->tsdbMeta->tables[tid], pRepo);
+      if (tsdbLoadCompInfo(&rhelper, NULL) < 0) break;
+      for (int i = 0; i < (int)pIdx->numOfBlocks; i++) {
+        if (subBlocks != NULL && rhelper.pCompInfo->blocks[i].numOfSubBlocks > 1) {
+          *subBlocks += rhelper.pCompInfo->blocks[i].numOfSubBlocks;
+        }
+        if (tsdbLoadBlockData(&rhelper, rhelper.pCompInfo->blocks + i, NULL) < 0) break;
+
+        SDataCols *pCols = rhelper.pDataCols[0];
+        for (int row = 0; row < pCols->numOfPoints; row++) *sum += ((int *)pCols->cols[1].pData)[row];
+      }
+    }
+  }
+  double elapsed = (taosGetTimestampUs() - st) * 1E-6;
+
+  tsdbDestroyHelper(&rhelper);
+  return elapsed;
+}
+
+// The sub-blocks counted by the commits in the data files of the groups
+int64_t countedSubBlocks(STsdbRepo *pRepo, int64_t *tombSize = NULL) {
+  STsdbFileH *pFileH = pRepo->tsdbFileH;
+  int64_t     subBlocks = 0;
+
+  if (tombSize != NULL) *tombSize = 0;
+  for (int i = 0; i < pFileH->numOfFGroups; i++) {
+    subBlocks += pFileH->fGroup[i].files[TSDB_FILE_TYPE_DATA].info.totalSubBlocks;
+    if (tombSize != NULL) *tombSize += pFileH->fGroup[i].files[TSDB_FILE_TYPE_DATA].info.tombSize;
+  }
+  return subBlocks;
+}
+
+void waitForCommit(STsdbRepo *repo) {
+  while (true) {
+    tsdbLockRepo((TsdbRepoT *)repo);
+    int busy = repo->commit || repo->compacting;
+    tsdbUnLockRepo((TsdbRepoT *)repo);
+    if (!busy) break;
+    usleep(1000);
+  }
+}
+
+// Insert rows spanning many file groups and commit them with the given number of threads
+void commitWithThreads(int numOfThreads, STsdbCommitStat *pStat, int64_t *dataSize, double *scanSec = NULL,
+                       int64_t *sum = NULL) {
+  char cmd[128];
+  char dataDir[128];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", COMMIT_TEST_DIR);
+  system(cmd);
+
+  STsdbCfg config;
+  tsdbSetDefaultCfg(&config);
+  config.maxTables = NUM_OF_TABLES + 1;
+  config.daysPerFile = 1;
+  config.cacheBlockSize = 16;
+  config.totalBlocks = 32;
+  ASSERT_EQ(tsdbCreateRepo((char *)COMMIT_TEST_DIR, &config, NULL), 0);
+
+  TsdbRepoT *pRepo = tsdbOpenRepo((char *)COMMIT_TEST_DIR, NULL);
+  ASSERT_NE(pRepo, nullptr);
+
+  STSchema *pSchema = genSchema(5);
+  TSKEY     interval = tsMsPerDay[TSDB_TIME_PRECISION_MILLI] * DAYS_OF_DATA / ROWS_PER_TABLE;
+  // at the start of a day, so that every run splits the rows into the same file groups
+  TSKEY     day = tsMsPerDay[TSDB_TIME_PRECISION_MILLI];
+  TSKEY     startKey = (taosGetTimestampMs() / day - (DAYS_OF_DATA + 1)) * day;
+
+  for (int tid = 1; tid <= NUM_OF_TABLES; tid++) {
+    STableCfg tCfg;
+    char      name[32];
+    ASSERT_EQ(tsdbInitTableCfg(&tCfg, TSDB_NORMAL_TABLE, 1000 + tid, tid), 0);
+    snprintf(name, sizeof(name), "t%d", tid);
+    tsdbTableSetName(&tCfg, name, false);
+    tsdbTableSetSchema(&tCfg, pSchema, true);
+    ASSERT_EQ(tsdbCreateTable(pRepo, &tCfg), 0);
+
+    ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, interval), 0);
+  }
+
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+  tsCommitThreads = numOfThreads;
+  ASSERT_EQ(tsdbTriggerCommit(pRepo), 0);
+  waitForCommit(repo);
+
+  tsdbGetCommitStat(pRepo, pStat);
+  snprintf(dataDir, sizeof(dataDir), "%s/data", COMMIT_TEST_DIR);
+  *dataSize = getDirSize(dataDir);
+  if (scanSec != NULL) *scanSec = scanFiles(repo, sum);
+
+  tsdbCloseRepo(pRepo, 0);
+  tdFreeSchema(pSchema);
+}
+
+}  // namespace
+
+TEST(TsdbCommitTest, parallelCommit) {
+  int threads[] = {1, 4};
+  STsdbCommitStat stats[2] = {{0}};
+  int64_t         dataSizes[2] = {0};
+
+  for (int i = 0; i < 2; i++) {
+    commitWithThreads(threads[i], &stats[i], &dataSizes[i]);
+
+    EXPECT_EQ(stats[i].numOfCommits, 1);
+    EXPECT_EQ(stats[i].numOfRows, (int64_t)NUM_OF_TABLES * ROWS_PER_TABLE);
+    EXPECT_GE(stats[i].numOfFGroups, DAYS_OF_DATA);
+    printf("%d commit threads: %" PRId64 " file groups, %" PRId64 " rows in %.3f seconds, %.0f rows/s\n", threads[i],
+           stats[i].numOfFGroups, stats[i].numOfRows, stats[i].lastCommitUs * 1E-6,
+           stats[i].numOfRows * 1E6 / stats[i].lastCommitUs);
+  }
+
+  // The files do not depend on how many threads wrote them
+  EXPECT_EQ(dataSizes[0], dataSizes[1]);
+  tsCommitThreads = TSDB_DEFAULT_COMMIT_THREADS;
+}
+
+TEST(TsdbCommitTest, adaptiveCompression) {
+  const char *names[TSDB_COMP_ALGORITHMS] = {"none", "one stage", "two stage", "bit pack", "chimp", "dictionary"};
+  STsdbCommitStat stats[2] = {{0}};
+  int64_t         dataSizes[2] = {0};
+  double          scanSecs[2] = {0};
+  int64_t         sums[2] = {0};
+
+  for (int i = 0; i < 2; i++) {
+    tsAdaptiveComp = i;
+    commitWithThreads(1, &stats[i], &dataSizes[i], &scanSecs[i], &sums[i]);
+    EXPECT_EQ(sums[i], (int64_t)NUM_OF_TABLES * ROWS_PER_TABLE * (ROWS_PER_TABLE - 1) / 2);
+
+    int64_t numOfCols = 0;
+    for (int j = 0; j < TSDB_COMP_ALGORITHMS; j++) numOfCols += stats[i].numOfColsByAlgorithm[j];
+    EXPECT_GT(numOfCols, 0);
+
+    printf("%s: %" PRId64 " bytes, commit %.3f seconds, decode %.3f seconds, columns by algorithm:",
+           i ? "adaptive" : "two stage", dataSizes[i], stats[i].lastCommitUs * 1E-6, scanSecs[i]);
+    for (int j = 0; j < TSDB_COMP_ALGORITHMS; j++) {
+      if (stats[i].numOfColsByAlgorithm[j] > 0) printf(" %s %" PRId64, names[j], stats[i].numOfColsByAlgorithm[j]);
+    }
+    printf("\n");
+  }
+
+  // Without the adaptive choice all the columns are compressed by the level of the repository
+  for (int j = 0; j < TSDB_COMP_ALGORITHMS; j++) {
+    if (j != TSDB_DEFAULT_COMP_LEVEL && j != DICT_COMP) EXPECT_EQ(stats[0].numOfColsByAlgorithm[j], 0);
+  }
+  tsAdaptiveComp = TSDB_DEFAULT_ADAPTIVE_COMP;
+}
+
+TEST(TsdbCommitTest, compaction) {
+  const int ROUNDS = 4;
+  const int ROWS_OF_BLOCK = 500;
+  char      cmd[128];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", COMMIT_TEST_DIR);
+  system(cmd);
+
+  // Compact by hand only
+  tsCompactSubBlocks = 0;
+  tsCompactTombSize = 0;
+
+  STsdbCfg config;
+  tsdbSetDefaultCfg(&config);
+  config.maxTables = NUM_OF_TABLES + 1;
+  config.minRowsPerFileBlock = 1000;
+  config.cacheBlockSize = 16;
+  config.totalBlocks = 32;
+  ASSERT_EQ(tsdbCreateRepo((char *)COMMIT_TEST_DIR, &config, NULL), 0);
+
+  TsdbRepoT *pRepo = tsdbOpenRepo((char *)COMMIT_TEST_DIR, NULL);
+  ASSERT_NE(pRepo, nullptr);
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+
+  STSchema *pSchema = genSchema(5);
+  TSKEY     startKey = taosGetTimestampMs() - tsMsPerDay[TSDB_TIME_PRECISION_MILLI];
+  STableId  tableIds[NUM_OF_TABLES + 1];
+
+  for (int tid = 1; tid <= NUM_OF_TABLES; tid++) {
+    STableCfg tCfg;
+    char      name[32];
+    ASSERT_EQ(tsdbInitTableCfg(&tCfg, TSDB_NORMAL_TABLE, 1000 + tid, tid), 0);
+    snprintf(name, sizeof(name), "t%d", tid);
+    tsdbTableSetName(&tCfg, name, false);
+    tsdbTableSetSchema(&tCfg, pSchema, true);
+    ASSERT_EQ(tsdbCreateTable(pRepo, &tCfg), 0);
+    tableIds[tid] = tCfg.tableId;
+  }
+
+  // A last block of each table, and small commits of rows between its rows added to it as sub-blocks
+  for (int round = 0; round <= ROUNDS; round++) {
+    for (int tid = 1; tid <= NUM_OF_TABLES; tid++) {
+      int numOfRows = (round == 0) ? ROWS_OF_BLOCK : ROWS_PER_SUBMIT;
+      ASSERT_EQ(insertRows(pRepo, tableIds[tid], pSchema, startKey + round, 10, numOfRows), 0);
+    }
+    ASSERT_EQ(tsdbTriggerCommit(pRepo), 0);
+    waitForCommit(repo);
+  }
+
+  int64_t sums[2] = {0}, subBlocks[2] = {0};
+  double  scanSecs[2] = {0};
+  scanSecs[0] = scanFiles(repo, &sums[0], &subBlocks[0]);
+  EXPECT_EQ(countedSubBlocks(repo), subBlocks[0]);
+
+  tsCompactSubBlocks = 20;
+  tsCompactTombSize = 30;
+  ASSERT_EQ(tsdbCompact(pRepo), 0);
+  waitForCommit(repo);
+
+  STsdbCompactStat stat = {0};
+  tsdbGetCompactStat(pRepo, &stat);
+  scanSecs[1] = scanFiles(repo, &sums[1], &subBlocks[1]);
+
+  EXPECT_GT(stat.numOfCompactions, 0);
+  EXPECT_EQ(stat.numOfAborts, 0);
+  EXPECT_GT(subBlocks[0], 0);
+  EXPECT_EQ(subBlocks[1], 0);
+  EXPECT_EQ(countedSubBlocks(repo), 0);
+  EXPECT_EQ(sums[0], sums[1]);
+  EXPECT_EQ(sums[1], (int64_t)NUM_OF_TABLES * (ROWS_OF_BLOCK * (ROWS_OF_BLOCK - 1) / 2 +
+                                                ROUNDS * ROWS_PER_SUBMIT * (ROWS_PER_SUBMIT - 1) / 2));
+  printf("compaction: %" PRId64 " sub-blocks, decode %.3f seconds before, %.3f seconds after, %" PRId64
+         " bytes read and %" PRId64 " bytes written in %.3f seconds\n",
+         subBlocks[0], scanSecs[0], scanSecs[1], stat.bytesRead, stat.bytesWritten, stat.totalCompactUs * 1E-6);
+
+  // The commits check the groups they write by the counters, and compact them
+  for (int round = ROUNDS + 1; round <= ROUNDS * 2; round++) {
+    for (int tid = 1; tid <= NUM_OF_TABLES; tid++) {
+      ASSERT_EQ(insertRows(pRepo, tableIds[tid], pSchema, startKey + round, 10, ROWS_PER_SUBMIT), 0);
+    }
+    ASSERT_EQ(tsdbTriggerCommit(pRepo), 0);
+    waitForCommit(repo);
+  }
+
+  STsdbCompactStat nstat = {0};
+  tsdbGetCompactStat(pRepo, &nstat);
+  scanFiles(repo, &sums[1], &subBlocks[1]);
+  EXPECT_GT(nstat.numOfCompactions, stat.numOfCompactions);
+  EXPECT_EQ(countedSubBlocks(repo), subBlocks[1]);
+
+  // The blocks of a dropped table are unused since the next commit to the group
+  int64_t tombSizes[2] = {0};
+  tsCompactSubBlocks = 0;
+  countedSubBlocks(repo, &tombSizes[0]);
+  ASSERT_EQ(tsdbDropTable(pRepo, tableIds[NUM_OF_TABLES]), 0);
+  ASSERT_EQ(insertRows(pRepo, tableIds[1], pSchema, startKey + ROUNDS * 2 + 1, 10, ROWS_PER_SUBMIT), 0);
+  ASSERT_EQ(tsdbTriggerCommit(pRepo), 0);
+  waitForCommit(repo);
+  countedSubBlocks(repo, &tombSizes[1]);
+  EXPECT_GT(tombSizes[1], tombSizes[0]);
+
+  tsdbCloseRepo(pRepo, 0);
+  tdFreeSchema(pSchema);
+  tsCompactSubBlocks = TSDB_DEFAULT_COMPACT_SUB_BLOCKS;
+  tsCompactTombSize = TSDB_DEFAULT_COMPACT_TOMB_SIZE;
+}
+
+namespace {
+
+void writeFile(const char *dataDir, int fid, const char *suffix, const char *content) {
+  char fname[TSDB_FILENAME_LEN];
+  tsdbGetFileName((char *)dataDir, fid, suffix, fname);
+  FILE *fp = fopen(fname, "w");
+  ASSERT_NE(fp, nullptr);
+  fputs(content, fp);
+  fclose(fp);
+}
+
+std::string readFile(const char *dataDir, int fid, const char *suffix) {
+  char fname[TSDB_FILENAME_LEN];
+  char buf[64] = {0};
+  tsdbGetFileName((char *)dataDir, fid, suffix, fname);
+  FILE *fp = fopen(fname, "r");
+  if (fp == NULL) return "";
+  fgets(buf, sizeof(buf), fp);
+  fclose(fp);
+  return buf;
+}
+
+}  // namespace
+
+TEST(TsdbCommitTest, compactionRecovery) {
+  const int fid = 7;
+  char      cmd[128];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s && mkdir -p %s", COMMIT_TEST_DIR, COMMIT_TEST_DIR);
+  system(cmd);
+
+  // A crash after the commit point: the head is replaced, the data and last files are not
+  writeFile(COMMIT_TEST_DIR, fid, ".head", "new head");
+  writeFile(COMMIT_TEST_DIR, fid, ".data", "old data");
+  writeFile(COMMIT_TEST_DIR, fid, ".last", "old last");
+  writeFile(COMMIT_TEST_DIR, fid, TSDB_COMPACT_DATA_SUFFIX, "new data");
+  writeFile(COMMIT_TEST_DIR, fid, TSDB_COMPACT_LAST_SUFFIX, "new last");
+  writeFile(COMMIT_TEST_DIR, fid, TSDB_COMPACT_OLD_HEAD_SUFFIX, "old head");
+  writeFile(COMMIT_TEST_DIR, fid, TSDB_COMPACT_MARK_SUFFIX, "");
+  ASSERT_EQ(tsdbRecoverCompaction((char *)COMMIT_TEST_DIR, fid), 0);
+
+  EXPECT_EQ(readFile(COMMIT_TEST_DIR, fid, ".head"), "new head");
+  EXPECT_EQ(readFile(COMMIT_TEST_DIR, fid, ".data"), "new data");
+  EXPECT_EQ(readFile(COMMIT_TEST_DIR, fid, ".last"), "new last");
+  EXPECT_NE(access((std::string(COMMIT_TEST_DIR) + "/f7" TSDB_COMPACT_OLD_HEAD_SUFFIX).c_str(), F_OK), 0);
+  EXPECT_NE(access((std::string(COMMIT_TEST_DIR) + "/f7" TSDB_COMPACT_MARK_SUFFIX).c_str(), F_OK), 0);
+
+  // A crash in the roll back of a failed replacement: the marker is removed, the head is not restored yet
+  writeFile(COMMIT_TEST_DIR, fid, TSDB_COMPACT_OLD_HEAD_SUFFIX, "old head");
+  writeFile(COMMIT_TEST_DIR, fid, TSDB_COMPACT_OLD_DATA_SUFFIX, "old data");
+  writeFile(COMMIT_TEST_DIR, fid, TSDB_COMPACT_OLD_LAST_SUFFIX, "old last");
+  writeFile(COMMIT_TEST_DIR, fid, TSDB_COMPACT_LAST_SUFFIX, "new last");
+  ASSERT_EQ(tsdbRecoverCompaction((char *)COMMIT_TEST_DIR, fid), 0);
+
+  EXPECT_EQ(readFile(COMMIT_TEST_DIR, fid, ".head"), "old head");
+  EXPECT_EQ(readFile(COMMIT_TEST_DIR, fid, ".data"), "old data");
+  EXPECT_EQ(readFile(COMMIT_TEST_DIR, fid, ".last"), "old last");
+  EXPECT_NE(access((std::string(COMMIT_TEST_DIR) + "/f7" TSDB_COMPACT_LAST_SUFFIX).c_str(), F_OK), 0);
+  EXPECT_NE(access((std::string(COMMIT_TEST_DIR) + "/f7" TSDB_COMPACT_OLD_DATA_SUFFIX).c_str(), F_OK), 0);
+}
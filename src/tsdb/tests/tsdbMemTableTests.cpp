@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "tdataformat.h"
+#include "tsdbMain.h"
+#include "tskiplist.h"
+
+namespace {
+
+double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+enum { KEY_ORDERED, KEY_MOSTLY_ORDERED, KEY_RANDOM };
+
+TSKEY *genKeys(int numOfRows, int pattern) {
+  TSKEY *keys = (TSKEY *)malloc(sizeof(TSKEY) * numOfRows);
+  TSKEY  start = 1584081000000L;
+
+  srand(1234);
+  for (int i = 0; i < numOfRows; i++) keys[i] = start + i * 10L;
+
+  if (pattern == KEY_MOSTLY_ORDERED) {  // 1% of rows arrive late by up to 1000 rows
+    for (int i = 0; i < numOfRows; i++) {
+      if (rand() % 100 == 0) keys[i] -= (rand() % 1000) * 10L + 5;
+    }
+  } else if (pattern == KEY_RANDOM) {
+    for (int i = numOfRows - 1; i > 0; i--) {
+      int   j = rand() % (i + 1);
+      TSKEY t = keys[i];
+      keys[i] = keys[j];
+      keys[j] = t;
+    }
+  }
+
+  return keys;
+}
+
+STSchema *genSchema(int numOfCols) {
+  STSchema *pSchema = tdNewSchema(numOfCols);
+  for (int i = 0; i < numOfCols; i++) {
+    tdSchemaAddCol(pSchema, (i == 0) ? TSDB_DATA_TYPE_TIMESTAMP : TSDB_DATA_TYPE_INT, i, -1);
+  }
+  return pSchema;
+}
+
+void fillRow(SDataRow row, STSchema *pSchema, TSKEY key) {
+  tdInitDataRow(row, pSchema);
+  for (int j = 0; j < schemaNCols(pSchema); j++) {
+    STColumn *pTCol = schemaColAt(pSchema, j);
+    if (j == 0) {
+      tdAppendColVal(row, (void *)(&key), pTCol->type, pTCol->bytes, pTCol->offset);
+    } else {
+      int val = j;
+      tdAppendColVal(row, (void *)(&val), pTCol->type, pTCol->bytes, pTCol->offset);
+    }
+  }
+}
+
+STsdbRepo *createRepo() {
+  STsdbRepo *pRepo = (STsdbRepo *)calloc(1, sizeof(STsdbRepo));
+  pthread_mutex_init(&pRepo->mutex, NULL);
+  // Keep the cache large enough that no commit is triggered
+  pRepo->tsdbCache = tsdbInitCache(16, 64, (TsdbRepoT *)pRepo);
+  return pRepo;
+}
+
+void destroyRepo(STsdbRepo *pRepo) {
+  tsdbFreeCache(pRepo->tsdbCache);
+  pthread_mutex_destroy(&pRepo->mutex);
+  free(pRepo);
+}
+
+// The per-row skiplist insertion used before the row log was introduced
+double insertBySkipList(TSKEY *keys, int numOfRows, STSchema *pSchema) {
+  STsdbRepo *pRepo = createRepo();
+  SSkipList *pList = tSkipListCreate(5, TSDB_DATA_TYPE_TIMESTAMP, TYPE_BYTES[TSDB_DATA_TYPE_TIMESTAMP], 0, 0, 0,
+                                     getTSTupleKey);
+  SDataRow   row = tdNewDataRowFromSchema(pSchema);
+
+  double stime = getCurTime();
+  for (int i = 0; i < numOfRows; i++) {
+    int32_t level = 0, headSize = 0;
+    fillRow(row, pSchema, keys[i]);
+
+    tSkipListNewNodeInfo(pList, &level, &headSize);
+    SSkipListNode *pNode = (SSkipListNode *)tsdbAllocFromCache(pRepo->tsdbCache, headSize + dataRowLen(row), keys[i]);
+    pNode->level = level;
+    dataRowCpy(SL_GET_NODE_DATA(pNode), row);
+    tSkipListPut(pList, pNode);
+  }
+  double etime = getCurTime();
+
+  tdFreeDataRow(row);
+  tSkipListDestroy(pList);
+  destroyRepo(pRepo);
+  return etime - stime;
+}
+
+double insertByMemTable(TSKEY *keys, int numOfRows, STSchema *pSchema, int *numOfDistinct) {
+  STsdbRepo *pRepo = createRepo();
+  SMemTable *pMem = NULL;
+  SDataRow   row = tdNewDataRowFromSchema(pSchema);
+
+  double stime = getCurTime();
+  for (int i = 0; i < numOfRows; i++) {
+    fillRow(row, pSchema, keys[i]);
+    if (tsdbInsertRowToMem(pRepo->tsdbCache, &pMem, row) < 0) break;
+  }
+  double etime = getCurTime();
+
+  // Check the merged iteration returns all distinct keys in order, both ways
+  int            count = 0;
+  TSKEY          lastKey = INT64_MIN;
+  SMemTableIter *pIter = tsdbCreateMemTableIter(pMem, NULL, TSDB_ORDER_ASC);
+  while (tsdbMemTableIterNext(pIter)) {
+    TSKEY key = dataRowKey(tsdbMemTableIterGet(pIter));
+    EXPECT_GT(key, lastKey);
+    lastKey = key;
+    count++;
+  }
+  tsdbDestroyMemTableIter(pIter);
+
+  int descCount = 0;
+  pIter = tsdbCreateMemTableIter(pMem, &lastKey, TSDB_ORDER_DESC);
+  while (tsdbMemTableIterNext(pIter)) {
+    TSKEY key = dataRowKey(tsdbMemTableIterGet(pIter));
+    EXPECT_LE(key, lastKey);
+    lastKey = key - 1;
+    descCount++;
+  }
+  tsdbDestroyMemTableIter(pIter);
+
+  EXPECT_EQ(count, descCount);
+  EXPECT_EQ(count, pMem->numOfPoints);
+  *numOfDistinct = count;
+
+  tdFreeDataRow(row);
+  tsdbFreeMemTable(pMem);
+  destroyRepo(pRepo);
+  return etime - stime;
+}
+
+int countDistinct(TSKEY *keys, int numOfRows) {
+  TSKEY *sorted = (TSKEY *)malloc(sizeof(TSKEY) * numOfRows);
+  memcpy(sorted, keys, sizeof(TSKEY) * numOfRows);
+  std::sort(sorted, sorted + numOfRows);
+  int count = (int)(std::unique(sorted, sorted + numOfRows) - sorted);
+  free(sorted);
+  return count;
+}
+
+}  // namespace
+
+TEST(TsdbMemTableTest, insertAndIterate) {
+  const char *names[] = {"ordered", "mostly-ordered", "random"};
+  int         numOfRows = 500000;
+  STSchema *  pSchema = genSchema(5);
+
+  for (int pattern = KEY_ORDERED; pattern <= KEY_RANDOM; pattern++) {
+    TSKEY *keys = genKeys(numOfRows, pattern);
+    int    numOfDistinct = 0;
+
+    double slTime = insertBySkipList(keys, numOfRows, pSchema);
+    double memTime = insertByMemTable(keys, numOfRows, pSchema, &numOfDistinct);
+    ASSERT_EQ(numOfDistinct, countDistinct(keys, numOfRows));
+
+    printf("%-15s skiplist: %.0f rows/s, mem table: %.0f rows/s\n", names[pattern], numOfRows / slTime,
+           numOfRows / memTime);
+    free(keys);
+  }
+
+  tdFreeSchema(pSchema);
+}
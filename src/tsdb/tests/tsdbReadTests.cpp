@@ -0,0 +1,1259 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "../../query/inc/qast.h"
+#include "tbuffer.h"
+#include "tdataformat.h"
+#include "tscompression.h"
+#include "tsdbMain.h"
+#include "ttime.h"
+
+namespace {
+
+const int   NUM_OF_ROWS = 200000;
+const int   ROWS_PER_SUBMIT = 100;
+const TSKEY INTERVAL = 1000;
+const char *READ_TEST_DIR = "/tmp/tsdbReadTest";
+
+// every 7th value is null, and the others repeat from 0 to 999
+bool valueOfRow(int row, int32_t *val) {
+  if (row % 7 == 0) {
+    *val = TSDB_DATA_INT_NULL;
+    return false;
+  }
+
+  *val = row % 1000;
+  return true;
+}
+
+// the value of the double columns is the half of the int column if the schema has any
+double doubleValueOfRow(int row) {
+  int32_t val = 0;
+  valueOfRow(row, &val);
+  return val * 0.5;
+}
+
+// the value of the binary columns, a status of few distinct values
+const char *statusOfRow(int row) {
+  if (row % 7 == 0) return "error";
+  return (row % 100 == 1) ? "stopped" : "running";
+}
+
+// insert the rows in [fromRow, toRow), the key of row i is startKey + i * interval
+int insertRows(TsdbRepoT *pRepo, STableId tableId, STSchema *pSchema, TSKEY startKey, int fromRow, int toRow,
+               TSKEY interval) {
+  SSubmitMsg *pMsg = (SSubmitMsg *)malloc(sizeof(SSubmitMsg) + sizeof(SSubmitBlk) +
+                                          dataRowMaxBytesFromSchema(pSchema) * ROWS_PER_SUBMIT);
+  SShellSubmitRspMsg rsp = {0};
+
+  for (int k = fromRow; k < toRow; k += ROWS_PER_SUBMIT) {
+    memset((void *)pMsg, 0, sizeof(SSubmitMsg) + sizeof(SSubmitBlk));
+    SSubmitBlk *pBlock = pMsg->blocks;
+    int         numOfRows = std::min(ROWS_PER_SUBMIT, toRow - k);
+
+    for (int i = 0; i < numOfRows; i++) {
+      int      row = k + i;
+      TSKEY    key = startKey + row * interval;
+      int32_t  val = 0;
+      SDataRow dataRow = (SDataRow)(pBlock->data + pBlock->len);
+
+      bool notNull = valueOfRow(row, &val);
+      tdInitDataRow(dataRow, pSchema);
+      tdAppendColVal(dataRow, (void *)(&key), TSDB_DATA_TYPE_TIMESTAMP, sizeof(TSKEY), schemaColAt(pSchema, 0)->offset);
+      tdAppendColVal(dataRow, (void *)(&val), TSDB_DATA_TYPE_INT, sizeof(int32_t), schemaColAt(pSchema, 1)->offset);
+      for (int c = 2; c < schemaNCols(pSchema); ++c) {
+        if (schemaColAt(pSchema, c)->type == TSDB_DATA_TYPE_BINARY) {
+          char status[32];
+          varDataLen(status) = sprintf((char *)varDataVal(status), "%s", statusOfRow(row));
+          tdAppendColVal(dataRow, (void *)status, TSDB_DATA_TYPE_BINARY, schemaColAt(pSchema, c)->bytes,
+                         schemaColAt(pSchema, c)->offset);
+          continue;
+        }
+
+        double dval = doubleValueOfRow(row);
+        if (!notNull) setNull((char *)&dval, TSDB_DATA_TYPE_DOUBLE, sizeof(double));
+        tdAppendColVal(dataRow, (void *)(&dval), TSDB_DATA_TYPE_DOUBLE, sizeof(double),
+                       schemaColAt(pSchema, c)->offset);
+      }
+      pBlock->len += dataRowLen(dataRow);
+    }
+
+    pMsg->length = htonl(TSDB_SUBMIT_MSG_HEAD_SIZE + sizeof(SSubmitBlk) + pBlock->len);
+    pMsg->numOfBlocks = htonl(1);
+    pBlock->len = htonl(pBlock->len);
+    pBlock->numOfRows = htons(numOfRows);
+    pBlock->uid = htobe64(tableId.uid);
+    pBlock->tid = htonl(tableId.tid);
+    pBlock->sversion = htonl(0);
+
+    if (tsdbInsertData(pRepo, pMsg, &rsp) != TSDB_CODE_SUCCESS) {
+      free(pMsg);
+      return -1;
+    }
+  }
+
+  free(pMsg);
+  return 0;
+}
+
+void commitAndWait(TsdbRepoT *pRepo) {
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+  ASSERT_EQ(tsdbTriggerCommit(pRepo), 0);
+  while (true) {
+    tsdbLockRepo(pRepo);
+    int commit = repo->commit;
+    tsdbUnLockRepo(pRepo);
+    if (!commit) break;
+    usleep(1000);
+  }
+}
+
+typedef struct {
+  int64_t sum;
+  int64_t count;
+  int64_t min;
+  int64_t max;
+  int32_t loadBlocks;
+  int32_t statisBlocks;
+} SAggResult;
+
+// aggregate the int column in the time window, from the block statistics if useStatis is true
+void aggregate(TsdbRepoT *pRepo, STableId tableId, STimeWindow win, bool useStatis, SAggResult *pRes,
+               int32_t order = TSDB_ORDER_ASC) {
+  SColumnInfo cols[2] = {{0}};
+  cols[0].colId = 0;
+  cols[0].type = TSDB_DATA_TYPE_TIMESTAMP;
+  cols[0].bytes = sizeof(TSKEY);
+  cols[1].colId = 1;
+  cols[1].type = TSDB_DATA_TYPE_INT;
+  cols[1].bytes = sizeof(int32_t);
+
+  STsdbQueryCond cond = {.twindow = win, .order = order, .numOfCols = 2, .colList = cols};
+
+  SArray *group = (SArray *)taosArrayInit(1, sizeof(STableId));
+  taosArrayPush(group, &tableId);
+  STableGroupInfo groupInfo = {.numOfTables = 1, .pGroupList = (SArray *)taosArrayInit(1, POINTER_BYTES)};
+  taosArrayPush(groupInfo.pGroupList, &group);
+
+  memset(pRes, 0, sizeof(SAggResult));
+  pRes->min = INT64_MAX;
+  pRes->max = INT64_MIN;
+
+  TsdbQueryHandleT *pHandle = tsdbQueryTables(pRepo, &cond, &groupInfo);
+  while (tsdbNextDataBlock(pHandle)) {
+    SDataBlockInfo blockInfo = tsdbRetrieveDataBlockInfo(pHandle);
+    SDataStatis *  pStatis = NULL;
+
+    if (useStatis) {
+      ASSERT_EQ(tsdbRetrieveDataBlockStatisInfo(pHandle, &pStatis), TSDB_CODE_SUCCESS);
+    }
+
+    if (pStatis != NULL) {
+      ASSERT_EQ(pStatis[1].colId, 1);
+      if (pStatis[1].numOfNull < blockInfo.rows) {
+        pRes->min = std::min<int64_t>(pRes->min, pStatis[1].min);
+        pRes->max = std::max<int64_t>(pRes->max, pStatis[1].max);
+      }
+      pRes->sum += pStatis[1].sum;
+      pRes->count += blockInfo.rows - pStatis[1].numOfNull;
+      pRes->statisBlocks += 1;
+      continue;
+    }
+
+    SArray *         pDataBlock = tsdbRetrieveDataBlock(pHandle, NULL);
+    SColumnInfoData *pColInfo = (SColumnInfoData *)taosArrayGet(pDataBlock, 1);
+    int32_t *        data = (int32_t *)pColInfo->pData;
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      if (isNull((char *)&data[i], TSDB_DATA_TYPE_INT)) continue;
+      pRes->sum += data[i];
+      pRes->count += 1;
+      pRes->min = std::min<int64_t>(pRes->min, data[i]);
+      pRes->max = std::max<int64_t>(pRes->max, data[i]);
+    }
+    pRes->loadBlocks += 1;
+  }
+
+  tsdbCleanupQueryHandle(pHandle);
+  taosArrayDestroy(group);
+  taosArrayDestroy(groupInfo.pGroupList);
+}
+
+typedef struct {
+  int64_t sum;
+  double  dsum;
+  int64_t count;
+} SHourlyAgg;
+
+typedef struct {
+  int32_t loadBlocks;
+  int32_t statisBlocks;
+} SBlockCount;
+
+// sum and count of the int and double columns in each hour of the window, the blocks inside an hour are aggregated
+// from the statistics
+void hourlyAggregate(TsdbRepoT *pRepo, STableId tableId, STimeWindow win, int64_t rollup,
+                     std::map<TSKEY, SHourlyAgg> *pRes, SBlockCount *pCount) {
+  const TSKEY HOUR = 3600 * 1000L;
+
+  SColumnInfo cols[3] = {{0}};
+  cols[0].colId = 0;
+  cols[0].type = TSDB_DATA_TYPE_TIMESTAMP;
+  cols[0].bytes = sizeof(TSKEY);
+  cols[1].colId = 1;
+  cols[1].type = TSDB_DATA_TYPE_INT;
+  cols[1].bytes = sizeof(int32_t);
+  cols[2].colId = 2;
+  cols[2].type = TSDB_DATA_TYPE_DOUBLE;
+  cols[2].bytes = sizeof(double);
+
+  STsdbQueryCond cond = {.twindow = win, .order = TSDB_ORDER_ASC, .numOfCols = 3, .colList = cols, .rollup = rollup};
+
+  SArray *group = (SArray *)taosArrayInit(1, sizeof(STableId));
+  taosArrayPush(group, &tableId);
+  STableGroupInfo groupInfo = {.numOfTables = 1, .pGroupList = (SArray *)taosArrayInit(1, POINTER_BYTES)};
+  taosArrayPush(groupInfo.pGroupList, &group);
+
+  pRes->clear();
+  memset(pCount, 0, sizeof(SBlockCount));
+
+  TsdbQueryHandleT *pHandle = tsdbQueryTables(pRepo, &cond, &groupInfo);
+  while (tsdbNextDataBlock(pHandle)) {
+    SDataBlockInfo blockInfo = tsdbRetrieveDataBlockInfo(pHandle);
+    SDataStatis *  pStatis = NULL;
+
+    TSKEY hour = blockInfo.window.skey / HOUR * HOUR;
+    if (blockInfo.window.ekey < hour + HOUR) {
+      ASSERT_EQ(tsdbRetrieveDataBlockStatisInfo(pHandle, &pStatis), TSDB_CODE_SUCCESS);
+    }
+
+    if (pStatis != NULL) {
+      SHourlyAgg *pAgg = &(*pRes)[hour];
+      pAgg->sum += pStatis[1].sum;
+      pAgg->dsum += *(double *)&pStatis[2].sum;
+      pAgg->count += blockInfo.rows - pStatis[1].numOfNull;
+      pCount->statisBlocks += 1;
+      continue;
+    }
+
+    SArray * pDataBlock = tsdbRetrieveDataBlock(pHandle, NULL);
+    TSKEY *  keys = (TSKEY *)((SColumnInfoData *)taosArrayGet(pDataBlock, 0))->pData;
+    int32_t *data = (int32_t *)((SColumnInfoData *)taosArrayGet(pDataBlock, 1))->pData;
+    double * ddata = (double *)((SColumnInfoData *)taosArrayGet(pDataBlock, 2))->pData;
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      if (isNull((char *)&data[i], TSDB_DATA_TYPE_INT)) continue;
+      SHourlyAgg *pAgg = &(*pRes)[keys[i] / HOUR * HOUR];
+      pAgg->sum += data[i];
+      pAgg->dsum += ddata[i];
+      pAgg->count += 1;
+    }
+    pCount->loadBlocks += 1;
+  }
+
+  tsdbCleanupQueryHandle(pHandle);
+  taosArrayDestroy(group);
+  taosArrayDestroy(groupInfo.pGroupList);
+}
+
+// flush the data files and drop them from the page cache, return the total size of the .data and .last files
+int64_t dropDataFilesFromPageCache(const char *dir) {
+  char    dataDir[128];
+  int64_t size = 0;
+  snprintf(dataDir, sizeof(dataDir), "%s/data", dir);
+
+  DIR *pDir = opendir(dataDir);
+  if (pDir == NULL) return -1;
+
+  struct dirent *dp = NULL;
+  while ((dp = readdir(pDir)) != NULL) {
+    if (dp->d_name[0] == '.') continue;
+
+    char fname[256];
+    snprintf(fname, sizeof(fname), "%s/%s", dataDir, dp->d_name);
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) continue;
+
+    struct stat st;
+    fstat(fd, &st);
+    if (strstr(dp->d_name, ".data") != NULL || strstr(dp->d_name, ".last") != NULL) size += st.st_size;
+
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+
+  closedir(pDir);
+  return size;
+}
+
+// bytes read by this process so far, the page cache hits included
+int64_t getReadBytes() {
+  FILE *fp = fopen("/proc/self/io", "r");
+  if (fp == NULL) return -1;
+
+  char    line[128];
+  int64_t rchar = -1;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "rchar: %" PRId64, &rchar) == 1) break;
+  }
+
+  fclose(fp);
+  return rchar;
+}
+
+// scan the first numOfCols columns of the table in the window, return the sum of the int column, and the sum of the
+// last column in *pDSum if it is a double one
+int64_t scanColumns(TsdbRepoT *pRepo, STableId tableId, STSchema *pSchema, int numOfCols, STimeWindow win,
+                    int32_t *loadBlocks, double *pDSum = NULL) {
+  SColumnInfo *cols = (SColumnInfo *)calloc(numOfCols, sizeof(SColumnInfo));
+  for (int i = 0; i < numOfCols; ++i) {
+    cols[i].colId = schemaColAt(pSchema, i)->colId;
+    cols[i].type = schemaColAt(pSchema, i)->type;
+    cols[i].bytes = schemaColAt(pSchema, i)->bytes;
+  }
+
+  STsdbQueryCond cond = {.twindow = win, .order = TSDB_ORDER_ASC, .numOfCols = numOfCols, .colList = cols};
+
+  SArray *group = (SArray *)taosArrayInit(1, sizeof(STableId));
+  taosArrayPush(group, &tableId);
+  STableGroupInfo groupInfo = {.numOfTables = 1, .pGroupList = (SArray *)taosArrayInit(1, POINTER_BYTES)};
+  taosArrayPush(groupInfo.pGroupList, &group);
+
+  int64_t sum = 0;
+  double  dsum = 0;
+  bool    lastIsDouble = (cols[numOfCols - 1].type == TSDB_DATA_TYPE_DOUBLE);
+  *loadBlocks = 0;
+
+  TsdbQueryHandleT *pHandle = tsdbQueryTables(pRepo, &cond, &groupInfo);
+  while (tsdbNextDataBlock(pHandle)) {
+    SDataBlockInfo blockInfo = tsdbRetrieveDataBlockInfo(pHandle);
+    SArray *       pDataBlock = tsdbRetrieveDataBlock(pHandle, NULL);
+    int32_t *      data = (int32_t *)((SColumnInfoData *)taosArrayGet(pDataBlock, 1))->pData;
+    double *   ddata = (double *)((SColumnInfoData *)taosArrayGet(pDataBlock, numOfCols - 1))->pData;
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      if (!isNull((char *)&data[i], TSDB_DATA_TYPE_INT)) sum += data[i];
+      if (lastIsDouble && !isNull((char *)&ddata[i], TSDB_DATA_TYPE_DOUBLE)) dsum += ddata[i];
+    }
+    *loadBlocks += 1;
+  }
+
+  tsdbCleanupQueryHandle(pHandle);
+  taosArrayDestroy(group);
+  taosArrayDestroy(groupInfo.pGroupList);
+  free(cols);
+  if (pDSum != NULL) *pDSum = dsum;
+  return sum;
+}
+
+// a filter of the tag column on the value, the value is a string for the binary tags
+tExprNode *newTagFilter(STColumn *pCol, bool isFirstTag, uint8_t optr, int64_t ival, const char *sval) {
+  tExprNode *pLeft = (tExprNode *)calloc(1, sizeof(tExprNode));
+  pLeft->nodeType = TSQL_NODE_COL;
+  pLeft->pSchema = (SSchema *)calloc(1, sizeof(SSchema));
+  pLeft->pSchema->type = pCol->type;
+  pLeft->pSchema->colId = pCol->colId;
+  pLeft->pSchema->bytes = pCol->bytes;
+  snprintf(pLeft->pSchema->name, sizeof(pLeft->pSchema->name), "t%d", pCol->colId);
+
+  tExprNode *pRight = (tExprNode *)calloc(1, sizeof(tExprNode));
+  pRight->nodeType = TSQL_NODE_VALUE;
+  pRight->pVal = (tVariant *)calloc(1, sizeof(tVariant));
+  if (sval != NULL) {
+    pRight->pVal->nType = TSDB_DATA_TYPE_BINARY;
+    pRight->pVal->nLen = (int32_t)strlen(sval);
+    pRight->pVal->pz = strdup(sval);
+  } else {
+    pRight->pVal->nType = TSDB_DATA_TYPE_BIGINT;
+    pRight->pVal->i64Key = ival;
+  }
+
+  tExprNode *pExpr = (tExprNode *)calloc(1, sizeof(tExprNode));
+  pExpr->nodeType = TSQL_NODE_EXPR;
+  pExpr->_node.optr = optr;
+  pExpr->_node.hasPK = isFirstTag;
+  pExpr->_node.pLeft = pLeft;
+  pExpr->_node.pRight = pRight;
+  return pExpr;
+}
+
+tExprNode *newTagExpr(uint8_t optr, tExprNode *pLeft, tExprNode *pRight) {
+  tExprNode *pExpr = (tExprNode *)calloc(1, sizeof(tExprNode));
+  pExpr->nodeType = TSQL_NODE_EXPR;
+  pExpr->_node.optr = optr;
+  pExpr->_node.pLeft = pLeft;
+  pExpr->_node.pRight = pRight;
+  return pExpr;
+}
+
+// the sorted tids of the child tables qualified by the tag condition, which is serialized as sent by the client
+std::vector<int32_t> queryTablesByTagCond(TsdbRepoT *pRepo, uint64_t suid, tExprNode *pExpr,
+                                          SColIndex *pGroupCols = NULL, int32_t numOfGroupCols = 0,
+                                          size_t *numOfGroups = NULL) {
+  SBufferWriter bw = tbufInitWriter(NULL, false);
+  exprTreeToBinary(&bw, pExpr);
+
+  STableGroupInfo groupInfo = {0};
+  EXPECT_EQ(tsdbQuerySTableByTagCond(pRepo, suid, tbufGetData(&bw, false), tbufTell(&bw), TSDB_RELATION_AND, NULL,
+                                     &groupInfo, pGroupCols, numOfGroupCols),
+            TSDB_CODE_SUCCESS);
+  tbufCloseWriter(&bw);
+
+  std::vector<int32_t> tids;
+  for (size_t i = 0; i < taosArrayGetSize(groupInfo.pGroupList); ++i) {
+    SArray *group = (SArray *)taosArrayGetP(groupInfo.pGroupList, i);
+    for (size_t j = 0; j < taosArrayGetSize(group); ++j) tids.push_back(((STableId *)taosArrayGet(group, j))->tid);
+    taosArrayDestroy(group);
+  }
+  if (numOfGroups != NULL) *numOfGroups = taosArrayGetSize(groupInfo.pGroupList);
+  EXPECT_EQ(groupInfo.numOfTables, tids.size());
+  taosArrayDestroy(groupInfo.pGroupList);
+
+  std::sort(tids.begin(), tids.end());
+  return tids;
+}
+
+// the devices of a super table, child table tid has the uid of the super table plus tid
+const int LOCATIONS = 100;
+const int MODELS = 50;
+const int FIRMWARES = 7;
+
+int locationOf(int tid) { return tid % LOCATIONS; }
+int modelOf(int tid) { return (tid / LOCATIONS) % MODELS; }
+int firmwareOf(int tid) { return tid % FIRMWARES; }
+
+// location, model and firmware of the devices
+STSchema *newDeviceTagSchema() {
+  STSchema *pTagSchema = tdNewSchema(3);
+  tdSchemaAddCol(pTagSchema, TSDB_DATA_TYPE_INT, 2, -1);
+  tdSchemaAddCol(pTagSchema, TSDB_DATA_TYPE_BINARY, 3, 16);
+  tdSchemaAddCol(pTagSchema, TSDB_DATA_TYPE_INT, 4, -1);
+  return pTagSchema;
+}
+
+// create the devices of tid in [fromTid, toTid]
+int createDevices(TsdbRepoT *pRepo, uint64_t suid, STSchema *pSchema, STSchema *pTagSchema, int fromTid, int toTid) {
+  for (int tid = fromTid; tid <= toTid; ++tid) {
+    char name[32], model[32];
+    snprintf(name, sizeof(name), "d%d", tid);
+    varDataLen(model) = sprintf((char *)varDataVal(model), "m%d", modelOf(tid));
+    int32_t tags[3] = {locationOf(tid), 0, firmwareOf(tid)};
+
+    SDataRow row = tdNewDataRowFromSchema(pTagSchema);
+    for (int i = 0; i < 3; ++i) {
+      STColumn *pCol = schemaColAt(pTagSchema, i);
+      tdAppendColVal(row, (i == 1) ? (void *)model : (void *)&tags[i], pCol->type, pCol->bytes, pCol->offset);
+    }
+
+    STableCfg tCfg;
+    tsdbInitTableCfg(&tCfg, TSDB_CHILD_TABLE, suid + tid, tid);
+    tsdbTableSetName(&tCfg, name, false);
+    tsdbTableSetSName(&tCfg, (char *)"devices", false);
+    tsdbTableSetSuperUid(&tCfg, suid);
+    tsdbTableSetSchema(&tCfg, pSchema, false);
+    tsdbTableSetTagSchema(&tCfg, pTagSchema, false);
+    tsdbTableSetTagValue(&tCfg, row, false);
+    int code = tsdbCreateTable(pRepo, &tCfg);
+    tdFreeDataRow(row);
+    if (code != 0) return code;
+  }
+
+  return 0;
+}
+
+}  // namespace
+
+class TsdbReadTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", READ_TEST_DIR);
+    system(cmd);
+
+    tsdbSetDefaultCfg(&config);
+    config.maxTables = TSDB_MIN_TABLES;
+    config.cacheBlockSize = 16;
+    config.totalBlocks = 32;
+
+    // the configurations changed by the tests are restored
+    blockCacheSize = tsBlockCacheSize;
+    readAheadBlocks = tsReadAheadBlocks;
+    decompressThreads = tsDecompressThreads;
+  }
+
+  void TearDown() override {
+    if (pRepo != NULL) tsdbCloseRepo(pRepo, 0);
+    if (pSchema != NULL) tdFreeSchema(pSchema);
+    tsBlockCacheSize = blockCacheSize;
+    tsReadAheadBlocks = readAheadBlocks;
+    tsDecompressThreads = decompressThreads;
+    tsRollupIntervals[0] = 0;
+  }
+
+  // create and open the repository of config
+  int openRepo() {
+    if (tsdbCreateRepo((char *)READ_TEST_DIR, &config, NULL) != 0) return -1;
+    pRepo = tsdbOpenRepo((char *)READ_TEST_DIR, NULL);
+    return (pRepo == NULL) ? -1 : 0;
+  }
+
+  // create the table t1 of a timestamp column, an int column, and numOfCols - 2 columns of the type
+  int createTable(int numOfCols, int8_t type = TSDB_DATA_TYPE_DOUBLE, int16_t bytes = -1) {
+    pSchema = tdNewSchema(numOfCols);
+    tdSchemaAddCol(pSchema, TSDB_DATA_TYPE_TIMESTAMP, 0, -1);
+    tdSchemaAddCol(pSchema, TSDB_DATA_TYPE_INT, 1, -1);
+    for (int c = 2; c < numOfCols; ++c) tdSchemaAddCol(pSchema, type, c, bytes);
+
+    if (tsdbInitTableCfg(&tCfg, TSDB_NORMAL_TABLE, 1001, 1) != 0) return -1;
+    tsdbTableSetName(&tCfg, (char *)"t1", false);
+    tsdbTableSetSchema(&tCfg, pSchema, true);
+    return tsdbCreateTable(pRepo, &tCfg);
+  }
+
+  STsdbCfg   config;
+  TsdbRepoT *pRepo = NULL;
+  STSchema * pSchema = NULL;
+  STableCfg  tCfg;
+  int32_t    blockCacheSize = 0;
+  int32_t    readAheadBlocks = 0;
+  int32_t    decompressThreads = 0;
+};
+
+TEST_F(TsdbReadTest, aggregateByBlockStatis) {
+  ASSERT_EQ(openRepo(), 0);
+
+  ASSERT_EQ(createTable(2), 0);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)NUM_OF_ROWS * INTERVAL * 2;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, NUM_OF_ROWS, INTERVAL), 0);
+
+  // commit all rows into data files
+  commitAndWait(pRepo);
+
+  // the query window starts and ends in the middle of data blocks
+  int         firstRow = 1234, lastRow = NUM_OF_ROWS - 4321;
+  STimeWindow win = {.skey = startKey + firstRow * INTERVAL, .ekey = startKey + lastRow * INTERVAL};
+
+  SAggResult expect = {0};
+  expect.min = INT64_MAX;
+  expect.max = INT64_MIN;
+  for (int row = firstRow; row <= lastRow; ++row) {
+    int32_t val = 0;
+    if (valueOfRow(row, &val)) {
+      expect.sum += val;
+      expect.count += 1;
+      expect.min = std::min<int64_t>(expect.min, val);
+      expect.max = std::max<int64_t>(expect.max, val);
+    }
+  }
+
+  SAggResult res[2];
+  for (int i = 0; i < 2; ++i) {
+    aggregate(pRepo, tCfg.tableId, win, (i == 1), &res[i]);
+
+    EXPECT_EQ(res[i].sum, expect.sum);
+    EXPECT_EQ(res[i].count, expect.count);
+    EXPECT_EQ(res[i].min, expect.min);
+    EXPECT_EQ(res[i].max, expect.max);
+  }
+
+  // only the two boundary blocks are loaded
+  EXPECT_EQ(res[1].loadBlocks, 2);
+  EXPECT_GT(res[1].statisBlocks, 0);
+  EXPECT_EQ(res[1].loadBlocks + res[1].statisBlocks, res[0].loadBlocks);
+}
+
+TEST_F(TsdbReadTest, doubleStatisOfOldBlocks) {
+  SRWHelper helper;
+  memset(&helper, 0, sizeof(helper));
+  helper.pCompData = (SCompData *)calloc(1, sizeof(SCompData) + sizeof(SCompCol) * 2);
+  helper.pCompData->numOfCols = 2;
+  helper.pCompData->cols[0].colId = 1;
+  helper.pCompData->cols[0].type = TSDB_DATA_TYPE_INT;
+  helper.pCompData->cols[0].sum = 10;
+  helper.pCompData->cols[1].colId = 2;
+  helper.pCompData->cols[1].type = TSDB_DATA_TYPE_DOUBLE;
+  helper.pCompData->cols[1].sum = 5;  // the sum converted to int64 before the flags
+  *(double *)(&helper.pCompData->cols[1].max) = 1.5;
+
+  SDataStatis statis[2] = {{0}};
+  statis[0].colId = 1;
+  statis[1].colId = 2;
+
+  // the statistics of an int column are in the same layout in the blocks written before
+  EXPECT_EQ(tsdbGetDataStatis(&helper, statis, 1), 0);
+  EXPECT_EQ(statis[0].sum, 10);
+  EXPECT_EQ(tsdbGetDataStatis(&helper, statis, 2), -1);
+
+  helper.pCompData->cols[1].flags |= TSDB_COL_FLAG_DOUBLE_STATIS;
+  EXPECT_EQ(tsdbGetDataStatis(&helper, statis, 2), 0);
+  EXPECT_EQ(*(double *)(&statis[1].max), 1.5);
+
+  free(helper.pCompData);
+}
+
+TEST_F(TsdbReadTest, hourlyAverageByRollup) {
+  const TSKEY DAY = 86400 * 1000L;
+  const TSKEY ROW_INTERVAL = 30 * 1000L;
+  const int   DAYS = 90;
+  const int   ROWS = DAYS * (DAY / ROW_INTERVAL);
+
+  strcpy(tsRollupIntervals, "60,3600,86400");
+
+  ASSERT_EQ(openRepo(), 0);
+
+  ASSERT_EQ(createTable(3), 0);
+
+  // the second commit appends to a file group committed by the first one, so its rollups are updated incrementally
+  TSKEY startKey = (taosGetTimestampMs() - (TSKEY)(DAYS + 10) * DAY) / DAY * DAY;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, ROWS / 2 + 1234, ROW_INTERVAL), 0);
+  commitAndWait(pRepo);
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, ROWS / 2 + 1234, ROWS, ROW_INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  // the window covers all file groups of the data
+  STimeWindow win = {.skey = startKey - 20 * DAY, .ekey = startKey + (DAYS + 20) * DAY};
+  int64_t     rollup = tsdbGetRollupInterval(pRepo, 3600 * 1000L, win.skey);
+  EXPECT_EQ(rollup, 3600 * 1000L);
+  EXPECT_EQ(tsdbGetRollupInterval(pRepo, 7 * 1000L, win.skey), 0);
+
+  std::map<TSKEY, SHourlyAgg> res[2];
+  SBlockCount                 count[2];
+  for (int i = 0; i < 2; ++i) {
+    hourlyAggregate(pRepo, tCfg.tableId, win, (i == 1) ? rollup : 0, &res[i], &count[i]);
+  }
+
+  ASSERT_EQ(res[0].size(), (size_t)DAYS * 24);
+  ASSERT_EQ(res[1].size(), res[0].size());
+  for (std::map<TSKEY, SHourlyAgg>::iterator it = res[0].begin(); it != res[0].end(); ++it) {
+    SHourlyAgg *pAgg = &res[1][it->first];
+    EXPECT_EQ(pAgg->count, it->second.count);
+    EXPECT_EQ(pAgg->sum, it->second.sum);
+    EXPECT_DOUBLE_EQ(pAgg->dsum, it->second.dsum);
+  }
+
+  // all rows are served by the hourly rollups
+  EXPECT_EQ(count[1].loadBlocks, 0);
+  EXPECT_EQ(count[1].statisBlocks, DAYS * 24);
+}
+
+TEST_F(TsdbReadTest, staleRollupAfterCrash) {
+  const TSKEY DAY = 86400 * 1000L;
+  const TSKEY ROW_INTERVAL = 1200 * 1000L;
+  const int   ROWS = DAY / ROW_INTERVAL;
+
+  strcpy(tsRollupIntervals, "60,3600,86400");
+
+  ASSERT_EQ(openRepo(), 0);
+
+  ASSERT_EQ(createTable(3), 0);
+
+  // the rows of a day are fewer than minRowsPerFileBlock, the last block is merged with the rows of the next commit
+  TSKEY startKey = (taosGetTimestampMs() - 30 * DAY) / DAY * DAY;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, ROWS - 10, ROW_INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  SFileGroup *pGroup = &((STsdbRepo *)pRepo)->tsdbFileH->fGroup[0];
+  char        fname[128] = "\0";
+  char        cmd[300];
+  ASSERT_EQ(tsdbGetRollupFileName(pGroup, TSDB_ROLLUP_FILE_SUFFIX, fname), 0);
+  snprintf(cmd, sizeof(cmd), "cp %s %s.old", fname, fname);
+  ASSERT_EQ(system(cmd), 0);
+
+  // so the SCompIdx part of the new .head file is at the same offset, only its version tells the rollups are stale
+  STsdbFileInfo info = pGroup->files[TSDB_FILE_TYPE_HEAD].info;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, ROWS - 10, ROWS, ROW_INTERVAL), 0);
+  commitAndWait(pRepo);
+  EXPECT_EQ(pGroup->files[TSDB_FILE_TYPE_HEAD].info.offset, info.offset);
+  EXPECT_EQ(pGroup->files[TSDB_FILE_TYPE_HEAD].info.len, info.len);
+  EXPECT_NE(pGroup->files[TSDB_FILE_TYPE_HEAD].info.version, info.version);
+
+  // a crash after the .head file is renamed leaves the rollups of the first commit
+  tsdbCloseRepo(pRepo, 0);
+  snprintf(cmd, sizeof(cmd), "mv %s.old %s", fname, fname);
+  ASSERT_EQ(system(cmd), 0);
+  pRepo = tsdbOpenRepo((char *)READ_TEST_DIR, NULL);
+  ASSERT_NE(pRepo, (TsdbRepoT *)NULL);
+
+  STimeWindow win = {.skey = startKey - 20 * DAY, .ekey = startKey + 20 * DAY};
+  int64_t     rollup = tsdbGetRollupInterval(pRepo, 3600 * 1000L, win.skey);
+
+  std::map<TSKEY, SHourlyAgg> res[2];
+  SBlockCount                 count[2];
+  for (int i = 0; i < 2; ++i) {
+    hourlyAggregate(pRepo, tCfg.tableId, win, (i == 1) ? rollup : 0, &res[i], &count[i]);
+  }
+
+  // the stale rollups are not used
+  ASSERT_EQ(res[0].size(), (size_t)24);
+  ASSERT_EQ(res[1].size(), res[0].size());
+  for (std::map<TSKEY, SHourlyAgg>::iterator it = res[0].begin(); it != res[0].end(); ++it) {
+    SHourlyAgg *pAgg = &res[1][it->first];
+    EXPECT_EQ(pAgg->count, it->second.count);
+    EXPECT_EQ(pAgg->sum, it->second.sum);
+    EXPECT_DOUBLE_EQ(pAgg->dsum, it->second.dsum);
+  }
+  EXPECT_EQ(count[1].loadBlocks, count[0].loadBlocks);
+}
+
+TEST_F(TsdbReadTest, repeatedQueryByBlockCache) {
+  ASSERT_EQ(openRepo(), 0);
+  SLRUCache *pCache = ((STsdbRepo *)pRepo)->pBlockCache;
+  ASSERT_NE(pCache, nullptr);
+
+  ASSERT_EQ(createTable(2), 0);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)NUM_OF_ROWS * INTERVAL * 2;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, NUM_OF_ROWS, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  STimeWindow win = {.skey = startKey, .ekey = startKey + NUM_OF_ROWS * INTERVAL};
+
+  // the same query repeated, like a dashboard refreshed periodically
+  SAggResult   res[3];
+  SCacheStatis statis[3];
+  for (int i = 0; i < 3; ++i) {
+    aggregate(pRepo, tCfg.tableId, win, false, &res[i]);
+    taosLRUCacheGetStatis(pCache, &statis[i]);
+  }
+
+  EXPECT_EQ(statis[0].hitCount, 0);
+  EXPECT_GT(statis[0].missCount, 0);
+  for (int i = 1; i < 3; ++i) {
+    EXPECT_EQ(res[i].sum, res[0].sum);
+    EXPECT_EQ(res[i].count, res[0].count);
+    EXPECT_EQ(res[i].loadBlocks, res[0].loadBlocks);
+    // two columns of each block are served by the cache
+    EXPECT_EQ(statis[i].hitCount - statis[i - 1].hitCount, res[0].loadBlocks * 2);
+    EXPECT_EQ(statis[i].missCount, statis[0].missCount);
+  }
+  EXPECT_GT(taosLRUCacheGetUsage(pCache), 0);
+
+  // a small table kept in the last file, whose block gets a sub-block at the same offset by the next commit
+  ASSERT_EQ(tsdbInitTableCfg(&tCfg, TSDB_NORMAL_TABLE, 1002, 2), 0);
+  tsdbTableSetName(&tCfg, (char *)"t2", false);
+  tsdbTableSetSchema(&tCfg, pSchema, true);
+  ASSERT_EQ(tsdbCreateTable(pRepo, &tCfg), 0);
+
+  const int ROWS = 50;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, ROWS, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  aggregate(pRepo, tCfg.tableId, win, false, &res[0]);
+  aggregate(pRepo, tCfg.tableId, win, false, &res[1]);
+  EXPECT_EQ(res[1].sum, res[0].sum);
+
+  // rows between the existing ones, the blocks of the old files must not be served from the cache
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey + INTERVAL / 2, 0, ROWS / 2, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  int64_t sum = res[0].sum, count = res[0].count;
+  for (int row = 0; row < ROWS / 2; ++row) {
+    int32_t val = 0;
+    if (valueOfRow(row, &val)) {
+      sum += val;
+      count += 1;
+    }
+  }
+
+  aggregate(pRepo, tCfg.tableId, win, false, &res[2]);
+  EXPECT_EQ(res[2].sum, sum);
+  EXPECT_EQ(res[2].count, count);
+}
+
+TEST_F(TsdbReadTest, coldScanWithReadAhead) {
+  const int ROWS = NUM_OF_ROWS * 2;
+
+  // the blocks are read from the files in each scan
+  tsBlockCacheSize = 0;
+
+  ASSERT_EQ(openRepo(), 0);
+
+  ASSERT_EQ(createTable(3), 0);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)ROWS * INTERVAL * 2;
+  for (int row = 0; row < ROWS; row += NUM_OF_ROWS) {
+    ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, row, std::min(row + NUM_OF_ROWS, ROWS), INTERVAL), 0);
+    commitAndWait(pRepo);
+  }
+
+  // the kernel reads ahead by itself in a forward scan, but not in a backward one, whose windows are reversed
+  STimeWindow win[2] = {{.skey = startKey, .ekey = startKey + ROWS * INTERVAL},
+                        {.skey = startKey + ROWS * INTERVAL, .ekey = startKey}};
+  int32_t     order[2] = {TSDB_ORDER_ASC, TSDB_ORDER_DESC};
+
+  SAggResult res[2][2];
+  for (int o = 0; o < 2; ++o) {
+    for (int i = 0; i < 2; ++i) {
+      tsReadAheadBlocks = (i == 0) ? 0 : readAheadBlocks;
+      ASSERT_GT(dropDataFilesFromPageCache(READ_TEST_DIR), 0);
+
+      aggregate(pRepo, tCfg.tableId, win[o], false, &res[o][i], order[o]);
+
+      EXPECT_EQ(res[o][i].sum, res[0][0].sum);
+      EXPECT_EQ(res[o][i].count, res[0][0].count);
+      EXPECT_EQ(res[o][i].loadBlocks, res[0][0].loadBlocks);
+    }
+  }
+}
+
+TEST_F(TsdbReadTest, projectedScanOfWideTable) {
+  const int NUM_OF_COLS = 52;
+
+  // the blocks are read from the files in each scan
+  tsBlockCacheSize = 0;
+
+  ASSERT_EQ(openRepo(), 0);
+
+  ASSERT_EQ(createTable(NUM_OF_COLS), 0);
+
+  int   rows = NUM_OF_ROWS / 4;
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)rows * INTERVAL * 2;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, rows, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  STimeWindow win = {.skey = startKey, .ekey = startKey + rows * INTERVAL};
+
+  // a scan of two columns reads a small part of each block, while a scan of all columns reads all of them
+  int     numOfCols[2] = {2, NUM_OF_COLS};
+  int64_t sum[2], readBytes[2];
+  int32_t loadBlocks[2];
+  for (int i = 0; i < 2; ++i) {
+    int64_t rchar = getReadBytes();
+    sum[i] = scanColumns(pRepo, tCfg.tableId, pSchema, numOfCols[i], win, &loadBlocks[i]);
+    readBytes[i] = getReadBytes() - rchar;
+  }
+
+  int64_t expect = 0;
+  for (int row = 0; row < rows; ++row) {
+    int32_t val = 0;
+    if (valueOfRow(row, &val)) expect += val;
+  }
+
+  EXPECT_EQ(sum[0], expect);
+  EXPECT_EQ(sum[1], expect);
+  EXPECT_EQ(loadBlocks[0], loadBlocks[1]);
+  EXPECT_LT(readBytes[0] * 5, readBytes[1]);
+}
+
+TEST_F(TsdbReadTest, parallelDecompression) {
+  const int NUM_OF_COLS = 100;
+  const int THREADS = 4;
+
+  // the blocks are decoded in each scan
+  tsBlockCacheSize = 0;
+  tsDecompressThreads = THREADS;
+
+  ASSERT_EQ(openRepo(), 0);
+  STsdbDecompPool *pPool = ((STsdbRepo *)pRepo)->pDecompPool;
+  ASSERT_NE(pPool, nullptr);
+  EXPECT_EQ(pPool->numOfThreads, THREADS);
+
+  ASSERT_EQ(createTable(NUM_OF_COLS), 0);
+
+  int   rows = NUM_OF_ROWS / 2;
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)rows * INTERVAL * 2;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, rows, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  STimeWindow win = {.skey = startKey, .ekey = startKey + rows * INTERVAL};
+
+  // the first scan warms up the page cache, and the queries without the pool decode the columns one by one
+  int64_t sum[3];
+  double  dsum[3];
+  int32_t loadBlocks[3];
+  for (int i = 0; i < 3; ++i) {
+    ((STsdbRepo *)pRepo)->pDecompPool = (i == 2) ? pPool : NULL;
+    sum[i] = scanColumns(pRepo, tCfg.tableId, pSchema, NUM_OF_COLS, win, &loadBlocks[i], &dsum[i]);
+  }
+  ((STsdbRepo *)pRepo)->pDecompPool = pPool;
+
+  int64_t expect = 0;
+  double  dexpect = 0;
+  for (int row = 0; row < rows; ++row) {
+    int32_t val = 0;
+    if (valueOfRow(row, &val)) {
+      expect += val;
+      dexpect += doubleValueOfRow(row);
+    }
+  }
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(sum[i], expect);
+    EXPECT_DOUBLE_EQ(dsum[i], dexpect);
+    EXPECT_EQ(loadBlocks[i], loadBlocks[0]);
+  }
+}
+
+TEST_F(TsdbReadTest, dictionaryEncodedStatusColumn) {
+  const int STATUS_BYTES = 16;
+
+  // the codes are not cached
+  tsBlockCacheSize = 0;
+
+  ASSERT_EQ(openRepo(), 0);
+
+  ASSERT_EQ(createTable(3, TSDB_DATA_TYPE_BINARY, STATUS_BYTES), 0);
+
+  int   rows = NUM_OF_ROWS / 4;
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)rows * INTERVAL * 2;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, rows, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  SColumnInfo cols[3] = {{0}};
+  for (int i = 0; i < 3; ++i) {
+    cols[i].colId = schemaColAt(pSchema, i)->colId;
+    cols[i].type = schemaColAt(pSchema, i)->type;
+    cols[i].bytes = schemaColAt(pSchema, i)->bytes;
+  }
+
+  STsdbQueryCond cond = {.twindow = {.skey = startKey, .ekey = startKey + rows * INTERVAL},
+                         .order = TSDB_ORDER_ASC,
+                         .numOfCols = 3,
+                         .colList = cols};
+
+  SArray *group = (SArray *)taosArrayInit(1, sizeof(STableId));
+  taosArrayPush(group, &tCfg.tableId);
+  STableGroupInfo groupInfo = {.numOfTables = 1, .pGroupList = (SArray *)taosArrayInit(1, POINTER_BYTES)};
+  taosArrayPush(groupInfo.pGroupList, &group);
+
+  // count the rows of the error status by comparing the strings, and by comparing each distinct value only
+  int64_t numOfErrors[2] = {0};
+  int32_t numOfBlocks = 0, numOfDictBlocks = 0;
+
+  TsdbQueryHandleT *pHandle = tsdbQueryTables(pRepo, &cond, &groupInfo);
+  while (tsdbNextDataBlock(pHandle)) {
+    SDataBlockInfo blockInfo = tsdbRetrieveDataBlockInfo(pHandle);
+    SArray *       pDataBlock = tsdbRetrieveDataBlock(pHandle, NULL);
+    char *         data = (char *)((SColumnInfoData *)taosArrayGet(pDataBlock, 2))->pData;
+
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      char *value = data + STATUS_BYTES * i;
+      if (varDataLen(value) == 5 && strncmp((char *)varDataVal(value), "error", 5) == 0) numOfErrors[0]++;
+    }
+
+    const uint8_t *codes = NULL;
+    int32_t        dictSize = tsdbRetrieveDataBlockDictCodes(pHandle, 2, &codes);
+    numOfBlocks++;
+    if (dictSize == 0) continue;
+
+    ASSERT_LE(dictSize, 3);
+    numOfDictBlocks++;
+
+    int8_t res[DICT_MAX_ENTRIES];
+    memset(res, -1, sizeof(res));
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      if (res[codes[i]] < 0) {
+        char *value = data + STATUS_BYTES * i;
+        res[codes[i]] = (varDataLen(value) == 5 && strncmp((char *)varDataVal(value), "error", 5) == 0);
+      }
+      numOfErrors[1] += res[codes[i]];
+    }
+
+    // the rows of the same code have the same value
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      for (int32_t j = 0; j < i && j < 64; ++j) {
+        if (codes[i] != codes[j]) continue;
+        ASSERT_EQ(memcmp(data + STATUS_BYTES * i, data + STATUS_BYTES * j, varDataTLen(data + STATUS_BYTES * i)), 0);
+      }
+    }
+  }
+
+  int64_t expect = 0;
+  for (int row = 0; row < rows; ++row) {
+    if (strcmp(statusOfRow(row), "error") == 0) expect++;
+  }
+
+  // all the blocks are returned as a whole, each of which has 3 distinct values
+  EXPECT_EQ(numOfErrors[0], expect);
+  EXPECT_EQ(numOfErrors[1], expect);
+  EXPECT_EQ(numOfDictBlocks, numOfBlocks);
+
+  tsdbCleanupQueryHandle(pHandle);
+  taosArrayDestroy(group);
+  taosArrayDestroy(groupInfo.pGroupList);
+}
+
+TEST_F(TsdbReadTest, narrowQueryByBlockIdx) {
+  const int QUERIES = 200;
+  const int ROWS_PER_QUERY = 500;
+
+  // small blocks, so that the SCompInfo of the table is large
+  config.maxRowsPerFileBlock = TSDB_MIN_MAX_ROW_FBLOCK;
+  config.minRowsPerFileBlock = TSDB_MIN_MIN_ROW_FBLOCK;
+  ASSERT_EQ(openRepo(), 0);
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+  SLRUCache *pCache = repo->pBlockIdxCache;
+  ASSERT_NE(pCache, nullptr);
+
+  ASSERT_EQ(createTable(2), 0);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)NUM_OF_ROWS * INTERVAL * 2;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, NUM_OF_ROWS, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  // windows spread over the table, with the expected results
+  std::vector<STimeWindow> wins;
+  std::vector<SAggResult>  expects;
+  for (int q = 0; q < QUERIES; ++q) {
+    int        from = (int)((int64_t)q * (NUM_OF_ROWS - ROWS_PER_QUERY) / QUERIES);
+    SAggResult expect = {0};
+    for (int row = from; row < from + ROWS_PER_QUERY; ++row) {
+      int32_t val = 0;
+      if (!valueOfRow(row, &val)) continue;
+      expect.sum += val;
+      expect.count += 1;
+    }
+    wins.push_back({startKey + from * INTERVAL, startKey + (from + ROWS_PER_QUERY - 1) * INTERVAL});
+    expects.push_back(expect);
+  }
+
+  // without the block index, then with the indexes put by the commit
+  for (int i = 0; i < 2; ++i) {
+    repo->pBlockIdxCache = (i == 0) ? NULL : pCache;
+    for (int q = 0; q < QUERIES; ++q) {
+      SAggResult res;
+      aggregate(pRepo, tCfg.tableId, wins[q], false, &res);
+      ASSERT_EQ(res.sum, expects[q].sum);
+      ASSERT_EQ(res.count, expects[q].count);
+    }
+  }
+
+  SCacheStatis statis;
+  taosLRUCacheGetStatis(pCache, &statis);
+  // a query looks for its blocks in each file group it overlaps
+  EXPECT_GE(statis.hitCount, QUERIES);
+  EXPECT_EQ(statis.missCount, 0);
+
+  // a commit of rows after the last ones puts the index of the new files, the old one is not hit any more
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, NUM_OF_ROWS, NUM_OF_ROWS + ROWS_PER_QUERY, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  SAggResult  res, expect = {0};
+  STimeWindow win = {startKey + NUM_OF_ROWS * INTERVAL, startKey + (NUM_OF_ROWS + ROWS_PER_QUERY) * INTERVAL};
+  for (int row = NUM_OF_ROWS; row < NUM_OF_ROWS + ROWS_PER_QUERY; ++row) {
+    int32_t val = 0;
+    if (!valueOfRow(row, &val)) continue;
+    expect.sum += val;
+    expect.count += 1;
+  }
+  aggregate(pRepo, tCfg.tableId, win, false, &res);
+  EXPECT_EQ(res.sum, expect.sum);
+  EXPECT_EQ(res.count, expect.count);
+
+  SCacheStatis statis2;
+  taosLRUCacheGetStatis(pCache, &statis2);
+  EXPECT_GT(statis2.hitCount, statis.hitCount);
+  EXPECT_EQ(statis2.missCount, 0);
+}
+
+TEST_F(TsdbReadTest, failedQueryOnCorruptedCompInfo) {
+  ASSERT_EQ(openRepo(), 0);
+  ASSERT_EQ(createTable(2), 0);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)NUM_OF_ROWS * INTERVAL * 2;
+  ASSERT_EQ(insertRows(pRepo, tCfg.tableId, pSchema, startKey, 0, NUM_OF_ROWS, INTERVAL), 0);
+  commitAndWait(pRepo);
+
+  // the SCompInfo of the table is read from the head file, not from the block index
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+  SLRUCache *pCache = repo->pBlockIdxCache;
+  repo->pBlockIdxCache = NULL;
+
+  SFileGroup *pGroup = repo->tsdbFileH->fGroup;
+  SRWHelper   rhelper;
+  ASSERT_EQ(tsdbInitReadHelper(&rhelper, repo), 0);
+  ASSERT_EQ(tsdbSetAndOpenHelperFile(&rhelper, pGroup), 0);
+  SCompIdx *pIdx = rhelper.pCompIdx + tCfg.tableId.tid;
+  ASSERT_GT(pIdx->len, 0);
+  long offset = (long)pIdx->offset + pIdx->len / 2;
+  tsdbDestroyHelper(&rhelper);
+
+  FILE *fp = fopen(pGroup->files[TSDB_FILE_TYPE_HEAD].fname, "r+b");
+  ASSERT_NE(fp, nullptr);
+  ASSERT_EQ(fseek(fp, offset, SEEK_SET), 0);
+  int c = fgetc(fp);
+  ASSERT_EQ(fseek(fp, offset, SEEK_SET), 0);
+  fputc(c ^ 0xff, fp);
+  fclose(fp);
+
+  // the query fails with the error instead of returning the rows of the other file groups and the cache
+  SColumnInfo cols[2] = {{0}};
+  cols[0].colId = 0;
+  cols[0].type = TSDB_DATA_TYPE_TIMESTAMP;
+  cols[0].bytes = sizeof(TSKEY);
+  cols[1].colId = 1;
+  cols[1].type = TSDB_DATA_TYPE_INT;
+  cols[1].bytes = sizeof(int32_t);
+
+  STimeWindow    win = {startKey, startKey + NUM_OF_ROWS * INTERVAL};
+  STsdbQueryCond cond = {.twindow = win, .order = TSDB_ORDER_ASC, .numOfCols = 2, .colList = cols};
+
+  SArray *group = (SArray *)taosArrayInit(1, sizeof(STableId));
+  taosArrayPush(group, &tCfg.tableId);
+  STableGroupInfo groupInfo = {.numOfTables = 1, .pGroupList = (SArray *)taosArrayInit(1, POINTER_BYTES)};
+  taosArrayPush(groupInfo.pGroupList, &group);
+
+  TsdbQueryHandleT *pHandle = tsdbQueryTables(pRepo, &cond, &groupInfo);
+  int               numOfBlocks = 0;
+  while (tsdbNextDataBlock(pHandle)) numOfBlocks++;
+  EXPECT_EQ(numOfBlocks, 0);
+  EXPECT_EQ(tsdbGetQueryCode(pHandle), TSDB_CODE_FILE_CORRUPTED);
+
+  tsdbCleanupQueryHandle(pHandle);
+  taosArrayDestroy(group);
+  taosArrayDestroy(groupInfo.pGroupList);
+  repo->pBlockIdxCache = pCache;
+}
+
+TEST_F(TsdbReadTest, tagFilterByTagIndex) {
+  const int      SCALES[] = {10000, 20000};
+  const uint64_t SUPER_UID = 1000000;
+
+  config.maxTables = SCALES[1] + 1;
+
+  // the tables are resolved by every query
+  int32_t tagCondCacheSize = tsTagCondCacheSize;
+  tsTagCondCacheSize = 0;
+  int     code = openRepo();
+  tsTagCondCacheSize = tagCondCacheSize;
+  ASSERT_EQ(code, 0);
+
+  pSchema = tdNewSchema(2);
+  tdSchemaAddCol(pSchema, TSDB_DATA_TYPE_TIMESTAMP, 0, -1);
+  tdSchemaAddCol(pSchema, TSDB_DATA_TYPE_INT, 1, -1);
+
+  STSchema *pTagSchema = newDeviceTagSchema();
+  STColumn *pLocation = schemaColAt(pTagSchema, 0);
+  STColumn *pModel = schemaColAt(pTagSchema, 1);
+  STColumn *pFirmware = schemaColAt(pTagSchema, 2);
+
+  int numOfTables = 0;
+  for (int scale : SCALES) {
+    ASSERT_EQ(createDevices(pRepo, SUPER_UID, pSchema, pTagSchema, numOfTables + 1, scale), 0);
+    numOfTables = scale;
+
+    STable *pSTable = tsdbGetTableByUid(tsdbGetMeta(pRepo), SUPER_UID);
+    ASSERT_NE(pSTable, nullptr);
+    ASSERT_NE(pSTable->pTagIndex, nullptr);
+
+    // model = 'm7' AND firmware = 3, model = 'm7' OR model = 'm9', location = 5 AND model = 'm7'
+    std::function<bool(int)> matches[] = {
+        [&](int tid) { return modelOf(tid) == 7 && firmwareOf(tid) == 3; },
+        [&](int tid) { return modelOf(tid) == 7 || modelOf(tid) == 9; },
+        [&](int tid) { return locationOf(tid) == 5 && modelOf(tid) == 7; },
+    };
+    tExprNode *exprs[] = {
+        newTagExpr(TSDB_RELATION_AND, newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m7"),
+                   newTagFilter(pFirmware, false, TSDB_RELATION_EQUAL, 3, NULL)),
+        newTagExpr(TSDB_RELATION_OR, newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m7"),
+                   newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m9")),
+        newTagExpr(TSDB_RELATION_AND, newTagFilter(pLocation, true, TSDB_RELATION_EQUAL, 5, NULL),
+                   newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m7")),
+    };
+
+    for (int q = 0; q < 3; ++q) {
+      std::vector<int32_t> expect;
+      for (int tid = 1; tid <= numOfTables; ++tid) {
+        if (matches[q](tid)) expect.push_back(tid);
+      }
+
+      EXPECT_EQ(queryTablesByTagCond(pRepo, SUPER_UID, exprs[q]), expect);
+
+      // the first two do not filter the first tag, so the skiplist index scans all the child tables for them
+      if (q < 2) {
+        void *pTagIndex = pSTable->pTagIndex;
+        pSTable->pTagIndex = NULL;
+        EXPECT_EQ(queryTablesByTagCond(pRepo, SUPER_UID, exprs[q]), expect);
+        pSTable->pTagIndex = pTagIndex;
+      }
+
+      tExprTreeDestroy(&exprs[q], NULL);
+    }
+  }
+
+  // a dropped table is removed from the tag index
+  int32_t dropped = LOCATIONS * 7 + 3;  // model 'm7' and firmware 3
+  ASSERT_EQ(tsdbDropTable(pRepo, {SUPER_UID + dropped, dropped}), 0);
+
+  tExprNode *pExpr = newTagExpr(TSDB_RELATION_AND, newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m7"),
+                                newTagFilter(pFirmware, false, TSDB_RELATION_EQUAL, 3, NULL));
+  std::vector<int32_t> tids = queryTablesByTagCond(pRepo, SUPER_UID, pExpr);
+  EXPECT_FALSE(tids.empty());
+  EXPECT_FALSE(std::binary_search(tids.begin(), tids.end(), dropped));
+  tExprTreeDestroy(&pExpr, NULL);
+
+  tdFreeSchema(pTagSchema);
+}
+
+TEST_F(TsdbReadTest, repeatedTagFilterByTagCondCache) {
+  const int      NUM_OF_DEVICES = 20000;
+  const int      QUERIES = 100;
+  const uint64_t SUPER_UID = 1000000;
+
+  config.maxTables = NUM_OF_DEVICES + 3;
+  ASSERT_EQ(openRepo(), 0);
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+  SLRUCache *pCache = repo->pTagCondCache;
+  ASSERT_NE(pCache, nullptr);
+
+  pSchema = tdNewSchema(2);
+  tdSchemaAddCol(pSchema, TSDB_DATA_TYPE_TIMESTAMP, 0, -1);
+  tdSchemaAddCol(pSchema, TSDB_DATA_TYPE_INT, 1, -1);
+  STSchema *pTagSchema = newDeviceTagSchema();
+  ASSERT_EQ(createDevices(pRepo, SUPER_UID, pSchema, pTagSchema, 1, NUM_OF_DEVICES), 0);
+
+  // firmware = 3 group by location
+  tExprNode *pExpr = newTagFilter(schemaColAt(pTagSchema, 2), false, TSDB_RELATION_EQUAL, 3, NULL);
+  SColIndex  groupCol = {0};
+  groupCol.colId = schemaColAt(pTagSchema, 0)->colId;
+  groupCol.colIndex = 0;
+  groupCol.flag = TSDB_COL_TAG;
+
+  std::vector<int32_t> expect;
+  for (int tid = 1; tid <= NUM_OF_DEVICES; ++tid) {
+    if (firmwareOf(tid) == 3) expect.push_back(tid);
+  }
+
+  // the cache is skipped at first, and then hit by all the queries but the first one
+  size_t numOfGroups = 0;
+  for (int c = 0; c < 2; ++c) {
+    repo->pTagCondCache = (c == 0) ? NULL : pCache;
+    for (int q = 0; q < QUERIES; ++q) {
+      EXPECT_EQ(queryTablesByTagCond(pRepo, SUPER_UID, pExpr, &groupCol, 1, &numOfGroups), expect);
+      EXPECT_EQ(numOfGroups, LOCATIONS);
+    }
+  }
+
+  SCacheStatis statis;
+  taosLRUCacheGetStatis(pCache, &statis);
+  EXPECT_EQ(statis.hitCount, QUERIES - 1);
+  EXPECT_EQ(statis.missCount, 1);
+
+  // a new device qualified is found by the next query, and a dropped one is not
+  int32_t tid = NUM_OF_DEVICES + 2;
+  ASSERT_EQ(firmwareOf(tid), 3);
+  ASSERT_EQ(createDevices(pRepo, SUPER_UID, pSchema, pTagSchema, tid, tid), 0);
+  std::vector<int32_t> tids = queryTablesByTagCond(pRepo, SUPER_UID, pExpr, &groupCol, 1);
+  EXPECT_EQ(tids.size(), expect.size() + 1);
+  EXPECT_TRUE(std::binary_search(tids.begin(), tids.end(), tid));
+
+  ASSERT_EQ(tsdbDropTable(pRepo, {SUPER_UID + expect[0], expect[0]}), 0);
+  tids = queryTablesByTagCond(pRepo, SUPER_UID, pExpr, &groupCol, 1);
+  EXPECT_EQ(tids.size(), expect.size());
+  EXPECT_FALSE(std::binary_search(tids.begin(), tids.end(), expect[0]));
+
+  // a different grouping of the same condition is another entry
+  tids = queryTablesByTagCond(pRepo, SUPER_UID, pExpr, NULL, 0, &numOfGroups);
+  EXPECT_EQ(numOfGroups, 1);
+
+  SCacheStatis statis2;
+  taosLRUCacheGetStatis(pCache, &statis2);
+  EXPECT_EQ(statis2.hitCount, statis.hitCount);
+  EXPECT_EQ(statis2.missCount, statis.missCount + 3);
+
+  tExprTreeDestroy(&pExpr, NULL);
+  tdFreeSchema(pTagSchema);
+}
@@ -6,6 +6,8 @@
 #include "tsdbMain.h"
 #include "tskiplist.h"
 
+const char *CREATE_TEST_DIR = "/tmp/tsdbCreateTest";
+
 static double getCurTime() {
   struct timeval tv;
   gettimeofday(&tv, NULL);
@@ -77,7 +79,8 @@ static int insertData(SInsertInfo *pInfo) {
     pMsg->numOfBlocks = htonl(pMsg->numOfBlocks);
     pMsg->compressed = htonl(pMsg->numOfBlocks);
 
-    if (tsdbInsertData(pInfo->pRepo, pMsg) < 0) {
+    SShellSubmitRspMsg rsp = {0};
+    if (tsdbInsertData(pInfo->pRepo, pMsg, &rsp) < 0) {
       tfree(pMsg);
       return -1;
     }
@@ -131,12 +134,17 @@ TEST(TsdbTest, DISABLED_tableEncodeDecode) {
 TEST(TsdbTest, createRepo) {
   STsdbCfg config;
   STsdbRepo *repo;
+  char       cmd[128];
 
   // 1. Create a tsdb repository
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", CREATE_TEST_DIR);
+  system(cmd);
   tsdbSetDefaultCfg(&config);
-  ASSERT_EQ(tsdbCreateRepo("/home/ubuntu/work/ttest/vnode0", &config, NULL), 0);
+  config.cacheBlockSize = 16;
+  config.totalBlocks = 32;
+  ASSERT_EQ(tsdbCreateRepo((char *)CREATE_TEST_DIR, &config, NULL), 0);
 
-  TsdbRepoT *pRepo = tsdbOpenRepo("/home/ubuntu/work/ttest/vnode0", NULL);
+  TsdbRepoT *pRepo = tsdbOpenRepo((char *)CREATE_TEST_DIR, NULL);
   ASSERT_NE(pRepo, nullptr);
 
   // 2. Create a normal table
@@ -170,7 +178,7 @@ TEST(TsdbTest, createRepo) {
     .sversion = tCfg.sversion,
     .startTime = 1584081000000,
     .interval = 1000,
-    .totalRows = 10000000,
+    .totalRows = 100000,
     .rowsPerSubmit = 1,
     .pSchema = schema
   };
@@ -178,12 +186,13 @@ TEST(TsdbTest, createRepo) {
   ASSERT_EQ(insertData(&iInfo), 0);
 
   // Close the repository
-  tsdbCloseRepo(pRepo);
+  tsdbCloseRepo(pRepo, 0);
 
   // Open the repository again
-  pRepo = tsdbOpenRepo("/home/ubuntu/work/ttest/vnode0", NULL);
+  pRepo = tsdbOpenRepo((char *)CREATE_TEST_DIR, NULL);
   repo = (STsdbRepo *)pRepo;
   ASSERT_NE(pRepo, nullptr);
+  ASSERT_NE(tsdbGetTableByUid(repo->tsdbMeta, tCfg.tableId.uid), nullptr);
 
   // // Insert more data
   // iInfo.startTime = iInfo.startTime + iInfo.interval * iInfo.totalRows;
@@ -214,7 +223,8 @@ TEST(TsdbTest, createRepo) {
   // ASSERT_EQ(tsdbLoadCompInfo(&rhelper, NULL), 0);
   // ASSERT_EQ(tsdbLoadBlockData(&rhelper, blockAtIdx(&rhelper, 0), NULL), 0);
 
-  int k = 0;
+  tsdbCloseRepo(pRepo, 0);
+  system(cmd);
 }
 
 TEST(TsdbTest, DISABLED_openRepo) {
@@ -0,0 +1,884 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "os.h"
+#include "qast.h"
+#include "taosmsg.h"
+#include "tbuffer.h"
+#include "tcache.h"
+#include "tglobal.h"
+#include "tlog.h"
+#include "tscompression.h"
+#include "tsdbMain.h"
+#include "ttime.h"
+
+// the read paths of tsdb measured one against the other, the results of both must be the same
+
+#define ROWS_PER_SUBMIT 100
+#define INTERVAL 1000
+#define LOCATIONS 100
+#define MODELS 50
+#define FIRMWARES 7
+#define SUPER_UID 1000000
+
+typedef struct {
+  int64_t sum;
+  int64_t count;
+  int32_t loadBlocks;
+  int32_t statisBlocks;
+} SBenchResult;
+
+static char       path[128] = "/tmp/tsdbbench";
+static int        rows = 200000;
+static TsdbRepoT *pRepo = NULL;
+static STSchema * pSchema = NULL;
+static STableId   tableId = {.uid = 1001, .tid = 1};
+
+static double elapsedMs(int64_t start) { return (taosGetTimestampUs() - start) / 1000.0; }
+
+// every 7th value is null, and the others repeat from 0 to 999
+static bool valueOfRow(int row, int32_t *val) {
+  if (row % 7 == 0) {
+    *val = TSDB_DATA_INT_NULL;
+    return false;
+  }
+
+  *val = row % 1000;
+  return true;
+}
+
+static const char *statusOfRow(int row) {
+  if (row % 7 == 0) return "error";
+  return (row % 100 == 1) ? "stopped" : "running";
+}
+
+static void openRepo(STsdbCfg *pCfg) {
+  char cmd[160];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+  system(cmd);
+
+  if (tsdbCreateRepo(path, pCfg, NULL) != 0 || (pRepo = tsdbOpenRepo(path, NULL)) == NULL) {
+    printf("failed to open repository %s\n", path);
+    exit(-1);
+  }
+}
+
+static void closeRepo() {
+  tsdbCloseRepo(pRepo, 0);
+  pRepo = NULL;
+  if (pSchema != NULL) tdFreeSchema(pSchema);
+  pSchema = NULL;
+}
+
+static STSchema *newSchema(int numOfCols, int8_t type, int16_t bytes) {
+  STSchema *pNew = tdNewSchema(numOfCols);
+  tdSchemaAddCol(pNew, TSDB_DATA_TYPE_TIMESTAMP, 0, -1);
+  tdSchemaAddCol(pNew, TSDB_DATA_TYPE_INT, 1, -1);
+  for (int c = 2; c < numOfCols; ++c) tdSchemaAddCol(pNew, type, c, bytes);
+  return pNew;
+}
+
+// create the table t1 of a timestamp column, an int column, and numOfCols - 2 columns of the type
+static void createTable(int numOfCols, int8_t type, int16_t bytes) {
+  STableCfg tCfg;
+
+  pSchema = newSchema(numOfCols, type, bytes);
+  tsdbInitTableCfg(&tCfg, TSDB_NORMAL_TABLE, tableId.uid, tableId.tid);
+  tsdbTableSetName(&tCfg, "t1", false);
+  tsdbTableSetSchema(&tCfg, pSchema, true);
+  if (tsdbCreateTable(pRepo, &tCfg) != 0) {
+    printf("failed to create table\n");
+    exit(-1);
+  }
+}
+
+// insert the rows in [fromRow, toRow), the key of row i is startKey + i * interval
+static void insertRows(TSKEY startKey, int fromRow, int toRow, TSKEY interval) {
+  SSubmitMsg *       pMsg = (SSubmitMsg *)malloc(sizeof(SSubmitMsg) + sizeof(SSubmitBlk) +
+                                          dataRowMaxBytesFromSchema(pSchema) * ROWS_PER_SUBMIT);
+  SShellSubmitRspMsg rsp = {0};
+
+  for (int k = fromRow; k < toRow; k += ROWS_PER_SUBMIT) {
+    memset((void *)pMsg, 0, sizeof(SSubmitMsg) + sizeof(SSubmitBlk));
+    SSubmitBlk *pBlock = pMsg->blocks;
+    int         numOfRows = MIN(ROWS_PER_SUBMIT, toRow - k);
+
+    for (int i = 0; i < numOfRows; i++) {
+      int      row = k + i;
+      TSKEY    key = startKey + row * interval;
+      int32_t  val = 0;
+      SDataRow dataRow = (SDataRow)(pBlock->data + pBlock->len);
+
+      bool notNull = valueOfRow(row, &val);
+      tdInitDataRow(dataRow, pSchema);
+      tdAppendColVal(dataRow, &key, TSDB_DATA_TYPE_TIMESTAMP, sizeof(TSKEY), schemaColAt(pSchema, 0)->offset);
+      tdAppendColVal(dataRow, &val, TSDB_DATA_TYPE_INT, sizeof(int32_t), schemaColAt(pSchema, 1)->offset);
+      for (int c = 2; c < schemaNCols(pSchema); ++c) {
+        STColumn *pCol = schemaColAt(pSchema, c);
+        if (pCol->type == TSDB_DATA_TYPE_BINARY) {
+          char status[32];
+          varDataLen(status) = sprintf(varDataVal(status), "%s", statusOfRow(row));
+          tdAppendColVal(dataRow, status, TSDB_DATA_TYPE_BINARY, pCol->bytes, pCol->offset);
+          continue;
+        }
+
+        double dval = val * 0.5;
+        if (!notNull) setNull((char *)&dval, TSDB_DATA_TYPE_DOUBLE, sizeof(double));
+        tdAppendColVal(dataRow, &dval, TSDB_DATA_TYPE_DOUBLE, sizeof(double), pCol->offset);
+      }
+      pBlock->len += dataRowLen(dataRow);
+    }
+
+    pMsg->length = htonl(TSDB_SUBMIT_MSG_HEAD_SIZE + sizeof(SSubmitBlk) + pBlock->len);
+    pMsg->numOfBlocks = htonl(1);
+    pBlock->len = htonl(pBlock->len);
+    pBlock->numOfRows = htons(numOfRows);
+    pBlock->uid = htobe64(tableId.uid);
+    pBlock->tid = htonl(tableId.tid);
+    pBlock->sversion = htonl(0);
+
+    if (tsdbInsertData(pRepo, pMsg, &rsp) != TSDB_CODE_SUCCESS) {
+      printf("failed to insert data\n");
+      exit(-1);
+    }
+  }
+
+  free(pMsg);
+}
+
+static void commitAndWait() {
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+
+  tsdbTriggerCommit(pRepo);
+  while (true) {
+    tsdbLockRepo(pRepo);
+    int commit = repo->commit;
+    tsdbUnLockRepo(pRepo);
+    if (!commit) break;
+    usleep(1000);
+  }
+}
+
+static TsdbQueryHandleT *queryTable(STsdbQueryCond *pCond, SArray **pGroup, STableGroupInfo *pGroupInfo) {
+  *pGroup = taosArrayInit(1, sizeof(STableId));
+  taosArrayPush(*pGroup, &tableId);
+  pGroupInfo->numOfTables = 1;
+  pGroupInfo->pGroupList = taosArrayInit(1, POINTER_BYTES);
+  taosArrayPush(pGroupInfo->pGroupList, pGroup);
+
+  return tsdbQueryTables(pRepo, pCond, pGroupInfo);
+}
+
+static void cleanupQuery(TsdbQueryHandleT *pHandle, SArray *pGroup, STableGroupInfo *pGroupInfo) {
+  tsdbCleanupQueryHandle(pHandle);
+  taosArrayDestroy(pGroup);
+  taosArrayDestroy(pGroupInfo->pGroupList);
+}
+
+// aggregate the int column in the window, from the statistics of the blocks or the rollups if they are returned
+static void aggregate(STimeWindow win, int32_t order, bool useStatis, int64_t rollup, SBenchResult *pRes) {
+  SColumnInfo cols[2] = {{0}};
+  cols[0].colId = 0;
+  cols[0].type = TSDB_DATA_TYPE_TIMESTAMP;
+  cols[0].bytes = sizeof(TSKEY);
+  cols[1].colId = 1;
+  cols[1].type = TSDB_DATA_TYPE_INT;
+  cols[1].bytes = sizeof(int32_t);
+
+  STsdbQueryCond  cond = {.twindow = win, .order = order, .numOfCols = 2, .colList = cols, .rollup = rollup};
+  SArray *        pGroup = NULL;
+  STableGroupInfo groupInfo = {0};
+
+  memset(pRes, 0, sizeof(SBenchResult));
+
+  TsdbQueryHandleT *pHandle = queryTable(&cond, &pGroup, &groupInfo);
+  while (tsdbNextDataBlock(pHandle)) {
+    SDataBlockInfo blockInfo = tsdbRetrieveDataBlockInfo(pHandle);
+    SDataStatis *  pStatis = NULL;
+
+    if (useStatis) tsdbRetrieveDataBlockStatisInfo(pHandle, &pStatis);
+    if (pStatis != NULL) {
+      pRes->sum += pStatis[1].sum;
+      pRes->count += blockInfo.rows - pStatis[1].numOfNull;
+      pRes->statisBlocks += 1;
+      continue;
+    }
+
+    SArray * pDataBlock = tsdbRetrieveDataBlock(pHandle, NULL);
+    int32_t *data = (int32_t *)((SColumnInfoData *)taosArrayGet(pDataBlock, 1))->pData;
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      if (isNull((char *)&data[i], TSDB_DATA_TYPE_INT)) continue;
+      pRes->sum += data[i];
+      pRes->count += 1;
+    }
+    pRes->loadBlocks += 1;
+  }
+
+  cleanupQuery(pHandle, pGroup, &groupInfo);
+}
+
+// scan the first numOfCols columns of the table in the window, and sum the int column
+static void scanColumns(int numOfCols, STimeWindow win, SBenchResult *pRes) {
+  SColumnInfo *cols = (SColumnInfo *)calloc(numOfCols, sizeof(SColumnInfo));
+  for (int i = 0; i < numOfCols; ++i) {
+    cols[i].colId = schemaColAt(pSchema, i)->colId;
+    cols[i].type = schemaColAt(pSchema, i)->type;
+    cols[i].bytes = schemaColAt(pSchema, i)->bytes;
+  }
+
+  STsdbQueryCond  cond = {.twindow = win, .order = TSDB_ORDER_ASC, .numOfCols = numOfCols, .colList = cols};
+  SArray *        pGroup = NULL;
+  STableGroupInfo groupInfo = {0};
+
+  memset(pRes, 0, sizeof(SBenchResult));
+
+  TsdbQueryHandleT *pHandle = queryTable(&cond, &pGroup, &groupInfo);
+  while (tsdbNextDataBlock(pHandle)) {
+    SDataBlockInfo blockInfo = tsdbRetrieveDataBlockInfo(pHandle);
+    SArray *       pDataBlock = tsdbRetrieveDataBlock(pHandle, NULL);
+    int32_t *      data = (int32_t *)((SColumnInfoData *)taosArrayGet(pDataBlock, 1))->pData;
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      if (!isNull((char *)&data[i], TSDB_DATA_TYPE_INT)) pRes->sum += data[i];
+    }
+    pRes->loadBlocks += 1;
+  }
+
+  cleanupQuery(pHandle, pGroup, &groupInfo);
+  free(cols);
+}
+
+static void checkResult(const char *name, SBenchResult *pRes1, SBenchResult *pRes2) {
+  if (pRes1->sum != pRes2->sum) {
+    printf("%s: results differ, sum %" PRId64 " and %" PRId64 "\n", name, pRes1->sum, pRes2->sum);
+    exit(-1);
+  }
+}
+
+// flush the data files and drop them from the page cache, return the total size of the .data and .last files
+static int64_t dropDataFilesFromPageCache() {
+  char    dataDir[160];
+  int64_t size = 0;
+  snprintf(dataDir, sizeof(dataDir), "%s/data", path);
+
+  DIR *pDir = opendir(dataDir);
+  if (pDir == NULL) return -1;
+
+  struct dirent *dp = NULL;
+  while ((dp = readdir(pDir)) != NULL) {
+    if (dp->d_name[0] == '.') continue;
+
+    char fname[512];
+    snprintf(fname, sizeof(fname), "%s/%s", dataDir, dp->d_name);
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) continue;
+
+    struct stat st;
+    fstat(fd, &st);
+    if (strstr(dp->d_name, ".data") != NULL || strstr(dp->d_name, ".last") != NULL) size += st.st_size;
+
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+
+  closedir(pDir);
+  return size;
+}
+
+// bytes read by this process so far, the page cache hits included
+static int64_t getReadBytes() {
+  FILE *fp = fopen("/proc/self/io", "r");
+  if (fp == NULL) return -1;
+
+  char    line[128];
+  int64_t rchar = -1;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "rchar: %" PRId64, &rchar) == 1) break;
+  }
+
+  fclose(fp);
+  return rchar;
+}
+
+static void defaultCfg(STsdbCfg *pCfg) {
+  tsdbSetDefaultCfg(pCfg);
+  pCfg->maxTables = TSDB_MIN_TABLES;
+  pCfg->cacheBlockSize = 16;
+  pCfg->totalBlocks = 32;
+}
+
+// a window starting and ending in the middle of blocks, by the block statistics or by loading all blocks
+static void statisBench() {
+  STsdbCfg     cfg;
+  SBenchResult res[2];
+  double       elapsed[2];
+
+  defaultCfg(&cfg);
+  openRepo(&cfg);
+  createTable(2, TSDB_DATA_TYPE_DOUBLE, -1);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)rows * INTERVAL * 2;
+  insertRows(startKey, 0, rows, INTERVAL);
+  commitAndWait();
+
+  STimeWindow win = {.skey = startKey + 1234 * INTERVAL, .ekey = startKey + (rows - 4321) * INTERVAL};
+  for (int i = 0; i < 2; ++i) {
+    int64_t st = taosGetTimestampUs();
+    aggregate(win, TSDB_ORDER_ASC, (i == 1), 0, &res[i]);
+    elapsed[i] = elapsedMs(st);
+  }
+  checkResult("statis", &res[0], &res[1]);
+
+  printf("statis: %d blocks loaded: %.2f ms, %d blocks loaded and %d by statistics: %.2f ms\n", res[0].loadBlocks,
+         elapsed[0], res[1].loadBlocks, res[1].statisBlocks, elapsed[1]);
+  closeRepo();
+}
+
+// a sum of 90 days, from the data blocks or from the hourly rollups
+static void rollupBench() {
+  const TSKEY DAY = 86400 * 1000L;
+  const int   DAYS = 90;
+  STsdbCfg    cfg;
+
+  strcpy(tsRollupIntervals, "60,3600,86400");
+  defaultCfg(&cfg);
+  openRepo(&cfg);
+  createTable(3, TSDB_DATA_TYPE_DOUBLE, -1);
+
+  TSKEY startKey = (taosGetTimestampMs() - (TSKEY)(DAYS + 10) * DAY) / DAY * DAY;
+  insertRows(startKey, 0, DAYS * 2880, 30 * 1000L);
+  commitAndWait();
+
+  STimeWindow  win = {.skey = startKey - 20 * DAY, .ekey = startKey + (DAYS + 20) * DAY};
+  int64_t      rollup = tsdbGetRollupInterval(pRepo, 3600 * 1000L, win.skey);
+  SBenchResult res[2];
+  double       elapsed[2];
+  for (int i = 0; i < 2; ++i) {
+    int64_t st = taosGetTimestampUs();
+    aggregate(win, TSDB_ORDER_ASC, (i == 1), (i == 1) ? rollup : 0, &res[i]);
+    elapsed[i] = elapsedMs(st);
+  }
+  checkResult("rollup", &res[0], &res[1]);
+
+  printf("rollup: %d days, raw: %d blocks loaded %.2f ms, rollup: %d entries %.2f ms\n", DAYS, res[0].loadBlocks,
+         elapsed[0], res[1].statisBlocks, elapsed[1]);
+  closeRepo();
+  tsRollupIntervals[0] = 0;
+}
+
+// the same query repeated, like a dashboard refreshed periodically, the blocks are decoded once
+static void cacheBench() {
+  STsdbCfg     cfg;
+  SBenchResult res[3];
+  double       elapsed[3];
+
+  defaultCfg(&cfg);
+  openRepo(&cfg);
+  createTable(2, TSDB_DATA_TYPE_DOUBLE, -1);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)rows * INTERVAL * 2;
+  insertRows(startKey, 0, rows, INTERVAL);
+  commitAndWait();
+
+  STimeWindow win = {.skey = startKey, .ekey = startKey + rows * INTERVAL};
+  for (int i = 0; i < 3; ++i) {
+    int64_t st = taosGetTimestampUs();
+    aggregate(win, TSDB_ORDER_ASC, false, 0, &res[i]);
+    elapsed[i] = elapsedMs(st);
+    checkResult("cache", &res[0], &res[i]);
+  }
+
+  SLRUCache *pCache = ((STsdbRepo *)pRepo)->pBlockCache;
+  printf("cache: %d blocks, cold query: %.2f ms, cached queries: %.2f ms, %.2f ms, %" PRId64 " bytes cached\n",
+         res[0].loadBlocks, elapsed[0], elapsed[1], elapsed[2], (pCache != NULL) ? taosLRUCacheGetUsage(pCache) : 0);
+  closeRepo();
+}
+
+// cold scans, forward and backward, with and without reading ahead the next blocks
+static void readAheadBench() {
+  int32_t  blockCacheSize = tsBlockCacheSize, readAheadBlocks = tsReadAheadBlocks;
+  int      numOfRows = rows * 5;
+  STsdbCfg cfg;
+
+  tsBlockCacheSize = 0;
+  defaultCfg(&cfg);
+  openRepo(&cfg);
+  createTable(3, TSDB_DATA_TYPE_DOUBLE, -1);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)numOfRows * INTERVAL * 2;
+  for (int row = 0; row < numOfRows; row += rows) {
+    insertRows(startKey, row, MIN(row + rows, numOfRows), INTERVAL);
+    commitAndWait();
+  }
+
+  // the kernel reads ahead by itself in a forward scan, but not in a backward one, whose windows are reversed
+  STimeWindow win[2] = {{.skey = startKey, .ekey = startKey + numOfRows * INTERVAL},
+                        {.skey = startKey + numOfRows * INTERVAL, .ekey = startKey}};
+  int32_t     order[2] = {TSDB_ORDER_ASC, TSDB_ORDER_DESC};
+
+  for (int o = 0; o < 2; ++o) {
+    SBenchResult res[2];
+    double       elapsed[2];
+    int64_t      size = 0;
+    for (int i = 0; i < 2; ++i) {
+      tsReadAheadBlocks = (i == 0) ? 0 : readAheadBlocks;
+      size = dropDataFilesFromPageCache();
+
+      int64_t st = taosGetTimestampUs();
+      aggregate(win[o], order[o], false, 0, &res[i]);
+      elapsed[i] = elapsedMs(st) / 1000;
+    }
+    checkResult("readahead", &res[0], &res[1]);
+
+    printf("readahead: cold %s scan of %d blocks %.2f MB, no read ahead: %.2f MB/s, %d blocks read ahead: %.2f MB/s\n",
+           (o == 0) ? "forward" : "backward", res[0].loadBlocks, size / 1048576.0, size / 1048576.0 / elapsed[0],
+           readAheadBlocks, size / 1048576.0 / elapsed[1]);
+  }
+
+  closeRepo();
+  tsBlockCacheSize = blockCacheSize;
+  tsReadAheadBlocks = readAheadBlocks;
+}
+
+// a scan of two columns of a wide table reads a small part of each block, a scan of all columns reads all of them
+static void projectionBench() {
+  const int    NUM_OF_COLS = 52;
+  int32_t      blockCacheSize = tsBlockCacheSize;
+  int          numOfCols[2] = {2, NUM_OF_COLS};
+  SBenchResult res[2];
+  int64_t      readBytes[2];
+  double       elapsed[2];
+  STsdbCfg     cfg;
+
+  tsBlockCacheSize = 0;
+  defaultCfg(&cfg);
+  openRepo(&cfg);
+  createTable(NUM_OF_COLS, TSDB_DATA_TYPE_DOUBLE, -1);
+
+  int   numOfRows = rows / 4;
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)numOfRows * INTERVAL * 2;
+  insertRows(startKey, 0, numOfRows, INTERVAL);
+  commitAndWait();
+
+  STimeWindow win = {.skey = startKey, .ekey = startKey + numOfRows * INTERVAL};
+  for (int i = 0; i < 2; ++i) {
+    int64_t rchar = getReadBytes();
+    int64_t st = taosGetTimestampUs();
+    scanColumns(numOfCols[i], win, &res[i]);
+    elapsed[i] = elapsedMs(st);
+    readBytes[i] = getReadBytes() - rchar;
+  }
+  checkResult("projection", &res[0], &res[1]);
+
+  printf("projection: scan of %d blocks, %d columns: %.2f MB read %.2f ms, %d columns: %.2f MB read %.2f ms\n",
+         res[0].loadBlocks, numOfCols[0], readBytes[0] / 1048576.0, elapsed[0], numOfCols[1],
+         readBytes[1] / 1048576.0, elapsed[1]);
+  closeRepo();
+  tsBlockCacheSize = blockCacheSize;
+}
+
+// a scan of all columns of a wide table, the columns of a block decoded one by one or by the threads of the pool
+static void decompressBench(int threads) {
+  const int    NUM_OF_COLS = 100;
+  int32_t      blockCacheSize = tsBlockCacheSize, decompressThreads = tsDecompressThreads;
+  SBenchResult res[3];
+  double       elapsed[3];
+  STsdbCfg     cfg;
+
+  tsBlockCacheSize = 0;
+  tsDecompressThreads = threads;
+  defaultCfg(&cfg);
+  openRepo(&cfg);
+  createTable(NUM_OF_COLS, TSDB_DATA_TYPE_DOUBLE, -1);
+
+  int   numOfRows = rows / 2;
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)numOfRows * INTERVAL * 2;
+  insertRows(startKey, 0, numOfRows, INTERVAL);
+  commitAndWait();
+
+  // the first scan warms up the page cache
+  STsdbRepo *      repo = (STsdbRepo *)pRepo;
+  STsdbDecompPool *pPool = repo->pDecompPool;
+  STimeWindow      win = {.skey = startKey, .ekey = startKey + numOfRows * INTERVAL};
+  for (int i = 0; i < 3; ++i) {
+    repo->pDecompPool = (i == 2) ? pPool : NULL;
+    int64_t st = taosGetTimestampUs();
+    scanColumns(NUM_OF_COLS, win, &res[i]);
+    elapsed[i] = elapsedMs(st);
+    checkResult("decompress", &res[0], &res[i]);
+  }
+  repo->pDecompPool = pPool;
+
+  printf("decompress: scan of %d blocks of %d columns, serial decompression: %.2f ms, %d threads: %.2f ms\n",
+         res[0].loadBlocks, NUM_OF_COLS, elapsed[1], (pPool != NULL) ? pPool->numOfThreads : 0, elapsed[2]);
+  closeRepo();
+  tsBlockCacheSize = blockCacheSize;
+  tsDecompressThreads = decompressThreads;
+}
+
+// the rows of a status column counted by comparing the strings, and by comparing each distinct value only
+static void dictBench() {
+  const int STATUS_BYTES = 16;
+  int32_t   blockCacheSize = tsBlockCacheSize;
+  STsdbCfg  cfg;
+
+  tsBlockCacheSize = 0;
+  defaultCfg(&cfg);
+  openRepo(&cfg);
+  createTable(3, TSDB_DATA_TYPE_BINARY, STATUS_BYTES);
+
+  int   numOfRows = rows / 4;
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)numOfRows * INTERVAL * 2;
+  insertRows(startKey, 0, numOfRows, INTERVAL);
+  commitAndWait();
+
+  SColumnInfo cols[3] = {{0}};
+  for (int i = 0; i < 3; ++i) {
+    cols[i].colId = schemaColAt(pSchema, i)->colId;
+    cols[i].type = schemaColAt(pSchema, i)->type;
+    cols[i].bytes = schemaColAt(pSchema, i)->bytes;
+  }
+
+  STsdbQueryCond  cond = {.twindow = {.skey = startKey, .ekey = startKey + numOfRows * INTERVAL},
+                         .order = TSDB_ORDER_ASC,
+                         .numOfCols = 3,
+                         .colList = cols};
+  SArray *        pGroup = NULL;
+  STableGroupInfo groupInfo = {0};
+  int64_t         numOfErrors[2] = {0};
+  int32_t         numOfBlocks = 0;
+  int64_t         elapsed[2] = {0};
+
+  TsdbQueryHandleT *pHandle = queryTable(&cond, &pGroup, &groupInfo);
+  while (tsdbNextDataBlock(pHandle)) {
+    SDataBlockInfo blockInfo = tsdbRetrieveDataBlockInfo(pHandle);
+    SArray *       pDataBlock = tsdbRetrieveDataBlock(pHandle, NULL);
+    char *         data = (char *)((SColumnInfoData *)taosArrayGet(pDataBlock, 2))->pData;
+
+    int64_t st = taosGetTimestampUs();
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      char *value = data + STATUS_BYTES * i;
+      if (varDataLen(value) == 5 && strncmp(varDataVal(value), "error", 5) == 0) numOfErrors[0]++;
+    }
+    elapsed[0] += taosGetTimestampUs() - st;
+    numOfBlocks++;
+
+    const uint8_t *codes = NULL;
+    if (tsdbRetrieveDataBlockDictCodes(pHandle, 2, &codes) == 0) continue;
+
+    st = taosGetTimestampUs();
+    int8_t res[DICT_MAX_ENTRIES];
+    memset(res, -1, sizeof(res));
+    for (int32_t i = 0; i < blockInfo.rows; ++i) {
+      if (res[codes[i]] < 0) {
+        char *value = data + STATUS_BYTES * i;
+        res[codes[i]] = (varDataLen(value) == 5 && strncmp(varDataVal(value), "error", 5) == 0);
+      }
+      numOfErrors[1] += res[codes[i]];
+    }
+    elapsed[1] += taosGetTimestampUs() - st;
+  }
+  cleanupQuery(pHandle, pGroup, &groupInfo);
+
+  printf("dict: filter of %d blocks, %" PRId64 " rows qualified, by the strings: %.2f ms, by the dictionary codes: "
+         "%" PRId64 " rows %.2f ms\n",
+         numOfBlocks, numOfErrors[0], elapsed[0] / 1000.0, numOfErrors[1], elapsed[1] / 1000.0);
+  closeRepo();
+  tsBlockCacheSize = blockCacheSize;
+}
+
+// narrow queries over a table of small blocks, looking for the blocks in the SCompInfo or by the block index
+static void blockIdxBench() {
+  const int QUERIES = 200;
+  const int ROWS_PER_QUERY = 500;
+  STsdbCfg  cfg;
+  double    elapsed[2];
+
+  defaultCfg(&cfg);
+  cfg.maxRowsPerFileBlock = TSDB_MIN_MAX_ROW_FBLOCK;
+  cfg.minRowsPerFileBlock = TSDB_MIN_MIN_ROW_FBLOCK;
+  openRepo(&cfg);
+  createTable(2, TSDB_DATA_TYPE_DOUBLE, -1);
+
+  TSKEY startKey = taosGetTimestampMs() - (TSKEY)rows * INTERVAL * 2;
+  insertRows(startKey, 0, rows, INTERVAL);
+  commitAndWait();
+
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+  SLRUCache *pCache = repo->pBlockIdxCache;
+  for (int i = 0; i < 2; ++i) {
+    repo->pBlockIdxCache = (i == 0) ? NULL : pCache;
+
+    int64_t st = taosGetTimestampUs();
+    for (int q = 0; q < QUERIES; ++q) {
+      int          from = (int)((int64_t)q * (rows - ROWS_PER_QUERY) / QUERIES);
+      STimeWindow  win = {startKey + from * INTERVAL, startKey + (from + ROWS_PER_QUERY - 1) * INTERVAL};
+      SBenchResult res;
+      aggregate(win, TSDB_ORDER_ASC, false, 0, &res);
+    }
+    elapsed[i] = elapsedMs(st);
+  }
+  repo->pBlockIdxCache = pCache;
+
+  printf("blockidx: %d queries of %d rows: %.2f ms without block index, %.2f ms with it\n", QUERIES, ROWS_PER_QUERY,
+         elapsed[0], elapsed[1]);
+  closeRepo();
+}
+
+static int locationOf(int tid) { return tid % LOCATIONS; }
+static int modelOf(int tid) { return (tid / LOCATIONS) % MODELS; }
+static int firmwareOf(int tid) { return tid % FIRMWARES; }
+
+// location, model and firmware of the devices
+static STSchema *newDeviceTagSchema() {
+  STSchema *pTagSchema = tdNewSchema(3);
+  tdSchemaAddCol(pTagSchema, TSDB_DATA_TYPE_INT, 2, -1);
+  tdSchemaAddCol(pTagSchema, TSDB_DATA_TYPE_BINARY, 3, 16);
+  tdSchemaAddCol(pTagSchema, TSDB_DATA_TYPE_INT, 4, -1);
+  return pTagSchema;
+}
+
+// create the devices of tid in [fromTid, toTid], child table tid has the uid of the super table plus tid
+static void createDevices(STSchema *pTagSchema, int fromTid, int toTid) {
+  for (int tid = fromTid; tid <= toTid; ++tid) {
+    char name[32], model[32];
+    snprintf(name, sizeof(name), "d%d", tid);
+    varDataLen(model) = sprintf(varDataVal(model), "m%d", modelOf(tid));
+    int32_t tags[3] = {locationOf(tid), 0, firmwareOf(tid)};
+
+    SDataRow row = tdNewDataRowFromSchema(pTagSchema);
+    for (int i = 0; i < 3; ++i) {
+      STColumn *pCol = schemaColAt(pTagSchema, i);
+      tdAppendColVal(row, (i == 1) ? (void *)model : (void *)&tags[i], pCol->type, pCol->bytes, pCol->offset);
+    }
+
+    STableCfg tCfg;
+    tsdbInitTableCfg(&tCfg, TSDB_CHILD_TABLE, SUPER_UID + tid, tid);
+    tsdbTableSetName(&tCfg, name, false);
+    tsdbTableSetSName(&tCfg, "devices", false);
+    tsdbTableSetSuperUid(&tCfg, SUPER_UID);
+    tsdbTableSetSchema(&tCfg, pSchema, false);
+    tsdbTableSetTagSchema(&tCfg, pTagSchema, false);
+    tsdbTableSetTagValue(&tCfg, row, false);
+    int code = tsdbCreateTable(pRepo, &tCfg);
+    tdFreeDataRow(row);
+    if (code != 0) {
+      printf("failed to create table %s\n", name);
+      exit(-1);
+    }
+  }
+}
+
+// a filter of the tag column on the value, the value is a string for the binary tags
+static tExprNode *newTagFilter(STColumn *pCol, bool isFirstTag, uint8_t optr, int64_t ival, const char *sval) {
+  tExprNode *pLeft = (tExprNode *)calloc(1, sizeof(tExprNode));
+  pLeft->nodeType = TSQL_NODE_COL;
+  pLeft->pSchema = (SSchema *)calloc(1, sizeof(SSchema));
+  pLeft->pSchema->type = pCol->type;
+  pLeft->pSchema->colId = pCol->colId;
+  pLeft->pSchema->bytes = pCol->bytes;
+  snprintf(pLeft->pSchema->name, sizeof(pLeft->pSchema->name), "t%d", pCol->colId);
+
+  tExprNode *pRight = (tExprNode *)calloc(1, sizeof(tExprNode));
+  pRight->nodeType = TSQL_NODE_VALUE;
+  pRight->pVal = (tVariant *)calloc(1, sizeof(tVariant));
+  if (sval != NULL) {
+    pRight->pVal->nType = TSDB_DATA_TYPE_BINARY;
+    pRight->pVal->nLen = (int32_t)strlen(sval);
+    pRight->pVal->pz = strdup(sval);
+  } else {
+    pRight->pVal->nType = TSDB_DATA_TYPE_BIGINT;
+    pRight->pVal->i64Key = ival;
+  }
+
+  tExprNode *pExpr = (tExprNode *)calloc(1, sizeof(tExprNode));
+  pExpr->nodeType = TSQL_NODE_EXPR;
+  pExpr->_node.optr = optr;
+  pExpr->_node.hasPK = isFirstTag;
+  pExpr->_node.pLeft = pLeft;
+  pExpr->_node.pRight = pRight;
+  return pExpr;
+}
+
+static tExprNode *newTagExpr(uint8_t optr, tExprNode *pLeft, tExprNode *pRight) {
+  tExprNode *pExpr = (tExprNode *)calloc(1, sizeof(tExprNode));
+  pExpr->nodeType = TSQL_NODE_EXPR;
+  pExpr->_node.optr = optr;
+  pExpr->_node.pLeft = pLeft;
+  pExpr->_node.pRight = pRight;
+  return pExpr;
+}
+
+// resolve the child tables of the tag condition serialized as sent by the client, return the microseconds taken
+static int64_t queryTablesByTagCond(tExprNode *pExpr, SColIndex *pGroupCol, int32_t *numOfTables) {
+  SBufferWriter bw = tbufInitWriter(NULL, false);
+  exprTreeToBinary(&bw, pExpr);
+
+  int64_t         st = taosGetTimestampUs();
+  STableGroupInfo groupInfo = {0};
+  tsdbQuerySTableByTagCond(pRepo, SUPER_UID, tbufGetData(&bw, false), tbufTell(&bw), TSDB_RELATION_AND, NULL,
+                           &groupInfo, pGroupCol, (pGroupCol != NULL) ? 1 : 0);
+  int64_t elapsed = taosGetTimestampUs() - st;
+  tbufCloseWriter(&bw);
+
+  for (size_t i = 0; i < taosArrayGetSize(groupInfo.pGroupList); ++i) {
+    taosArrayDestroy(taosArrayGetP(groupInfo.pGroupList, i));
+  }
+  taosArrayDestroy(groupInfo.pGroupList);
+  *numOfTables = groupInfo.numOfTables;
+  return elapsed;
+}
+
+// tag conditions over a super table of many child tables, by the tag index or by scanning the child tables
+static void tagIndexBench(int numOfDevices) {
+  int32_t  tagCondCacheSize = tsTagCondCacheSize;
+  STsdbCfg cfg;
+
+  tsTagCondCacheSize = 0;
+  defaultCfg(&cfg);
+  cfg.maxTables = numOfDevices + 1;
+  openRepo(&cfg);
+
+  pSchema = newSchema(2, TSDB_DATA_TYPE_INT, -1);
+  STSchema *pTagSchema = newDeviceTagSchema();
+  createDevices(pTagSchema, 1, numOfDevices);
+
+  STable *pSTable = tsdbGetTableByUid(tsdbGetMeta(pRepo), SUPER_UID);
+  STColumn *pLocation = schemaColAt(pTagSchema, 0);
+  STColumn *pModel = schemaColAt(pTagSchema, 1);
+  STColumn *pFirmware = schemaColAt(pTagSchema, 2);
+
+  const char *names[] = {"model = 'm7' AND firmware = 3", "model = 'm7' OR model = 'm9'",
+                         "location = 5 AND model = 'm7'"};
+  tExprNode * exprs[] = {
+      newTagExpr(TSDB_RELATION_AND, newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m7"),
+                 newTagFilter(pFirmware, false, TSDB_RELATION_EQUAL, 3, NULL)),
+      newTagExpr(TSDB_RELATION_OR, newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m7"),
+                 newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m9")),
+      newTagExpr(TSDB_RELATION_AND, newTagFilter(pLocation, true, TSDB_RELATION_EQUAL, 5, NULL),
+                 newTagFilter(pModel, false, TSDB_RELATION_EQUAL, 0, "m7")),
+  };
+
+  for (int q = 0; q < 3; ++q) {
+    int32_t numOfTables = 0;
+    int64_t indexed = queryTablesByTagCond(exprs[q], NULL, &numOfTables);
+    printf("tagidx: %d child tables, %d qualified by %s: %.3f ms by tag index", numOfDevices, numOfTables, names[q],
+           indexed / 1000.0);
+
+    // the first two do not filter the first tag, so the skiplist index scans all the child tables for them
+    if (q < 2) {
+      void *pTagIndex = pSTable->pTagIndex;
+      pSTable->pTagIndex = NULL;
+      int64_t scanned = queryTablesByTagCond(exprs[q], NULL, &numOfTables);
+      pSTable->pTagIndex = pTagIndex;
+      printf(", %.3f ms by scanning", scanned / 1000.0);
+    }
+    printf("\n");
+    tExprTreeDestroy(&exprs[q], NULL);
+  }
+
+  tdFreeSchema(pTagSchema);
+  closeRepo();
+  tsTagCondCacheSize = tagCondCacheSize;
+}
+
+// the same tag condition of a super table query repeated, the tables are resolved and grouped once by the cache
+static void tagCondCacheBench(int numOfDevices) {
+  const int QUERIES = 100;
+  STsdbCfg  cfg;
+  int64_t   elapsed[2] = {0};
+  int32_t   numOfTables = 0;
+
+  defaultCfg(&cfg);
+  cfg.maxTables = numOfDevices + 1;
+  openRepo(&cfg);
+
+  pSchema = newSchema(2, TSDB_DATA_TYPE_INT, -1);
+  STSchema *pTagSchema = newDeviceTagSchema();
+  createDevices(pTagSchema, 1, numOfDevices);
+
+  // firmware = 3 group by location
+  tExprNode *pExpr = newTagFilter(schemaColAt(pTagSchema, 2), false, TSDB_RELATION_EQUAL, 3, NULL);
+  SColIndex  groupCol = {0};
+  groupCol.colId = schemaColAt(pTagSchema, 0)->colId;
+  groupCol.colIndex = 0;
+  groupCol.flag = TSDB_COL_TAG;
+
+  STsdbRepo *repo = (STsdbRepo *)pRepo;
+  SLRUCache *pCache = repo->pTagCondCache;
+  for (int c = 0; c < 2; ++c) {
+    repo->pTagCondCache = (c == 0) ? NULL : pCache;
+    for (int q = 0; q < QUERIES; ++q) elapsed[c] += queryTablesByTagCond(pExpr, &groupCol, &numOfTables);
+  }
+  repo->pTagCondCache = pCache;
+
+  printf("tagcache: %d devices, %d qualified, %d queries: %.3f ms resolving the tables, %.3f ms by cache\n",
+         numOfDevices, numOfTables, QUERIES, elapsed[0] / 1000.0, elapsed[1] / 1000.0);
+  tExprTreeDestroy(&pExpr, NULL);
+  tdFreeSchema(pTagSchema);
+  closeRepo();
+}
+
+int main(int argc, char *argv[]) {
+  char bench[32] = "all";
+  int  threads = 4;
+  int  devices = 100000;
+
+  for (int i=1; i<argc; ++i) {
+    if (strcmp(argv[i], "-p")==0 && i < argc-1) {
+      strncpy(path, argv[++i], sizeof(path) - 1);
+    } else if (strcmp(argv[i], "-b")==0 && i < argc-1) {
+      strncpy(bench, argv[++i], sizeof(bench) - 1);
+    } else if (strcmp(argv[i], "-r")==0 && i < argc-1) {
+      rows = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-t")==0 && i < argc-1) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n")==0 && i < argc-1) {
+      devices = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-d")==0 && i < argc-1) {
+      tsdbDebugFlag = uDebugFlag = atoi(argv[++i]);
+    } else {
+      printf("\nusage: %s [options] \n", argv[0]);
+      printf("  [-p path]: repository path, default is:%s\n", path);
+      printf("  [-b bench]: statis, rollup, cache, readahead, projection, decompress, dict, blockidx, tagidx,\n");
+      printf("              tagcache or all, default is:%s\n", bench);
+      printf("  [-r rows]: rows of the table, default is:%d\n", rows);
+      printf("  [-t threads]: decompression threads, default is:%d\n", threads);
+      printf("  [-n devices]: child tables of the tag benchmarks, default is:%d\n", devices);
+      printf("  [-d debugFlag]: debug flag, default:%d\n", tsdbDebugFlag);
+      printf("  [-h help]: print out this help\n\n");
+      exit(0);
+    }
+  }
+
+  if (rows < 10000) rows = 10000;
+  if (devices <= 0 || devices >= TSDB_MAX_TABLES) devices = TSDB_MAX_TABLES - 1;
+
+  taosInitLog("tsdbbench.log", 100000, 10);
+
+  bool all = (strcmp(bench, "all") == 0);
+  if (all || strcmp(bench, "statis") == 0) statisBench();
+  if (all || strcmp(bench, "rollup") == 0) rollupBench();
+  if (all || strcmp(bench, "cache") == 0) cacheBench();
+  if (all || strcmp(bench, "readahead") == 0) readAheadBench();
+  if (all || strcmp(bench, "projection") == 0) projectionBench();
+  if (all || strcmp(bench, "decompress") == 0) decompressBench(threads);
+  if (all || strcmp(bench, "dict") == 0) dictBench();
+  if (all || strcmp(bench, "blockidx") == 0) blockIdxBench();
+  if (all || strcmp(bench, "tagidx") == 0) tagIndexBench(devices);
+  if (all || strcmp(bench, "tagcache") == 0) tagCondCacheBench(MIN(devices, 20000));
+
+  return 0;
+}
@@ -160,6 +160,73 @@ void taosCacheEmpty(SCacheObj *pCacheObj);
  */
 void taosCacheCleanup(SCacheObj *pCacheObj);
 
+/*
+ * A size bounded cache, which evicts the least recently used elements once the total size of the cached data
+ * exceeds the capacity. The elements are spread over several shards by the hash value of the key, each shard is
+ * guarded by its own lock, so that concurrent queries seldom wait for each other.
+ *
+ * The data is copied in by taosLRUCachePut and copied out by taosLRUCacheGet, no reference is handed out.
+ */
+typedef struct SLRUNode {
+  struct SLRUNode *prev;
+  struct SLRUNode *next;
+  uint32_t         keyLen;
+  uint32_t         dataSize;
+  char             data[];  // key followed by the cached data
+} SLRUNode;
+
+typedef struct {
+  pthread_mutex_t lock;
+  int64_t         capacity;
+  int64_t         usage;       // size of the cached data, keys included
+  SLRUNode *      pHead;       // the most recently used one
+  SLRUNode *      pTail;       // the least recently used one
+  SHashObj *      pHashTable;  // key -> SLRUNode *
+  SCacheStatis    statistics;
+} SLRUCacheShard;
+
+typedef struct {
+  int32_t         numOfShards;
+  SLRUCacheShard *shards;
+} SLRUCache;
+
+/**
+ * @param capacity      maximum size in bytes of the cached data in all shards
+ * @param numOfShards   number of shards, each of which holds capacity / numOfShards bytes at most
+ * @return
+ */
+SLRUCache *taosLRUCacheInit(int64_t capacity, int32_t numOfShards);
+
+/**
+ * add data into cache, the old data with the same key is replaced. Elements larger than the capacity of a shard
+ * are not cached.
+ * @return              0 if the data is cached, -1 otherwise
+ */
+int32_t taosLRUCachePut(SLRUCache *pCache, const void *key, size_t keyLen, const void *pData, size_t dataSize);
+
+/**
+ * copy the cached data of the key into pBuf, and mark the element as the most recently used one
+ * @return              the size of the cached data, or -1 if the key is not cached or pBuf is not large enough
+ */
+int32_t taosLRUCacheGet(SLRUCache *pCache, const void *key, size_t keyLen, void *pBuf, size_t bufSize);
+
+/**
+ * copy the cached data of the key into a buffer allocated for it, for the data whose size is not known in advance
+ * @param ppData        the buffer, which is freed by the caller
+ * @return              the size of the cached data, or -1 if the key is not cached
+ */
+int32_t taosLRUCacheGetDup(SLRUCache *pCache, const void *key, size_t keyLen, void **ppData);
+
+void taosLRUCacheRemove(SLRUCache *pCache, const void *key, size_t keyLen);
+
+/**
+ * sum up the hit/miss counters of all shards
+ */
+void    taosLRUCacheGetStatis(SLRUCache *pCache, SCacheStatis *pStatis);
+int64_t taosLRUCacheGetUsage(SLRUCache *pCache);
+
+void taosLRUCacheCleanup(SLRUCache *pCache);
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,27 +33,44 @@ extern "C" {
 #define NO_COMPRESSION 0
 #define ONE_STAGE_COMP 1
 #define TWO_STAGE_COMP 2
+#define BITPACK_COMP 3    // one stage, with the integers bit packed in blocks for fast decompression
+#define CHIMP_COMP 4      // one stage, with the float and double values XOR encoded at bit level
+#define DICT_COMP 5       // binary and nchar values as codes of the distinct ones, chosen for a column of a block
+
+// Maximum number of distinct values of a dictionary encoded column
+#define DICT_MAX_ENTRIES 256
 
 extern int tsCompressINTImp(const char *const input, const int nelements, char *const output, const char type);
 extern int tsDecompressINTImp(const char *const input, const int nelements, char *const output, const char type);
+extern int tsCompressBitPackImp(const char *const input, const int nelements, char *const output, const char type);
+extern int tsDecompressBitPackImp(const char *const input, const int nelements, char *const output, const char type);
 extern int tsCompressBoolImp(const char *const input, const int nelements, char *const output);
 extern int tsDecompressBoolImp(const char *const input, const int nelements, char *const output);
 extern int tsCompressStringImp(const char *const input, int inputSize, char *const output, int outputSize);
 extern int tsDecompressStringImp(const char *const input, int compressedSize, char *const output, int outputSize);
+extern int tsCompressDictImp(const char *const input, const int inputSize, const int nelements, char *const output,
+                             const int outputSize);
+extern int tsDecompressDictImp(const char *const input, const int compressedSize, const int nelements,
+                               char *const output, const int outputSize, uint8_t *const codes);
 extern int tsCompressTimestampImp(const char *const input, const int nelements, char *const output);
 extern int tsDecompressTimestampImp(const char *const input, const int nelements, char *const output);
 extern int tsCompressDoubleImp(const char *const input, const int nelements, char *const output);
 extern int tsDecompressDoubleImp(const char *const input, const int nelements, char *const output);
+extern int tsCompressChimpImp(const char *const input, const int nelements, char *const output, const char type);
+extern int tsDecompressChimpImp(const char *const input, int compressedSize, const int nelements, char *const output,
+                                const char type);
 extern int tsCompressFloatImp(const char *const input, const int nelements, char *const output);
 extern int tsDecompressFloatImp(const char *const input, const int nelements, char *const output);
 
 static FORCE_INLINE int tsCompressTinyint(const char *const input, int inputSize, const int nelements, char *const output, int outputSize, char algorithm,
                       char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == CHIMP_COMP) {
     return tsCompressINTImp(input, nelements, output, TSDB_DATA_TYPE_TINYINT);
   } else if (algorithm == TWO_STAGE_COMP) {
     int len = tsCompressINTImp(input, nelements, buffer, TSDB_DATA_TYPE_TINYINT);
     return tsCompressStringImp(buffer, len, output, outputSize);
+  } else if (algorithm == BITPACK_COMP) {
+    return tsCompressBitPackImp(input, nelements, output, TSDB_DATA_TYPE_TINYINT);
   } else {
     assert(0);
   }
@@ -61,11 +78,13 @@ static FORCE_INLINE int tsCompressTinyint(const char *const input, int inputSize
 
 static FORCE_INLINE int tsDecompressTinyint(const char *const input, int compressedSize, const int nelements, char *const output,
                         int outputSize, char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == CHIMP_COMP) {
     return tsDecompressINTImp(input, nelements, output, TSDB_DATA_TYPE_TINYINT);
   } else if (algorithm == TWO_STAGE_COMP) {
     tsDecompressStringImp(input, compressedSize, buffer, bufferSize);
     return tsDecompressINTImp(buffer, nelements, output, TSDB_DATA_TYPE_TINYINT);
+  } else if (algorithm == BITPACK_COMP) {
+    return tsDecompressBitPackImp(input, nelements, output, TSDB_DATA_TYPE_TINYINT);
   } else {
     assert(0);
   }
@@ -73,11 +92,13 @@ static FORCE_INLINE int tsDecompressTinyint(const char *const input, int compres
 
 static FORCE_INLINE int tsCompressSmallint(const char *const input, int inputSize, const int nelements, char *const output, int outputSize, char algorithm,
                        char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == CHIMP_COMP) {
     return tsCompressINTImp(input, nelements, output, TSDB_DATA_TYPE_SMALLINT);
   } else if (algorithm == TWO_STAGE_COMP) {
     int len = tsCompressINTImp(input, nelements, buffer, TSDB_DATA_TYPE_SMALLINT);
     return tsCompressStringImp(buffer, len, output, outputSize);
+  } else if (algorithm == BITPACK_COMP) {
+    return tsCompressBitPackImp(input, nelements, output, TSDB_DATA_TYPE_SMALLINT);
   } else {
     assert(0);
   }
@@ -85,11 +106,13 @@ static FORCE_INLINE int tsCompressSmallint(const char *const input, int inputSiz
 
 static FORCE_INLINE int tsDecompressSmallint(const char *const input, int compressedSize, const int nelements, char *const output,
                          int outputSize, char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == CHIMP_COMP) {
     return tsDecompressINTImp(input, nelements, output, TSDB_DATA_TYPE_SMALLINT);
   } else if (algorithm == TWO_STAGE_COMP) {
     tsDecompressStringImp(input, compressedSize, buffer, bufferSize);
     return tsDecompressINTImp(buffer, nelements, output, TSDB_DATA_TYPE_SMALLINT);
+  } else if (algorithm == BITPACK_COMP) {
+    return tsDecompressBitPackImp(input, nelements, output, TSDB_DATA_TYPE_SMALLINT);
   } else {
     assert(0);
   }
@@ -97,11 +120,13 @@ static FORCE_INLINE int tsDecompressSmallint(const char *const input, int compre
 
 static FORCE_INLINE int tsCompressInt(const char *const input, int inputSize, const int nelements, char *const output, int outputSize, char algorithm,
                   char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == CHIMP_COMP) {
     return tsCompressINTImp(input, nelements, output, TSDB_DATA_TYPE_INT);
   } else if (algorithm == TWO_STAGE_COMP) {
     int len = tsCompressINTImp(input, nelements, buffer, TSDB_DATA_TYPE_INT);
     return tsCompressStringImp(buffer, len, output, outputSize);
+  } else if (algorithm == BITPACK_COMP) {
+    return tsCompressBitPackImp(input, nelements, output, TSDB_DATA_TYPE_INT);
   } else {
     assert(0);
   }
@@ -109,11 +134,13 @@ static FORCE_INLINE int tsCompressInt(const char *const input, int inputSize, co
 
 static FORCE_INLINE int tsDecompressInt(const char *const input, int compressedSize, const int nelements, char *const output,
                     int outputSize, char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == CHIMP_COMP) {
     return tsDecompressINTImp(input, nelements, output, TSDB_DATA_TYPE_INT);
   } else if (algorithm == TWO_STAGE_COMP) {
     tsDecompressStringImp(input, compressedSize, buffer, bufferSize);
     return tsDecompressINTImp(buffer, nelements, output, TSDB_DATA_TYPE_INT);
+  } else if (algorithm == BITPACK_COMP) {
+    return tsDecompressBitPackImp(input, nelements, output, TSDB_DATA_TYPE_INT);
   } else {
     assert(0);
   }
@@ -121,11 +148,13 @@ static FORCE_INLINE int tsDecompressInt(const char *const input, int compressedS
 
 static FORCE_INLINE int tsCompressBigint(const char *const input, int inputSize, const int nelements, char *const output, int outputSize,
                      char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == CHIMP_COMP) {
     return tsCompressINTImp(input, nelements, output, TSDB_DATA_TYPE_BIGINT);
   } else if (algorithm == TWO_STAGE_COMP) {
     int len = tsCompressINTImp(input, nelements, buffer, TSDB_DATA_TYPE_BIGINT);
     return tsCompressStringImp(buffer, len, output, outputSize);
+  } else if (algorithm == BITPACK_COMP) {
+    return tsCompressBitPackImp(input, nelements, output, TSDB_DATA_TYPE_BIGINT);
   } else {
     assert(0);
   }
@@ -133,11 +162,13 @@ static FORCE_INLINE int tsCompressBigint(const char *const input, int inputSize,
 
 static FORCE_INLINE int tsDecompressBigint(const char *const input, int compressedSize, const int nelements, char *const output,
                        int outputSize, char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == CHIMP_COMP) {
     return tsDecompressINTImp(input, nelements, output, TSDB_DATA_TYPE_BIGINT);
   } else if (algorithm == TWO_STAGE_COMP) {
     tsDecompressStringImp(input, compressedSize, buffer, bufferSize);
     return tsDecompressINTImp(buffer, nelements, output, TSDB_DATA_TYPE_BIGINT);
+  } else if (algorithm == BITPACK_COMP) {
+    return tsDecompressBitPackImp(input, nelements, output, TSDB_DATA_TYPE_BIGINT);
   } else {
     assert(0);
   }
@@ -145,7 +176,7 @@ static FORCE_INLINE int tsDecompressBigint(const char *const input, int compress
 
 static FORCE_INLINE int tsCompressBool(const char *const input, int inputSize, const int nelements, char *const output, int outputSize, 
                    char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == BITPACK_COMP || algorithm == CHIMP_COMP) {
     return tsCompressBoolImp(input, nelements, output);
   } else if (algorithm == TWO_STAGE_COMP) {
     int len = tsCompressBoolImp(input, nelements, buffer);
@@ -157,7 +188,7 @@ static FORCE_INLINE int tsCompressBool(const char *const input, int inputSize, c
 
 static FORCE_INLINE int tsDecompressBool(const char *const input, int compressedSize, const int nelements, char *const output,
                      int outputSize, char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == BITPACK_COMP || algorithm == CHIMP_COMP) {
     return tsDecompressBoolImp(input, nelements, output);
   } else if (algorithm == TWO_STAGE_COMP) {
     tsDecompressStringImp(input, compressedSize, buffer, bufferSize);
@@ -179,11 +210,13 @@ static FORCE_INLINE int tsDecompressString(const char *const input, int compress
 
 static FORCE_INLINE int tsCompressFloat(const char *const input, int inputSize, const int nelements, char *const output, int outputSize,
                     char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == BITPACK_COMP) {
     return tsCompressFloatImp(input, nelements, output);
   } else if (algorithm == TWO_STAGE_COMP) {
     int len = tsCompressFloatImp(input, nelements, buffer);
     return tsCompressStringImp(buffer, len, output, outputSize);
+  } else if (algorithm == CHIMP_COMP) {
+    return tsCompressChimpImp(input, nelements, output, TSDB_DATA_TYPE_FLOAT);
   } else {
     assert(0);
   }
@@ -191,11 +224,13 @@ static FORCE_INLINE int tsCompressFloat(const char *const input, int inputSize,
 
 static FORCE_INLINE int tsDecompressFloat(const char *const input, int compressedSize, const int nelements, char *const output,
                       int outputSize, char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == BITPACK_COMP) {
     return tsDecompressFloatImp(input, nelements, output);
   } else if (algorithm == TWO_STAGE_COMP) {
     tsDecompressStringImp(input, compressedSize, buffer, bufferSize);
     return tsDecompressFloatImp(buffer, nelements, output);
+  } else if (algorithm == CHIMP_COMP) {
+    return tsDecompressChimpImp(input, compressedSize, nelements, output, TSDB_DATA_TYPE_FLOAT);
   } else {
     assert(0);
   }
@@ -203,11 +238,13 @@ static FORCE_INLINE int tsDecompressFloat(const char *const input, int compresse
 
 static FORCE_INLINE int tsCompressDouble(const char *const input, int inputSize, const int nelements, char *const output, int outputSize,
                      char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == BITPACK_COMP) {
     return tsCompressDoubleImp(input, nelements, output);
   } else if (algorithm == TWO_STAGE_COMP) {
     int len = tsCompressDoubleImp(input, nelements, buffer);
     return tsCompressStringImp(buffer, len, output, outputSize);
+  } else if (algorithm == CHIMP_COMP) {
+    return tsCompressChimpImp(input, nelements, output, TSDB_DATA_TYPE_DOUBLE);
   } else {
     assert(0);
   }
@@ -215,11 +252,13 @@ static FORCE_INLINE int tsCompressDouble(const char *const input, int inputSize,
 
 static FORCE_INLINE int tsDecompressDouble(const char *const input, int compressedSize, const int nelements, char *const output,
                        int outputSize, char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == BITPACK_COMP) {
     return tsDecompressDoubleImp(input, nelements, output);
   } else if (algorithm == TWO_STAGE_COMP) {
     tsDecompressStringImp(input, compressedSize, buffer, bufferSize);
     return tsDecompressDoubleImp(buffer, nelements, output);
+  } else if (algorithm == CHIMP_COMP) {
+    return tsDecompressChimpImp(input, compressedSize, nelements, output, TSDB_DATA_TYPE_DOUBLE);
   } else {
     assert(0);
   }
@@ -227,7 +266,7 @@ static FORCE_INLINE int tsDecompressDouble(const char *const input, int compress
 
 static FORCE_INLINE int tsCompressTimestamp(const char *const input, int inputSize, const int nelements, char *const output, int outputSize,
                         char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == BITPACK_COMP || algorithm == CHIMP_COMP) {
     return tsCompressTimestampImp(input, nelements, output);
   } else if (algorithm == TWO_STAGE_COMP) {
     int len = tsCompressTimestampImp(input, nelements, buffer);
@@ -239,7 +278,7 @@ static FORCE_INLINE int tsCompressTimestamp(const char *const input, int inputSi
 
 static FORCE_INLINE int tsDecompressTimestamp(const char *const input, int compressedSize, const int nelements, char *const output,
                           int outputSize, char algorithm, char *const buffer, int bufferSize) {
-  if (algorithm == ONE_STAGE_COMP) {
+  if (algorithm == ONE_STAGE_COMP || algorithm == BITPACK_COMP || algorithm == CHIMP_COMP) {
     return tsDecompressTimestampImp(input, nelements, output);
   } else if (algorithm == TWO_STAGE_COMP) {
     tsDecompressStringImp(input, compressedSize, buffer, bufferSize);
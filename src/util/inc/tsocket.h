@@ -27,7 +27,7 @@ int taosNonblockwrite(int fd, char *ptr, int nbytes);
 int taosCopyFds(int sfd, int dfd, int64_t len);
 int taosSetNonblocking(int sock, int on);
 
-int  taosOpenUdpSocket(uint32_t localIp, uint16_t localPort);
+int  taosOpenUdpSocket(uint32_t localIp, uint16_t localPort, bool reusePort);
 int  taosOpenTcpClientSocket(uint32_t ip, uint16_t port, uint32_t localIp);
 int  taosOpenTcpServerSocket(uint32_t ip, uint16_t port);
 int  taosKeepTcpAlive(int sockFd);
@@ -583,3 +583,256 @@ void taosCacheCleanup(SCacheObj *pCacheObj) {
     doCleanupDataCache(pCacheObj);
   }
 }
+
+static FORCE_INLINE void taosLRUUnlink(SLRUCacheShard *pShard, SLRUNode *pNode) {
+  if (pNode->prev != NULL) {
+    pNode->prev->next = pNode->next;
+  } else {
+    pShard->pHead = pNode->next;
+  }
+
+  if (pNode->next != NULL) {
+    pNode->next->prev = pNode->prev;
+  } else {
+    pShard->pTail = pNode->prev;
+  }
+}
+
+static FORCE_INLINE void taosLRUInsertHead(SLRUCacheShard *pShard, SLRUNode *pNode) {
+  pNode->prev = NULL;
+  pNode->next = pShard->pHead;
+  if (pShard->pHead != NULL) {
+    pShard->pHead->prev = pNode;
+  } else {
+    pShard->pTail = pNode;
+  }
+
+  pShard->pHead = pNode;
+}
+
+static FORCE_INLINE int64_t taosLRUNodeSize(SLRUNode *pNode) {
+  return sizeof(SLRUNode) + pNode->keyLen + pNode->dataSize;
+}
+
+static SLRUCacheShard *taosLRUGetShard(SLRUCache *pCache, const void *key, size_t keyLen) {
+  // the low bits of the hash value pick the slot in the hash table of the shard, use the high bits here
+  uint32_t hashVal = MurmurHash3_32(key, (uint32_t)keyLen);
+  return pCache->shards + ((hashVal >> 16) % pCache->numOfShards);
+}
+
+static void taosLRURemoveNode(SLRUCacheShard *pShard, SLRUNode *pNode) {
+  taosHashRemove(pShard->pHashTable, pNode->data, pNode->keyLen);
+  taosLRUUnlink(pShard, pNode);
+  pShard->usage -= taosLRUNodeSize(pNode);
+  free(pNode);
+}
+
+SLRUCache *taosLRUCacheInit(int64_t capacity, int32_t numOfShards) {
+  if (capacity <= 0 || numOfShards <= 0) {
+    return NULL;
+  }
+
+  SLRUCache *pCache = calloc(1, sizeof(SLRUCache));
+  if (pCache == NULL) {
+    uError("failed to allocate memory, reason:%s", strerror(errno));
+    return NULL;
+  }
+
+  pCache->shards = calloc(numOfShards, sizeof(SLRUCacheShard));
+  if (pCache->shards == NULL) {
+    uError("failed to allocate memory, reason:%s", strerror(errno));
+    free(pCache);
+    return NULL;
+  }
+
+  for (int32_t i = 0; i < numOfShards; ++i) {
+    SLRUCacheShard *pShard = pCache->shards + i;
+
+    pShard->pHashTable = taosHashInit(128, taosGetDefaultHashFunction(TSDB_DATA_TYPE_BINARY), false);
+    if (pShard->pHashTable == NULL) {
+      taosLRUCacheCleanup(pCache);
+      return NULL;
+    }
+
+    pthread_mutex_init(&pShard->lock, NULL);
+    pShard->capacity = capacity / numOfShards;
+    pCache->numOfShards++;
+  }
+
+  return pCache;
+}
+
+int32_t taosLRUCachePut(SLRUCache *pCache, const void *key, size_t keyLen, const void *pData, size_t dataSize) {
+  if (pCache == NULL || keyLen == 0) {
+    return -1;
+  }
+
+  SLRUCacheShard *pShard = taosLRUGetShard(pCache, key, keyLen);
+  if (sizeof(SLRUNode) + keyLen + dataSize > pShard->capacity) {
+    return -1;
+  }
+
+  SLRUNode *pNewNode = malloc(sizeof(SLRUNode) + keyLen + dataSize);
+  if (pNewNode == NULL) {
+    uError("failed to allocate memory, reason:%s", strerror(errno));
+    return -1;
+  }
+
+  pNewNode->keyLen = (uint32_t)keyLen;
+  pNewNode->dataSize = (uint32_t)dataSize;
+  memcpy(pNewNode->data, key, keyLen);
+  memcpy(pNewNode->data + keyLen, pData, dataSize);
+
+  pthread_mutex_lock(&pShard->lock);
+
+  SLRUNode **ppNode = taosHashGet(pShard->pHashTable, key, keyLen);
+  if (ppNode != NULL) {
+    taosLRURemoveNode(pShard, *ppNode);
+  }
+
+  while (pShard->usage + taosLRUNodeSize(pNewNode) > pShard->capacity) {
+    taosLRURemoveNode(pShard, pShard->pTail);
+  }
+
+  if (taosHashPut(pShard->pHashTable, key, keyLen, &pNewNode, POINTER_BYTES) < 0) {
+    pthread_mutex_unlock(&pShard->lock);
+    free(pNewNode);
+    return -1;
+  }
+
+  taosLRUInsertHead(pShard, pNewNode);
+  pShard->usage += taosLRUNodeSize(pNewNode);
+
+  pthread_mutex_unlock(&pShard->lock);
+  return 0;
+}
+
+int32_t taosLRUCacheGet(SLRUCache *pCache, const void *key, size_t keyLen, void *pBuf, size_t bufSize) {
+  if (pCache == NULL || keyLen == 0) {
+    return -1;
+  }
+
+  SLRUCacheShard *pShard = taosLRUGetShard(pCache, key, keyLen);
+  int32_t         size = -1;
+
+  pthread_mutex_lock(&pShard->lock);
+
+  pShard->statistics.totalAccess++;
+
+  SLRUNode **ppNode = taosHashGet(pShard->pHashTable, key, keyLen);
+  if (ppNode != NULL && (*ppNode)->dataSize <= bufSize) {
+    SLRUNode *pNode = *ppNode;
+    memcpy(pBuf, pNode->data + pNode->keyLen, pNode->dataSize);
+    size = (int32_t)pNode->dataSize;
+
+    taosLRUUnlink(pShard, pNode);
+    taosLRUInsertHead(pShard, pNode);
+    pShard->statistics.hitCount++;
+  } else {
+    pShard->statistics.missCount++;
+  }
+
+  pthread_mutex_unlock(&pShard->lock);
+  return size;
+}
+
+int32_t taosLRUCacheGetDup(SLRUCache *pCache, const void *key, size_t keyLen, void **ppData) {
+  *ppData = NULL;
+  if (pCache == NULL || keyLen == 0) {
+    return -1;
+  }
+
+  SLRUCacheShard *pShard = taosLRUGetShard(pCache, key, keyLen);
+  int32_t         size = -1;
+
+  pthread_mutex_lock(&pShard->lock);
+
+  pShard->statistics.totalAccess++;
+
+  SLRUNode **ppNode = taosHashGet(pShard->pHashTable, key, keyLen);
+  if (ppNode != NULL && (*ppNode)->dataSize > 0 && (*ppData = malloc((*ppNode)->dataSize)) != NULL) {
+    SLRUNode *pNode = *ppNode;
+    memcpy(*ppData, pNode->data + pNode->keyLen, pNode->dataSize);
+    size = (int32_t)pNode->dataSize;
+
+    taosLRUUnlink(pShard, pNode);
+    taosLRUInsertHead(pShard, pNode);
+    pShard->statistics.hitCount++;
+  } else {
+    pShard->statistics.missCount++;
+  }
+
+  pthread_mutex_unlock(&pShard->lock);
+  return size;
+}
+
+void taosLRUCacheRemove(SLRUCache *pCache, const void *key, size_t keyLen) {
+  if (pCache == NULL || keyLen == 0) {
+    return;
+  }
+
+  SLRUCacheShard *pShard = taosLRUGetShard(pCache, key, keyLen);
+
+  pthread_mutex_lock(&pShard->lock);
+
+  SLRUNode **ppNode = taosHashGet(pShard->pHashTable, key, keyLen);
+  if (ppNode != NULL) {
+    taosLRURemoveNode(pShard, *ppNode);
+  }
+
+  pthread_mutex_unlock(&pShard->lock);
+}
+
+void taosLRUCacheGetStatis(SLRUCache *pCache, SCacheStatis *pStatis) {
+  memset(pStatis, 0, sizeof(SCacheStatis));
+  if (pCache == NULL) {
+    return;
+  }
+
+  for (int32_t i = 0; i < pCache->numOfShards; ++i) {
+    SLRUCacheShard *pShard = pCache->shards + i;
+
+    pthread_mutex_lock(&pShard->lock);
+    pStatis->hitCount += pShard->statistics.hitCount;
+    pStatis->missCount += pShard->statistics.missCount;
+    pStatis->totalAccess += pShard->statistics.totalAccess;
+    pthread_mutex_unlock(&pShard->lock);
+  }
+}
+
+int64_t taosLRUCacheGetUsage(SLRUCache *pCache) {
+  int64_t usage = 0;
+  if (pCache == NULL) {
+    return 0;
+  }
+
+  for (int32_t i = 0; i < pCache->numOfShards; ++i) {
+    SLRUCacheShard *pShard = pCache->shards + i;
+
+    pthread_mutex_lock(&pShard->lock);
+    usage += pShard->usage;
+    pthread_mutex_unlock(&pShard->lock);
+  }
+
+  return usage;
+}
+
+void taosLRUCacheCleanup(SLRUCache *pCache) {
+  if (pCache == NULL) {
+    return;
+  }
+
+  for (int32_t i = 0; i < pCache->numOfShards; ++i) {
+    SLRUCacheShard *pShard = pCache->shards + i;
+
+    while (pShard->pHead != NULL) {
+      taosLRURemoveNode(pShard, pShard->pHead);
+    }
+
+    taosHashCleanup(pShard->pHashTable);
+    pthread_mutex_destroy(&pShard->lock);
+  }
+
+  free(pCache->shards);
+  free(pCache);
+}
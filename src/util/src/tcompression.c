@@ -26,6 +26,12 @@
  *   NOTE : For bigint, only 59 bits can be used, which means data from -(2**59) to (2**59)-1
  *   are allowed.
  *
+ *   With BITPACK_COMP, integers are compressed by frame of reference instead. The values are split into
+ *   blocks of 128, each block records a reference value and a bit width, and the values minus the reference
+ *   are bit packed with the width. If the differences between adjacent values need fewer bits, like those
+ *   of a counter, the differences are packed instead. The full range of bigint is allowed, and the values
+ *   of a block are decoded without any branch on each of them.
+ *
  * BOOLEAN Compression Algorithm:
  *   We provide two methods for compress boolean types. Because boolean types in C
  *   code are char bytes with 0 and 1 values only, only one bit can used to discrimenate
@@ -38,6 +44,10 @@
  * STRING Compression Algorithm:
  *   We us LZ4 method to compress the string type.
  *
+ *   A binary or nchar column of a block with few distinct values is dictionary encoded instead (DICT_COMP),
+ *   which is chosen for each column when the block is written. The distinct values are kept once, and each
+ *   value is replaced by the bit packed index of it in the distinct values.
+ *
  * FLOAT Compression Algorithm:
  *   We use the same method with Akumuli to compress float and double types. The compression
  *   algorithm assumes the float/double values change slightly. So we take the XOR between two
@@ -45,6 +55,11 @@
  *   of leading zeros are larger than the trailing zeros, then record the last serveral bytes
  *   of the XORed value with informations. If not, record the first corresponding bytes.
  *
+ *   With CHIMP_COMP, the XORed value is recorded at bit level instead of byte level, following
+ *   Chimp (a successor of Gorilla). Only the bits between the leading zeros and the trailing
+ *   zeros are written, and a repeated value takes 2 bits. The XORed values depend on each other,
+ *   so the decoder is a plain bit reader which loads 8 bytes at a time.
+ *
  */
 
 #include "os.h"
@@ -282,6 +297,300 @@ int tsDecompressINTImp(const char *const input, const int nelements, char *const
   return nelements * word_length;
 }
 
+/*
+ * Compress Integer (frame of reference + bit packing).
+ *
+ * Each block of BITPACK_BLOCK_SIZE values (the last one may be shorter) is encoded as:
+ *   1 byte  : the bit width, with BITPACK_DELTA_FLAG set if the differences are packed
+ *   8 bytes : the reference, the minimum of the values or the differences
+ *   ceil(n * width / 8) bytes : the values minus the reference, packed with the width
+ * The difference of the first value of a block is taken from the last value of the previous block, or 0.
+ *
+ * In a full block, the values of even and odd positions are packed into two streams of 64-bit words, and the words of
+ * the streams are interleaved, so that a 128-bit load gets a word of each stream, and two adjacent values are decoded
+ * by the same shifts. The values of the last block, if it is not full, are packed one after another.
+ */
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define BITPACK_BLOCK_SIZE 128
+#define BITPACK_DELTA_FLAG 0x80
+
+static FORCE_INLINE int64_t bitPackGetValue(const char *const input, int i, const char type) {
+  switch (type) {
+    case TSDB_DATA_TYPE_TINYINT:
+      return *((int8_t *)input + i);
+    case TSDB_DATA_TYPE_SMALLINT:
+      return *((int16_t *)input + i);
+    case TSDB_DATA_TYPE_INT:
+      return *((int32_t *)input + i);
+    default:
+      return *((int64_t *)input + i);
+  }
+}
+
+static FORCE_INLINE int bitPackWidth(uint64_t range) { return (range == 0) ? 0 : (64 - BUILDIN_CLZL(range)); }
+
+// pack the n values of width bits in input, with the given stride, one after another, return the bytes written
+static int bitPack(const uint64_t *input, int n, int stride, int width, char *const output) {
+  if (width == 0) return 0;
+
+  char *   op = output;
+  uint64_t acc = 0;
+  int      bits = 0;  // bits in acc
+  for (int i = 0; i < n; i++) {
+    uint64_t v = input[i * stride];
+    acc |= v << bits;
+    if (bits + width >= 64) {
+      memcpy(op, &acc, sizeof(acc));
+      op += sizeof(acc);
+      int used = 64 - bits;  // bits of v in the flushed word
+      acc = (used == 64) ? 0 : (v >> used);
+      bits = bits + width - 64;
+    } else {
+      bits += width;
+    }
+  }
+
+  memcpy(op, &acc, (bits + 7) / 8);
+  return (int)(op - output) + (bits + 7) / 8;
+}
+
+// pack a full block into the two interleaved streams
+static int bitPackBlock(const uint64_t *input, int width, char *const output) {
+  uint64_t words[2][BITPACK_BLOCK_SIZE / 2];
+  for (int s = 0; s < 2; s++) bitPack(input + s, BITPACK_BLOCK_SIZE / 2, 2, width, (char *)words[s]);
+
+  uint64_t *op = (uint64_t *)output;
+  for (int k = 0; k < width; k++) {
+    memcpy(op + 2 * k, &words[0][k], sizeof(uint64_t));
+    memcpy(op + 2 * k + 1, &words[1][k], sizeof(uint64_t));
+  }
+
+  return width * 2 * sizeof(uint64_t);
+}
+
+// decode a full block of width bits packed by bitPackBlock, with the reference added
+static void bitUnpackBlock(const char *const input, int width, uint64_t ref, uint64_t *output) {
+  if (width == 0) {
+    for (int j = 0; j < BITPACK_BLOCK_SIZE; j++) output[j] = ref;
+    return;
+  }
+
+  int bits = 0;  // bits of the current words decoded
+#ifdef __SSE2__
+  const __m128i *ip = (const __m128i *)input;
+  __m128i        cur = _mm_loadu_si128(ip++);
+  __m128i        mask = _mm_set1_epi64x((width == 64) ? -1 : (int64_t)INT64MASK(width));
+  __m128i        vref = _mm_set1_epi64x((int64_t)ref);
+
+  for (int j = 0; j < BITPACK_BLOCK_SIZE; j += 2) {
+    __m128i v = _mm_srl_epi64(cur, _mm_cvtsi32_si128(bits));
+    if (bits + width >= 64) {
+      // no word is left after the last values if they end at a word boundary
+      if (bits + width > 64 || j + 2 < BITPACK_BLOCK_SIZE) {
+        __m128i next = _mm_loadu_si128(ip++);
+        if (bits + width > 64) v = _mm_or_si128(v, _mm_sll_epi64(next, _mm_cvtsi32_si128(64 - bits)));
+        cur = next;
+      }
+      bits = bits + width - 64;
+    } else {
+      bits += width;
+    }
+    v = _mm_add_epi64(_mm_and_si128(v, mask), vref);
+    _mm_storeu_si128((__m128i *)(output + j), v);
+  }
+#else
+  const uint64_t *ip = (const uint64_t *)input;
+  uint64_t        cur[2] = {ip[0], ip[1]};
+  uint64_t        mask = (width == 64) ? (uint64_t)-1 : INT64MASK(width);
+  ip += 2;
+
+  for (int j = 0; j < BITPACK_BLOCK_SIZE; j += 2) {
+    for (int s = 0; s < 2; s++) {
+      uint64_t v = cur[s] >> bits;
+      if (bits + width > 64) v |= ip[s] << (64 - bits);
+      output[j + s] = (v & mask) + ref;
+    }
+    if (bits + width >= 64) {
+      if (bits + width > 64 || j + 2 < BITPACK_BLOCK_SIZE) {
+        cur[0] = ip[0];
+        cur[1] = ip[1];
+        ip += 2;
+      }
+      bits = bits + width - 64;
+    } else {
+      bits += width;
+    }
+  }
+#endif
+}
+
+// unpack n values of width bits packed one after another by bitPack, with the reference added
+static void bitUnpack(const char *const input, int width, int n, uint64_t ref, uint64_t *output) {
+  for (int i = 0; i < n; i++) {
+    int64_t  bit = (int64_t)i * width;
+    uint64_t v = 0;
+    for (int got = 0; got < width;) {
+      int pos = (int)(bit >> 3);
+      int shift = (int)(bit & 7);
+      int take = MIN(8 - shift, width - got);
+      v |= ((uint64_t)(((uint8_t)input[pos] >> shift) & INT8MASK(take))) << got;
+      got += take;
+      bit += take;
+    }
+    output[i] = v + ref;
+  }
+}
+
+int tsCompressBitPackImp(const char *const input, const int nelements, char *const output, const char type) {
+  int word_length = 0;
+  switch (type) {
+    case TSDB_DATA_TYPE_BIGINT:
+      word_length = LONG_BYTES;
+      break;
+    case TSDB_DATA_TYPE_INT:
+      word_length = INT_BYTES;
+      break;
+    case TSDB_DATA_TYPE_SMALLINT:
+      word_length = SHORT_BYTES;
+      break;
+    case TSDB_DATA_TYPE_TINYINT:
+      word_length = CHAR_BYTES;
+      break;
+    default:
+      perror("Wrong integer types.\n");
+      exit(1);
+  }
+
+  int      byte_limit = nelements * word_length + 1;
+  int      opos = 1;
+  uint64_t prev_value = 0;
+  uint64_t values[BITPACK_BLOCK_SIZE];
+  uint64_t diffs[BITPACK_BLOCK_SIZE];
+
+  for (int i = 0; i < nelements; i += BITPACK_BLOCK_SIZE) {
+    int     n = MIN(BITPACK_BLOCK_SIZE, nelements - i);
+    int64_t vmin = INT64_MAX, vmax = INT64_MIN, dmin = INT64_MAX, dmax = INT64_MIN;
+
+    for (int j = 0; j < n; j++) {
+      int64_t curr_value = bitPackGetValue(input, i + j, type);
+      int64_t diff = (int64_t)((uint64_t)curr_value - prev_value);
+      values[j] = (uint64_t)curr_value;
+      diffs[j] = (uint64_t)diff;
+      vmin = MIN(vmin, curr_value);
+      vmax = MAX(vmax, curr_value);
+      dmin = MIN(dmin, diff);
+      dmax = MAX(dmax, diff);
+      prev_value = (uint64_t)curr_value;
+    }
+
+    // The unsigned differences to the minimum never overflow
+    int       vwidth = bitPackWidth((uint64_t)vmax - (uint64_t)vmin);
+    int       dwidth = bitPackWidth((uint64_t)dmax - (uint64_t)dmin);
+    bool      packDiffs = (dwidth < vwidth);
+    int       width = packDiffs ? dwidth : vwidth;
+    uint64_t  ref = packDiffs ? (uint64_t)dmin : (uint64_t)vmin;
+    uint64_t *pack = packDiffs ? diffs : values;
+
+    if (opos + 1 + LONG_BYTES + (n * width + 7) / 8 > byte_limit) {
+      output[0] = 1;
+      memcpy(output + 1, input, byte_limit - 1);
+      return byte_limit;
+    }
+
+    for (int j = 0; j < n; j++) pack[j] -= ref;
+
+    output[opos++] = (char)(packDiffs ? (width | BITPACK_DELTA_FLAG) : width);
+    memcpy(output + opos, &ref, LONG_BYTES);
+    opos += LONG_BYTES;
+    if (n == BITPACK_BLOCK_SIZE) {
+      opos += bitPackBlock(pack, width, output + opos);
+    } else {
+      opos += bitPack(pack, n, 1, width, output + opos);
+    }
+  }
+
+  // set the indicator.
+  output[0] = 0;
+  return opos;
+}
+
+int tsDecompressBitPackImp(const char *const input, const int nelements, char *const output, const char type) {
+  int word_length = 0;
+  switch (type) {
+    case TSDB_DATA_TYPE_BIGINT:
+      word_length = LONG_BYTES;
+      break;
+    case TSDB_DATA_TYPE_INT:
+      word_length = INT_BYTES;
+      break;
+    case TSDB_DATA_TYPE_SMALLINT:
+      word_length = SHORT_BYTES;
+      break;
+    case TSDB_DATA_TYPE_TINYINT:
+      word_length = CHAR_BYTES;
+      break;
+    default:
+      perror("Wrong integer types.\n");
+      exit(1);
+  }
+
+  // If not compressed.
+  if (input[0] == 1) {
+    memcpy(output, input + 1, nelements * word_length);
+    return nelements * word_length;
+  }
+
+  const char *ip = input + 1;
+  uint64_t    prev_value = 0;
+  uint64_t    values[BITPACK_BLOCK_SIZE];
+
+  for (int i = 0; i < nelements; i += BITPACK_BLOCK_SIZE) {
+    int      n = MIN(BITPACK_BLOCK_SIZE, nelements - i);
+    uint8_t  flag = (uint8_t)ip[0];
+    int      width = flag & (~BITPACK_DELTA_FLAG);
+    uint64_t ref = 0;
+    memcpy(&ref, ip + 1, LONG_BYTES);
+    ip += 1 + LONG_BYTES;
+
+    // the values of a bigint block are decoded in place
+    uint64_t *pValues = (type == TSDB_DATA_TYPE_BIGINT) ? ((uint64_t *)output + i) : values;
+    if (n == BITPACK_BLOCK_SIZE) {
+      bitUnpackBlock(ip, width, ref, pValues);
+    } else {
+      bitUnpack(ip, width, n, ref, pValues);
+    }
+    ip += (n * width + 7) / 8;
+
+    if (flag & BITPACK_DELTA_FLAG) {
+      for (int j = 0; j < n; j++) {
+        prev_value += pValues[j];
+        pValues[j] = prev_value;
+      }
+    } else {
+      prev_value = pValues[n - 1];
+    }
+
+    switch (type) {
+      case TSDB_DATA_TYPE_BIGINT:
+        break;
+      case TSDB_DATA_TYPE_INT:
+        for (int j = 0; j < n; j++) *((int32_t *)output + i + j) = (int32_t)values[j];
+        break;
+      case TSDB_DATA_TYPE_SMALLINT:
+        for (int j = 0; j < n; j++) *((int16_t *)output + i + j) = (int16_t)values[j];
+        break;
+      default:
+        for (int j = 0; j < n; j++) *((int8_t *)output + i + j) = (int8_t)values[j];
+        break;
+    }
+  }
+
+  return nelements * word_length;
+}
+
 /* ----------------------------------------------Bool Compression
  * ---------------------------------------------- */
 // TODO: You can also implement it using RLE method.
@@ -431,6 +740,147 @@ int tsDecompressStringImp(const char *const input, int compressedSize, char *con
   }
 }
 
+/*
+ * Dictionary encoding of binary and nchar data, for the columns of few distinct values like a status. The encoded
+ * data is:
+ *   number of distinct values (uint16) | code width (uint8) | the distinct values | the code of each value
+ * The distinct values are in the var data format, in the order of their first appearance. The code of a value is the
+ * index of it in the distinct values, the codes are bit packed with the width from the lowest bit of each byte.
+ */
+#define DICT_HEAD_SIZE (sizeof(uint16_t) + sizeof(uint8_t))
+#define DICT_HASH_SLOTS 1024  // a power of 2, larger than DICT_MAX_ENTRIES * 2
+#define DICT_MIN_REPEATS 4    // a value repeats at least these times in average, or the dictionary is not worth it
+
+static FORCE_INLINE uint32_t dictHash(const char *value) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (int i = 0; i < varDataTLen(value); i++) {
+    hash = (hash ^ (uint8_t)value[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/*
+ * Return the size of the encoded data, or 0 if the values are not worth a dictionary, i.e. there are too many
+ * distinct values or the encoded data is not smaller than the input.
+ */
+int tsCompressDictImp(const char *const input, const int inputSize, const int nelements, char *const output,
+                      const int outputSize) {
+  int maxEntries = MIN(DICT_MAX_ENTRIES, nelements / DICT_MIN_REPEATS);
+  if (maxEntries == 0) return 0;
+
+  uint8_t *codes = (uint8_t *)malloc(nelements);
+  if (codes == NULL) return 0;
+
+  int16_t slots[DICT_HASH_SLOTS];  // index of the distinct value + 1, 0 if the slot is empty
+  int32_t entries[DICT_MAX_ENTRIES];  // offset of each distinct value in the input
+  int     numOfEntries = 0;
+  int     dictSize = 0;
+  memset(slots, 0, sizeof(slots));
+
+  const char *value = input;
+  for (int i = 0; i < nelements; i++) {
+    uint32_t slot = dictHash(value) & (DICT_HASH_SLOTS - 1);
+    while (slots[slot] != 0) {
+      const char *entry = input + entries[slots[slot] - 1];
+      if (varDataLen(entry) == varDataLen(value) && memcmp(varDataVal(entry), varDataVal(value), varDataLen(value)) == 0) {
+        break;
+      }
+      slot = (slot + 1) & (DICT_HASH_SLOTS - 1);
+    }
+
+    if (slots[slot] == 0) {
+      if (numOfEntries == maxEntries) {
+        free(codes);
+        return 0;
+      }
+      entries[numOfEntries++] = (int32_t)(value - input);
+      slots[slot] = numOfEntries;
+      dictSize += varDataTLen(value);
+    }
+
+    codes[i] = (uint8_t)(slots[slot] - 1);
+    value += varDataTLen(value);
+  }
+
+  int width = (numOfEntries == 1) ? 0 : (32 - BUILDIN_CLZ(numOfEntries - 1));
+  int len = DICT_HEAD_SIZE + dictSize + (nelements * width + BITS_PER_BYTE - 1) / BITS_PER_BYTE;
+  if (len >= inputSize || len > outputSize) {
+    free(codes);
+    return 0;
+  }
+
+  char *ptr = output;
+  *(uint16_t *)ptr = (uint16_t)numOfEntries;
+  ptr[sizeof(uint16_t)] = (char)width;
+  ptr += DICT_HEAD_SIZE;
+
+  for (int i = 0; i < numOfEntries; i++) {
+    memcpy(ptr, input + entries[i], varDataTLen(input + entries[i]));
+    ptr += varDataTLen(input + entries[i]);
+  }
+
+  uint32_t buffer = 0;
+  int      nbits = 0;
+  for (int i = 0; i < nelements; i++) {
+    buffer |= (uint32_t)codes[i] << nbits;
+    nbits += width;
+    while (nbits >= BITS_PER_BYTE) {
+      *(ptr++) = (char)buffer;
+      buffer >>= BITS_PER_BYTE;
+      nbits -= BITS_PER_BYTE;
+    }
+  }
+  if (nbits > 0) *(ptr++) = (char)buffer;
+
+  free(codes);
+  assert(ptr - output == len);
+  return len;
+}
+
+/*
+ * Decode the values into output in the var data format one after another, and the code of each value into codes if
+ * it is not NULL. Return the size of the decoded values, or -1 if the encoded data is corrupted.
+ */
+int tsDecompressDictImp(const char *const input, const int compressedSize, const int nelements, char *const output,
+                        const int outputSize, uint8_t *const codes) {
+  if (compressedSize < (int)DICT_HEAD_SIZE) return -1;
+
+  int numOfEntries = *(uint16_t *)input;
+  int width = (uint8_t)input[sizeof(uint16_t)];
+  if (numOfEntries == 0 || numOfEntries > DICT_MAX_ENTRIES || width > BITS_PER_BYTE) return -1;
+
+  const char *entries[DICT_MAX_ENTRIES];
+  const char *ptr = input + DICT_HEAD_SIZE;
+  const char *end = input + compressedSize;
+  for (int i = 0; i < numOfEntries; i++) {
+    if (ptr + sizeof(VarDataLenT) > end || ptr + varDataTLen(ptr) > end) return -1;
+    entries[i] = ptr;
+    ptr += varDataTLen(ptr);
+  }
+  if ((end - ptr) * BITS_PER_BYTE < (int64_t)nelements * width) return -1;
+
+  const uint8_t *pCodes = (const uint8_t *)ptr;
+  uint32_t       mask = INT32MASK(width);
+  int            len = 0;
+  for (int i = 0; i < nelements; i++) {
+    int      bit = i * width;
+    uint32_t w = pCodes[bit >> 3];
+    if ((bit & 7) + width > BITS_PER_BYTE) w |= (uint32_t)pCodes[(bit >> 3) + 1] << BITS_PER_BYTE;
+
+    int code = (w >> (bit & 7)) & mask;
+    if (code >= numOfEntries) return -1;
+
+    int tlen = varDataTLen(entries[code]);
+    if (len + tlen > outputSize) return -1;
+    memcpy(output + len, entries[code], tlen);
+    len += tlen;
+
+    if (codes != NULL) codes[i] = (uint8_t)code;
+  }
+
+  return len;
+}
+
 /* --------------------------------------------Timestamp Compression
  * ---------------------------------------------- */
 // TODO: Take care here, we assumes little endian encoding.
@@ -887,3 +1337,188 @@ int tsDecompressFloatImp(const char *const input, const int nelements, char *con
 
   return nelements * FLOAT_BYTES;
 }
+
+/* --------------------------------------------Chimp Compression
+ * ---------------------------------------------- */
+/*
+ * A variant of Chimp (Liakos et al., VLDB 2022) for float and double: the XOR of a value and the previous one is
+ * written bit by bit, from the lowest bit of the stream, as one of:
+ *   00                                    : the XOR is 0, the value is repeated
+ *   01 + lead(3) + center length - 1 + center bits
+ *                                         : the XOR has many trailing zeros, only the bits between the rounded leading
+ *                                           zeros and the trailing zeros are written
+ *   10 + the bits below the leading zeros : the rounded leading zeros are the same as the previous XOR
+ *   11 + lead(3) + the bits below the leading zeros
+ * The numbers of leading zeros are rounded down to one of the 8 in chimpLeads, and written by the index. The first
+ * value is written as it is.
+ */
+static const int chimpLeads64[] = {0, 8, 12, 16, 18, 20, 22, 24};
+static const int chimpLeads32[] = {0, 4, 6, 8, 10, 12, 14, 16};
+
+typedef struct {
+  char *   out;
+  int      pos;    // bytes flushed
+  uint64_t acc;
+  int      nbits;  // bits in acc
+} SChimpWriter;
+
+static FORCE_INLINE void chimpPut(SChimpWriter *pWriter, uint64_t v, int n) {
+  if (n == 0) return;
+
+  pWriter->acc |= v << pWriter->nbits;
+  if (pWriter->nbits + n >= 64) {
+    memcpy(pWriter->out + pWriter->pos, &pWriter->acc, sizeof(uint64_t));
+    pWriter->pos += sizeof(uint64_t);
+    int used = 64 - pWriter->nbits;  // bits of v in the flushed word
+    pWriter->acc = (used == 64) ? 0 : (v >> used);
+    pWriter->nbits = pWriter->nbits + n - 64;
+  } else {
+    pWriter->nbits += n;
+  }
+}
+
+// the 57 bits at least from the bit of the input, which has len bytes
+static FORCE_INLINE uint64_t chimpPeek(const char *const input, int len, int64_t bit) {
+  int      pos = (int)(bit >> 3);
+  uint64_t w = 0;
+  if (pos + 8 <= len) {
+    memcpy(&w, input + pos, sizeof(w));
+  } else if (pos < len) {
+    memcpy(&w, input + pos, len - pos);
+  }
+  return w >> (bit & 7);
+}
+
+static FORCE_INLINE uint64_t chimpRead(const char *const input, int len, int64_t *bit, int n) {
+  uint64_t v;
+  if (n <= 56) {
+    v = chimpPeek(input, len, *bit) & INT64MASK(n);
+  } else {
+    v = chimpPeek(input, len, *bit) & INT64MASK(32);
+    v |= (chimpPeek(input, len, *bit + 32) & INT64MASK((n - 32))) << 32;
+  }
+  *bit += n;
+  return v;
+}
+
+int tsCompressChimpImp(const char *const input, const int nelements, char *const output, const char type) {
+  int        bits = (type == TSDB_DATA_TYPE_FLOAT) ? FLOAT_BYTES * BITS_PER_BYTE : DOUBLE_BYTES * BITS_PER_BYTE;
+  const int *leads = (bits == 64) ? chimpLeads64 : chimpLeads32;
+  int        threshold = (bits == 64) ? 6 : 5;          // trailing zeros worth the center form
+  int        centerBits = (bits == 64) ? 6 : 5;         // bits of the center length
+  int        maxBits = 2 + 3 + centerBits + bits;       // bits of a value at most
+  int        byte_limit = nelements * (bits / BITS_PER_BYTE) + 1;
+
+  SChimpWriter writer = {.out = output + 1, .pos = 0, .acc = 0, .nbits = 0};
+  uint64_t     prev_value = 0;
+  int          prev_lead = -1;
+
+  for (int i = 0; i < nelements; i++) {
+    uint64_t curr_value = (bits == 64) ? *((uint64_t *)input + i) : *((uint32_t *)input + i);
+
+    if (1 + writer.pos + (writer.nbits + maxBits + 7) / BITS_PER_BYTE > byte_limit) {
+      output[0] = 1;
+      memcpy(output + 1, input, byte_limit - 1);
+      return byte_limit;
+    }
+
+    if (i == 0) {
+      chimpPut(&writer, curr_value, bits);
+      prev_value = curr_value;
+      continue;
+    }
+
+    uint64_t xor = curr_value ^ prev_value;
+    prev_value = curr_value;
+
+    if (xor == 0) {
+      chimpPut(&writer, 0, 2);
+      prev_lead = -1;
+      continue;
+    }
+
+    int clz = BUILDIN_CLZL(xor) - (64 - bits);
+    int tz = BUILDIN_CTZL(xor);
+    int code = 7;
+    while (leads[code] > clz) code--;
+    int lead = leads[code];
+
+    if (tz > threshold) {
+      int center = bits - lead - tz;
+      chimpPut(&writer, 1 | (code << 2) | ((center - 1) << 5), 5 + centerBits);
+      chimpPut(&writer, xor >> tz, center);
+      prev_lead = -1;
+    } else if (lead == prev_lead) {
+      chimpPut(&writer, 2, 2);
+      chimpPut(&writer, xor, bits - lead);
+    } else {
+      chimpPut(&writer, 3 | (code << 2), 5);
+      chimpPut(&writer, xor, bits - lead);
+      prev_lead = lead;
+    }
+  }
+
+  memcpy(writer.out + writer.pos, &writer.acc, (writer.nbits + 7) / BITS_PER_BYTE);
+
+  output[0] = 0;
+  return 1 + writer.pos + (writer.nbits + 7) / BITS_PER_BYTE;
+}
+
+int tsDecompressChimpImp(const char *const input, int compressedSize, const int nelements, char *const output,
+                         const char type) {
+  int bits = (type == TSDB_DATA_TYPE_FLOAT) ? FLOAT_BYTES * BITS_PER_BYTE : DOUBLE_BYTES * BITS_PER_BYTE;
+
+  if (input[0] == 1) {
+    memcpy(output, input + 1, nelements * (bits / BITS_PER_BYTE));
+    return nelements * (bits / BITS_PER_BYTE);
+  }
+
+  const int * leads = (bits == 64) ? chimpLeads64 : chimpLeads32;
+  int         centerBits = (bits == 64) ? 6 : 5;
+  const char *ip = input + 1;
+  int         len = compressedSize - 1;
+  int64_t     bit = 0;
+  uint64_t    prev_value = 0;
+  int         prev_lead = 0;
+
+  for (int i = 0; i < nelements; i++) {
+    if (i == 0) {
+      prev_value = chimpRead(ip, len, &bit, bits);
+    } else {
+      uint64_t peek = chimpPeek(ip, len, bit);
+      uint64_t xor = 0;
+
+      switch (peek & 3) {
+        case 0:
+          bit += 2;
+          break;
+        case 1: {
+          int lead = leads[(peek >> 2) & 7];
+          int center = (int)((peek >> 5) & INT64MASK(centerBits)) + 1;
+          bit += 5 + centerBits;
+          xor = chimpRead(ip, len, &bit, center) << (bits - lead - center);
+          break;
+        }
+        case 2:
+          bit += 2;
+          xor = chimpRead(ip, len, &bit, bits - prev_lead);
+          break;
+        default:
+          prev_lead = leads[(peek >> 2) & 7];
+          bit += 5;
+          xor = chimpRead(ip, len, &bit, bits - prev_lead);
+          break;
+      }
+
+      prev_value ^= xor;
+    }
+
+    if (bits == 64) {
+      *((uint64_t *)output + i) = prev_value;
+    } else {
+      *((uint32_t *)output + i) = (uint32_t)prev_value;
+    }
+  }
+
+  return nelements * (bits / BITS_PER_BYTE);
+}
@@ -1194,9 +1194,16 @@ static uint32_t shift_crc(uint32_t shift_table[][256], uint32_t crc) {
          shift_table[2][(crc >> 16) & 0xff] ^ shift_table[3][crc >> 24];
 }
 
+/* Resolve the implementation on the first call, so that the processes not
+   calling taosResolveCRC use the hardware version too. */
+static uint32_t crc32c_resolve(uint32_t crci, crc_stream bytes, size_t len) {
+  taosResolveCRC();
+  return (*crc32c)(crci, bytes, len);
+}
+
 /* Compute a CRC-32C.  If the crc32 instruction is available, use the hardware
    version.  Otherwise, use the software version. */
-uint32_t (*crc32c)(uint32_t crci, crc_stream bytes, size_t len) = crc32c_sf;
+uint32_t (*crc32c)(uint32_t crci, crc_stream bytes, size_t len) = crc32c_resolve;
 
 #ifndef _TD_ARM_
 /* Compute CRC-32C using the Intel hardware instruction. */
@@ -199,7 +199,7 @@ int taosReadn(int fd, char *ptr, int nbytes) {
   return (nbytes - nleft);
 }
 
-int taosOpenUdpSocket(uint32_t ip, uint16_t port) {
+int taosOpenUdpSocket(uint32_t ip, uint16_t port, bool reusePort) {
   struct sockaddr_in localAddr;
   int                sockFd;
   int                ttl = 128;
@@ -225,6 +225,21 @@ int taosOpenUdpSocket(uint32_t ip, uint16_t port) {
     return -1;
   };
 
+  // sockets bound to the same port with SO_REUSEPORT share the datagrams to it, spread by the peer address
+  if (reusePort) {
+#ifdef SO_REUSEPORT
+    if (taosSetSockOpt(sockFd, SOL_SOCKET, SO_REUSEPORT, (void *)&reuse, sizeof(reuse)) < 0) {
+      uError("setsockopt SO_REUSEPORT failed: %d (%s)", errno, strerror(errno));
+      close(sockFd);
+      return -1;
+    }
+#else
+    uError("SO_REUSEPORT is not supported");
+    close(sockFd);
+    return -1;
+#endif
+  }
+
   nocheck = 1;
   if (taosSetSockOpt(sockFd, SOL_SOCKET, SO_NO_CHECK, (void *)&nocheck, sizeof(nocheck)) < 0) {
     if (!taosSkipSocketCheck()) {
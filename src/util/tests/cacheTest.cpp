@@ -135,4 +135,58 @@ TEST(testCase, cache_resize_test) {
   printf("retrieve %d object cost:%" PRIu64 " us,avg:%f\n", num, endTime - startTime, (endTime - startTime)/(double)num);
 
   taosCacheCleanup(pCache);
-}
\ No newline at end of file
+}
+
+TEST(testCase, lru_cache_test) {
+  // one shard, room for about 10 elements of 100 bytes
+  SLRUCache* pCache = taosLRUCacheInit(10 * (sizeof(SLRUNode) + 8 + 100) + 50, 1);
+  ASSERT_TRUE(pCache != NULL);
+
+  char data[100] = {0};
+  char buf[100] = {0};
+  for (int64_t i = 0; i < 10; ++i) {
+    memset(data, (int)i, sizeof(data));
+    ASSERT_EQ(taosLRUCachePut(pCache, &i, sizeof(i), data, sizeof(data)), 0);
+  }
+
+  // touch the oldest one, so that the second one is evicted by the next put
+  int64_t key = 0;
+  ASSERT_EQ(taosLRUCacheGet(pCache, &key, sizeof(key), buf, sizeof(buf)), 100);
+  ASSERT_EQ(buf[99], 0);
+
+  key = 10;
+  ASSERT_EQ(taosLRUCachePut(pCache, &key, sizeof(key), data, sizeof(data)), 0);
+
+  key = 1;
+  ASSERT_EQ(taosLRUCacheGet(pCache, &key, sizeof(key), buf, sizeof(buf)), -1);
+  key = 0;
+  ASSERT_EQ(taosLRUCacheGet(pCache, &key, sizeof(key), buf, sizeof(buf)), 100);
+  key = 9;
+  ASSERT_EQ(taosLRUCacheGet(pCache, &key, sizeof(key), buf, sizeof(buf)), 100);
+  ASSERT_EQ(buf[0], 9);
+
+  // a buffer too small is a miss
+  ASSERT_EQ(taosLRUCacheGet(pCache, &key, sizeof(key), buf, 10), -1);
+
+  // or a buffer is allocated for the data
+  void* pData = NULL;
+  ASSERT_EQ(taosLRUCacheGetDup(pCache, &key, sizeof(key), &pData), 100);
+  ASSERT_EQ(((char*)pData)[99], 9);
+  free(pData);
+
+  taosLRUCacheRemove(pCache, &key, sizeof(key));
+  ASSERT_EQ(taosLRUCacheGet(pCache, &key, sizeof(key), buf, sizeof(buf)), -1);
+
+  SCacheStatis statis;
+  taosLRUCacheGetStatis(pCache, &statis);
+  ASSERT_EQ(statis.hitCount, 4);
+  ASSERT_EQ(statis.missCount, 3);
+  ASSERT_EQ(statis.totalAccess, 7);
+  ASSERT_EQ(taosLRUCacheGetUsage(pCache), 9 * (sizeof(SLRUNode) + 8 + 100));
+
+  // larger than the capacity
+  char large[2048] = {0};
+  ASSERT_EQ(taosLRUCachePut(pCache, &key, sizeof(key), large, sizeof(large)), -1);
+
+  taosLRUCacheCleanup(pCache);
+}
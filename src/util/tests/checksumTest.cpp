@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "tchecksum.h"
+
+namespace {
+
+double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+// throughput in GB/s of fp over the buffer
+double measure(uint32_t (*fp)(uint32_t, crc_stream, size_t), const uint8_t *buf, size_t len, int loops,
+               uint32_t *pCrc) {
+  uint32_t crc = 0;
+  double   st = getCurTime();
+  for (int i = 0; i < loops; ++i) crc = fp(crc, buf, len);
+  double elapsed = getCurTime() - st;
+
+  *pCrc = crc;
+  return (double)len * loops / elapsed / 1E9;
+}
+
+}  // namespace
+
+TEST(checksumTest, crc32c_test) {
+  const char *str = "123456789";
+  EXPECT_EQ(crc32c_sf(0, (crc_stream)str, strlen(str)), 0xE3069283);
+  EXPECT_EQ(crc32c(0, (crc_stream)str, strlen(str)), 0xE3069283);
+
+  // all the paths of the hardware version: the unaligned head, the 3-way interleaved long and short parts and the tail
+  const size_t SIZE = 3 * 8192 * 4 + 64;
+  uint8_t *    buf = (uint8_t *)malloc(SIZE);
+  for (size_t i = 0; i < SIZE; ++i) buf[i] = (uint8_t)rand();
+
+  size_t lens[] = {0, 1, 7, 8, 9, 255, 3 * 256 - 1, 3 * 256, 3 * 256 + 13, 3 * 8192, 3 * 8192 + 777, 3 * 8192 * 4};
+  for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); ++l) {
+    for (size_t offset = 0; offset < 8; ++offset) {
+      uint32_t expect = crc32c_sf(0, buf + offset, lens[l]);
+      EXPECT_EQ(crc32c(0, buf + offset, lens[l]), expect);
+#ifndef _TD_ARM_
+      EXPECT_EQ(crc32c_hw(0, buf + offset, lens[l]), expect);
+#endif
+    }
+  }
+
+  // the checksum of a buffer equals the one computed part by part
+  uint32_t whole = crc32c(0, buf, SIZE);
+  EXPECT_EQ(crc32c(crc32c(0, buf, 1000), buf + 1000, SIZE - 1000), whole);
+
+  // the checksum appended to a buffer is verified
+  ASSERT_EQ(taosCalcChecksumAppend(0, buf, SIZE), 0);
+  EXPECT_TRUE(taosCheckChecksumWhole(buf, SIZE));
+  buf[100] ^= 1;
+  EXPECT_FALSE(taosCheckChecksumWhole(buf, SIZE));
+
+  free(buf);
+}
+
+TEST(checksumTest, crc32c_throughput) {
+  const size_t SIZE = 16 * 1024 * 1024;
+  uint8_t *    buf = (uint8_t *)malloc(SIZE);
+  for (size_t i = 0; i < SIZE; ++i) buf[i] = (uint8_t)rand();
+
+  // a large buffer like a WAL file, and a small one like a column of a file block
+  size_t sizes[2] = {SIZE, 4096};
+  int    loops[2] = {8, 32768};
+  for (int i = 0; i < 2; ++i) {
+    uint32_t crc[2] = {0};
+    double   sf = measure(crc32c_sf, buf, sizes[i], loops[i], &crc[0]);
+#ifndef _TD_ARM_
+    double hw = measure(crc32c_hw, buf, sizes[i], loops[i], &crc[1]);
+    EXPECT_EQ(crc[0], crc[1]);
+#else
+    double hw = 0;
+#endif
+    printf("crc32c of %zu bytes, software: %.2f GB/s, hardware: %.2f GB/s\n", sizes[i], sf, hw);
+  }
+
+  free(buf);
+}
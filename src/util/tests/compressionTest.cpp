@@ -0,0 +1,371 @@
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <map>
+#include <string>
+
+#include "tscompression.h"
+
+namespace {
+
+const int NUM_OF_VALUES = 4096;
+
+double getCurTime() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1E-6;
+}
+
+// a bytes-transferred counter sampled periodically, reset at a restart
+void genCounter(int64_t *data, int n) {
+  int64_t val = 1234567890123L;
+  for (int i = 0; i < n; ++i) {
+    if (i == n / 3) val = 0;
+    val += 1000 + rand() % 1000;
+    data[i] = val;
+  }
+}
+
+// a gauge like a temperature in 0.1 degree, wandering slowly
+void genGauge(int32_t *data, int n) {
+  int32_t val = 250;
+  for (int i = 0; i < n; ++i) {
+    val += rand() % 7 - 3;
+    data[i] = val;
+  }
+}
+
+template <typename T>
+void checkRoundTrip(const T *data, int n, char type) {
+  char *comp = (char *)malloc(n * sizeof(T) + COMP_OVERFLOW_BYTES);
+  T *   decomp = (T *)malloc(n * sizeof(T));
+
+  int len = tsCompressBitPackImp((const char *)data, n, comp, type);
+  ASSERT_LE(len, (int)(n * sizeof(T)) + 1);
+  ASSERT_EQ(tsDecompressBitPackImp(comp, n, (char *)decomp, type), (int)(n * sizeof(T)));
+  for (int i = 0; i < n; ++i) ASSERT_EQ(decomp[i], data[i]) << "type:" << (int)type << " n:" << n << " i:" << i;
+
+  free(comp);
+  free(decomp);
+}
+
+// compress the data by simple8b and by bit packing, print the ratios and the decompression speed
+void compare(const char *name, const char *data, int n, char type, int bytes) {
+  char *comp = (char *)malloc(n * bytes + COMP_OVERFLOW_BYTES);
+  char *decomp = (char *)malloc(n * bytes);
+  int   loops = 1000;
+
+  int    len[2];
+  double speed[2];
+  for (int c = 0; c < 2; ++c) {
+    len[c] = (c == 0) ? tsCompressINTImp(data, n, comp, type) : tsCompressBitPackImp(data, n, comp, type);
+
+    double st = getCurTime();
+    for (int i = 0; i < loops; ++i) {
+      if (c == 0) {
+        tsDecompressINTImp(comp, n, decomp, type);
+      } else {
+        tsDecompressBitPackImp(comp, n, decomp, type);
+      }
+    }
+    speed[c] = (double)n * loops / (getCurTime() - st) / 1E6;
+    EXPECT_EQ(memcmp(data, decomp, n * bytes), 0);
+  }
+
+  printf("%s, %d values, simple8b: %.2f bytes/value %.1f M values/s, bit packing: %.2f bytes/value %.1f M values/s\n",
+         name, n, (double)len[0] / n, speed[0], (double)len[1] / n, speed[1]);
+
+  free(comp);
+  free(decomp);
+}
+
+// a temperature in 0.1 degree, wandering slowly and repeated from time to time
+void genTemperature(double *data, int n) {
+  int32_t val = 250;
+  for (int i = 0; i < n; ++i) {
+    if (rand() % 4 != 0) val += rand() % 7 - 3;
+    data[i] = val / 10.0;
+  }
+}
+
+// a vibration sampled by a sensor, a sine wave with noise
+void genVibration(double *data, int n) {
+  for (int i = 0; i < n; ++i) data[i] = sin(i * 0.05) * 3.7 + (rand() % 1000) / 1000.0;
+}
+
+template <typename T>
+void checkChimpRoundTrip(const T *data, int n, char type) {
+  char *comp = (char *)malloc(n * sizeof(T) + COMP_OVERFLOW_BYTES);
+  T *   decomp = (T *)malloc(n * sizeof(T));
+
+  int len = tsCompressChimpImp((const char *)data, n, comp, type);
+  ASSERT_LE(len, (int)(n * sizeof(T)) + 1);
+  ASSERT_EQ(tsDecompressChimpImp(comp, len, n, (char *)decomp, type), (int)(n * sizeof(T)));
+  ASSERT_EQ(memcmp(decomp, data, n * sizeof(T)), 0) << "type:" << (int)type << " n:" << n;
+
+  free(comp);
+  free(decomp);
+}
+
+// compress the data by the existing one and by chimp, print the ratios and the decompression speed
+void compareChimp(const char *name, const char *data, int n, char type, int bytes) {
+  char *comp = (char *)malloc(n * bytes + COMP_OVERFLOW_BYTES);
+  char *decomp = (char *)malloc(n * bytes);
+  int   loops = 1000;
+
+  int    len[2];
+  double speed[2];
+  for (int c = 0; c < 2; ++c) {
+    if (c == 0) {
+      len[c] = (type == TSDB_DATA_TYPE_DOUBLE) ? tsCompressDoubleImp(data, n, comp) : tsCompressFloatImp(data, n, comp);
+    } else {
+      len[c] = tsCompressChimpImp(data, n, comp, type);
+    }
+
+    double st = getCurTime();
+    for (int i = 0; i < loops; ++i) {
+      if (c == 1) {
+        tsDecompressChimpImp(comp, len[c], n, decomp, type);
+      } else if (type == TSDB_DATA_TYPE_DOUBLE) {
+        tsDecompressDoubleImp(comp, n, decomp);
+      } else {
+        tsDecompressFloatImp(comp, n, decomp);
+      }
+    }
+    speed[c] = (double)n * bytes * loops / (getCurTime() - st) / 1E9;
+    EXPECT_EQ(memcmp(data, decomp, n * bytes), 0);
+  }
+
+  printf("%s, %d values, one stage: %.2f bytes/value %.2f GB/s, chimp: %.2f bytes/value %.2f GB/s\n", name, n,
+         (double)len[0] / n, speed[0], (double)len[1] / n, speed[1]);
+
+  free(comp);
+  free(decomp);
+}
+
+// the values of a status column in the var data format, one of the numOfDistinct statuses in each row
+int genStatus(char *data, int n, int numOfDistinct) {
+  int len = 0;
+  for (int i = 0; i < n; ++i) {
+    char *value = data + len;
+    int   status = (rand() % 4 == 0) ? rand() % numOfDistinct : 0;  // most of them are the first one
+    varDataLen(value) = sprintf((char *)varDataVal(value), "status-%s-%d", (status == 0) ? "running" : "error", status);
+    len += varDataTLen(value);
+  }
+  return len;
+}
+
+}  // namespace
+
+TEST(compressionTest, bitPackRoundTrip) {
+  int lens[] = {1, 2, 127, 128, 129, 1000, NUM_OF_VALUES};
+
+  int64_t *i64 = (int64_t *)malloc(sizeof(int64_t) * NUM_OF_VALUES);
+  int32_t *i32 = (int32_t *)malloc(sizeof(int32_t) * NUM_OF_VALUES);
+  int16_t *i16 = (int16_t *)malloc(sizeof(int16_t) * NUM_OF_VALUES);
+  int8_t * i8 = (int8_t *)malloc(sizeof(int8_t) * NUM_OF_VALUES);
+
+  for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); ++l) {
+    int n = lens[l];
+
+    // the full range of bigint, which simple8b can not hold
+    for (int i = 0; i < n; ++i) i64[i] = (i % 2 == 0) ? INT64_MIN + i : INT64_MAX - i;
+    checkRoundTrip(i64, n, TSDB_DATA_TYPE_BIGINT);
+
+    // all the bit widths
+    for (int w = 0; w <= 64; ++w) {
+      for (int i = 0; i < n; ++i) {
+        uint64_t r = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+        i64[i] = (int64_t)((w == 64) ? r : (r & ((1ul << w) - 1)));
+      }
+      checkRoundTrip(i64, n, TSDB_DATA_TYPE_BIGINT);
+    }
+
+    genCounter(i64, n);
+    checkRoundTrip(i64, n, TSDB_DATA_TYPE_BIGINT);
+
+    genGauge(i32, n);
+    checkRoundTrip(i32, n, TSDB_DATA_TYPE_INT);
+    for (int i = 0; i < n; ++i) i32[i] = rand() * ((i % 3) ? 1 : -1);
+    checkRoundTrip(i32, n, TSDB_DATA_TYPE_INT);
+
+    for (int i = 0; i < n; ++i) i16[i] = (int16_t)rand();
+    checkRoundTrip(i16, n, TSDB_DATA_TYPE_SMALLINT);
+
+    for (int i = 0; i < n; ++i) i8[i] = (int8_t)(i % 11 - 5);
+    checkRoundTrip(i8, n, TSDB_DATA_TYPE_TINYINT);
+  }
+
+  free(i64);
+  free(i32);
+  free(i16);
+  free(i8);
+}
+
+TEST(compressionTest, bitPackVsSimple8b) {
+  int64_t *counter = (int64_t *)malloc(sizeof(int64_t) * NUM_OF_VALUES);
+  int32_t *gauge = (int32_t *)malloc(sizeof(int32_t) * NUM_OF_VALUES);
+
+  genCounter(counter, NUM_OF_VALUES);
+  genGauge(gauge, NUM_OF_VALUES);
+
+  compare("bigint counter", (const char *)counter, NUM_OF_VALUES, TSDB_DATA_TYPE_BIGINT, sizeof(int64_t));
+  compare("int gauge", (const char *)gauge, NUM_OF_VALUES, TSDB_DATA_TYPE_INT, sizeof(int32_t));
+
+  free(counter);
+  free(gauge);
+}
+
+TEST(compressionTest, chimpRoundTrip) {
+  int lens[] = {1, 2, 3, 127, 1000, NUM_OF_VALUES};
+
+  double *d = (double *)malloc(sizeof(double) * NUM_OF_VALUES);
+  float * f = (float *)malloc(sizeof(float) * NUM_OF_VALUES);
+
+  for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); ++l) {
+    int n = lens[l];
+
+    genTemperature(d, n);
+    for (int i = 0; i < n; ++i) f[i] = (float)d[i];
+    checkChimpRoundTrip(d, n, TSDB_DATA_TYPE_DOUBLE);
+    checkChimpRoundTrip(f, n, TSDB_DATA_TYPE_FLOAT);
+
+    genVibration(d, n);
+    for (int i = 0; i < n; ++i) f[i] = (float)d[i];
+    checkChimpRoundTrip(d, n, TSDB_DATA_TYPE_DOUBLE);
+    checkChimpRoundTrip(f, n, TSDB_DATA_TYPE_FLOAT);
+
+    // the special values and random bits, which falls back to the raw copy
+    double specials[] = {0.0, -0.0, NAN, INFINITY, -INFINITY, 1e-310, 1.0, 1.0, 3.14};
+    for (int i = 0; i < n; ++i) {
+      d[i] = (i % 2) ? specials[i % 9] : (double)rand() / rand();
+      f[i] = (float)d[i];
+    }
+    checkChimpRoundTrip(d, n, TSDB_DATA_TYPE_DOUBLE);
+    checkChimpRoundTrip(f, n, TSDB_DATA_TYPE_FLOAT);
+
+    for (int i = 0; i < n; ++i) {
+      uint64_t r = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+      memcpy(d + i, &r, sizeof(r));
+      memcpy(f + i, &r, sizeof(float));
+    }
+    checkChimpRoundTrip(d, n, TSDB_DATA_TYPE_DOUBLE);
+    checkChimpRoundTrip(f, n, TSDB_DATA_TYPE_FLOAT);
+
+    // a constant
+    for (int i = 0; i < n; ++i) d[i] = 36.6, f[i] = 36.6f;
+    checkChimpRoundTrip(d, n, TSDB_DATA_TYPE_DOUBLE);
+    checkChimpRoundTrip(f, n, TSDB_DATA_TYPE_FLOAT);
+  }
+
+  free(d);
+  free(f);
+}
+
+TEST(compressionTest, chimpVsOneStage) {
+  double *d = (double *)malloc(sizeof(double) * NUM_OF_VALUES);
+  float * f = (float *)malloc(sizeof(float) * NUM_OF_VALUES);
+
+  genTemperature(d, NUM_OF_VALUES);
+  for (int i = 0; i < NUM_OF_VALUES; ++i) f[i] = (float)d[i];
+  compareChimp("double temperature", (const char *)d, NUM_OF_VALUES, TSDB_DATA_TYPE_DOUBLE, sizeof(double));
+  compareChimp("float temperature", (const char *)f, NUM_OF_VALUES, TSDB_DATA_TYPE_FLOAT, sizeof(float));
+
+  genVibration(d, NUM_OF_VALUES);
+  for (int i = 0; i < NUM_OF_VALUES; ++i) f[i] = (float)d[i];
+  compareChimp("double vibration", (const char *)d, NUM_OF_VALUES, TSDB_DATA_TYPE_DOUBLE, sizeof(double));
+  compareChimp("float vibration", (const char *)f, NUM_OF_VALUES, TSDB_DATA_TYPE_FLOAT, sizeof(float));
+
+  free(d);
+  free(f);
+}
+
+TEST(compressionTest, dictRoundTrip) {
+  int   lens[] = {4, 5, 127, 1000, NUM_OF_VALUES};
+  int   distincts[] = {1, 2, 3, 17, 200, DICT_MAX_ENTRIES};
+  char *data = (char *)malloc(NUM_OF_VALUES * 32);
+  char *comp = (char *)malloc(NUM_OF_VALUES * 32);
+  char *decomp = (char *)malloc(NUM_OF_VALUES * 32);
+  uint8_t *codes = (uint8_t *)malloc(NUM_OF_VALUES);
+
+  for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); ++l) {
+    for (size_t d = 0; d < sizeof(distincts) / sizeof(distincts[0]); ++d) {
+      int n = lens[l];
+      int size = genStatus(data, n, distincts[d]);
+      int len = tsCompressDictImp(data, size, n, comp, NUM_OF_VALUES * 32);
+      if (len == 0) continue;  // not worth a dictionary
+
+      ASSERT_LT(len, size);
+      ASSERT_EQ(tsDecompressDictImp(comp, len, n, decomp, NUM_OF_VALUES * 32, codes), size);
+      ASSERT_EQ(memcmp(data, decomp, size), 0) << "n:" << n << " distinct:" << distincts[d];
+
+      // the rows of the same code have the same value
+      char *value = decomp;
+      std::map<int, std::string> values;
+      for (int i = 0; i < n; ++i) {
+        std::string str((char *)varDataVal(value), varDataLen(value));
+        if (values.count(codes[i]) == 0) values[codes[i]] = str;
+        ASSERT_EQ(values[codes[i]], str);
+        value += varDataTLen(value);
+      }
+
+      // a corrupted one is rejected rather than overflowing the output
+      EXPECT_EQ(tsDecompressDictImp(comp, len, n, decomp, size - 1, NULL), -1);
+    }
+  }
+
+  // too many distinct values
+  int size = 0;
+  for (int i = 0; i < NUM_OF_VALUES; ++i) {
+    char *value = data + size;
+    varDataLen(value) = sprintf((char *)varDataVal(value), "%d", i % (DICT_MAX_ENTRIES + 1));
+    size += varDataTLen(value);
+  }
+  EXPECT_EQ(tsCompressDictImp(data, size, NUM_OF_VALUES, comp, NUM_OF_VALUES * 32), 0);
+
+  free(data);
+  free(comp);
+  free(decomp);
+  free(codes);
+}
+
+TEST(compressionTest, dictVsLZ4) {
+  char *data = (char *)malloc(NUM_OF_VALUES * 32);
+  char *comp = (char *)malloc(NUM_OF_VALUES * 32);
+  char *decomp = (char *)malloc(NUM_OF_VALUES * 32);
+  int   loops = 1000;
+
+  int distincts[] = {4, 60};
+  for (int d = 0; d < 2; ++d) {
+    int size = genStatus(data, NUM_OF_VALUES, distincts[d]);
+
+    int    len[2];
+    double speed[2];
+    for (int c = 0; c < 2; ++c) {
+      len[c] = (c == 0) ? tsCompressStringImp(data, size, comp, NUM_OF_VALUES * 32)
+                        : tsCompressDictImp(data, size, NUM_OF_VALUES, comp, NUM_OF_VALUES * 32);
+      ASSERT_GT(len[c], 0);
+
+      double st = getCurTime();
+      for (int i = 0; i < loops; ++i) {
+        if (c == 0) {
+          tsDecompressStringImp(comp, len[c], decomp, NUM_OF_VALUES * 32);
+        } else {
+          tsDecompressDictImp(comp, len[c], NUM_OF_VALUES, decomp, NUM_OF_VALUES * 32, NULL);
+        }
+      }
+      speed[c] = (double)NUM_OF_VALUES * loops / (getCurTime() - st) / 1E6;
+      EXPECT_EQ(memcmp(data, decomp, size), 0);
+    }
+
+    printf("status of %d distinct values, %d values, lz4: %.2f bytes/value %.1f M values/s, dictionary: %.2f "
+           "bytes/value %.1f M values/s\n",
+           distincts[d], NUM_OF_VALUES, (double)len[0] / NUM_OF_VALUES, speed[0], (double)len[1] / NUM_OF_VALUES,
+           speed[1]);
+  }
+
+  free(data);
+  free(comp);
+  free(decomp);
+}
@@ -379,6 +379,32 @@ void vnodeBuildStatusMsg(void *param) {
   taosHashDestroyIter(pIter);
 }
 
+void vnodeGetCommitStat(STsdbCommitStat *pStat) {
+  SHashMutableIterator *pIter = taosHashCreateIter(tsDnodeVnodesHash);
+  memset(pStat, 0, sizeof(STsdbCommitStat));
+
+  while (taosHashIterNext(pIter)) {
+    SVnodeObj **pVnode = taosHashIterGet(pIter);
+    if (pVnode == NULL) continue;
+    if (*pVnode == NULL) continue;
+    if ((*pVnode)->status != TAOS_VN_STATUS_READY || (*pVnode)->tsdb == NULL) continue;
+
+    STsdbCommitStat stat;
+    tsdbGetCommitStat((*pVnode)->tsdb, &stat);
+    pStat->numOfCommits += stat.numOfCommits;
+    pStat->numOfFGroups += stat.numOfFGroups;
+    pStat->numOfRows += stat.numOfRows;
+    pStat->totalCommitUs += stat.totalCommitUs;
+    pStat->lastCommitUs = MAX(pStat->lastCommitUs, stat.lastCommitUs);
+    pStat->lastCommitRows = MAX(pStat->lastCommitRows, stat.lastCommitRows);
+    for (int i = 0; i < TSDB_COMP_ALGORITHMS; i++) {
+      pStat->numOfColsByAlgorithm[i] += stat.numOfColsByAlgorithm[i];
+    }
+  }
+
+  taosHashDestroyIter(pIter);
+}
+
 static void vnodeCleanUp(SVnodeObj *pVnode) {
   taosHashRemove(tsDnodeVnodesHash, (const char *)&pVnode->vgId, sizeof(int32_t));
 
@@ -643,6 +669,7 @@ static int32_t vnodeReadCfg(SVnodeObj *pVnode) {
   }
   pVnode->walCfg.wals = (int8_t)wals->valueint;
   pVnode->walCfg.keep = 0;
+  pVnode->walCfg.segSize = tsWalSegmentSize * 1024 * 1024;
 
   cJSON *replica = cJSON_GetObjectItem(root, "replica");
   if (!replica || replica->type != cJSON_Number) {
@@ -95,6 +95,7 @@ static int32_t vnodeProcessSubmitMsg(SVnodeObj *pVnode, void *pCont, SRspRet *pR
   pRet->rsp = rpcMallocCont(pRet->len);
   SShellSubmitRspMsg *pRsp = pRet->rsp;
   code = tsdbInsertData(pVnode->tsdb, pCont, pRsp);
+  if (code == TSDB_CODE_SUCCESS) cqProcessSubmit(pVnode->cq, pCont);
   pRsp->numOfFailedBlocks = 0; //TODO
   //pRet->len += pRsp->numOfFailedBlocks * sizeof(SShellSubmitRspBlock); //TODO
   pRsp->code              = 0;
@@ -20,6 +20,7 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <fcntl.h> 
+#include <sys/uio.h>
 
 #include "os.h"
 #include "tlog.h"
@@ -27,8 +28,13 @@
 #include "tutil.h"
 #include "twal.h"
 #include "tqueue.h"
+#include "ttime.h"
 
 #define walPrefix "wal"
+#define walBufferSize (256 * 1024)  // records are gathered here and written to the file in one call
+#define walReadBlockSize (2 * 1024 * 1024)  // records are handed from the reader thread in blocks of this size
+#define walReadBlocks 4
+#define walMaxRecordSize 1024000
 #define wError(...) if (wDebugFlag & DEBUG_ERROR) {taosPrintLog("ERROR WAL ", wDebugFlag, __VA_ARGS__);}
 #define wWarn(...) if (wDebugFlag & DEBUG_WARN) {taosPrintLog("WARN WAL ", wDebugFlag, __VA_ARGS__);}
 #define wTrace(...) if (wDebugFlag & DEBUG_TRACE) {taosPrintLog("WAL ", wDebugFlag, __VA_ARGS__);}
@@ -44,15 +50,40 @@ typedef struct {
   int      num;  // number of wal files
   char     path[TSDB_FILENAME_LEN];
   char     name[TSDB_FILENAME_LEN];
+  char    *buffer;   // records written but not flushed into the file yet
+  int32_t  bufLen;
+  int32_t  segSize;  // size of pre-allocated files, 0 for files growing with writes
+  int64_t  offset;   // end of the records written into the file, the next flush writes at it
   pthread_mutex_t mutex;
 } SWal;
 
+// a WAL file is read and verified by a reader thread ahead of the thread applying the records
+typedef struct {
+  char    *data;
+  int32_t  len;
+  int32_t  numOfRecords;
+} SWalReadBlock;
+
+typedef struct {
+  const char     *name;
+  FILE           *fp;
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  int32_t         first;  // the first filled block
+  int32_t         numOfFilled;
+  bool            over;   // no more block will be filled
+  uint64_t        version;  // version of the last record read, records shall have increasing versions
+  int64_t         offset;   // end of the valid records in file
+  SWalReadBlock   blocks[walReadBlocks];
+} SWalReader;
+
 int wDebugFlag = 135;
 
 static uint32_t walSignature = 0xFAFBFDFE;
 static int walHandleExistingFiles(const char *path);
-static int walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp);
+static int walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp, uint64_t *version, int64_t *numOfRecords);
 static int walRemoveWalFiles(const char *path);
+static int walFlushBuffer(SWal *pWal, SWalHead *pHead);
 
 void *walOpen(const char *path, const SWalCfg *pCfg) {
   SWal *pWal = calloc(sizeof(SWal), 1);
@@ -64,9 +95,17 @@ void *walOpen(const char *path, const SWalCfg *pCfg) {
   pWal->num = 0;
   pWal->level = pCfg->walLevel;
   pWal->keep = pCfg->keep;
+  pWal->segSize = pCfg->segSize;
   strcpy(pWal->path, path);
   pthread_mutex_init(&pWal->mutex, NULL);
 
+  pWal->buffer = malloc(walBufferSize);
+  if (pWal->buffer == NULL) {
+    pthread_mutex_destroy(&pWal->mutex);
+    free(pWal);
+    return NULL;
+  }
+
   if (access(path, F_OK) != 0) mkdir(path, 0755);
   
   if (pCfg->keep == 1) return pWal;
@@ -77,6 +116,7 @@ void *walOpen(const char *path, const SWalCfg *pCfg) {
   if (pWal->fd <0) {
     wError("wal:%s, failed to open", path);
     pthread_mutex_destroy(&pWal->mutex);
+    free(pWal->buffer);
     free(pWal);
     pWal = NULL;
   } else {
@@ -90,6 +130,7 @@ void walClose(void *handle) {
   if (handle == NULL) return;
   
   SWal *pWal = handle;  
+  if (walFlushBuffer(pWal, NULL) < 0) wError("wal:%s, %d bytes are lost on close", pWal->name, pWal->bufLen);
   close(pWal->fd);
 
   if (pWal->keep == 0) {
@@ -108,6 +149,7 @@ void walClose(void *handle) {
 
   pthread_mutex_destroy(&pWal->mutex);
 
+  free(pWal->buffer);
   free(pWal);
 }
 
@@ -118,6 +160,8 @@ int walRenew(void *handle) {
   pthread_mutex_lock(&pWal->mutex);
 
   if (pWal->fd >=0) {
+    // records failed to be written are kept in the buffer and go into the new file
+    if (walFlushBuffer(pWal, NULL) < 0) wError("wal:%s, %d bytes are moved to the next file", pWal->name, pWal->bufLen);
     close(pWal->fd);
     pWal->id++;
     wTrace("wal:%s, it is closed", pWal->name);
@@ -126,7 +170,22 @@ int walRenew(void *handle) {
   pWal->num++;
 
   sprintf(pWal->name, "%s/%s%d", pWal->path, walPrefix, pWal->id);
+
+  if (pWal->segSize > 0 && pWal->num > pWal->max) {
+    // recycle the oldest wal file, its blocks are allocated already. The stale records left in it
+    // are detected by the version during restore
+    char name[TSDB_FILENAME_LEN * 3];
+    sprintf(name, "%s/%s%d", pWal->path, walPrefix, pWal->id - pWal->max);
+    if (rename(name, pWal->name) < 0) {
+      wError("wal:%s, failed to recycle to %s(%s)", name, pWal->name, strerror(errno));
+    } else {
+      wTrace("wal:%s, it is recycled to %s", name, pWal->name);
+      pWal->num--;
+    }
+  }
+
   pWal->fd = open(pWal->name, O_WRONLY | O_CREAT, S_IRWXU | S_IRWXG | S_IRWXO);
+  pWal->offset = 0;
 
   if (pWal->fd < 0) {
     wError("wal:%d, failed to open(%s)", pWal->name, strerror(errno));
@@ -134,6 +193,12 @@ int walRenew(void *handle) {
   } else {
     wTrace("wal:%s, it is created", pWal->name);
 
+    // allocate the segment up front, so writes neither allocate blocks nor change the file size
+    if (pWal->segSize > 0) {
+      int ret = posix_fallocate(pWal->fd, 0, pWal->segSize);
+      if (ret != 0) wWarn("wal:%s, failed to allocate %d bytes(%s)", pWal->name, pWal->segSize, strerror(ret));
+    }
+
     if (pWal->num > pWal->max) {
       // remove the oldest wal file
       char name[TSDB_FILENAME_LEN * 3];
@@ -165,25 +230,43 @@ int walWrite(void *handle, SWalHead *pHead) {
   taosCalcChecksumAppend(0, (uint8_t *)pHead, sizeof(SWalHead));
   int contLen = pHead->len + sizeof(SWalHead);
 
-  if(write(pWal->fd, pHead, contLen) != contLen) {
-    wError("wal:%s, failed to write(%s)", pWal->name, strerror(errno));
-    code = -1;
+  // the record is copied since the caller may modify the message after it is written into WAL
+  pthread_mutex_lock(&pWal->mutex);
+
+  if (pWal->bufLen + contLen <= walBufferSize) {
+    memcpy(pWal->buffer + pWal->bufLen, pHead, contLen);
+    pWal->bufLen += contLen;
   } else {
-    pWal->version = pHead->version;
+    code = walFlushBuffer(pWal, pHead);
   }
 
+  if (code == 0) pWal->version = pHead->version;
+
+  pthread_mutex_unlock(&pWal->mutex);
+
   return code;
 }
 
-void walFsync(void *handle) {
-
+int walFsync(void *handle) {
   SWal *pWal = handle;
+  int   code = 0;
+
+  if (pWal == NULL || pWal->level == TAOS_WAL_NOLOG) return 0;
+
+  pthread_mutex_lock(&pWal->mutex);
+  code = walFlushBuffer(pWal, NULL);
+  pthread_mutex_unlock(&pWal->mutex);
 
-  if (pWal->level == TAOS_WAL_FSYNC && pWal->fd >=0) {
-    if (fsync(pWal->fd) < 0) {
+  if (code == 0 && pWal->level == TAOS_WAL_FSYNC && pWal->fd >=0) {
+    // the size of a pre-allocated file does not change, so its metadata need not be flushed
+    int ret = (pWal->segSize > 0) ? fdatasync(pWal->fd) : fsync(pWal->fd);
+    if (ret < 0) {
       wError("wal:%s, fsync failed(%s)", pWal->name, strerror(errno));
+      code = -1;
     }
   }
+
+  return code;
 }
 
 int walRestore(void *handle, void *pVnode, int (*writeFp)(void *, void *, int)) {
@@ -192,6 +275,8 @@ int walRestore(void *handle, void *pVnode, int (*writeFp)(void *, void *, int))
   struct   dirent *ent;
   int      count = 0;
   uint32_t maxId = 0, minId = -1, index =0;
+  int64_t  numOfRecords = 0;
+  uint64_t version = 0;
 
   int   plen = strlen(walPrefix);
   char  opath[TSDB_FILENAME_LEN+5];
@@ -225,14 +310,24 @@ int walRestore(void *handle, void *pVnode, int (*writeFp)(void *, void *, int))
     code = -1;
   } else {
     wTrace("wal:%s, %d files will be restored", opath, count);
+    int64_t start = taosGetTimestampMs();
 
     for (index = minId; index<=maxId; ++index) {
       sprintf(pWal->name, "%s/%s%d", opath, walPrefix, index);
-      code = walRestoreWalFile(pWal, pVnode, writeFp);
+      code = walRestoreWalFile(pWal, pVnode, writeFp, &version, &numOfRecords);
       if (code < 0) break;
     }
+
+    int64_t elapsed = taosGetTimestampMs() - start;
+    wPrint("wal:%s, %d files %" PRId64 " records are restored in %" PRId64 " ms, %.0f records/s", opath, count,
+           numOfRecords, elapsed, (elapsed > 0) ? numOfRecords * 1000.0 / elapsed : (double)numOfRecords);
   }
 
+  // a writeFp writing the records synchronously, as the sdb does, has them in the new WAL now, so they are made
+  // durable before the old files are removed. The vnode only queues them, they are written by its write workers
+  // later and the old files do not wait for that
+  if (code == 0) code = walFsync(pWal);
+
   if (code == 0) {
     if (pWal->keep == 0) {
       code = walRemoveWalFiles(opath);
@@ -243,14 +338,18 @@ int walRestore(void *handle, void *pVnode, int (*writeFp)(void *, void *, int))
         }
       }
     } else { 
-      // open the existing WAL file in append mode
+      // open the existing WAL file, new records are written after its last valid record
       pWal->num = count;
       pWal->id = maxId;
       sprintf(pWal->name, "%s/%s%d", opath, walPrefix, maxId);
-      pWal->fd = open(pWal->name, O_WRONLY | O_CREAT | O_APPEND, S_IRWXU | S_IRWXG | S_IRWXO);
+      pWal->fd = open(pWal->name, O_WRONLY | O_CREAT, S_IRWXU | S_IRWXG | S_IRWXO);
       if (pWal->fd < 0) {
         wError("wal:%s, failed to open file(%s)", pWal->name, strerror(errno));
         code = -1;
+      } else if (pWal->segSize == 0 && ftruncate(pWal->fd, pWal->offset) < 0) {
+        // a torn record after the last valid one would be left behind the new records
+        wError("wal:%s, failed to truncate to %" PRId64 "(%s)", pWal->name, pWal->offset, strerror(errno));
+        code = -1;
       }
     }
   }
@@ -283,50 +382,159 @@ int walGetWalFile(void *handle, char *name, uint32_t *index) {
   return code;
 }  
 
-static int walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp) {
-  int   code = 0;
-  char *name = pWal->name;
+// read records into the free blocks until the end of file or a broken record
+static void *walReadWalFile(void *param) {
+  SWalReader *pReader = param;
+  const char *name = pReader->name;
+  bool        over = false;
+
+  while (!over) {
+    pthread_mutex_lock(&pReader->mutex);
+    while (pReader->numOfFilled == walReadBlocks) pthread_cond_wait(&pReader->cond, &pReader->mutex);
+    SWalReadBlock *pBlock = pReader->blocks + (pReader->first + pReader->numOfFilled) % walReadBlocks;
+    pthread_mutex_unlock(&pReader->mutex);
+
+    pBlock->len = 0;
+    pBlock->numOfRecords = 0;
+
+    while (1) {
+      // the head is read into the block, it is kept only if the whole record fits
+      if (pBlock->len + sizeof(SWalHead) > walReadBlockSize) break;
+      SWalHead *pHead = (SWalHead *)(pBlock->data + pBlock->len);
+
+      size_t ret = fread(pHead, 1, sizeof(SWalHead), pReader->fp);
+      if (ret == 0) { over = true; break; }
+
+      if (ret != sizeof(SWalHead)) {
+        wWarn("wal:%s, failed to read head, skip, ret:%d(%s)", name, (int)ret, strerror(errno));
+        over = true;
+        break;
+      }
+
+      // zeros after the last record of a pre-allocated file
+      if (pHead->signature == 0) { over = true; break; }
 
-  char *buffer = malloc(1024000);  // size for one record
-  if (buffer == NULL) return -1;
+      // only the head carries a checksum, walWrite does not cover the body with it
+      if (!taosCheckChecksumWhole((uint8_t *)pHead, sizeof(SWalHead))) {
+        wWarn("wal:%s, cksum is messed up, skip the rest of file", name);
+        over = true;
+        break;
+      }
+
+      // stale records left in a recycled file
+      if (pHead->version <= pReader->version) {
+        wTrace("wal:%s, version:%" PRIu64 " is not after %" PRIu64 ", end of file", name, pHead->version,
+               pReader->version);
+        over = true;
+        break;
+      }
 
-  SWalHead *pHead = (SWalHead *)buffer;
+      if (pHead->len < 0 || pHead->len > walMaxRecordSize - (int32_t)sizeof(SWalHead)) {
+        wWarn("wal:%s, invalid record length:%d, skip the rest of file", name, pHead->len);
+        over = true;
+        break;
+      }
+
+      if (pBlock->len + sizeof(SWalHead) + pHead->len > walReadBlockSize) {
+        // no room for the body, move the record to the next block
+        fseek(pReader->fp, -(long)sizeof(SWalHead), SEEK_CUR);
+        break;
+      }
+
+      ret = fread(pHead->cont, 1, pHead->len, pReader->fp);
+      if (ret != pHead->len) {
+        wWarn("wal:%s, failed to read body, skip, len:%d ret:%d", name, pHead->len, (int)ret);
+        over = true;
+        break;
+      }
 
-  int fd = open(name, O_RDONLY);
-  if (fd < 0) {
+      pBlock->len += sizeof(SWalHead) + pHead->len;
+      pBlock->numOfRecords++;
+      pReader->version = pHead->version;
+      pReader->offset += sizeof(SWalHead) + pHead->len;
+    }
+
+    pthread_mutex_lock(&pReader->mutex);
+    pReader->numOfFilled++;
+    pReader->over = over;
+    pthread_cond_broadcast(&pReader->cond);
+    pthread_mutex_unlock(&pReader->mutex);
+  }
+
+  return NULL;
+}
+
+static int walRestoreWalFile(SWal *pWal, void *pVnode, FWalWrite writeFp, uint64_t *version, int64_t *numOfRecords) {
+  int        code = 0;
+  char      *name = pWal->name;
+  SWalReader reader = {0};
+  pthread_t  thread;
+
+  reader.name = name;
+  reader.version = *version;
+  reader.fp = fopen(name, "r");
+  if (reader.fp == NULL) {
     wError("wal:%s, failed to open for restore(%s)", name, strerror(errno));
-    free(buffer);
     return -1;
   }
 
-  wTrace("wal:%s, start to restore", name);
+  // read ahead in large chunks, the reader thread runs ahead of the callback
+  setvbuf(reader.fp, NULL, _IOFBF, walReadBlockSize);
+  posix_fadvise(fileno(reader.fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+  pthread_mutex_init(&reader.mutex, NULL);
+  pthread_cond_init(&reader.cond, NULL);
 
-  while (1) {
-    int ret = read(fd, pHead, sizeof(SWalHead));
-    if ( ret == 0) { code = 0; break;}  
+  for (int i = 0; i < walReadBlocks; ++i) {
+    reader.blocks[i].data = malloc(walReadBlockSize);
+    if (reader.blocks[i].data == NULL) code = -1;
+  }
 
-    if (ret != sizeof(SWalHead)) {
-      wWarn("wal:%s, failed to read head, skip, ret:%d(%s)", name, ret, strerror(errno));
-      break;
+  if (code == 0) {
+    if (pthread_create(&thread, NULL, walReadWalFile, &reader) != 0) {
+      wError("wal:%s, failed to create reader thread(%s)", name, strerror(errno));
+      code = -1;
     }
+  }
 
-    if (!taosCheckChecksumWhole((uint8_t *)pHead, sizeof(SWalHead))) {
-      wWarn("wal:%s, cksum is messed up, skip the rest of file", name);
-      break;
-    } 
+  if (code == 0) {
+    wTrace("wal:%s, start to restore", name);
+
+    while (1) {
+      pthread_mutex_lock(&reader.mutex);
+      while (reader.numOfFilled == 0 && !reader.over) pthread_cond_wait(&reader.cond, &reader.mutex);
+      if (reader.numOfFilled == 0) {
+        pthread_mutex_unlock(&reader.mutex);
+        break;
+      }
+      SWalReadBlock *pBlock = reader.blocks + reader.first;
+      pthread_mutex_unlock(&reader.mutex);
 
-    ret = read(fd, pHead->cont, pHead->len);
-    if ( ret != pHead->len) {
-      wWarn("wal:%s, failed to read body, skip, len:%d ret:%d", name, pHead->len, ret);
-      break;
+      char *ptr = pBlock->data;
+      for (int i = 0; i < pBlock->numOfRecords; ++i) {
+        SWalHead *pHead = (SWalHead *)ptr;
+        ptr += sizeof(SWalHead) + pHead->len;
+
+        if (pWal->keep) pWal->version = pHead->version;
+        (*writeFp)(pVnode, pHead, TAOS_QTYPE_WAL);
+      }
+      *numOfRecords += pBlock->numOfRecords;
+
+      pthread_mutex_lock(&reader.mutex);
+      reader.first = (reader.first + 1) % walReadBlocks;
+      reader.numOfFilled--;
+      pthread_cond_broadcast(&reader.cond);
+      pthread_mutex_unlock(&reader.mutex);
     }
 
-    if (pWal->keep) pWal->version = pHead->version;
-    (*writeFp)(pVnode, pHead, TAOS_QTYPE_WAL);
+    pthread_join(thread, NULL);
+    *version = reader.version;
+    if (pWal->keep) pWal->offset = reader.offset;
   }
 
-  close(fd);
-  free(buffer);
+  pthread_cond_destroy(&reader.cond);
+  pthread_mutex_destroy(&reader.mutex);
+  for (int i = 0; i < walReadBlocks; ++i) free(reader.blocks[i].data);
+  fclose(reader.fp);
 
   return code;
 }
@@ -398,3 +606,78 @@ static int walRemoveWalFiles(const char *path) {
   return code;
 }
 
+
+// write the buffered records and the record pHead, if any, into the file with one call. The buffer is
+// cleared only once its records are written, they have been accepted by walWrite already
+static int walFlushBuffer(SWal *pWal, SWalHead *pHead) {
+  struct iovec iov[2];
+  int          iovcnt = 0;
+  ssize_t      total = 0;
+
+  if (pWal->bufLen > 0) {
+    iov[iovcnt].iov_base = pWal->buffer;
+    iov[iovcnt].iov_len = pWal->bufLen;
+    total += pWal->bufLen;
+    iovcnt++;
+  }
+
+  if (pHead) {
+    iov[iovcnt].iov_base = pHead;
+    iov[iovcnt].iov_len = pHead->len + sizeof(SWalHead);
+    total += iov[iovcnt].iov_len;
+    iovcnt++;
+  }
+
+  if (iovcnt == 0) return 0;
+
+  if (pWal->fd < 0) {
+    wError("wal:%s, %" PRId64 " bytes are pending but no file is open", pWal->name, (int64_t)total);
+    return -1;
+  }
+
+  struct iovec *pIov = iov;
+  ssize_t       written = 0;
+  while (written < total) {
+    // written at the position following the last record, a pre-allocated file is not written at its end
+    ssize_t ret = pwritev(pWal->fd, pIov, iovcnt, pWal->offset);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      wError("wal:%s, failed to write at %" PRId64 "(%s)", pWal->name, pWal->offset, strerror(errno));
+      break;
+    }
+    if (ret == 0) {
+      wError("wal:%s, no bytes are written at %" PRId64, pWal->name, pWal->offset);
+      break;
+    }
+
+    written += ret;
+    pWal->offset += ret;
+    while (iovcnt > 0 && (size_t)ret >= pIov->iov_len) {
+      ret -= pIov->iov_len;
+      pIov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      pIov->iov_base = (char *)pIov->iov_base + ret;
+      pIov->iov_len -= ret;
+    }
+  }
+
+  // keep the buffered records not written yet, so a later flush retries them
+  int32_t bufWritten = (int32_t)MIN(written, (ssize_t)pWal->bufLen);
+  if (bufWritten > 0 && bufWritten < pWal->bufLen) {
+    memmove(pWal->buffer, pWal->buffer + bufWritten, pWal->bufLen - bufWritten);
+  }
+  pWal->bufLen -= bufWritten;
+
+  // a record written partially fails in walWrite, its bytes are overwritten by the following records, and cut off
+  // a growing file so that they are not left behind its last record
+  if (written < total && written > bufWritten) {
+    pWal->offset -= (int64_t)(written - bufWritten);
+    if (pWal->segSize == 0 && ftruncate(pWal->fd, pWal->offset) < 0) {
+      wError("wal:%s, failed to truncate to %" PRId64 "(%s)", pWal->name, pWal->offset, strerror(errno));
+    }
+  }
+
+  return (written == total) ? 0 : -1;
+}
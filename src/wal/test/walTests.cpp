@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <vector>
+
+#include "os.h"
+#include "twal.h"
+
+namespace {
+
+#define WAL_TEST_DIR "/tmp/wal_test"
+
+const int RECORD_LEN = 1000;
+const int LARGE_RECORD_LEN = 512 * 1024;  // larger than the buffer, written with the buffered records
+
+std::vector<uint64_t> restored;
+
+int collectRecord(void *pVnode, void *data, int type) {
+  restored.push_back(((SWalHead *)data)->version);
+  return 0;
+}
+
+int writeRecord(twalh pWal, uint64_t version, int len = RECORD_LEN) {
+  std::vector<char> buf(sizeof(SWalHead) + len);
+  SWalHead *        pHead = (SWalHead *)buf.data();
+  pHead->msgType = 1;
+  pHead->len = len;
+  pHead->version = version;
+  memset(pHead->cont, (int)version, len);
+  return walWrite(pWal, pHead);
+}
+
+// open the kept WAL in the directory, and restore its records
+twalh openAndRestore() {
+  SWalCfg cfg = {.walLevel = TAOS_WAL_FSYNC, .wals = 3, .keep = 1, .segSize = 0};
+  twalh   pWal = walOpen(WAL_TEST_DIR, &cfg);
+  if (pWal == NULL) return NULL;
+
+  restored.clear();
+  if (walRestore(pWal, NULL, collectRecord) != 0) {
+    walClose(pWal);
+    return NULL;
+  }
+  return pWal;
+}
+
+int64_t fileSize(const char *name) {
+  struct stat st;
+  return (stat(name, &st) < 0) ? -1 : (int64_t)st.st_size;
+}
+
+}  // namespace
+
+TEST(WalTest, restoreAfterShortWrite) {
+  char cmd[128];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", WAL_TEST_DIR);
+  system(cmd);
+
+  // the file reopened by the restore is written after the short write
+  twalh pWal = openAndRestore();
+  ASSERT_NE(pWal, nullptr);
+  for (uint64_t v = 1; v <= 10; ++v) ASSERT_EQ(writeRecord(pWal, v), 0);
+  ASSERT_EQ(walFsync(pWal), 0);
+  walClose(pWal);
+
+  pWal = openAndRestore();
+  ASSERT_NE(pWal, nullptr);
+  ASSERT_EQ(restored.size(), 10u);
+
+  char name[128];
+  snprintf(name, sizeof(name), "%s/wal0", WAL_TEST_DIR);
+  int64_t size = fileSize(name);
+  ASSERT_EQ(size, 10 * (int64_t)(sizeof(SWalHead) + RECORD_LEN));
+
+  // the file size limit cuts the large record in the middle, after the buffered one
+  struct rlimit limit, old;
+  ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &old), 0);
+  signal(SIGXFSZ, SIG_IGN);
+  limit = old;
+  limit.rlim_cur = size + sizeof(SWalHead) + RECORD_LEN + LARGE_RECORD_LEN / 2;
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &limit), 0);
+
+  ASSERT_EQ(writeRecord(pWal, 11), 0);
+  EXPECT_LT(writeRecord(pWal, 12, LARGE_RECORD_LEN), 0);
+  ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &old), 0);
+
+  // the torn record is cut off, the following records are written after the last whole one
+  EXPECT_EQ(fileSize(name), size + (int64_t)(sizeof(SWalHead) + RECORD_LEN));
+  for (uint64_t v = 13; v <= 20; ++v) ASSERT_EQ(writeRecord(pWal, v), 0);
+  ASSERT_EQ(walFsync(pWal), 0);
+  walClose(pWal);
+
+  pWal = openAndRestore();
+  ASSERT_NE(pWal, nullptr);
+  ASSERT_EQ(restored.size(), 19u);
+  for (size_t i = 0; i < restored.size(); ++i) EXPECT_EQ(restored[i], (i < 11) ? i + 1 : i + 2);
+  walClose(pWal);
+}
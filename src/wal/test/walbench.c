@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2019 TAOS Data, Inc. <jhtao@taosdata.com>
+ *
+ * This program is free software: you can use, redistribute, and/or modify
+ * it under the terms of the GNU Affero General Public License, version 3
+ * or later ("AGPL"), as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//#define _DEFAULT_SOURCE
+#include "os.h"
+#include "tglobal.h"
+#include "tlog.h"
+#include "ttime.h"
+#include "twal.h"
+
+// write rows of records, walFsync is called after every batch of records, just like a write worker
+// does after draining a queue. Returns the records written per second
+static double walBench(void *pWal, SWalHead *pHead, int64_t *ver, int rows, int size, int batch) {
+  int64_t start = taosGetTimestampUs();
+
+  for (int k = 0; k < rows; ++k) {
+    pHead->version = ++(*ver);
+    pHead->len = size;
+    if (walWrite(pWal, pHead) < 0) {
+      printf("failed to write wal\n");
+      exit(-1);
+    }
+
+    if ((k + 1) % batch == 0) walFsync(pWal);
+  }
+  walFsync(pWal);
+
+  int64_t elapsed = taosGetTimestampUs() - start;
+  return (elapsed > 0) ? rows * 1000000.0 / elapsed : 0;
+}
+
+static int compareLatency(const void *p1, const void *p2) {
+  int64_t l1 = *(const int64_t *)p1, l2 = *(const int64_t *)p2;
+  return (l1 < l2) ? -1 : ((l1 > l2) ? 1 : 0);
+}
+
+// each record is written and synced on its own. Files are renewed after every rows of records, the
+// latency is measured in the last round, when pre-allocated files have been recycled
+static void walFsyncBench(const char *path, int32_t segSize, int rows, int size) {
+  SWalCfg walCfg;
+  walCfg.walLevel = TAOS_WAL_FSYNC;
+  walCfg.wals = 2;
+  walCfg.keep = 0;
+  walCfg.segSize = segSize;
+
+  void *pWal = walOpen(path, &walCfg);
+  if (pWal == NULL) {
+    printf("failed to open wal\n");
+    exit(-1);
+  }
+
+  SWalHead *pHead = (SWalHead *)calloc(1, sizeof(SWalHead) + size);
+  int64_t  *latency = (int64_t *)malloc(sizeof(int64_t) * rows);
+  int64_t   ver = 0, total = 0;
+  int       rounds = walCfg.wals + 2;
+
+  for (int r = 0; r < rounds; ++r) {
+    for (int k = 0; k < rows; ++k) {
+      pHead->version = ++ver;
+      pHead->len = size;
+      int64_t start = taosGetTimestampUs();
+      walWrite(pWal, pHead);
+      walFsync(pWal);
+      latency[k] = taosGetTimestampUs() - start;
+    }
+    if (r < rounds - 1) walRenew(pWal);
+  }
+
+  for (int k = 0; k < rows; ++k) total += latency[k];
+  qsort(latency, rows, sizeof(int64_t), compareLatency);
+  printf("  segment:%4dMB fsync latency avg:%8.1fus p50:%6" PRId64 "us p99:%6" PRId64 "us max:%6" PRId64 "us\n",
+         segSize / (1024 * 1024), (double)total / rows, latency[rows / 2], latency[rows * 99 / 100], latency[rows - 1]);
+
+  free(latency);
+  free(pHead);
+  walClose(pWal);
+}
+
+int main(int argc, char *argv[]) {
+  char    path[128] = "/tmp/walbench";
+  int     level = 2;
+  int     rows = 10000;
+  int     size = 128;
+  int     batch = 100;
+  int     segSize = -1;
+  int64_t ver = 0;
+
+  for (int i=1; i<argc; ++i) {
+    if (strcmp(argv[i], "-p")==0 && i < argc-1) {
+      strcpy(path, argv[++i]);
+    } else if (strcmp(argv[i], "-l")==0 && i < argc-1) {
+      level = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-r")==0 && i < argc-1) {
+      rows = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-s")==0 && i < argc-1) {
+      size = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-b")==0 && i < argc-1) {
+      batch = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-g")==0 && i < argc-1) {
+      segSize = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-d")==0 && i < argc-1) {
+      wDebugFlag = uDebugFlag = atoi(argv[++i]);
+    } else {
+      printf("\nusage: %s [options] \n", argv[0]);
+      printf("  [-p path]: wal file path default is:%s\n", path);
+      printf("  [-l level]: wal level, default is:%d\n", level);
+      printf("  [-r rows]: rows of records to write, default is:%d\n", rows);
+      printf("  [-s size]: size of each record, default is:%d\n", size);
+      printf("  [-b batch]: records written between two walFsync calls, default is:%d\n", batch);
+      printf("  [-g segSize]: compare the fsync latency of growing files and segments of segSize MB\n");
+      printf("  [-d debugFlag]: debug flag, default:%d\n", wDebugFlag);
+      printf("  [-h help]: print out this help\n\n");
+      exit(0);
+    }
+  }
+
+  if (batch <= 0) batch = 1;
+
+  taosInitLog("walbench.log", 100000, 10);
+
+  if (segSize > 0) {
+    printf("record size:%d, rows per file:%d\n", size, rows);
+    walFsyncBench(path, 0, rows, size);
+    walFsyncBench(path, segSize * 1024 * 1024, rows, size);
+    return 0;
+  }
+
+  SWalCfg walCfg;
+  walCfg.walLevel = level;
+  walCfg.wals = 3;
+  walCfg.keep = 0;
+  walCfg.segSize = 0;
+
+  void *pWal = walOpen(path, &walCfg);
+  if (pWal == NULL) {
+    printf("failed to open wal\n");
+    exit(-1);
+  }
+
+  SWalHead *pHead = (SWalHead *)calloc(1, sizeof(SWalHead) + size);
+
+  // one record per batch is how the WAL was written before records were gathered
+  double single = walBench(pWal, pHead, &ver, rows, size, 1);
+  walRenew(pWal);
+  double batched = walBench(pWal, pHead, &ver, rows, size, batch);
+
+  double mb = (sizeof(SWalHead) + size) / (1024.0 * 1024.0);
+  printf("level:%d, record size:%d\n", level, size);
+  printf("  batch:%-6d %12.0f records/s %10.2f MB/s\n", 1, single, single * mb);
+  printf("  batch:%-6d %12.0f records/s %10.2f MB/s\n", batch, batched, batched * mb);
+
+  free(pHead);
+  walClose(pWal);
+
+  return 0;
+}
@@ -42,6 +42,7 @@ int main(int argc, char *argv[]) {
   int  rows = 10000;
   int  size = 128;
   int  keep = 0;
+  int  segSize = 0;
 
   for (int i=1; i<argc; ++i) {
     if (strcmp(argv[i], "-p")==0 && i < argc-1) {
@@ -58,6 +59,8 @@ int main(int argc, char *argv[]) {
       total = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-s")==0 && i < argc-1) {
       size = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-g")==0 && i < argc-1) {
+      segSize = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-v")==0 && i < argc-1) {
       ver = atoll(argv[++i]);
     } else if (strcmp(argv[i], "-d")==0 && i < argc-1) {
@@ -70,6 +73,7 @@ int main(int argc, char *argv[]) {
       printf("  [-t total]: total wal files, default is:%d\n", total);
       printf("  [-r rows]: rows of records per wal file, default is:%d\n", rows);
       printf("  [-k keep]: keep the wal after closing, default is:%d\n", keep);
+      printf("  [-g segSize]: size in MB of pre-allocated wal files, default is:%d\n", segSize);
       printf("  [-v version]: initial version, default is:%ld\n", ver);
       printf("  [-d debugFlag]: debug flag, default:%d\n", dDebugFlag);
       printf("  [-h help]: print out this help\n\n");
@@ -83,6 +87,7 @@ int main(int argc, char *argv[]) {
   walCfg.walLevel = level;
   walCfg.wals = max;
   walCfg.keep = keep;
+  walCfg.segSize = segSize * 1024 * 1024;
 
   pWal = walOpen(path, &walCfg);
   if (pWal == NULL) {